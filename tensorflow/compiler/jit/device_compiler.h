@@ -313,10 +313,7 @@ DeviceCompiler<ExecutableType, ClientType>::CompileStrict(
       options, *out_compilation_result, compiler_client_.get());
 
   if (loaded_executable.has_value()) {
-    cache_value.compilation_status = loaded_executable->status();
-    if (loaded_executable->ok()) {
-      out_executable = *std::move(*loaded_executable);
-    }
+    out_executable = *std::move(loaded_executable);
   } else {
     auto built_executable =
         compiler_client_->BuildExecutable(options, *out_compilation_result);
@@ -414,8 +414,8 @@ TEST_F(DeviceCompilerTest, CompileFailedToLoadFromPersistentCache) {
   TF_ASSERT_OK(serialized_executable_file->Close());
 
   // Create another DeviceCompiler object pointing to the same persistent cache
-  // directory. It should error out while loading the executable from the
-  // corrupt file.
+  // directory. The corrupt file should be treated as a cache miss: the cluster
+  // is compiled again and the file is rewritten.
   auto xla_device_compiler_2 =
       CreateXlaDeviceCompiler(/*enable_persistence=*/true);
   core::ScopedUnref xla_device_compiler_ref_2(xla_device_compiler_2);
@@ -423,15 +423,18 @@ TEST_F(DeviceCompilerTest, CompileFailedToLoadFromPersistentCache) {
   const XlaCompiler::CompilationResult* compilation_result_2 = nullptr;
   xla::LocalExecutable* xla_executable_2 = nullptr;
 
-  EXPECT_FALSE(xla_device_compiler_2
-                   ->CompileIfNeeded(options, fn, args,
-                                     XlaCompiler::CompileOptions{},
-                                     DeviceCompileMode::kStrict, profiler_,
-                                     &compilation_result_2, &xla_executable_2)
-                   .ok());
+  TF_EXPECT_OK(xla_device_compiler_2->CompileIfNeeded(
+      options, fn, args, XlaCompiler::CompileOptions{},
+      DeviceCompileMode::kStrict, profiler_, &compilation_result_2,
+      &xla_executable_2));
+
+  EXPECT_TRUE(compilation_result_2 != nullptr);
+  EXPECT_TRUE(xla_executable_2 != nullptr);
 
-  EXPECT_TRUE(compilation_result_2 == nullptr);
-  EXPECT_TRUE(xla_executable_2 == nullptr);
+  XlaSerializedCacheEntry entry;
+  TF_EXPECT_OK(ReadTextOrBinaryProto(Env::Default(),
+                                     serialized_executable_filepath, &entry));
+  EXPECT_FALSE(entry.executable().empty());
 }
 
 TEST_F(DeviceCompilerTest, CompileStrictPersistentCacheFailedToPersist) {
@@ -16,8 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_COMPILER_JIT_DEVICE_EXECUTABLE_PERSISTOR_H_
 #define TENSORFLOW_COMPILER_JIT_DEVICE_EXECUTABLE_PERSISTOR_H_
 
+#include <algorithm>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "absl/log/log.h"
 #include "tensorflow/compiler/jit/xla_compilation_cache.pb.h"
@@ -28,6 +31,9 @@ limitations under the License.
 #include "xla/util.h"
 #include "tensorflow/core/framework/device.h"
 #include "tensorflow/core/lib/strings/proto_serialization.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/statusor.h"
@@ -74,6 +80,17 @@ class DeviceExecutablePersistor {
 
     // Cache is read-only if set to true.
     bool persistent_cache_directory_read_only = false;
+
+    // Fingerprint of the compiler and the target it generates code for. It is
+    // part of the cache key, so that entries persisted by a different TF
+    // build, with different XLA flags or on a different host CPU are not
+    // loaded. Zero if unknown.
+    uint64 compiler_fingerprint = 0;
+
+    // If positive, after persisting an entry the least recently used entries
+    // are evicted until the cache directory holds at most this many bytes of
+    // entries.
+    int64_t persistent_cache_max_size_bytes = 0;
   };
 
   DeviceExecutablePersistor(const Config& config,
@@ -81,12 +98,15 @@ class DeviceExecutablePersistor {
   virtual ~DeviceExecutablePersistor() = default;
 
   // Returns std::nullopt if persistence is not enabled (i.e.
-  // `persistent_cache_directory_` is empty) or if the serialized entry is not
-  // found on disk. Otherwise, loads and returns the serialized executable
-  // (or returns a status).
+  // `persistent_cache_directory_` is empty) or if no usable serialized entry is
+  // found on disk. Otherwise, loads and returns the serialized executable.
+  // An entry that cannot be read, fails verification or fails to load is
+  // treated as missing: the failure is logged and the entry is deleted (unless
+  // the cache is read-only), so that the caller builds and persists the
+  // executable again.
   // TODO(b/255826209): Take in Signature instead of hash and string once cache
   // is refactored.
-  std::optional<StatusOr<std::unique_ptr<ExecutableType>>> TryToLoadExecutable(
+  std::optional<std::unique_ptr<ExecutableType>> TryToLoadExecutable(
       uint64 signature_hash, const std::string& signature_str,
       const XlaCompiler::Options& options,
       const XlaCompiler::CompilationResult& compilation_result,
@@ -137,11 +157,26 @@ class DeviceExecutablePersistor {
   StatusOr<std::optional<XlaSerializedCacheEntry>> TryToReadSerializedEntry(
       const XlaSerializedCacheKey& key) const;
 
-  // Checks if the loaded `entry` matches the expected `key` and `hlo_module`.
+  // Checks if the loaded `entry` matches the expected `key` and `hlo_module`,
+  // and that its executable was not corrupted.
   Status VerifyLoadedCacheEntry(const XlaSerializedCacheKey& key,
                                 const xla::HloModuleProto& hlo_module,
                                 const XlaSerializedCacheEntry& entry) const;
 
+  // Records that the entry at `file_path` was used, for the purpose of
+  // evicting the least recently used entries.
+  void MarkEntryUsed(const std::string& file_path) const;
+
+  // Logs why the entry at `file_path` cannot be used and deletes it along with
+  // its used marker, unless the cache is read-only.
+  void DiscardEntry(const std::string& file_path, const Status& status) const;
+
+  // Deletes the least recently used entries (other than the one at
+  // `keep_file_path`) until the cache directory holds at most
+  // `persistent_cache_max_size_bytes_` bytes of entries. Entries concurrently
+  // deleted by other processes are skipped.
+  Status EvictLeastRecentlyUsedEntries(const std::string& keep_file_path) const;
+
   std::string XlaSerializedCacheKeyToString(
       const XlaSerializedCacheKey& key) const;
   std::string GetFilePath(const XlaSerializedCacheKey& key) const;
@@ -157,6 +192,9 @@ class DeviceExecutablePersistor {
   // Cache is read-only if set to true.
   const bool persistent_cache_directory_read_only_;
 
+  const uint64 compiler_fingerprint_;
+  const int64_t persistent_cache_max_size_bytes_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(DeviceExecutablePersistor);
 };
 
@@ -169,7 +207,14 @@ DeviceExecutablePersistor<ExecutableType, ClientType>::
       persistence_prefix_(config.persistence_prefix),
       persistent_cache_directory_(config.persistent_cache_directory),
       persistent_cache_directory_read_only_(
-          config.persistent_cache_directory_read_only) {}
+          config.persistent_cache_directory_read_only),
+      compiler_fingerprint_(config.compiler_fingerprint),
+      persistent_cache_max_size_bytes_(
+          config.persistent_cache_max_size_bytes) {}
+
+// Suffix of the marker file whose modification time records the last use of
+// the entry it is named after.
+inline constexpr char kXlaSerializedCacheEntryUsedSuffix[] = ".used";
 
 template <typename ExecutableType, typename ClientType>
 std::string DeviceExecutablePersistor<ExecutableType, ClientType>::
@@ -180,6 +225,10 @@ std::string DeviceExecutablePersistor<ExecutableType, ClientType>::
       key.signature_fingerprint(), kXlaSerializedCacheKeySeparator,
       key.cluster_fingerprint(), kXlaSerializedCacheKeySeparator,
       key.device_type(),
+      key.compiler_fingerprint() == 0
+          ? ""
+          : absl::StrCat(kXlaSerializedCacheKeySeparator,
+                         key.compiler_fingerprint()),
       key.compiled_using_pjrt()
           ? absl::StrCat(kXlaSerializedCacheKeySeparator, "pjrt")
           : "");
@@ -204,6 +253,7 @@ DeviceExecutablePersistor<ExecutableType, ClientType>::BuildSerializedCacheKey(
   key.set_device_type(device_type().type_string());
   key.set_prefix(persistence_prefix());
   key.set_compiled_using_pjrt(compiled_using_pjrt);
+  key.set_compiler_fingerprint(compiler_fingerprint_);
   return key;
 }
 
@@ -235,7 +285,12 @@ DeviceExecutablePersistor<ExecutableType, ClientType>::TryToReadSerializedEntry(
   }
 
   XlaSerializedCacheEntry entry;
-  TF_RETURN_IF_ERROR(ReadTextOrBinaryProto(env, file_path, &entry));
+  Status status = ReadTextOrBinaryProto(env, file_path, &entry);
+  if (errors::IsNotFound(status)) {
+    // The entry was evicted by another process since we checked for it.
+    return StatusOr<std::optional<XlaSerializedCacheEntry>>(std::nullopt);
+  }
+  TF_RETURN_IF_ERROR(status);
   return std::optional<XlaSerializedCacheEntry>(entry);
 }
 
@@ -270,6 +325,101 @@ DeviceExecutablePersistor<ExecutableType, ClientType>::VerifyLoadedCacheEntry(
   if (entry.executable().empty()) {
     return errors::InvalidArgument("No binary found in serialized entry.");
   }
+  if (entry.executable_fingerprint() != 0 &&
+      entry.executable_fingerprint() != Fingerprint64(entry.executable())) {
+    return errors::InvalidArgument(
+        "Serialized executable does not match its fingerprint.");
+  }
+  return OkStatus();
+}
+
+template <typename ExecutableType, typename ClientType>
+void DeviceExecutablePersistor<ExecutableType, ClientType>::MarkEntryUsed(
+    const std::string& file_path) const {
+  if (persistent_cache_directory_read_only_ ||
+      persistent_cache_max_size_bytes_ <= 0) {
+    return;
+  }
+  // `Env` has no way to update the modification time of a file, so rewrite an
+  // empty marker file next to the entry instead.
+  WriteStringToFile(Env::Default(),
+                    absl::StrCat(file_path, kXlaSerializedCacheEntryUsedSuffix),
+                    "")
+      .IgnoreError();
+}
+
+template <typename ExecutableType, typename ClientType>
+void DeviceExecutablePersistor<ExecutableType, ClientType>::DiscardEntry(
+    const std::string& file_path, const Status& status) const {
+  LOG(WARNING) << "Ignoring XLA persistent cache entry " << file_path << ": "
+               << status;
+  if (persistent_cache_directory_read_only_) {
+    return;
+  }
+  Env* env = Env::Default();
+  env->DeleteFile(file_path).IgnoreError();
+  env->DeleteFile(absl::StrCat(file_path, kXlaSerializedCacheEntryUsedSuffix))
+      .IgnoreError();
+}
+
+template <typename ExecutableType, typename ClientType>
+Status DeviceExecutablePersistor<ExecutableType, ClientType>::
+    EvictLeastRecentlyUsedEntries(const std::string& keep_file_path) const {
+  if (persistent_cache_max_size_bytes_ <= 0) {
+    return OkStatus();
+  }
+  XLA_SCOPED_LOGGING_TIMER("Evicting persistent cache entries");
+  Env* env = Env::Default();
+  std::vector<std::string> file_paths;
+  TF_RETURN_IF_ERROR(env->GetMatchingPaths(
+      io::JoinPath(persistent_cache_directory_, "*.pb"), &file_paths));
+
+  struct CachedFile {
+    std::string path;
+    int64_t length;
+    int64_t last_used_nsec;
+  };
+  std::vector<CachedFile> files;
+  int64_t total_bytes = 0;
+  for (std::string& path : file_paths) {
+    FileStatistics stats;
+    if (!env->Stat(path, &stats).ok()) {
+      continue;  // Deleted concurrently.
+    }
+    int64_t last_used_nsec = stats.mtime_nsec;
+    FileStatistics used_stats;
+    if (env->Stat(absl::StrCat(path, kXlaSerializedCacheEntryUsedSuffix),
+                  &used_stats)
+            .ok()) {
+      last_used_nsec = std::max(last_used_nsec, used_stats.mtime_nsec);
+    }
+    total_bytes += stats.length;
+    files.push_back({std::move(path), stats.length, last_used_nsec});
+  }
+  if (total_bytes <= persistent_cache_max_size_bytes_) {
+    return OkStatus();
+  }
+
+  std::sort(files.begin(), files.end(),
+            [](const CachedFile& a, const CachedFile& b) {
+              return a.last_used_nsec < b.last_used_nsec;
+            });
+  for (const CachedFile& file : files) {
+    if (total_bytes <= persistent_cache_max_size_bytes_) {
+      break;
+    }
+    if (file.path == keep_file_path) {
+      continue;
+    }
+    Status status = env->DeleteFile(file.path);
+    if (!status.ok() && !errors::IsNotFound(status)) {
+      return status;
+    }
+    env->DeleteFile(absl::StrCat(file.path, kXlaSerializedCacheEntryUsedSuffix))
+        .IgnoreError();
+    VLOG(1) << "Evicted persistent cache entry " << file.path;
+    total_bytes -= file.length;
+  }
   return OkStatus();
 }
 
@@ -304,8 +454,14 @@ DeviceExecutablePersistor<ExecutableType, ClientType>::SaveSerializedEntry(
     return absl::UnavailableError(absl::StrCat(
         "Could not create a unique file inside ", persistent_cache_directory_));
   }
-  TF_RETURN_IF_ERROR(WriteBinaryProto(env, temp_path, entry));
-  return env->RenameFile(temp_path, GetFilePath(entry.key()));
+  Status status = WriteBinaryProto(env, temp_path, entry);
+  if (status.ok()) {
+    status = env->RenameFile(temp_path, GetFilePath(entry.key()));
+  }
+  if (!status.ok()) {
+    env->DeleteFile(temp_path).IgnoreError();
+  }
+  return status;
 }
 
 template <typename ExecutableType, typename ClientType>
@@ -344,7 +500,7 @@ DeviceExecutablePersistor<ExecutableType, ClientType>::SerializeEntry(
 }
 
 template <typename ExecutableType, typename ClientType>
-std::optional<StatusOr<std::unique_ptr<ExecutableType>>>
+std::optional<std::unique_ptr<ExecutableType>>
 DeviceExecutablePersistor<ExecutableType, ClientType>::TryToLoadExecutable(
     uint64 signature_hash, const std::string& signature_str,
     const XlaCompiler::Options& options,
@@ -359,24 +515,40 @@ DeviceExecutablePersistor<ExecutableType, ClientType>::TryToLoadExecutable(
 
   XlaSerializedCacheKey cache_key =
       BuildSerializedCacheKey(signature_hash, hlo_module);
+  const std::string file_path = GetFilePath(cache_key);
 
   std::optional<XlaSerializedCacheEntry> serialized_entry;
   {
     XLA_SCOPED_LOGGING_TIMER(
         absl::StrCat("Try loading serialized cache entry:", signature_str));
-    TF_ASSIGN_OR_RETURN(serialized_entry, TryToReadSerializedEntry(cache_key));
+    auto read_entry = TryToReadSerializedEntry(cache_key);
+    if (!read_entry.ok()) {
+      DiscardEntry(file_path, read_entry.status());
+      return std::nullopt;
+    }
+    serialized_entry = *std::move(read_entry);
   }
 
   if (!serialized_entry.has_value()) {
     return std::nullopt;
   }
 
-  TF_RETURN_IF_ERROR(
-      VerifyLoadedCacheEntry(cache_key, hlo_module, *serialized_entry));
+  Status status =
+      VerifyLoadedCacheEntry(cache_key, hlo_module, *serialized_entry);
+  if (!status.ok()) {
+    DiscardEntry(file_path, status);
+    return std::nullopt;
+  }
 
   VLOG(1) << "Loading cached entry for: " << signature_str;
-  return compiler_client->LoadExecutable(options, compilation_result,
-                                         serialized_entry->executable());
+  auto executable = compiler_client->LoadExecutable(
+      options, compilation_result, serialized_entry->executable());
+  if (!executable.ok()) {
+    DiscardEntry(file_path, executable.status());
+    return std::nullopt;
+  }
+  MarkEntryUsed(file_path);
+  return *std::move(executable);
 }
 
 template <typename ExecutableType, typename ClientType>
@@ -399,7 +571,16 @@ DeviceExecutablePersistor<ExecutableType, ClientType>::TryToPersistExecutable(
   TF_ASSIGN_OR_RETURN(XlaSerializedCacheEntry serialized_entry,
                       SerializeEntry(signature_hash, options,
                                      compilation_result, executable, client));
-  TF_RETURN_IF_ERROR(SaveSerializedEntry(std::move(serialized_entry)));
+  serialized_entry.set_executable_fingerprint(
+      Fingerprint64(serialized_entry.executable()));
+  TF_RETURN_IF_ERROR(SaveSerializedEntry(serialized_entry));
+
+  Status status =
+      EvictLeastRecentlyUsedEntries(GetFilePath(serialized_entry.key()));
+  if (!status.ok()) {
+    LOG(WARNING) << "Failed to evict entries from the XLA persistent cache at "
+                 << persistent_cache_directory_ << ": " << status;
+  }
   return OkStatus();
 }
 
@@ -38,8 +38,11 @@ limitations under the License.
 #include "xla/pjrt/tfrt_cpu_pjrt_client.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/path.h"
 #include "tensorflow/core/platform/status_matchers.h"
 #include "tensorflow/core/platform/statusor.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/tfrt/common/create_pjrt_client_util.h"
 #include "tensorflow/core/tfrt/common/pjrt_util.h"
 
@@ -54,6 +57,43 @@ using XlaDeviceExecutablePersistor =
 using PjRtDeviceExecutablePersistor =
     DeviceExecutablePersistor<xla::PjRtLoadedExecutable, xla::PjRtClient>;
 
+// Compiles a graph that adds (or multiplies, if `mul` is true) two int32
+// vectors of `size` elements.
+StatusOr<XlaCompiler::CompilationResult> BuildCompilationResult(
+    const XlaCompiler::Options& options, bool mul = false, int64_t size = 2) {
+  std::unique_ptr<Graph> graph(new Graph(OpRegistry::Global()));
+  Scope scope = Scope::NewRootScope().ExitOnError();
+  auto a = ops::_Arg(scope.WithOpName("A"), DT_INT32, 0);
+  auto b = ops::_Arg(scope.WithOpName("B"), DT_INT32, 1);
+  if (mul) {
+    auto c = ops::Mul(scope.WithOpName("C"), a, b);
+    auto d = ops::_Retval(scope.WithOpName("D"), c, 0);
+    TF_RETURN_IF_ERROR(scope.ToGraph(graph.get()));
+  } else {
+    auto c = ops::Add(scope.WithOpName("C"), a, b);
+    auto d = ops::_Retval(scope.WithOpName("D"), c, 0);
+    TF_RETURN_IF_ERROR(scope.ToGraph(graph.get()));
+  }
+
+  // Builds a description of the arguments.
+  std::vector<XlaCompiler::Argument> args(2);
+  args[0].kind = XlaCompiler::Argument::kParameter;
+  args[0].type = DT_INT32;
+  args[0].shape = TensorShape({size});
+  args[1].kind = XlaCompiler::Argument::kParameter;
+  args[1].type = DT_INT32;
+  args[1].shape = TensorShape({size});
+
+  // Compiles the graph.
+  XlaCompiler compiler(options);
+
+  XlaCompiler::CompilationResult compilation_result;
+  TF_RETURN_IF_ERROR(compiler.CompileGraph(XlaCompiler::CompileOptions(),
+                                           "graph", std::move(graph), args,
+                                           &compilation_result));
+  return compilation_result;
+}
+
 class DeviceExecutionPersistorTest : public ::testing::Test {
  protected:
   void SetUp() override {
@@ -84,37 +124,7 @@ class DeviceExecutionPersistorTest : public ::testing::Test {
 
   StatusOr<XlaCompiler::CompilationResult> BuildSampleCompilationResult(
       bool mul = false) {
-    std::unique_ptr<Graph> graph(new Graph(OpRegistry::Global()));
-    Scope scope = Scope::NewRootScope().ExitOnError();
-    auto a = ops::_Arg(scope.WithOpName("A"), DT_INT32, 0);
-    auto b = ops::_Arg(scope.WithOpName("B"), DT_INT32, 1);
-    if (mul) {
-      auto c = ops::Mul(scope.WithOpName("C"), a, b);
-      auto d = ops::_Retval(scope.WithOpName("D"), c, 0);
-      TF_RETURN_IF_ERROR(scope.ToGraph(graph.get()));
-    } else {
-      auto c = ops::Add(scope.WithOpName("C"), a, b);
-      auto d = ops::_Retval(scope.WithOpName("D"), c, 0);
-      TF_RETURN_IF_ERROR(scope.ToGraph(graph.get()));
-    }
-
-    // Builds a description of the arguments.
-    std::vector<XlaCompiler::Argument> args(2);
-    args[0].kind = XlaCompiler::Argument::kParameter;
-    args[0].type = DT_INT32;
-    args[0].shape = TensorShape({2});
-    args[1].kind = XlaCompiler::Argument::kParameter;
-    args[1].type = DT_INT32;
-    args[1].shape = TensorShape({2});
-
-    // Compiles the graph.
-    XlaCompiler compiler(DefaultXlaOptions());
-
-    XlaCompiler::CompilationResult compilation_result;
-    TF_RETURN_IF_ERROR(compiler.CompileGraph(XlaCompiler::CompileOptions(),
-                                             "graph", std::move(graph), args,
-                                             &compilation_result));
-    return compilation_result;
+    return BuildCompilationResult(DefaultXlaOptions(), mul);
   }
 
   XlaCompiler::Options DefaultXlaOptions() {
@@ -201,6 +211,10 @@ std::string GetFilePath(XlaSerializedCacheKey key,
       key.signature_fingerprint(), kXlaSerializedCacheKeySeparator,
       key.cluster_fingerprint(), kXlaSerializedCacheKeySeparator,
       key.device_type(),
+      key.compiler_fingerprint() == 0
+          ? ""
+          : absl::StrCat(kXlaSerializedCacheKeySeparator,
+                         key.compiler_fingerprint()),
       key.compiled_using_pjrt()
           ? absl::StrCat(kXlaSerializedCacheKeySeparator, "pjrt")
           : "",
@@ -221,7 +235,7 @@ XlaSerializedCacheKey CreateCacheKey(
     uint64 signature_hash,
     const XlaCompiler::CompilationResult& compilation_result,
     const DeviceType& device_type, const std::string& persistence_prefix,
-    bool compiled_using_pjrt = false) {
+    bool compiled_using_pjrt = false, uint64 compiler_fingerprint = 0) {
   XlaSerializedCacheKey key;
   key.set_signature_fingerprint(signature_hash);
   key.set_cluster_fingerprint(
@@ -229,6 +243,7 @@ XlaSerializedCacheKey CreateCacheKey(
   key.set_device_type(device_type.type_string());
   key.set_prefix(persistence_prefix);
   key.set_compiled_using_pjrt(compiled_using_pjrt);
+  key.set_compiler_fingerprint(compiler_fingerprint);
   return key;
 }
 
@@ -402,9 +417,8 @@ TEST_F(DeviceExecutionPersistorTest, LoadSuccess) {
       /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
       compilation_result_add_, &mock_client);
 
-  EXPECT_TRUE(loaded_executable.has_value());
-  EXPECT_TRUE(loaded_executable.value().ok());
-  EXPECT_TRUE((*loaded_executable.value())->executable() != nullptr);
+  ASSERT_TRUE(loaded_executable.has_value());
+  EXPECT_TRUE((*loaded_executable)->executable() != nullptr);
 }
 
 TEST_F(DeviceExecutionPersistorTest, LoadFileDoesntExist) {
@@ -446,15 +460,19 @@ TEST_F(DeviceExecutionPersistorTest, LoadSerializedKeyMismatch) {
 
   MockXlaCompilerClient mock_client;
   // Try to load an executable from file corresponding to key2 (whose file
-  // content corresponds to key1).
+  // content corresponds to key1). The mismatching entry is treated as missing
+  // and deleted.
   auto loaded_executable = persistor.TryToLoadExecutable(
       /*signature_hash=*/456, "different_signature", DefaultXlaOptions(),
       compilation_result_add_, &mock_client);
 
-  EXPECT_TRUE(loaded_executable.has_value());
-  EXPECT_FALSE(loaded_executable->ok());
-  EXPECT_THAT(loaded_executable.value(),
-              testing::StatusIs(error::INVALID_ARGUMENT));
+  EXPECT_FALSE(loaded_executable.has_value());
+  EXPECT_FALSE(Env::Default()
+                   ->FileExists(GetFilePath(
+                       key2, persistor.persistent_cache_directory()))
+                   .ok());
+  TF_EXPECT_OK(Env::Default()->FileExists(
+      GetFilePath(key1, persistor.persistent_cache_directory())));
 }
 
 TEST_F(DeviceExecutionPersistorTest, LoadSerializedHloMismatch) {
@@ -494,10 +512,11 @@ TEST_F(DeviceExecutionPersistorTest, LoadSerializedHloMismatch) {
       /*signature_hash=*/123, "signature", DefaultXlaOptions(),
       compilation_result_mul, &mock_client);
 
-  EXPECT_TRUE(loaded_executable.has_value());
-  EXPECT_FALSE(loaded_executable->ok());
-  EXPECT_THAT(loaded_executable.value(),
-              testing::StatusIs(error::INVALID_ARGUMENT));
+  EXPECT_FALSE(loaded_executable.has_value());
+  EXPECT_FALSE(Env::Default()
+                   ->FileExists(GetFilePath(
+                       key2, persistor.persistent_cache_directory()))
+                   .ok());
 }
 
 TEST_F(DeviceExecutionPersistorTest, LoadStrictChecksDisabled) {
@@ -540,7 +559,6 @@ TEST_F(DeviceExecutionPersistorTest, LoadStrictChecksDisabled) {
                                     compilation_result_mul, &mock_client);
 
   EXPECT_TRUE(loaded_executable.has_value());
-  EXPECT_TRUE(loaded_executable->ok());
 }
 
 TEST_F(DeviceExecutionPersistorTest, LoadSerializedExecutableEmpty) {
@@ -571,10 +589,11 @@ TEST_F(DeviceExecutionPersistorTest, LoadSerializedExecutableEmpty) {
       /*signature_hash=*/123, "signature", DefaultXlaOptions(),
       compilation_result_add_, &mock_client);
 
-  EXPECT_TRUE(loaded_executable.has_value());
-  EXPECT_FALSE(loaded_executable->ok());
-  EXPECT_THAT(loaded_executable.value(),
-              testing::StatusIs(error::INVALID_ARGUMENT));
+  EXPECT_FALSE(loaded_executable.has_value());
+  EXPECT_FALSE(
+      Env::Default()
+          ->FileExists(GetFilePath(key, persistor.persistent_cache_directory()))
+          .ok());
 }
 
 TEST_F(DeviceExecutionPersistorTest, PersistPjRtAndXlaExecutables) {
@@ -628,5 +647,288 @@ TEST_F(DeviceExecutionPersistorTest, PersistPjRtAndXlaExecutables) {
   EXPECT_EQ(entry.executable(), serialized_xla_executable_);
 }
 
+TEST_F(DeviceExecutionPersistorTest, PersistExecutableFingerprint) {
+  XlaDeviceExecutablePersistor::Config config(
+      /*persistent_cache_directory=*/cache_dir_,
+      /*disable_strict_signature_checks=*/false,
+      /*persistence_prefix=*/"xla_fingerprint");
+  XlaDeviceExecutablePersistor persistor(config,
+                                         DefaultXlaOptions().device_type);
+
+  MockXlaCompilerClient mock_client;
+  EXPECT_CALL(mock_client, SerializeExecutable(_))
+      .WillOnce(Return(serialized_xla_executable_));
+  TF_ASSERT_OK_AND_ASSIGN(auto executable, BuildSampleExecutable());
+  TF_EXPECT_OK(persistor.TryToPersistExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, *executable, &mock_client));
+
+  auto key =
+      CreateCacheKey(/*signature_hash=*/123, compilation_result_add_,
+                     persistor.device_type(), persistor.persistence_prefix());
+  TF_ASSERT_OK_AND_ASSIGN(auto entry, ReadCacheEntryFromFile(key, cache_dir_));
+  EXPECT_EQ(entry.executable_fingerprint(),
+            Fingerprint64(serialized_xla_executable_));
+
+  // Corrupt the executable without updating its fingerprint.
+  entry.mutable_executable()->back() ^= 1;
+  TF_ASSERT_OK(WriteBinaryProto(Env::Default(), GetFilePath(key, cache_dir_),
+                                entry));
+
+  auto loaded_executable = persistor.TryToLoadExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, &mock_client);
+  EXPECT_FALSE(loaded_executable.has_value());
+  EXPECT_FALSE(Env::Default()->FileExists(GetFilePath(key, cache_dir_)).ok());
+}
+
+// A truncated entry, or one that fails to load, is treated as a cache miss:
+// it is deleted, so that the executable is compiled and persisted again.
+TEST_F(DeviceExecutionPersistorTest, LoadCorruptEntryIsRewritten) {
+  const std::string cache_dir = io::JoinPath(cache_dir_, "corrupt");
+  XlaDeviceExecutablePersistor::Config config(
+      /*persistent_cache_directory=*/cache_dir,
+      /*disable_strict_signature_checks=*/false,
+      /*persistence_prefix=*/"xla");
+  XlaDeviceExecutablePersistor persistor(config,
+                                         DefaultXlaOptions().device_type);
+
+  MockXlaCompilerClient mock_client;
+  EXPECT_CALL(mock_client, SerializeExecutable(_))
+      .WillRepeatedly(Return(serialized_xla_executable_));
+  TF_ASSERT_OK_AND_ASSIGN(auto executable, BuildSampleExecutable());
+  TF_ASSERT_OK(persistor.TryToPersistExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, *executable, &mock_client));
+
+  auto key =
+      CreateCacheKey(/*signature_hash=*/123, compilation_result_add_,
+                     persistor.device_type(), persistor.persistence_prefix());
+  const std::string file_path = GetFilePath(key, cache_dir);
+  std::string contents;
+  TF_ASSERT_OK(ReadFileToString(Env::Default(), file_path, &contents));
+  TF_ASSERT_OK(WriteStringToFile(Env::Default(), file_path,
+                                 contents.substr(0, contents.size() / 2)));
+
+  auto loaded_executable = persistor.TryToLoadExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, &mock_client);
+  EXPECT_FALSE(loaded_executable.has_value());
+  EXPECT_FALSE(Env::Default()->FileExists(file_path).ok());
+
+  // The caller then compiles the cluster and persists it again.
+  TF_ASSERT_OK_AND_ASSIGN(executable, BuildSampleExecutable());
+  TF_ASSERT_OK(persistor.TryToPersistExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, *executable, &mock_client));
+  TF_ASSERT_OK_AND_ASSIGN(auto entry, ReadCacheEntryFromFile(key, cache_dir));
+  EXPECT_EQ(entry.executable(), serialized_xla_executable_);
+
+  // An entry that fails to load is discarded as well.
+  EXPECT_CALL(mock_client, LoadExecutable(_, _, serialized_xla_executable_))
+      .WillOnce(Return(errors::Internal("Incompatible executable.")));
+  loaded_executable = persistor.TryToLoadExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, &mock_client);
+  EXPECT_FALSE(loaded_executable.has_value());
+  EXPECT_FALSE(Env::Default()->FileExists(file_path).ok());
+}
+
+TEST_F(DeviceExecutionPersistorTest, LoadCompilerFingerprintMismatch) {
+  XlaDeviceExecutablePersistor::Config config(
+      /*persistent_cache_directory=*/cache_dir_,
+      /*disable_strict_signature_checks=*/false,
+      /*persistence_prefix=*/"xla_compiler");
+  config.compiler_fingerprint = 1;
+  XlaDeviceExecutablePersistor persistor(config,
+                                         DefaultXlaOptions().device_type);
+
+  MockXlaCompilerClient mock_client;
+  EXPECT_CALL(mock_client, SerializeExecutable(_))
+      .WillOnce(Return(serialized_xla_executable_));
+  TF_ASSERT_OK_AND_ASSIGN(auto executable, BuildSampleExecutable());
+  TF_EXPECT_OK(persistor.TryToPersistExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, *executable, &mock_client));
+
+  auto key = CreateCacheKey(/*signature_hash=*/123, compilation_result_add_,
+                            persistor.device_type(),
+                            persistor.persistence_prefix(),
+                            /*compiled_using_pjrt=*/false,
+                            /*compiler_fingerprint=*/1);
+  TF_ASSERT_OK_AND_ASSIGN(auto entry, ReadCacheEntryFromFile(key, cache_dir_));
+  EXPECT_EQ(entry.key().compiler_fingerprint(), 1);
+
+  // A persistor for a different compiler does not find the entry.
+  config.compiler_fingerprint = 2;
+  XlaDeviceExecutablePersistor other_persistor(config,
+                                               DefaultXlaOptions().device_type);
+  auto loaded_executable = other_persistor.TryToLoadExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, &mock_client);
+  EXPECT_FALSE(loaded_executable.has_value());
+
+  EXPECT_CALL(mock_client, LoadExecutable(_, _, serialized_xla_executable_))
+      .WillOnce(Return(ByMove(std::move(executable))));
+  loaded_executable = persistor.TryToLoadExecutable(
+      /*signature_hash=*/123, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, &mock_client);
+  EXPECT_TRUE(loaded_executable.has_value());
+}
+
+TEST_F(DeviceExecutionPersistorTest, EvictLeastRecentlyUsedEntries) {
+  const std::string cache_dir = io::JoinPath(cache_dir_, "lru");
+  XlaDeviceExecutablePersistor::Config config(
+      /*persistent_cache_directory=*/cache_dir,
+      /*disable_strict_signature_checks=*/false,
+      /*persistence_prefix=*/"xla");
+  XlaDeviceExecutablePersistor unbounded_persistor(
+      config, DefaultXlaOptions().device_type);
+
+  MockXlaCompilerClient mock_client;
+  EXPECT_CALL(mock_client, SerializeExecutable(_))
+      .WillRepeatedly(Return(serialized_xla_executable_));
+  TF_ASSERT_OK_AND_ASSIGN(auto executable, BuildSampleExecutable());
+  auto persist = [&](const XlaDeviceExecutablePersistor& persistor,
+                     uint64 signature_hash) {
+    TF_EXPECT_OK(persistor.TryToPersistExecutable(
+        signature_hash, "signature_string", DefaultXlaOptions(),
+        compilation_result_add_, *executable, &mock_client));
+    // Make sure that modification times differ.
+    Env::Default()->SleepForMicroseconds(20 * 1000);
+  };
+  auto exists = [&](uint64 signature_hash) {
+    auto key = CreateCacheKey(signature_hash, compilation_result_add_,
+                              unbounded_persistor.device_type(),
+                              unbounded_persistor.persistence_prefix());
+    return Env::Default()->FileExists(GetFilePath(key, cache_dir)).ok();
+  };
+
+  // All entries have the same size.
+  persist(unbounded_persistor, 1000);
+  uint64 entry_bytes = 0;
+  TF_ASSERT_OK(Env::Default()->GetFileSize(
+      GetFilePath(CreateCacheKey(1000, compilation_result_add_,
+                                 unbounded_persistor.device_type(),
+                                 unbounded_persistor.persistence_prefix()),
+                  cache_dir),
+      &entry_bytes));
+
+  config.persistent_cache_max_size_bytes = 2 * entry_bytes + entry_bytes / 2;
+  XlaDeviceExecutablePersistor persistor(config,
+                                         DefaultXlaOptions().device_type);
+  persist(persistor, 2000);
+  EXPECT_TRUE(exists(1000));
+  EXPECT_TRUE(exists(2000));
+
+  // Using the first entry makes the second one the least recently used.
+  TF_ASSERT_OK_AND_ASSIGN(auto loaded, BuildSampleExecutable());
+  EXPECT_CALL(mock_client, LoadExecutable(_, _, serialized_xla_executable_))
+      .WillOnce(Return(ByMove(std::move(loaded))));
+  auto loaded_executable = persistor.TryToLoadExecutable(
+      /*signature_hash=*/1000, "signature_string", DefaultXlaOptions(),
+      compilation_result_add_, &mock_client);
+  ASSERT_TRUE(loaded_executable.has_value());
+  Env::Default()->SleepForMicroseconds(20 * 1000);
+
+  persist(persistor, 3000);
+  EXPECT_TRUE(exists(1000));
+  EXPECT_FALSE(exists(2000));
+  EXPECT_TRUE(exists(3000));
+}
+
+// Measures the time to get the executables of `kNumClusters` clusters on
+// startup with a cold (state.range(0) == 0) or warm (state.range(0) == 1)
+// persistent cache. With a cold cache every cluster is compiled and persisted,
+// with a warm cache every cluster is loaded from disk.
+void BM_PersistentCacheStartup(::testing::benchmark::State& state) {
+  constexpr int kNumClusters = 50;
+  const bool warm = state.range(0);
+
+  XlaOpRegistry::RegisterCompilationKernels();
+  XlaDeviceCompilerClient client(xla::ClientLibrary::LocalClientOrDie());
+  FunctionLibraryDefinition flib_def(OpRegistry::Global(),
+                                     FunctionDefLibrary());
+  XlaCompiler::Options options;
+  options.device_type = DeviceType(DEVICE_CPU_XLA_JIT);
+  options.client = client.client();
+  options.flib_def = &flib_def;
+
+  std::vector<XlaCompiler::CompilationResult> compilation_results;
+  for (int i = 0; i < kNumClusters; ++i) {
+    auto compilation_result =
+        BuildCompilationResult(options, /*mul=*/i % 2, /*size=*/i + 1);
+    TF_CHECK_OK(compilation_result.status());
+    compilation_results.push_back(std::move(*compilation_result));
+  }
+
+  const std::string cache_dir =
+      io::JoinPath(testing::TmpDir(), "persistent_cache_startup");
+  XlaDeviceExecutablePersistor::Config config(
+      cache_dir, /*disable_strict_signature_checks=*/false,
+      /*persistence_prefix=*/"xla");
+  config.compiler_fingerprint = 1;
+  XlaDeviceExecutablePersistor persistor(config, options.device_type);
+
+  auto compile_and_persist = [&]() -> Status {
+    for (int i = 0; i < kNumClusters; ++i) {
+      TF_ASSIGN_OR_RETURN(
+          auto executable,
+          client.BuildExecutable(options, compilation_results[i]));
+      TF_RETURN_IF_ERROR(persistor.TryToPersistExecutable(
+          i, "signature", options, compilation_results[i], *executable,
+          &client));
+    }
+    return OkStatus();
+  };
+  auto load = [&]() -> Status {
+    for (int i = 0; i < kNumClusters; ++i) {
+      auto executable = persistor.TryToLoadExecutable(
+          i, "signature", options, compilation_results[i], &client);
+      if (!executable.has_value()) {
+        return errors::NotFound("No persisted executable for cluster ", i);
+      }
+    }
+    return OkStatus();
+  };
+  auto clear_cache = [&]() {
+    int64_t undeleted_files, undeleted_dirs;
+    Env::Default()
+        ->DeleteRecursively(cache_dir, &undeleted_files, &undeleted_dirs)
+        .IgnoreError();
+  };
+
+  clear_cache();
+  if (warm) {
+    // Persisting or loading fails if the compiler does not support exporting
+    // executables.
+    Status status = compile_and_persist();
+    if (status.ok()) {
+      status = load();
+    }
+    if (!status.ok()) {
+      state.SkipWithError(status.ToString().c_str());
+      return;
+    }
+  }
+  for (auto s : state) {
+    if (warm) {
+      TF_CHECK_OK(load());
+    } else {
+      state.PauseTiming();
+      clear_cache();
+      state.ResumeTiming();
+      Status status = compile_and_persist();
+      if (!status.ok()) {
+        state.SkipWithError(status.ToString().c_str());
+        break;
+      }
+    }
+  }
+  clear_cache();
+}
+
+BENCHMARK(BM_PersistentCacheStartup)->Arg(0)->Arg(1)->UseRealTime();
+
 }  // namespace
 }  // namespace tensorflow
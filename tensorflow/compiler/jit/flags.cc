@@ -167,6 +167,11 @@ void AppendMarkForCompilationPassFlagsInternal(std::vector<Flag>* flag_list) {
       Flag("tf_xla_persistent_cache_read_only",
            &mark_for_compilation_flags->tf_xla_persistent_cache_read_only,
            "If true, the persistent cache will be read-only."),
+      Flag("tf_xla_persistent_cache_max_size_mb",
+           &mark_for_compilation_flags->tf_xla_persistent_cache_max_size_mb,
+           "If positive, the least recently used entries of the persistent "
+           "cache are evicted once the cache directory holds more than this "
+           "many megabytes. Unlimited by default."),
       Flag("tf_xla_disable_strict_signature_checks",
            &mark_for_compilation_flags->tf_xla_disable_strict_signature_checks,
            "If true, entires loaded into the XLA compile cache will not have "
@@ -242,6 +247,7 @@ void AllocateAndParseFlags() {
   mark_for_compilation_flags->tf_xla_persistent_cache_directory = "";
   mark_for_compilation_flags->tf_xla_persistent_cache_device_types = "";
   mark_for_compilation_flags->tf_xla_persistent_cache_read_only = false;
+  mark_for_compilation_flags->tf_xla_persistent_cache_max_size_mb = 0;
   mark_for_compilation_flags->tf_xla_disable_strict_signature_checks = false;
   mark_for_compilation_flags->tf_xla_persistent_cache_prefix =
       "xla_compile_cache";
@@ -104,6 +104,10 @@ struct MarkForCompilationPassFlags {
 
   bool tf_xla_persistent_cache_read_only;
 
+  // If positive, the least recently used entries of the persistent cache are
+  // evicted once the cache directory holds more than this many megabytes.
+  int64_t tf_xla_persistent_cache_max_size_mb;
+
   // If true, entries loaded into the XLA compile cache will not have their
   // signatures checked strictly. This should generally not be disabled except
   // for debugging. Defaults to false.
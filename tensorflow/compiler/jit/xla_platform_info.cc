@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/xla_platform_info.h"
 
+#include <cstdlib>
 #include <memory>
 #include <optional>
 #include <set>
@@ -24,6 +25,7 @@ limitations under the License.
 
 #include "absl/algorithm/container.h"
 #include "absl/status/status.h"
+#include "absl/strings/str_cat.h"
 #include "absl/strings/str_split.h"
 #include "absl/strings/string_view.h"
 #include "tensorflow/compiler/jit/device_executable_persistor.h"
@@ -31,6 +33,7 @@ limitations under the License.
 #include "tensorflow/compiler/jit/pjrt_device_compiler_client.h"
 #include "tensorflow/compiler/jit/xla_compile_util.h"
 #include "tensorflow/compiler/jit/xla_device_compiler_client.h"
+#include "tensorflow/compiler/tf2xla/xla_op_registry.h"
 #include "xla/client/client_library.h"
 #include "xla/client/local_client.h"
 #include "xla/pjrt/pjrt_client.h"
@@ -38,7 +41,10 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/resource_mgr.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/cpu_info.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/public/version.h"
 #include "tensorflow/core/tfrt/common/create_pjrt_client_util.h"
 #include "tensorflow/core/tfrt/common/global_state.h"
 #include "tensorflow/core/tfrt/common/pjrt_util.h"
@@ -64,16 +70,28 @@ XlaDeviceCompiler* CreateXlaDeviceCompiler(
       std::make_unique<XlaDeviceCompilerClient>(local_client));
 }
 
+// Returns the persistor configuration for `device_type` from the XLA flags.
+template <typename PersistorConfig>
+PersistorConfig GetPersistorConfig(const DeviceType& device_type) {
+  const MarkForCompilationPassFlags* flags = GetMarkForCompilationPassFlags();
+  PersistorConfig config(GetPersistentCacheDirectory(device_type),
+                         flags->tf_xla_disable_strict_signature_checks,
+                         flags->tf_xla_persistent_cache_prefix,
+                         flags->tf_xla_persistent_cache_read_only);
+  if (!config.persistent_cache_directory.empty()) {
+    config.compiler_fingerprint =
+        GetPersistentCacheCompilerFingerprint(device_type);
+    config.persistent_cache_max_size_bytes =
+        flags->tf_xla_persistent_cache_max_size_mb << 20;
+  }
+  return config;
+}
+
 PjRtDeviceCompiler* CreatePjRtDeviceCompiler(DeviceType compilation_device_type,
                                              xla::PjRtClient* pjrt_client) {
-  std::string persistent_cache_directory =
-      GetPersistentCacheDirectory(compilation_device_type);
-
-  PjRtDeviceExecutablePersistor::Config persistor_config(
-      persistent_cache_directory,
-      GetMarkForCompilationPassFlags()->tf_xla_disable_strict_signature_checks,
-      GetMarkForCompilationPassFlags()->tf_xla_persistent_cache_prefix,
-      GetMarkForCompilationPassFlags()->tf_xla_persistent_cache_read_only);
+  auto persistor_config =
+      GetPersistorConfig<PjRtDeviceExecutablePersistor::Config>(
+          compilation_device_type);
 
   return new PjRtDeviceCompiler(
       std::make_unique<PjRtDeviceExecutablePersistor>(
@@ -166,6 +184,27 @@ std::string GetPersistentCacheDirectory(
   return GetMarkForCompilationPassFlags()->tf_xla_persistent_cache_directory;
 }
 
+uint64 GetPersistentCacheCompilerFingerprint(const DeviceType& device_type) {
+  std::string compiler = TF_VERSION_STRING;
+  if (const char* xla_flags = std::getenv("XLA_FLAGS")) {
+    absl::StrAppend(&compiler, ";", xla_flags);
+  }
+  // The CPU backend generates code for the features of the host CPU.
+  if (device_type == DeviceType(DEVICE_CPU) ||
+      device_type == DeviceType(DEVICE_CPU_XLA_JIT) ||
+      device_type == DeviceType(DEVICE_XLA_CPU)) {
+    absl::StrAppend(&compiler, ";", port::CPUVendorIDString(), ";",
+                    port::CPUFamily(), ";", port::CPUModelNum(), ";");
+    for (int feature = port::MMX; feature <= port::AMX_BF16; ++feature) {
+      absl::StrAppend(
+          &compiler,
+          port::TestCPUFeature(static_cast<port::CPUFeature>(feature)) ? "1"
+                                                                       : "0");
+    }
+  }
+  return Fingerprint64(compiler);
+}
+
 xla::StatusOr<std::optional<std::set<int>>> ParseVisibleDeviceList(
     absl::string_view visible_device_list) {
   std::set<int> gpu_ids;
@@ -190,14 +229,9 @@ xla::StatusOr<std::optional<std::set<int>>> ParseVisibleDeviceList(
 Status BuildXlaDeviceCompiler(DeviceBase* device, FunctionLibraryRuntime* flr,
                               const XlaPlatformInfo& platform_info,
                               XlaDeviceCompiler** xla_device_compiler) {
-  std::string persistent_cache_directory =
-      GetPersistentCacheDirectory(platform_info.device_type());
-
-  XlaDeviceExecutablePersistor::Config persistor_config(
-      persistent_cache_directory,
-      GetMarkForCompilationPassFlags()->tf_xla_disable_strict_signature_checks,
-      GetMarkForCompilationPassFlags()->tf_xla_persistent_cache_prefix,
-      GetMarkForCompilationPassFlags()->tf_xla_persistent_cache_read_only);
+  auto persistor_config =
+      GetPersistorConfig<XlaDeviceExecutablePersistor::Config>(
+          platform_info.device_type());
 
   if (platform_info.xla_device_metadata()) {
     *xla_device_compiler = CreateXlaDeviceCompiler(
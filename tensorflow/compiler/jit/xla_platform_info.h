@@ -149,6 +149,12 @@ XlaPlatformInfo XlaPlatformInfoFromDevice(DeviceBase* device);
 std::string GetPersistentCacheDirectory(
     const DeviceType& compilation_device_type);
 
+// Returns a fingerprint of the compiler and target that executables for
+// `device_type` are built with: the TF version, the XLA flags and, for CPU
+// devices, the host CPU and its features. Persisted executables are only
+// loaded by processes with the same fingerprint.
+uint64 GetPersistentCacheCompilerFingerprint(const DeviceType& device_type);
+
 // Returns allocator from platform info if non-null, or populate and return a
 // pointer to the allocator adapter with allocator from context.
 //
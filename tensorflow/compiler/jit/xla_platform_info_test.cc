@@ -15,7 +15,10 @@ limitations under the License.
 
 #include "tensorflow/compiler/jit/xla_platform_info.h"
 
+#include <stdlib.h>
+
 #include <memory>
+#include <string>
 #include <vector>
 
 #include <gtest/gtest.h>
@@ -293,5 +296,29 @@ TEST_F(XlaPlatformInfoTest, GetPersistentCacheDirectoryNoDeviceTypes) {
   EXPECT_EQ(GetPersistentCacheDirectory(device_tpu), "/tmp/xla_cache");
 }
 
+TEST_F(XlaPlatformInfoTest, GetPersistentCacheCompilerFingerprint) {
+  DeviceType device_cpu = DeviceType(DEVICE_CPU_XLA_JIT);
+  DeviceType device_gpu = DeviceType(DEVICE_GPU_XLA_JIT);
+  const uint64 cpu_fingerprint =
+      GetPersistentCacheCompilerFingerprint(device_cpu);
+  EXPECT_NE(cpu_fingerprint, 0);
+  EXPECT_EQ(GetPersistentCacheCompilerFingerprint(device_cpu),
+            cpu_fingerprint);
+  // Only CPU executables depend on the host CPU.
+  EXPECT_NE(GetPersistentCacheCompilerFingerprint(device_gpu),
+            cpu_fingerprint);
+
+  const char* xla_flags = getenv("XLA_FLAGS");
+  const std::string original_xla_flags = xla_flags ? xla_flags : "";
+  setenv("XLA_FLAGS", "--xla_cpu_enable_fast_math=true", /*overwrite=*/1);
+  EXPECT_NE(GetPersistentCacheCompilerFingerprint(device_cpu),
+            cpu_fingerprint);
+  if (xla_flags) {
+    setenv("XLA_FLAGS", original_xla_flags.c_str(), /*overwrite=*/1);
+  } else {
+    unsetenv("XLA_FLAGS");
+  }
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -0,0 +1,277 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/critical_path_analyzer.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env_time.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace {
+
+int64_t ElapsedNanos(const NodeExecStats& stats) {
+  return stats.all_end_rel_nanos() > 0
+             ? stats.all_end_rel_nanos()
+             : stats.all_end_rel_micros() * EnvTime::kMicrosToNanos;
+}
+
+int64_t StartNanos(const NodeExecStats& stats) {
+  return stats.all_start_nanos() > 0
+             ? stats.all_start_nanos()
+             : stats.all_start_micros() * EnvTime::kMicrosToNanos;
+}
+
+// Times of all executions of a node in a step.
+struct NodeTimes {
+  int64_t elapsed_nanos = 0;
+  // Start of the first and end of the last execution.
+  int64_t start_nanos = 0;
+  int64_t end_nanos = 0;
+};
+
+// Returns the key matching a _Send node with its _Recv node.
+bool GetTransferKey(const Node* node, string* key) {
+  string tensor_name, send_device, recv_device;
+  if (!TryGetNodeAttr(node->attrs(), "tensor_name", &tensor_name) ||
+      !TryGetNodeAttr(node->attrs(), "send_device", &send_device) ||
+      !TryGetNodeAttr(node->attrs(), "recv_device", &recv_device)) {
+    return false;
+  }
+  *key = strings::StrCat(send_device, ";", recv_device, ";", tensor_name);
+  return true;
+}
+
+struct DagNode {
+  const Node* node;
+  const string* device;
+  int64_t nanos = 0;
+  const NodeTimes* times = nullptr;
+  bool ran = false;
+  int num_pending_preds = 0;
+  std::vector<int> succs;
+};
+
+}  // namespace
+
+void CriticalPathAnalyzer::AddStep(
+    const StepStats& step_stats,
+    const std::unordered_map<string, const Graph*>& device_map) {
+  // Times of each node that ran in the step, by device and node name.
+  absl::flat_hash_map<StringPiece, absl::flat_hash_map<StringPiece, NodeTimes>>
+      node_times;
+  for (const DeviceStepStats& device_stats : step_stats.dev_stats()) {
+    auto& device_node_times = node_times[device_stats.device()];
+    for (const NodeExecStats& node_stats : device_stats.node_stats()) {
+      const int64_t elapsed_nanos = ElapsedNanos(node_stats);
+      const int64_t start_nanos = StartNanos(node_stats);
+      auto it = device_node_times.find(node_stats.node_name());
+      if (it == device_node_times.end()) {
+        device_node_times[node_stats.node_name()] = {
+            elapsed_nanos, start_nanos, start_nanos + elapsed_nanos};
+        continue;
+      }
+      NodeTimes& times = it->second;
+      times.elapsed_nanos += elapsed_nanos;
+      times.start_nanos = std::min(times.start_nanos, start_nanos);
+      times.end_nanos =
+          std::max(times.end_nanos, start_nanos + elapsed_nanos);
+    }
+  }
+
+  // Visit devices in name order, so that ties between paths are broken the
+  // same way in every step.
+  std::vector<std::pair<const string*, const Graph*>> graphs;
+  graphs.reserve(device_map.size());
+  for (const auto& it : device_map) graphs.emplace_back(&it.first, it.second);
+  std::sort(graphs.begin(), graphs.end(),
+            [](const auto& a, const auto& b) { return *a.first < *b.first; });
+
+  std::vector<DagNode> dag;
+  absl::flat_hash_map<const Node*, int> index;
+  absl::flat_hash_map<string, int> sends;
+  string key;
+  for (const auto& it : graphs) {
+    const auto device_it = node_times.find(*it.first);
+    for (const Node* n : it.second->op_nodes()) {
+      DagNode dag_node;
+      dag_node.node = n;
+      dag_node.device = it.first;
+      if (device_it != node_times.end()) {
+        const auto node_it = device_it->second.find(n->name());
+        if (node_it != device_it->second.end()) {
+          dag_node.nanos = node_it->second.elapsed_nanos;
+          dag_node.times = &node_it->second;
+          dag_node.ran = true;
+        }
+      }
+      index[n] = dag.size();
+      if (n->IsSend() && GetTransferKey(n, &key)) sends[key] = dag.size();
+      dag.push_back(std::move(dag_node));
+    }
+  }
+  auto add_edge = [&dag](int src, int dst) {
+    dag[src].succs.push_back(dst);
+    ++dag[dst].num_pending_preds;
+  };
+  for (int i = 0; i < dag.size(); ++i) {
+    const Node* n = dag[i].node;
+    for (const Edge* e : n->in_edges()) {
+      // Skip back edges of loops; the time of all iterations is already
+      // included in the times of the loop's nodes.
+      if (!e->src()->IsOp() || e->src()->IsNextIteration()) continue;
+      add_edge(index.at(e->src()), i);
+    }
+    if (n->IsRecv() && GetTransferKey(n, &key)) {
+      const auto send_it = sends.find(key);
+      if (send_it == sends.end()) continue;
+      add_edge(send_it->second, i);
+      // A _Recv mostly waits for its _Send, whose time is already on the
+      // path through the _Send edge, so only count the time it ran after the
+      // _Send finished.
+      const DagNode& send = dag[send_it->second];
+      if (dag[i].ran && send.ran) {
+        const int64_t recv_nanos =
+            dag[i].times->end_nanos -
+            std::max(dag[i].times->start_nanos, send.times->end_nanos);
+        dag[i].nanos =
+            std::min(dag[i].nanos, std::max<int64_t>(recv_nanos, 0));
+      }
+    }
+  }
+
+  // Compute the earliest finish time of each node in topological order, and
+  // the predecessor that determines it.
+  std::vector<int> order;
+  order.reserve(dag.size());
+  for (int i = 0; i < dag.size(); ++i) {
+    if (dag[i].num_pending_preds == 0) order.push_back(i);
+  }
+  std::vector<int64_t> earliest_start(dag.size(), 0);
+  std::vector<int64_t> earliest_finish(dag.size(), 0);
+  std::vector<int> critical_pred(dag.size(), -1);
+  for (int o = 0; o < order.size(); ++o) {
+    const int i = order[o];
+    earliest_finish[i] = earliest_start[i] + dag[i].nanos;
+    for (int s : dag[i].succs) {
+      if (earliest_finish[i] > earliest_start[s]) {
+        earliest_start[s] = earliest_finish[i];
+        critical_pred[s] = i;
+      }
+      if (--dag[s].num_pending_preds == 0) order.push_back(s);
+    }
+  }
+  if (order.size() < dag.size()) {
+    LOG(WARNING) << "Skipping critical path analysis of a step whose graphs "
+                 << "have a cycle.";
+    return;
+  }
+
+  int last = -1;
+  int64_t critical_path_nanos = 0;
+  for (int i : order) {
+    if (last < 0 || earliest_finish[i] > critical_path_nanos) {
+      last = i;
+      critical_path_nanos = earliest_finish[i];
+    }
+  }
+  std::vector<bool> on_critical_path(dag.size(), false);
+  std::vector<int> critical_path;
+  for (int i = last; i >= 0; i = critical_pred[i]) {
+    on_critical_path[i] = true;
+    if (dag[i].ran) critical_path.push_back(i);
+  }
+  std::reverse(critical_path.begin(), critical_path.end());
+
+  // Compute the latest finish time of each node that does not delay the end
+  // of the step.
+  std::vector<int64_t> latest_finish(dag.size(), critical_path_nanos);
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    for (int s : dag[*it].succs) {
+      latest_finish[*it] =
+          std::min(latest_finish[*it], latest_finish[s] - dag[s].nanos);
+    }
+  }
+
+  mutex_lock l(mu_);
+  ++num_steps_;
+  critical_path_nanos_ = critical_path_nanos;
+  total_critical_path_nanos_ += critical_path_nanos;
+  critical_path_.clear();
+  for (int i : critical_path) critical_path_.push_back(dag[i].node->name());
+  for (int i = 0; i < dag.size(); ++i) {
+    const DagNode& dag_node = dag[i];
+    if (!dag_node.ran) continue;
+    const int64_t slack_nanos = latest_finish[i] - earliest_finish[i];
+    CriticalPathNodeStats& stats =
+        node_stats_[NodeKey(*dag_node.device, dag_node.node->name())];
+    if (stats.num_steps() == 0) {
+      stats.set_node_name(dag_node.node->name());
+      stats.set_device(*dag_node.device);
+      stats.set_min_slack_nanos(slack_nanos);
+    }
+    stats.set_num_steps(stats.num_steps() + 1);
+    stats.set_total_nanos(stats.total_nanos() + dag_node.nanos);
+    stats.set_min_slack_nanos(std::min(stats.min_slack_nanos(), slack_nanos));
+    stats.set_total_slack_nanos(stats.total_slack_nanos() + slack_nanos);
+    if (on_critical_path[i]) {
+      stats.set_num_critical_steps(stats.num_critical_steps() + 1);
+      stats.set_total_critical_nanos(stats.total_critical_nanos() +
+                                     dag_node.nanos);
+    }
+  }
+}
+
+void CriticalPathAnalyzer::ExportReport(int max_nodes,
+                                        CriticalPathReport* report) const {
+  mutex_lock l(mu_);
+  report->Clear();
+  report->set_num_steps(num_steps_);
+  report->set_critical_path_nanos(critical_path_nanos_);
+  report->set_total_critical_path_nanos(total_critical_path_nanos_);
+  for (const string& name : critical_path_) report->add_critical_path(name);
+
+  // Order nodes by time on the critical path, then by mean slack, so that
+  // nodes which never were on the critical path but were close follow.
+  std::vector<const CriticalPathNodeStats*> nodes;
+  nodes.reserve(node_stats_.size());
+  for (const auto& it : node_stats_) nodes.push_back(&it.second);
+  const auto by_criticality = [](const CriticalPathNodeStats* a,
+                                 const CriticalPathNodeStats* b) {
+    if (a->total_critical_nanos() != b->total_critical_nanos()) {
+      return a->total_critical_nanos() > b->total_critical_nanos();
+    }
+    const double a_slack =
+        static_cast<double>(a->total_slack_nanos()) / a->num_steps();
+    const double b_slack =
+        static_cast<double>(b->total_slack_nanos()) / b->num_steps();
+    if (a_slack != b_slack) return a_slack < b_slack;
+    return std::tie(a->device(), a->node_name()) <
+           std::tie(b->device(), b->node_name());
+  };
+  const int num_reported =
+      std::min<int>(std::max(max_nodes, 0), nodes.size());
+  std::partial_sort(nodes.begin(), nodes.begin() + num_reported, nodes.end(),
+                    by_criticality);
+  for (int i = 0; i < num_reported; ++i) {
+    *report->add_nodes() = *nodes[i];
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,75 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_COMMON_RUNTIME_CRITICAL_PATH_ANALYZER_H_
+#define TENSORFLOW_CORE_COMMON_RUNTIME_CRITICAL_PATH_ANALYZER_H_
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Computes the critical path of steps from their step stats, and aggregates
+// per-node critical path statistics over all steps of a session.
+//
+// The nodes of the graphs of all devices of a step form a DAG, whose edges
+// are the data and control edges of the graphs plus an edge from each _Send
+// to its matching _Recv. Each node is weighted by its measured wall time
+// (summed over all its executions in the step), or zero if it has no stats.
+// A _Recv whose _Send also has stats is only weighted by the time it ran
+// after the _Send finished, since the time it waited for the _Send is
+// already counted on the path through the _Send.
+// The critical path is the longest path through the DAG, and the slack of a
+// node is how much its time could grow before the critical path lengthens.
+// The critical path only accounts for dependencies, not for time spent
+// waiting for a thread to run on. It is not a strict lower bound of the step
+// latency: a node's time may include waits that the DAG does not model, and
+// the _Recv adjustment relies on the clocks of the devices agreeing.
+class CriticalPathAnalyzer {
+ public:
+  // Computes the critical path of a step through the graphs in `device_map`,
+  // keyed by device name, using the node stats of the devices in
+  // `step_stats`, and adds it to the aggregated statistics.
+  void AddStep(const StepStats& step_stats,
+               const std::unordered_map<string, const Graph*>& device_map);
+
+  // Fills `report` with the aggregated statistics, including the
+  // `max_nodes` nodes with the largest total time on the critical path.
+  void ExportReport(int max_nodes, CriticalPathReport* report) const;
+
+ private:
+  // Statistics of a node, keyed by device and node name.
+  using NodeKey = std::pair<string, string>;
+
+  mutable mutex mu_;
+  int64_t num_steps_ TF_GUARDED_BY(mu_) = 0;
+  int64_t critical_path_nanos_ TF_GUARDED_BY(mu_) = 0;
+  int64_t total_critical_path_nanos_ TF_GUARDED_BY(mu_) = 0;
+  std::vector<string> critical_path_ TF_GUARDED_BY(mu_);
+  absl::flat_hash_map<NodeKey, CriticalPathNodeStats> node_stats_
+      TF_GUARDED_BY(mu_);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_COMMON_RUNTIME_CRITICAL_PATH_ANALYZER_H_
@@ -0,0 +1,201 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/critical_path_analyzer.h"
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+const char* const kDevice0 = "/job:a/replica:0/task:0/device:CPU:0";
+const char* const kDevice1 = "/job:a/replica:0/task:0/device:CPU:1";
+
+// Adds stats of a node that ran for `nanos` on `device`, starting at
+// `start_nanos`, to `step_stats`.
+void AddNodeStats(const string& device, const Node* node, int64_t nanos,
+                  StepStats* step_stats, int64_t start_nanos = 0) {
+  DeviceStepStats* device_stats = nullptr;
+  for (DeviceStepStats& ds : *step_stats->mutable_dev_stats()) {
+    if (ds.device() == device) device_stats = &ds;
+  }
+  if (device_stats == nullptr) {
+    device_stats = step_stats->add_dev_stats();
+    device_stats->set_device(device);
+  }
+  NodeExecStats* node_stats = device_stats->add_node_stats();
+  node_stats->set_node_name(node->name());
+  node_stats->set_all_start_nanos(start_nanos);
+  node_stats->set_all_end_rel_nanos(nanos);
+}
+
+std::map<string, CriticalPathNodeStats> NodesByName(
+    const CriticalPathReport& report) {
+  std::map<string, CriticalPathNodeStats> nodes;
+  for (const CriticalPathNodeStats& node : report.nodes()) {
+    nodes[node.node_name()] = node;
+  }
+  return nodes;
+}
+
+TEST(CriticalPathAnalyzerTest, Diamond) {
+  Graph g(OpRegistry::Global());
+  Node* a = test::graph::NoOp(&g, {});
+  Node* b = test::graph::NoOp(&g, {a});
+  Node* c = test::graph::NoOp(&g, {a});
+  Node* d = test::graph::NoOp(&g, {b, c});
+  StepStats step_stats;
+  AddNodeStats(kDevice0, a, 10, &step_stats);
+  AddNodeStats(kDevice0, b, 30, &step_stats);
+  AddNodeStats(kDevice0, c, 5, &step_stats);
+  AddNodeStats(kDevice0, d, 10, &step_stats);
+
+  CriticalPathAnalyzer analyzer;
+  analyzer.AddStep(step_stats, {{kDevice0, &g}});
+  CriticalPathReport report;
+  analyzer.ExportReport(10, &report);
+
+  EXPECT_EQ(report.num_steps(), 1);
+  EXPECT_EQ(report.critical_path_nanos(), 50);
+  EXPECT_EQ(report.total_critical_path_nanos(), 50);
+  EXPECT_EQ(std::vector<string>(report.critical_path().begin(),
+                                report.critical_path().end()),
+            std::vector<string>({a->name(), b->name(), d->name()}));
+  ASSERT_EQ(report.nodes_size(), 4);
+  // Ordered by time on the critical path.
+  EXPECT_EQ(report.nodes(0).node_name(), b->name());
+  EXPECT_EQ(report.nodes(3).node_name(), c->name());
+  auto nodes = NodesByName(report);
+  EXPECT_EQ(nodes[b->name()].device(), kDevice0);
+  EXPECT_EQ(nodes[b->name()].total_critical_nanos(), 30);
+  EXPECT_EQ(nodes[b->name()].min_slack_nanos(), 0);
+  EXPECT_EQ(nodes[c->name()].num_steps(), 1);
+  EXPECT_EQ(nodes[c->name()].num_critical_steps(), 0);
+  EXPECT_EQ(nodes[c->name()].total_nanos(), 5);
+  EXPECT_EQ(nodes[c->name()].total_critical_nanos(), 0);
+  EXPECT_EQ(nodes[c->name()].min_slack_nanos(), 25);
+}
+
+TEST(CriticalPathAnalyzerTest, FollowsSendToRecv) {
+  Graph g0(OpRegistry::Global());
+  Node* x = test::graph::Constant(&g0, Tensor(1.0f));
+  Node* send = test::graph::Send(&g0, x, "x", kDevice0, 1, kDevice1);
+  Graph g1(OpRegistry::Global());
+  Node* recv = test::graph::Recv(&g1, "x", "float", kDevice0, 1, kDevice1);
+  Node* y = test::graph::Identity(&g1, recv);
+  Node* z = test::graph::Constant(&g1, Tensor(2.0f));
+  StepStats step_stats;
+  AddNodeStats(kDevice0, x, 20, &step_stats);
+  AddNodeStats(kDevice1, y, 20, &step_stats);
+  AddNodeStats(kDevice1, z, 5, &step_stats);
+
+  CriticalPathAnalyzer analyzer;
+  analyzer.AddStep(step_stats, {{kDevice0, &g0}, {kDevice1, &g1}});
+  CriticalPathReport report;
+  analyzer.ExportReport(10, &report);
+
+  EXPECT_EQ(report.critical_path_nanos(), 40);
+  // Transfers have no stats, and are left out of the path.
+  EXPECT_EQ(std::vector<string>(report.critical_path().begin(),
+                                report.critical_path().end()),
+            std::vector<string>({x->name(), y->name()}));
+  auto nodes = NodesByName(report);
+  ASSERT_EQ(nodes.size(), 3);
+  EXPECT_EQ(nodes[x->name()].device(), kDevice0);
+  EXPECT_EQ(nodes[y->name()].device(), kDevice1);
+  EXPECT_EQ(nodes[z->name()].min_slack_nanos(), 35);
+
+  // The _Recv starts with `x` and waits for the _Send, which ends at 1025.
+  // Only the 5ns it runs after that are counted, not the whole 30ns.
+  StepStats transfer_step_stats;
+  AddNodeStats(kDevice0, x, 20, &transfer_step_stats, /*start_nanos=*/1000);
+  AddNodeStats(kDevice0, send, 5, &transfer_step_stats, /*start_nanos=*/1020);
+  AddNodeStats(kDevice1, recv, 30, &transfer_step_stats, /*start_nanos=*/1000);
+  AddNodeStats(kDevice1, y, 20, &transfer_step_stats, /*start_nanos=*/1030);
+  AddNodeStats(kDevice1, z, 5, &transfer_step_stats, /*start_nanos=*/1000);
+  analyzer.AddStep(transfer_step_stats, {{kDevice0, &g0}, {kDevice1, &g1}});
+  analyzer.ExportReport(10, &report);
+
+  EXPECT_EQ(report.critical_path_nanos(), 50);
+  EXPECT_EQ(std::vector<string>(report.critical_path().begin(),
+                                report.critical_path().end()),
+            std::vector<string>({x->name(), send->name(), recv->name(),
+                                 y->name()}));
+}
+
+TEST(CriticalPathAnalyzerTest, AggregatesSteps) {
+  Graph g(OpRegistry::Global());
+  Node* a = test::graph::NoOp(&g, {});
+  Node* b = test::graph::NoOp(&g, {});
+  Node* c = test::graph::NoOp(&g, {});
+  CriticalPathAnalyzer analyzer;
+  for (int step = 0; step < 3; ++step) {
+    // `a` is critical in the first two steps, `b` in the last.
+    StepStats step_stats;
+    AddNodeStats(kDevice0, a, step < 2 ? 100 : 10, &step_stats);
+    AddNodeStats(kDevice0, b, step < 2 ? 50 : 60, &step_stats);
+    AddNodeStats(kDevice0, c, 1, &step_stats);
+    analyzer.AddStep(step_stats, {{kDevice0, &g}});
+  }
+  CriticalPathReport report;
+  analyzer.ExportReport(2, &report);
+
+  EXPECT_EQ(report.num_steps(), 3);
+  EXPECT_EQ(report.critical_path_nanos(), 60);
+  EXPECT_EQ(report.total_critical_path_nanos(), 260);
+  EXPECT_EQ(std::vector<string>(report.critical_path().begin(),
+                                report.critical_path().end()),
+            std::vector<string>({b->name()}));
+  ASSERT_EQ(report.nodes_size(), 2);
+  const CriticalPathNodeStats& first = report.nodes(0);
+  EXPECT_EQ(first.node_name(), a->name());
+  EXPECT_EQ(first.num_steps(), 3);
+  EXPECT_EQ(first.num_critical_steps(), 2);
+  EXPECT_EQ(first.total_nanos(), 210);
+  EXPECT_EQ(first.total_critical_nanos(), 200);
+  EXPECT_EQ(first.min_slack_nanos(), 0);
+  EXPECT_EQ(first.total_slack_nanos(), 50);
+  const CriticalPathNodeStats& second = report.nodes(1);
+  EXPECT_EQ(second.node_name(), b->name());
+  EXPECT_EQ(second.num_critical_steps(), 1);
+  EXPECT_EQ(second.total_critical_nanos(), 60);
+  EXPECT_EQ(second.total_slack_nanos(), 100);
+}
+
+TEST(CriticalPathAnalyzerTest, NodesWithoutStats) {
+  Graph g(OpRegistry::Global());
+  Node* a = test::graph::NoOp(&g, {});
+  test::graph::NoOp(&g, {a});
+  StepStats step_stats;
+  AddNodeStats(kDevice0, a, 7, &step_stats);
+
+  CriticalPathAnalyzer analyzer;
+  analyzer.AddStep(step_stats, {{kDevice0, &g}});
+  CriticalPathReport report;
+  analyzer.ExportReport(10, &report);
+  EXPECT_EQ(report.critical_path_nanos(), 7);
+  EXPECT_EQ(report.critical_path_size(), 1);
+  EXPECT_EQ(report.nodes_size(), 1);
+}
+
+}  // namespace
+}  // namespace tensorflow
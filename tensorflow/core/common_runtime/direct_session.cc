@@ -694,7 +694,9 @@ Status DirectSession::RunInternal(
           ((measure_step_count + 1) % build_cost_model_every == 0);
     }
   }
-  if (do_trace || update_cost_model ||
+  const int critical_path_report_size =
+      run_options.experimental().critical_path_report_size();
+  if (do_trace || update_cost_model || critical_path_report_size > 0 ||
       run_options.report_tensor_allocations_upon_oom()) {
     run_state.collector.reset(
         new StepStatsCollector(run_metadata->mutable_step_stats()));
@@ -800,17 +802,18 @@ Status DirectSession::RunInternal(
     run_state.collector->Finalize();
   }
 
-  // Build and return the cost model as instructed.
-  if (update_cost_model) {
-    // Build the cost model
-    std::unordered_map<string, const Graph*> device_to_graph;
+  std::unordered_map<string, const Graph*> device_to_graph;
+  if (update_cost_model || critical_path_report_size > 0) {
     for (const PerPartitionExecutorsAndLib& partition :
          executors_and_keys->items) {
       const Graph* graph = partition.graph.get();
       const string& device = partition.flib->device()->name();
       device_to_graph[device] = graph;
     }
+  }
 
+  // Build and return the cost model as instructed.
+  if (update_cost_model) {
     mutex_lock l(executor_lock_);
     run_state.collector->BuildCostModel(&cost_model_manager_, device_to_graph);
 
@@ -822,6 +825,14 @@ Status DirectSession::RunInternal(
     }
   }
 
+  if (critical_path_report_size > 0) {
+    run_state.collector->AnalyzeCriticalPath(&critical_path_analyzer_,
+                                             device_to_graph);
+    critical_path_analyzer_.ExportReport(
+        critical_path_report_size,
+        run_metadata->mutable_critical_path_report());
+  }
+
   // If requested via RunOptions, output the partition graphs.
   if (run_options.output_partition_graphs()) {
     if (options_.config.experimental().disable_output_partition_graphs()) {
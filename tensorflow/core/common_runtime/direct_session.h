@@ -24,6 +24,7 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
+#include "tensorflow/core/common_runtime/critical_path_analyzer.h"
 #include "tensorflow/core/common_runtime/debugger_state_interface.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/device_set.h"
@@ -422,6 +423,10 @@ class DirectSession : public Session {
   // Manages all the cost models for the graphs executed in this session.
   CostModelManager cost_model_manager_;
 
+  // Aggregates the critical paths of the steps that requested
+  // RunOptions.experimental.critical_path_report_size.
+  CriticalPathAnalyzer critical_path_analyzer_;
+
   // For testing collective graph key generation.
   mutex collective_graph_key_lock_;
   int64_t collective_graph_key_ TF_GUARDED_BY(collective_graph_key_lock_) = -1;
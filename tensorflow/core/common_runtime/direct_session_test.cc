@@ -44,6 +44,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/numa.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/stacktrace.h"
 #include "tensorflow/core/platform/test.h"
@@ -767,6 +768,37 @@ TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithOpts_Callable) {
   EXPECT_EQ(run_metadata.step_stats().dev_stats_size(), 2);
 }
 
+TEST_F(DirectSessionMinusAXTest, RunSimpleNetworkWithCriticalPathReport) {
+  Initialize({3, 2, -1, 0});
+  auto session = CreateSession();
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  RunOptions run_options;
+  run_options.mutable_experimental()->set_critical_path_report_size(2);
+  for (int step = 1; step <= 3; ++step) {
+    RunMetadata run_metadata;
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run(run_options, {}, {y_ + ":0"}, {y_neg_},
+                              &outputs, &run_metadata));
+    const CriticalPathReport& report = run_metadata.critical_path_report();
+    EXPECT_EQ(report.num_steps(), step);
+    EXPECT_GT(report.critical_path_size(), 0);
+    EXPECT_GE(report.total_critical_path_nanos(), report.critical_path_nanos());
+    ASSERT_EQ(report.nodes_size(), 2);
+    EXPECT_GE(report.nodes(0).total_critical_nanos(),
+              report.nodes(1).total_critical_nanos());
+    EXPECT_EQ(report.nodes(0).num_steps(), step);
+  }
+
+  // Steps without the option are not analyzed.
+  RunMetadata run_metadata;
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run(RunOptions(), {}, {y_ + ":0"}, {y_neg_}, &outputs,
+                            &run_metadata));
+  EXPECT_FALSE(run_metadata.has_critical_path_report());
+}
+
 TEST_F(DirectSessionMinusAXTest, UseRunHandlerPool) {
   Initialize({3, 2, -1, 0});
   auto session = CreateSession();
@@ -2733,6 +2765,141 @@ BENCHMARK(BM_FeedFetchCallableSingleThreadExecutor)
     ->Arg(5)
     ->Arg(10);
 
+// Runs `num_towers` independent chains of 256x256 matrix multiplications,
+// either all on "/cpu:0" or, with NUMA affinity, spread round-robin over the
+// CPU devices of the NUMA nodes.
+void BM_MultiTowerMatMul(::testing::benchmark::State& state) {
+  const int num_towers = state.range(0);
+  const bool use_numa_affinity = state.range(1);
+  constexpr int kDim = 256;
+  constexpr int kDepth = 16;
+  const int num_devices = use_numa_affinity ? port::NUMANumNodes() : 1;
+
+  Graph g(OpRegistry::Global());
+  std::vector<string> targets;
+  for (int t = 0; t < num_towers; ++t) {
+    const string device = strings::StrCat("/cpu:", t % num_devices);
+    Node* shape =
+        test::graph::Constant(&g, test::AsTensor<int32>({kDim, kDim}));
+    shape->set_requested_device(device);
+    Node* a = test::graph::RandomUniform(&g, shape, DT_FLOAT);
+    a->set_requested_device(device);
+    Node* x = a;
+    for (int i = 0; i < kDepth; ++i) {
+      x = test::graph::Matmul(&g, x, a, false, false);
+      x->set_requested_device(device);
+    }
+    targets.push_back(x->name());
+  }
+  GraphDef gd;
+  g.ToGraphDef(&gd);
+  SessionOptions opts;
+  opts.config.mutable_experimental()->set_use_numa_affinity(use_numa_affinity);
+  std::unique_ptr<Session> session(NewSession(opts));
+  TF_CHECK_OK(session->Create(gd));
+  // Ignore the first run, which partitions the graph.
+  TF_CHECK_OK(session->Run({}, {}, targets, nullptr));
+
+  for (auto s : state) {
+    TF_CHECK_OK(session->Run({}, {}, targets, nullptr));
+  }
+  state.SetItemsProcessed(state.iterations() * num_towers * kDepth * 2 *
+                          kDim * kDim * kDim);
+}
+
+BENCHMARK(BM_MultiTowerMatMul)
+    ->UseRealTime()
+    ->ArgsProduct({{1, 2, 4, 8, 16}, {0, 1}});
+
+// Runs `num_branches` independent stacks of small fully-connected layers, so
+// that each step makes many small, short-lived allocations from many threads.
+// Run with TF_CPU_ALLOCATOR_USE_THREAD_CACHE=1 to measure
+// ThreadCachingCPUAllocator instead of the default CPU allocator.
+void BM_SmallMLPInference(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+  const int num_branches = state.range(1);
+  constexpr int kWidth = 64;
+  constexpr int kNumLayers = 8;
+
+  Graph g(OpRegistry::Global());
+  Tensor weights(DT_FLOAT, TensorShape({kWidth, kWidth}));
+  weights.flat<float>().setConstant(1.0f / kWidth);
+  Tensor bias(DT_FLOAT, TensorShape({kWidth}));
+  bias.flat<float>().setConstant(0.1f);
+  std::vector<string> targets;
+  for (int b = 0; b < num_branches; ++b) {
+    Node* shape = test::graph::Constant(
+        &g, test::AsTensor<int32>({batch_size, kWidth}));
+    Node* x = test::graph::RandomUniform(&g, shape, DT_FLOAT);
+    for (int i = 0; i < kNumLayers; ++i) {
+      x = test::graph::Matmul(&g, x, test::graph::Constant(&g, weights), false,
+                              false);
+      x = test::graph::BiasAdd(&g, x, test::graph::Constant(&g, bias));
+      x = test::graph::Relu(&g, x);
+    }
+    targets.push_back(x->name());
+  }
+  GraphDef gd;
+  g.ToGraphDef(&gd);
+  std::unique_ptr<Session> session(NewSession(SessionOptions()));
+  TF_CHECK_OK(session->Create(gd));
+  // Ignore the first run, which partitions the graph.
+  TF_CHECK_OK(session->Run({}, {}, targets, nullptr));
+
+  for (auto s : state) {
+    TF_CHECK_OK(session->Run({}, {}, targets, nullptr));
+  }
+  state.SetItemsProcessed(state.iterations() * num_branches * batch_size);
+}
+
+BENCHMARK(BM_SmallMLPInference)
+    ->UseRealTime()
+    ->ArgsProduct({{1, 16, 128}, {1, 8, 32}});
+
+// Runs a graph of about `num_nodes` small additions in independent chains,
+// without step stats (mode 0), with a software trace (mode 1), or with a
+// software trace and critical path analysis (mode 2).
+void BM_CriticalPathAnalysis(::testing::benchmark::State& state) {
+  const int num_nodes = state.range(0);
+  const int mode = state.range(1);
+  constexpr int kNumChains = 16;
+
+  Graph g(OpRegistry::Global());
+  std::vector<string> targets;
+  for (int c = 0; c < kNumChains; ++c) {
+    Node* shape = test::graph::Constant(&g, test::AsTensor<int32>({1}));
+    Node* seed = test::graph::RandomUniform(&g, shape, DT_FLOAT);
+    Node* x = seed;
+    for (int i = 0; i < num_nodes / kNumChains; ++i) {
+      x = test::graph::Add(&g, x, seed);
+    }
+    targets.push_back(x->name());
+  }
+  GraphDef gd;
+  g.ToGraphDef(&gd);
+  std::unique_ptr<Session> session(NewSession(SessionOptions()));
+  TF_CHECK_OK(session->Create(gd));
+  RunOptions run_options;
+  if (mode >= 1) run_options.set_trace_level(RunOptions::SOFTWARE_TRACE);
+  if (mode == 2) {
+    run_options.mutable_experimental()->set_critical_path_report_size(10);
+  }
+  // Ignore the first run, which partitions the graph.
+  TF_CHECK_OK(session->Run({}, {}, targets, nullptr));
+
+  for (auto s : state) {
+    RunMetadata run_metadata;
+    std::vector<Tensor> outputs;
+    TF_CHECK_OK(session->Run(run_options, {}, {}, targets, &outputs,
+                             &run_metadata));
+  }
+  state.SetItemsProcessed(state.iterations() * num_nodes);
+}
+
+BENCHMARK(BM_CriticalPathAnalysis)
+    ->UseRealTime()
+    ->ArgsProduct({{1 << 10, 1 << 14}, {0, 1, 2}});
+
 }  // namespace
 
 class DirectSessionCollectiveTest : public ::testing::Test {
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <atomic>
+#include <deque>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -62,6 +63,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/manual_constructor.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/context.h"
+#include "tensorflow/core/platform/cpu_info.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/logging.h"
@@ -147,7 +149,9 @@ typedef gtl::InlinedVector<AllocatorAttributes, 4> AllocatorAttributeVec;
 
 class ExecutorImpl : public Executor {
  public:
-  explicit ExecutorImpl(const LocalExecutorParams& p) : immutable_state_(p) {}
+  explicit ExecutorImpl(const LocalExecutorParams& p,
+                        bool work_stealing = false)
+      : immutable_state_(p), work_stealing_(work_stealing) {}
 
   Status Initialize(const Graph& graph) {
     TF_RETURN_IF_ERROR(immutable_state_.Initialize(graph));
@@ -226,10 +230,27 @@ class ExecutorImpl : public Executor {
   ImmutableExecutorState immutable_state_;
   KernelStats kernel_stats_;
 
+  // If true, ready nodes are dispatched through per-worker deques with work
+  // stealing. See `NewWorkStealingLocalExecutor()`.
+  const bool work_stealing_;
+
   ExecutorImpl(const ExecutorImpl&) = delete;
   void operator=(const ExecutorImpl&) = delete;
 };
 
+// Identifies the work-stealing worker running on the current thread, if any.
+// `state` is the ExecutorState whose worker is running, so that nested
+// executors running on the same thread do not mistake it for their own.
+struct WorkStealingWorkerSlot {
+  const void* state = nullptr;
+  int worker = -1;
+};
+
+WorkStealingWorkerSlot* CurrentWorkStealingWorkerSlot() {
+  static thread_local WorkStealingWorkerSlot slot;
+  return &slot;
+}
+
 // The state associated with one invocation of ExecutorImpl::Run.
 //
 // ExecutorState dispatches nodes when they become ready, and delegates to an
@@ -284,7 +305,8 @@ class ExecutorState {
  public:
   ExecutorState(const Executor::Args& args,
                 const ImmutableExecutorState& immutable_state_,
-                ExecutorImpl::KernelStats* kernel_stats_);
+                ExecutorImpl::KernelStats* kernel_stats_,
+                bool work_stealing = false);
   ~ExecutorState();
 
   void RunAsync(Executor::DoneCallback done);
@@ -346,6 +368,39 @@ class ExecutorState {
   template <typename Closure>
   void RunTask(Closure&& c, int sample_rate = 0);
 
+  // A node queued on one of the work-stealing deques.
+  struct QueuedNode {
+    TaggedNode tagged_node;
+    int64_t scheduled_nsec;
+  };
+
+  // One deque of ready nodes per work-stealing worker. Padded to a cache line
+  // so that workers touching their own deque do not false-share.
+  struct alignas(64) WorkerQueue {
+    mutex mu;
+    std::deque<QueuedNode> nodes TF_GUARDED_BY(mu);
+  };
+
+  // Queues `tagged_node` on the deque of the current worker (or, when called
+  // from a thread that is not a worker of this step, on a round-robin chosen
+  // deque) and starts another worker if fewer than `num_workers_` are active.
+  // Unless it started a worker, the caller must not touch this state after
+  // the call, since the step may have finished.
+  void PushReady(const TaggedNode& tagged_node, int64_t scheduled_nsec);
+
+  // Pops the most recently queued node from the deque of `worker`, or steals
+  // the oldest node from another worker's deque if it is empty.
+  absl::optional<QueuedNode> PopOrStealReady(int worker);
+
+  // Reserves a slot for an active worker. Returns false if `num_workers_`
+  // workers are already active.
+  bool TryReserveWorker();
+
+  // Processes queued nodes until all deques are empty. Each running worker
+  // holds a reference on `num_outstanding_ops_` so that the step cannot
+  // finish (and delete this state) while the worker still touches it.
+  void RunWorker(int worker);
+
   // Clean up when this executor is done.
   void Finish();
   void ScheduleFinish();
@@ -405,6 +460,14 @@ class ExecutorState {
 
   std::atomic_int_fast32_t num_outstanding_ops_;
 
+  // Work-stealing scheduling state; only used if `work_stealing_` is true.
+  const bool work_stealing_;
+  const int num_workers_;
+  std::unique_ptr<WorkerQueue[]> worker_queues_;
+  std::atomic<int> num_active_workers_{0};
+  std::atomic<int64_t> num_queued_nodes_{0};
+  std::atomic<uint32> next_worker_{0};
+
   // Available via OpKernelContext to every OpKernel invocation.
   mutex num_deferred_ops_mu_;
   int64_t num_deferred_ops_ TF_GUARDED_BY(num_deferred_ops_mu_) = 0;
@@ -418,7 +481,7 @@ class ExecutorState {
 template <class PropagatorStateType>
 ExecutorState<PropagatorStateType>::ExecutorState(
     const Executor::Args& args, const ImmutableExecutorState& immutable_state,
-    ExecutorImpl::KernelStats* kernel_stats)
+    ExecutorImpl::KernelStats* kernel_stats, bool work_stealing)
     : vlog_(VLOG_IS_ON(1)),
       log_memory_(LogMemory::IsEnabled()),
       step_id_(args.step_id),
@@ -447,7 +510,12 @@ ExecutorState<PropagatorStateType>::ExecutorState(
       sync_on_finish_(args.sync_on_finish),
       run_all_kernels_inline_(args.run_all_kernels_inline),
       propagator_(immutable_state, step_id_, vlog_),
-      num_outstanding_ops_(0) {
+      num_outstanding_ops_(0),
+      work_stealing_(work_stealing && !run_all_kernels_inline_),
+      num_workers_(work_stealing_ ? port::MaxParallelism() : 0) {
+  if (work_stealing_) {
+    worker_queues_ = std::make_unique<WorkerQueue[]>(num_workers_);
+  }
   if (args.user_intra_op_threadpool != nullptr) {
     Device* device = immutable_state_.params().device;
     user_device_ = RenamedDevice::NewRenamedDevice(
@@ -487,6 +555,99 @@ void ExecutorState<PropagatorStateType>::RunTask(Closure&& c, int sample_rate) {
   });
 }
 
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::PushReady(
+    const TaggedNode& tagged_node, int64_t scheduled_nsec) {
+  const WorkStealingWorkerSlot* slot = CurrentWorkStealingWorkerSlot();
+  const int worker =
+      slot->state == this
+          ? slot->worker
+          : next_worker_.fetch_add(1, std::memory_order_relaxed) % num_workers_;
+  // Everything that touches this state must happen before `tagged_node` is
+  // published: the caller does not necessarily hold a reference on
+  // `num_outstanding_ops_` (e.g. when called from RunAsync() or from the done
+  // callback of an async kernel), so an active worker may pop the node, run
+  // the step to completion and delete `this` as soon as it is queued.
+  //
+  // Counting the node first also means that a worker that gives up its slot
+  // always sees it, and never observes a negative count.
+  num_queued_nodes_.fetch_add(1);
+  const bool start_worker = TryReserveWorker();
+  int new_worker = 0;
+  if (start_worker) {
+    // The new worker's reference keeps this state alive until RunWorker()
+    // returns, including for the RunTask() call below.
+    num_outstanding_ops_.fetch_add(1, std::memory_order_relaxed);
+    new_worker =
+        next_worker_.fetch_add(1, std::memory_order_relaxed) % num_workers_;
+  }
+  {
+    WorkerQueue& queue = worker_queues_[worker];
+    mutex_lock l(queue.mu);
+    queue.nodes.push_back({tagged_node, scheduled_nsec});
+  }
+  if (start_worker) {
+    RunTask([this, new_worker]() { RunWorker(new_worker); });
+  }
+}
+
+template <class PropagatorStateType>
+absl::optional<typename ExecutorState<PropagatorStateType>::QueuedNode>
+ExecutorState<PropagatorStateType>::PopOrStealReady(int worker) {
+  for (int i = 0; i < num_workers_; ++i) {
+    WorkerQueue& queue = worker_queues_[(worker + i) % num_workers_];
+    mutex_lock l(queue.mu);
+    if (queue.nodes.empty()) continue;
+    // Run our own most recently produced node to keep its inputs hot in cache,
+    // but steal the oldest node from peers.
+    QueuedNode node = i == 0 ? queue.nodes.back() : queue.nodes.front();
+    if (i == 0) {
+      queue.nodes.pop_back();
+    } else {
+      queue.nodes.pop_front();
+    }
+    num_queued_nodes_.fetch_sub(1);
+    return node;
+  }
+  return absl::nullopt;
+}
+
+template <class PropagatorStateType>
+bool ExecutorState<PropagatorStateType>::TryReserveWorker() {
+  int num_active = num_active_workers_.load(std::memory_order_relaxed);
+  while (num_active < num_workers_) {
+    if (num_active_workers_.compare_exchange_weak(num_active, num_active + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class PropagatorStateType>
+void ExecutorState<PropagatorStateType>::RunWorker(int worker) {
+  WorkStealingWorkerSlot* slot = CurrentWorkStealingWorkerSlot();
+  const WorkStealingWorkerSlot saved_slot = *slot;
+  slot->state = this;
+  slot->worker = worker;
+  while (true) {
+    absl::optional<QueuedNode> node = PopOrStealReady(worker);
+    if (node.has_value()) {
+      Process(node->tagged_node, node->scheduled_nsec);
+      continue;
+    }
+    // Give up the worker slot, then re-check: a node pushed after the deques
+    // were found empty but before the slot was released did not start a new
+    // worker, so this one has to take it. PushReady() counts a node before
+    // queuing it, so this may briefly poll for a node that is about to land.
+    num_active_workers_.fetch_sub(1);
+    if (num_queued_nodes_.load() == 0 || !TryReserveWorker()) break;
+  }
+  *slot = saved_slot;
+  // Release the reference taken in PushReady(). This may finish the step and
+  // delete `this`.
+  if (num_outstanding_ops_.fetch_sub(1) == 1) ScheduleFinish();
+}
+
 template <class PropagatorStateType>
 void ExecutorState<PropagatorStateType>::RunAsync(Executor::DoneCallback done) {
   TaggedNodeSeq ready;
@@ -1294,6 +1455,30 @@ void ExecutorState<PropagatorStateType>::ScheduleReady(
         inline_ready->push_back(tagged_node);
       }
     }
+  } else if (work_stealing_) {
+    // Same inlining policy as below, but the nodes that would be dispatched
+    // as individual closures are queued on the work-stealing deques instead.
+    const TaggedNode* curr_expensive_node = nullptr;
+    for (auto& tagged_node : *ready) {
+      if (inline_ready == nullptr) {
+        PushReady(tagged_node, scheduled_nsec);
+      } else if (tagged_node.get_is_dead() ||
+                 !kernel_stats_->IsExpensive(*tagged_node.node_item)) {
+        inline_ready->push_back(tagged_node);
+      } else {
+        if (curr_expensive_node) {
+          PushReady(*curr_expensive_node, scheduled_nsec);
+        }
+        curr_expensive_node = &tagged_node;
+      }
+    }
+    if (curr_expensive_node) {
+      if (inline_ready->empty()) {
+        inline_ready->push_back(*curr_expensive_node);
+      } else {
+        PushReady(*curr_expensive_node, scheduled_nsec);
+      }
+    }
   } else {
     const TaggedNode* curr_expensive_node = nullptr;
     TaggedNodeSeq expensive_nodes;
@@ -1510,14 +1695,15 @@ void ExecutorState<PropagatorStateType>::Finish() {
 void ExecutorImpl::RunAsyncInternal(const Args& args, DoneCallback done) {
   if (OpOrderDeterminismRequired()) {
     (new ExecutorState<OrderedPropagatorState>(args, immutable_state_,
-                                               &kernel_stats_))
+                                               &kernel_stats_, work_stealing_))
         ->RunAsync(std::move(done));
   } else if (immutable_state_.requires_control_flow_support()) {
-    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_))
+    (new ExecutorState<PropagatorState>(args, immutable_state_, &kernel_stats_,
+                                        work_stealing_))
         ->RunAsync(std::move(done));
   } else {
     (new ExecutorState<SimplePropagatorState>(args, immutable_state_,
-                                              &kernel_stats_))
+                                              &kernel_stats_, work_stealing_))
         ->RunAsync(std::move(done));
   }
 }
@@ -1536,6 +1722,18 @@ Status NewLocalExecutor(const LocalExecutorParams& params, const Graph& graph,
   return s;
 }
 
+Status NewWorkStealingLocalExecutor(const LocalExecutorParams& params,
+                                    const Graph& graph, Executor** executor) {
+  ExecutorImpl* impl = new ExecutorImpl(params, /*work_stealing=*/true);
+  const Status s = impl->Initialize(graph);
+  if (s.ok()) {
+    *executor = impl;
+  } else {
+    delete impl;
+  }
+  return s;
+}
+
 Status CreateNonCachedKernel(Device* device, FunctionLibraryRuntime* flib,
                              const std::shared_ptr<const NodeProperties>& props,
                              int graph_def_version, OpKernel** kernel) {
@@ -1571,6 +1769,25 @@ class DefaultExecutorRegistrar {
 };
 static DefaultExecutorRegistrar registrar;
 
+class WorkStealingExecutorRegistrar {
+ public:
+  WorkStealingExecutorRegistrar() {
+    ExecutorFactory::Register("WORK_STEALING_EXECUTOR", new Factory);
+  }
+
+ private:
+  class Factory : public ExecutorFactory {
+    Status NewExecutor(const LocalExecutorParams& params, const Graph& graph,
+                       std::unique_ptr<Executor>* out_executor) override {
+      Executor* ret = nullptr;
+      TF_RETURN_IF_ERROR(NewWorkStealingLocalExecutor(params, graph, &ret));
+      out_executor->reset(ret);
+      return OkStatus();
+    }
+  };
+};
+static WorkStealingExecutorRegistrar work_stealing_registrar;
+
 }  // namespace
 
 }  // namespace tensorflow
@@ -160,6 +160,22 @@ class Executor {
 ::tensorflow::Status NewLocalExecutor(const LocalExecutorParams& params,
                                       const Graph& graph, Executor** executor);
 
+// Like NewLocalExecutor(), but the returned executor dispatches ready nodes
+// through per-worker deques with work stealing instead of scheduling one
+// closure on `Executor::Args::runner` per expensive node. A node that becomes
+// ready is queued on the deque of the worker that produced it, so chains of
+// producer and consumer nodes tend to stay on the same thread, and at most one
+// closure per worker is outstanding at any time.
+//
+// Workers only pick up a new node after the previous one returns, so kernels
+// that block waiting for other nodes of the same step may deadlock when all
+// workers are blocked. This is also registered with the ExecutorFactory as
+// "WORK_STEALING_EXECUTOR", which can be selected through
+// `ConfigProto.experimental.executor_type`.
+::tensorflow::Status NewWorkStealingLocalExecutor(
+    const LocalExecutorParams& params, const Graph& graph,
+    Executor** executor);
+
 // A class to help run multiple executors in parallel and wait until
 // all of them are complete.
 //
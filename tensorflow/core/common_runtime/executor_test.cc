@@ -42,6 +42,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/strcat.h"
 #include "tensorflow/core/platform/test.h"
@@ -77,8 +78,9 @@ class ExecutorTest : public ::testing::Test {
     delete exec_;
   }
 
-  // Resets executor_ with a new executor based on a graph 'gdef'.
-  void Create(std::unique_ptr<const Graph> graph) {
+  // Resets executor_ with a new executor based on a graph 'gdef'. If
+  // 'work_stealing' is true, uses NewWorkStealingLocalExecutor().
+  void Create(std::unique_ptr<const Graph> graph, bool work_stealing = false) {
     const int version = graph->versions().producer();
     LocalExecutorParams params;
     params.device = device_.get();
@@ -93,7 +95,11 @@ class ExecutorTest : public ::testing::Test {
     };
     rendez_ = NewLocalRendezvous();
     delete exec_;
-    TF_CHECK_OK(NewLocalExecutor(params, *graph, &exec_));
+    if (work_stealing) {
+      TF_CHECK_OK(NewWorkStealingLocalExecutor(params, *graph, &exec_));
+    } else {
+      TF_CHECK_OK(NewLocalExecutor(params, *graph, &exec_));
+    }
     runner_ = [this](std::function<void()> fn) { thread_pool_->Schedule(fn); };
   }
 
@@ -266,6 +272,74 @@ TEST_F(ExecutorTest, RandomTree) {
   EXPECT_EQ(4096.0, V(out));
 }
 
+TEST_F(ExecutorTest, RandomTreeWorkStealing) {
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildTree(4096, g.get());
+  Create(std::move(g), /*work_stealing=*/true);
+  Rendezvous::Args args;
+  // Run several steps so that both the initially "expensive" and the
+  // subsequently inlined schedules are exercised.
+  for (int iters = 0; iters < 4; ++iters) {
+    TF_ASSERT_OK(rendez_->Send(Key(ALICE, kIncarnation, BOB, "a"), args,
+                               V(1.0), false));
+    TF_ASSERT_OK(Run(rendez_));
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(4096.0, V(out));
+  }
+}
+
+// Receives 'N' scalars "a0", "a1", ... through (asynchronous) Recv kernels,
+// adds them up pairwise and sends the sum as "b".
+void BuildAsyncRecvSum(int N, Graph* g) {
+  std::vector<Node*> nodes;
+  for (int i = 0; i < N; ++i) {
+    nodes.push_back(test::graph::Recv(g, strings::StrCat("a", i), "float",
+                                      ALICE, 1, BOB));
+  }
+  while (nodes.size() > 1) {
+    std::vector<Node*> sums;
+    for (size_t i = 0; i + 1 < nodes.size(); i += 2) {
+      sums.push_back(test::graph::Add(g, nodes[i], nodes[i + 1]));
+    }
+    if (nodes.size() % 2 == 1) sums.push_back(nodes.back());
+    nodes.swap(sums);
+  }
+  test::graph::Send(g, nodes.back(), "b", BOB, 1, ALICE);
+}
+
+// Async kernels schedule their successors from their done callbacks, without
+// holding a reference on the step, while the work-stealing workers may be
+// running the rest of the step to completion. Run many steps with the inputs
+// arriving concurrently to shake out lifetime races (most useful under
+// ASAN/TSAN).
+TEST_F(ExecutorTest, AsyncRecvWorkStealingStress) {
+  constexpr int kNumInputs = 256;
+  auto g = std::make_unique<Graph>(OpRegistry::Global());
+  BuildAsyncRecvSum(kNumInputs, g.get());
+  Create(std::move(g), /*work_stealing=*/true);
+  Rendezvous::Args args;
+  for (int iters = 0; iters < 200; ++iters) {
+    std::unique_ptr<Thread> sender(Env::Default()->StartThread(
+        ThreadOptions(), "sender", [this, &args]() {
+          for (int i = 0; i < kNumInputs; ++i) {
+            TF_CHECK_OK(rendez_->Send(
+                Key(ALICE, kIncarnation, BOB, strings::StrCat("a", i)), args,
+                V(1.0), false));
+          }
+        }));
+    TF_ASSERT_OK(Run(rendez_));
+    sender.reset();
+    Tensor out = V(-1);
+    bool is_dead = false;
+    TF_ASSERT_OK(rendez_->Recv(Key(BOB, kIncarnation, ALICE, "b"), args, &out,
+                               &is_dead));
+    EXPECT_EQ(static_cast<float>(kNumInputs), V(out));
+  }
+}
+
 void BuildConcurrentAddAssign(Graph* g) {
   auto one = test::graph::Constant(g, V(1.0));
   // A variable holds one float.
@@ -494,6 +568,48 @@ BENCHMARK(BM_executor)->UseRealTime()->ArgPair(8192, 32);
 // Tall fat graph
 BENCHMARK(BM_executor)->UseRealTime()->ArgPair(1024, 1024);
 
+// Create a graph of 'width' independent chains that are 'depth' nodes deep.
+// Every node negates a 'tensor_size'-element float tensor, which is enough
+// work to keep the nodes "expensive" so that they go through the executor's
+// scheduling path instead of being inlined.
+static void BM_ExecutorScheduling(::testing::benchmark::State& state) {
+  const int width = state.range(0);
+  const int depth = state.range(1);
+  const int tensor_size = state.range(2);
+  const bool work_stealing = state.range(3);
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, TensorShape({tensor_size}));
+  input.flat<float>().setRandom();
+  Node* in = test::graph::Constant(g, input);
+  for (int i = 0; i < width; ++i) {
+    Node* cur = in;
+    for (int j = 0; j < depth; ++j) {
+      cur = test::graph::Unary(g, "Neg", cur);
+    }
+  }
+
+  FixupSourceAndSinkEdges(g);
+  test::Benchmark("cpu", g, /*options=*/nullptr, /*init=*/nullptr,
+                  /*rendez=*/nullptr,
+                  work_stealing ? "WORK_STEALING_EXECUTOR" : "",
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+
+  state.SetLabel(work_stealing ? "work_stealing" : "default");
+  state.SetItemsProcessed(static_cast<int64_t>(width) * depth *
+                          state.iterations());
+}
+
+// Wide graphs
+BENCHMARK(BM_ExecutorScheduling)
+    ->UseRealTime()
+    ->ArgsProduct({{1024, 8192}, {2}, {4096}, {0, 1}});
+// Deep graphs
+BENCHMARK(BM_ExecutorScheduling)
+    ->UseRealTime()
+    ->ArgsProduct({{4, 16}, {1024}, {4096}, {0, 1}});
+
 static void BM_const_identity(::testing::benchmark::State& state) {
   const int width = state.range(0);
   const int outputs_per_const = state.range(1);
@@ -17,6 +17,9 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/local_device.h"
 
+#include <algorithm>
+#include <memory>
+
 #include "unsupported/Eigen/CXX11/Tensor"  // from @eigen_archive
 #include "tensorflow/core/common_runtime/process_state.h"
 #include "tensorflow/core/common_runtime/process_util.h"
@@ -47,6 +50,26 @@ bool OverrideGlobalThreadPoolFromEnvironment() {
   return override_global_threadpool;
 }
 
+// Returns a pool for running the kernels of CPU devices on `numa_node`, with
+// the session's inter-op threads divided evenly among the NUMA nodes.
+thread::ThreadPool* NewNUMAInterOpThreadPool(const SessionOptions& options,
+                                             int numa_node,
+                                             int num_numa_nodes) {
+  const int32_t num_inter_op_threads =
+      NumInterOpThreadsFromSessionOptions(options);
+  const int32_t num_threads = std::max(
+      1, (num_inter_op_threads + num_numa_nodes - 1) / num_numa_nodes);
+  ThreadOptions thread_opts;
+  thread_opts.numa_node = numa_node;
+  VLOG(1) << "Creating inter-op thread pool for NUMA node " << numa_node
+          << " with " << num_threads << " threads";
+  return new thread::ThreadPool(
+      options.env, thread_opts,
+      strings::StrCat("numa_", numa_node, "_inter_op"), num_threads,
+      !options.config.experimental().disable_thread_spinning(),
+      /*allocator=*/nullptr);
+}
+
 }  // namespace
 
 /* static */
@@ -106,6 +129,8 @@ struct LocalDevice::EigenThreadPoolInfo {
   DeviceBase::CpuWorkerThreads eigen_worker_threads_;
   std::unique_ptr<Eigen::ThreadPoolDevice> eigen_device_;
   std::unique_ptr<EigenAllocator> eigen_allocator_;
+  // Runs the kernels of CPU devices on the same NUMA node, if any.
+  std::unique_ptr<thread::ThreadPool> inter_op_workers_;
 };
 
 LocalDevice::LocalDevice(const SessionOptions& options,
@@ -143,6 +168,17 @@ LocalDevice::LocalDevice(const SessionOptions& options,
             options, numa_node, numa_allocator);
       }
       tp_info = global_tp_info[numa_node];
+      // Unless the session runs kernels in the caller's thread, run those of
+      // CPU devices on inter-op threads pinned to the same node as their
+      // intra-op threads and memory.
+      if (attributes.device_type() == DEVICE_CPU &&
+          options.config.inter_op_parallelism_threads() >= 0) {
+        if (!tp_info->inter_op_workers_) {
+          tp_info->inter_op_workers_.reset(
+              NewNUMAInterOpThreadPool(options, numa_node, num_numa_nodes));
+        }
+        set_tensorflow_device_thread_pool(tp_info->inter_op_workers_.get());
+      }
     } else {
       if (global_tp_info.empty()) {
         global_tp_info.push_back(new LocalDevice::EigenThreadPoolInfo(
@@ -28,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/bfloat16.h"
 #include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -73,6 +74,22 @@ string RingAlgBufKey(const string& name, const string& exec_key, int pass,
   }
 }
 
+// Converts the values of `src` to the type of `dst`, which has as many
+// elements. Only conversions between DT_FLOAT and DT_BFLOAT16 are supported.
+void ConvertWireChunk(const Tensor& src, Tensor* dst) {
+  DCHECK_EQ(src.NumElements(), dst->NumElements());
+  if (src.dtype() == DT_FLOAT) {
+    DCHECK_EQ(dst->dtype(), DT_BFLOAT16);
+    RoundFloatToBFloat16(src.flat<float>().data(),
+                         dst->flat<bfloat16>().data(), src.NumElements());
+  } else {
+    DCHECK_EQ(src.dtype(), DT_BFLOAT16);
+    DCHECK_EQ(dst->dtype(), DT_FLOAT);
+    BFloat16ToFloat(src.flat<bfloat16>().data(), dst->flat<float>().data(),
+                    src.NumElements());
+  }
+}
+
 }  // namespace
 
 void RingAlg::PCQueue::Enqueue(RingField* rf) {
@@ -331,8 +348,11 @@ void RingAlg::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
   // a device can simultaneously send data by 2 or more independent
   // channels we can speed up the transfer by subdividing chunks and
   // processing multiple subdivisions at once.  So the actual number
-  // of RingFields is group_size_ * num_subdivs_.
-  DCHECK_EQ(field_idx, (chunk_idx * num_subdivs_) + subdiv_idx);
+  // of RingFields is group_size_ * num_subdivs_.  Each of those may
+  // further be split into num_pieces_ pieces that are transferred
+  // independently, so that reducing and forwarding one piece overlaps
+  // with receiving the next.
+  DCHECK_EQ(field_idx / num_pieces_, (chunk_idx * num_subdivs_) + subdiv_idx);
   rf->chunk_idx = chunk_idx;
   rf->subdiv_idx = subdiv_idx;
   rf->sc_idx = field_idx;
@@ -348,6 +368,16 @@ void RingAlg::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
                          .subdiv_permutations[subdiv_idx][send_to_rank];
   rf->recv_is_remote = !col_params_->group.members[rf->recv_dev_idx].is_local;
   rf->send_is_remote = !col_params_->group.members[send_dev_idx].is_local;
+  if (wire_data_type_ != DT_INVALID) {
+    // Only values crossing task boundaries are converted, which the sender
+    // and the receiver of each hop agree on.
+    const string& task =
+        col_params_->group.members[col_params_->default_rank].task;
+    rf->recv_is_compressed =
+        col_params_->group.members[rf->recv_dev_idx].task != task;
+    rf->send_is_compressed =
+        col_params_->group.members[send_dev_idx].task != task;
+  }
   if (ca_->ChunkBytes(rf->sc_idx) > 0) {
     // In pass 0 we skip Recv when rank = chunk_idx
     rf->do_recv = (rf->chunk_idx != rf->rank);
@@ -359,6 +389,11 @@ void RingAlg::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
       (rf->rank == ((rf->chunk_idx + (group_size_ - 1)) % group_size_));
   if (rf->do_send || rf->do_recv) {
     rf->chunk = ca_->ChunkAlias(rf->sc_idx);
+    if (rf->send_is_compressed || rf->recv_is_compressed) {
+      rf->wire_chunk = Tensor(col_ctx_->device->GetAllocator(
+                                  col_ctx_->op_ctx->output_alloc_attr(0)),
+                              wire_data_type_, rf->chunk.shape());
+    }
   }
   VLOG(2) << this << " InitRingField " << rf->DebugString() << " chunk "
           << ca_->TBounds(rf->chunk);
@@ -383,6 +418,13 @@ void RingAlg::AdvanceToSecondPass(RingField* rf) {
   VLOG(3) << "IncrRingField new value " << rf->DebugString();
 }
 
+void RingAlg::RoundChunkToWireDataType(RingField* rf) {
+  DCHECK_EQ(wire_data_type_, DT_BFLOAT16);
+  if (ca_->ChunkBytes(rf->sc_idx) == 0) return;
+  auto values = rf->chunk.flat<float>();
+  values = values.cast<bfloat16>().cast<float>();
+}
+
 string RingAlg::RingField::DebugString() const {
   string rv = strings::StrCat("RingField rank=", rank, " chunk_idx=", chunk_idx,
                               " subdiv=", subdiv_idx, " sc_idx=", sc_idx,
@@ -391,6 +433,10 @@ string RingAlg::RingField::DebugString() const {
   strings::StrAppend(&rv, " do_send=", do_send, " do_recv=", do_recv,
                      " is_final=", is_final, " recv_is_remote=", recv_is_remote,
                      " recv_dev_idx=", recv_dev_idx, " sc_idx=", sc_idx);
+  if (send_is_compressed || recv_is_compressed) {
+    strings::StrAppend(&rv, " send_is_compressed=", send_is_compressed,
+                       " recv_is_compressed=", recv_is_compressed);
+  }
   return rv;
 }
 
@@ -404,11 +450,16 @@ void RingAlg::DispatchSend(RingField* rf, const StatusCallback& done) {
   int send_to_rank = (rf->rank + 1) % group_size_;
   int send_to_dev_idx = col_params_->instance.impl_details
                             .subdiv_permutations[rf->subdiv_idx][send_to_rank];
+  Tensor* src_tensor = &rf->chunk;
+  if (rf->send_is_compressed) {
+    ConvertWireChunk(rf->chunk, &rf->wire_chunk);
+    src_tensor = &rf->wire_chunk;
+  }
   col_ctx_->col_exec->remote_access()->PostToPeer(
       col_params_->group.members[send_to_dev_idx].device.name(),
       col_params_->group.members[send_to_dev_idx].task, send_buf_key,
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
-      col_ctx_->op_ctx->output_alloc_attr(0), &rf->chunk,
+      col_ctx_->op_ctx->output_alloc_attr(0), src_tensor,
       col_ctx_->device_locality, col_ctx_->op_ctx->cancellation_manager(),
       done);
 }
@@ -424,14 +475,25 @@ void RingAlg::DispatchRecv(RingField* rf, const StatusCallback& done) {
   Tensor* dst_tensor = (!rf->second_pass && (col_params_->merge_op != nullptr))
                            ? &rf->tmp_chunk
                            : &rf->chunk;
+  Tensor* recv_tensor = dst_tensor;
+  StatusCallback recv_done = done;
+  if (rf->recv_is_compressed) {
+    // Receive into wire_chunk and convert into the destination once the
+    // transfer completes.
+    recv_tensor = &rf->wire_chunk;
+    recv_done = [rf, dst_tensor, done](const Status& s) {
+      if (s.ok()) ConvertWireChunk(rf->wire_chunk, dst_tensor);
+      done(s);
+    };
+  }
   col_ctx_->col_exec->remote_access()->RecvFromPeer(
       col_params_->group.members[rf->recv_dev_idx].device.name(),
       col_params_->group.members[rf->recv_dev_idx].task,
       col_params_->group.members[rf->recv_dev_idx].is_local, recv_buf_key,
       col_ctx_->device, col_ctx_->op_ctx->op_device_context(),
-      col_ctx_->op_ctx->output_alloc_attr(0), dst_tensor,
+      col_ctx_->op_ctx->output_alloc_attr(0), recv_tensor,
       col_ctx_->device_locality, rf->subdiv_idx,
-      col_ctx_->op_ctx->cancellation_manager(), done);
+      col_ctx_->op_ctx->cancellation_manager(), recv_done);
 }
 
 string RingAlg::FieldState() {
@@ -75,12 +75,19 @@ class RingAlg : public CollectiveImplementationInterface {
     bool is_final = false;  // is the last field in the pass for this rank
     Tensor chunk;           // alias to field values
     Tensor tmp_chunk;
+    // Set if the value is sent or recv'd as wire_data_type_ via wire_chunk.
+    bool send_is_compressed = false;
+    bool recv_is_compressed = false;
+    Tensor wire_chunk;
     Status status;
     string DebugString() const;
   };
   virtual void InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
                              int field_idx);
   void AdvanceToSecondPass(RingField* rf);
+  // Rounds the values of rf->chunk to the precision of wire_data_type_, so
+  // that the rank producing a final value keeps the same value it sends.
+  void RoundChunkToWireDataType(RingField* rf);
   void DispatchSend(RingField* rf, const StatusCallback& done);
   void DispatchRecv(RingField* rf, const StatusCallback& done);
 
@@ -108,6 +115,13 @@ class RingAlg : public CollectiveImplementationInterface {
   StatusCallback done_;
   int group_size_;
   int num_subdivs_;
+  // Number of independent pieces each chunk of each subdivision is split
+  // into, so that field index = ((chunk_idx * num_subdivs_) + subdiv_idx) *
+  // num_pieces_ + piece_idx.
+  int num_pieces_ = 1;
+  // If not DT_INVALID, values sent between devices in different tasks are
+  // converted to this type on the wire.
+  DataType wire_data_type_ = DT_INVALID;
   Tensor group_size_tensor_;
   Notification group_size_tensor_ready_;
   std::unique_ptr<CollectiveAdapter> ca_;
@@ -16,8 +16,10 @@ limitations under the License.
 
 #include <stdlib.h>
 
+#include <algorithm>
 #include <atomic>
 #include <functional>
+#include <limits>
 #include <utility>
 
 #include "tensorflow/core/common_runtime/collective_rma_local.h"
@@ -49,6 +51,19 @@ Status RingReducer::InitializeCollectiveParams(CollectiveParams* col_params) {
   // TODO(b/113171733): change CHECKs to return errors.
   CHECK_EQ(col_params->instance.type, REDUCTION_COLLECTIVE);
   CHECK_EQ(col_params->instance.impl_details.collective_name, "RingReduce");
+  const DataType wire_data_type =
+      col_params->instance.impl_details.wire_data_type;
+  if (wire_data_type != DT_INVALID &&
+      (wire_data_type != DT_BFLOAT16 ||
+       col_params->instance.data_type != DT_FLOAT ||
+       col_params->group.device_type != DEVICE_CPU)) {
+    return errors::Unimplemented(
+        "RingReduce does not support sending ",
+        DataTypeString(col_params->instance.data_type), " values as ",
+        DataTypeString(wire_data_type), " on ",
+        col_params->group.device_type.type_string(),
+        "; only DT_FLOAT as DT_BFLOAT16 on CPU is supported");
+  }
   return RingAlg::InitializeCollectiveParams(col_params);
 }
 
@@ -64,6 +79,12 @@ void RingReducer::Run(StatusCallback done) {
   num_subdivs_ = static_cast<int>(
       col_params_->instance.impl_details.subdiv_permutations.size());
   CHECK_GT(num_subdivs_, 0);
+  num_pieces_ = NumPipelinePieces();
+  // Within a single task the values never leave the process, so converting
+  // them would only lose precision.
+  if (col_params_->group.num_tasks > 1) {
+    wire_data_type_ = col_params_->instance.impl_details.wire_data_type;
+  }
 
   if (VLOG_IS_ON(1)) {
     string buf;
@@ -81,7 +102,9 @@ void RingReducer::Run(StatusCallback done) {
       }
     }
     VLOG(1) << "RingReducer::Run for device " << col_ctx_->device_name
-            << " default_rank " << col_params_->default_rank << "\n"
+            << " default_rank " << col_params_->default_rank << " num_pieces "
+            << num_pieces_ << " wire_data_type "
+            << DataTypeString(wire_data_type_) << "\n"
             << buf;
   }
 
@@ -117,7 +140,8 @@ void RingReducer::Run(StatusCallback done) {
 // which cannot be blocked.
 void RingReducer::ContinueAfterInputCopy() {
   AllocatorAttributes attr = col_ctx_->op_ctx->output_alloc_attr(0);
-  ca_.reset(MakeCollectiveAdapter(col_ctx_->output, group_size_ * num_subdivs_,
+  ca_.reset(MakeCollectiveAdapter(col_ctx_->output,
+                                  group_size_ * num_subdivs_ * num_pieces_,
                                   col_ctx_->device->GetAllocator(attr)));
 
   if (col_params_->final_op) {
@@ -161,6 +185,20 @@ void RingReducer::ContinueAfterInputCopy() {
   Finish(RunAsyncParts());
 }
 
+int RingReducer::NumPipelinePieces() const {
+  const int64_t piece_bytes =
+      col_params_->instance.impl_details.pipeline_piece_bytes;
+  if (piece_bytes <= 0) return 1;
+  const int64_t num_fields = group_size_ * num_subdivs_;
+  const int64_t field_bytes =
+      (col_ctx_->output->TotalBytes() + num_fields - 1) / num_fields;
+  int64_t num_pieces = (field_bytes + piece_bytes - 1) / piece_bytes;
+  // RingField indices must fit in an int16.
+  num_pieces =
+      std::min(num_pieces, std::numeric_limits<int16>::max() / num_fields);
+  return static_cast<int>(std::max<int64_t>(num_pieces, 1));
+}
+
 void RingReducer::InitRingField(RingField* rf, int chunk_idx, int subdiv_idx,
                                 int field_idx) {
   RingAlg::InitRingField(rf, chunk_idx, subdiv_idx, field_idx);
@@ -178,13 +216,16 @@ bool RingReducer::RunAsyncParts() {
   // complete. Hence function local variables are accessible only by that
   // one thread and do not require an explicit mutex.
   rfv_.clear();
-  rfv_.resize(group_size_ * num_subdivs_);
+  rfv_.resize(group_size_ * num_subdivs_ * num_pieces_);
   PCQueue ready_queue;
   for (int chunk_idx = 0; chunk_idx < group_size_; ++chunk_idx) {
     for (int subdiv_idx = 0; subdiv_idx < num_subdivs_; ++subdiv_idx) {
-      int rf_index = (chunk_idx * num_subdivs_) + subdiv_idx;
-      InitRingField(&rfv_[rf_index], chunk_idx, subdiv_idx, rf_index);
-      ready_queue.Enqueue(&rfv_[rf_index]);
+      for (int piece_idx = 0; piece_idx < num_pieces_; ++piece_idx) {
+        int rf_index =
+            ((chunk_idx * num_subdivs_) + subdiv_idx) * num_pieces_ + piece_idx;
+        InitRingField(&rfv_[rf_index], chunk_idx, subdiv_idx, rf_index);
+        ready_queue.Enqueue(&rfv_[rf_index]);
+      }
     }
   }
   const DeviceBase::AcceleratorDeviceInfo* gpu_info =
@@ -314,6 +355,11 @@ bool RingReducer::RunAsyncParts() {
             ++field_done_count;
             break;  // from do while(!dispatched)
           } else {
+            if (rf->is_final && wire_data_type_ != DT_INVALID) {
+              // Every other rank receives this final value through at least
+              // one conversion to wire_data_type_.
+              RoundChunkToWireDataType(rf);
+            }
             AdvanceToSecondPass(rf);
           }
         }
@@ -47,6 +47,9 @@ class RingReducer : public RingAlg {
 
  private:
   void ContinueAfterInputCopy();
+  // Returns the number of pieces each field is split into to respect
+  // impl_details.pipeline_piece_bytes.
+  int NumPipelinePieces() const;
   bool RunAsyncParts();
 
   Tensor group_size_tensor_;
@@ -36,8 +36,10 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/refcount.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 #include "tensorflow/core/platform/unbounded_work_queue.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/public/version.h"
@@ -91,6 +93,10 @@ class RingReducerTest : public ::testing::Test {
         int rank = wi * num_devices + di;
         instances_.push_back(std::make_unique<DeviceInstance>(
             rank, num_subdivs, dtype, shape, test_env_.get()));
+        CollImplDetails& impl_details =
+            instances_.back()->col_params_->instance.impl_details;
+        impl_details.pipeline_piece_bytes = pipeline_piece_bytes_;
+        impl_details.wire_data_type = wire_data_type_;
       }
     }
   }
@@ -147,8 +153,18 @@ class RingReducerTest : public ::testing::Test {
       }
       for (int di = 0; di < static_cast<int>(instances_.size()); ++di) {
         TF_EXPECT_OK(instances_[di]->status_);
-        test::ExpectTensorEqual<T>(test::AsTensor<T>(expected),
-                                   instances_[di]->tensor());
+        if (wire_data_type_ == DT_INVALID || num_workers == 1) {
+          test::ExpectTensorEqual<T>(test::AsTensor<T>(expected),
+                                     instances_[di]->tensor());
+        } else {
+          // Each conversion to bfloat16 has a relative error of at most 2^-8
+          // and a value is converted at most once per hop.
+          test::ExpectClose(test::AsTensor<T>(expected),
+                            instances_[di]->tensor(), /*atol=*/0,
+                            /*rtol=*/4e-3 * instances_.size());
+          test::ExpectTensorEqual<T>(instances_[0]->tensor(),
+                                     instances_[di]->tensor());
+        }
       }
     }
   }
@@ -199,6 +215,9 @@ class RingReducerTest : public ::testing::Test {
 
   std::unique_ptr<CollectiveTestEnv> test_env_;
   std::vector<std::unique_ptr<DeviceInstance>> instances_;
+  // Applied to the impl_details of every instance created by Init().
+  int64_t pipeline_piece_bytes_ = 0;
+  DataType wire_data_type_ = DT_INVALID;
   mutex mu_;
   int32 reduce_counter_ TF_GUARDED_BY(mu_) = 0;
 };
@@ -219,6 +238,13 @@ class RingReducerInitParamsTest : public ::testing::Test {
     EXPECT_EQ(expected_subdiv_rank, cp->subdiv_rank);
     reducer->group_size_tensor_ready_.Notify();  // To unblock destructor.
   }
+
+  Status InitializeCollectiveParams(CollectiveParams* cp) {
+    core::RefCountPtr<RingReducer> reducer(new RingReducer());
+    Status s = reducer->InitializeCollectiveParams(cp);
+    reducer->group_size_tensor_ready_.Notify();  // To unblock destructor.
+    return s;
+  }
 };
 
 TEST_F(RingReducerInitParamsTest, SpecifiedSubdivs) {
@@ -356,6 +382,21 @@ TEST_F(RingReducerInitParamsTest, AutomaticSubdivUsesDefault) {
   RunSubdivPermsTest(cp.get(), {{0, 1, 2, 3}, {0, 1, 2, 3}}, {0, 0});
 }
 
+TEST_F(RingReducerInitParamsTest, UnsupportedWireDataType) {
+  auto test_env = CreateCollectiveTestEnv(/*num_workers=*/2,
+                                          /*num_devices_per_worker=*/1,
+                                          DEVICE_CPU);
+  auto cp =
+      CreateCollectiveParams(*test_env, /*rank*/ 0, "RingReduce",
+                             REDUCTION_COLLECTIVE, DT_DOUBLE, TensorShape({1}));
+  cp->instance.impl_details.wire_data_type = DT_BFLOAT16;
+  EXPECT_TRUE(errors::IsUnimplemented(InitializeCollectiveParams(cp.get())));
+
+  cp->instance.data_type = DT_FLOAT;
+  cp->instance.impl_details.wire_data_type = DT_HALF;
+  EXPECT_TRUE(errors::IsUnimplemented(InitializeCollectiveParams(cp.get())));
+}
+
 TEST_F(RingReducerInitParamsTest, AutomaticSubdivDisabled) {
   const int kNumDevsPerWorker = 1;
   const int kNumWorkers = 4;
@@ -427,6 +468,45 @@ DEF_TEST(INT64, CPU, 2, 8, 3, 4095, 0)
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 1)
 DEF_TEST(FLOAT, CPU, 2, 8, 1, 9408, 7)
 DEF_TEST(FLOAT, CPU, 2, 8, 2, 9408, 11)
+
+TEST_F(RingReducerTest, PipelinedPieces) {
+  pipeline_piece_bytes_ = 256;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/2, /*num_devices=*/4,
+                 /*num_subdivs=*/2, /*tensor_len=*/9408, /*fail_after=*/0);
+}
+
+TEST_F(RingReducerTest, PipelinedPiecesSmallerThanAlignment) {
+  // Most pieces end up empty.
+  pipeline_piece_bytes_ = 1;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/2, /*num_devices=*/2,
+                 /*num_subdivs=*/1, /*tensor_len=*/1001, /*fail_after=*/0);
+}
+
+TEST_F(RingReducerTest, PipelinedPiecesAbort) {
+  pipeline_piece_bytes_ = 1024;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/2, /*num_devices=*/8,
+                 /*num_subdivs=*/1, /*tensor_len=*/9408, /*fail_after=*/7);
+}
+
+TEST_F(RingReducerTest, BFloat16WireDataType) {
+  wire_data_type_ = DT_BFLOAT16;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/4, /*num_devices=*/2,
+                 /*num_subdivs=*/2, /*tensor_len=*/4095, /*fail_after=*/0);
+}
+
+TEST_F(RingReducerTest, BFloat16WireDataTypePipelined) {
+  wire_data_type_ = DT_BFLOAT16;
+  pipeline_piece_bytes_ = 1024;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/3, /*num_devices=*/1,
+                 /*num_subdivs=*/1, /*tensor_len=*/9408, /*fail_after=*/0);
+}
+
+TEST_F(RingReducerTest, BFloat16WireDataTypeUnusedWithinTask) {
+  // RunTest expects an exact result for a single worker.
+  wire_data_type_ = DT_BFLOAT16;
+  RunTest<float>(DT_FLOAT, DEVICE_CPU, /*num_workers=*/1, /*num_devices=*/4,
+                 /*num_subdivs=*/1, /*tensor_len=*/1001, /*fail_after=*/0);
+}
 #endif
 
 #if GOOGLE_CUDA || TENSORFLOW_USE_ROCM
@@ -454,4 +534,61 @@ DEF_TEST(FLOAT, GPU, 1, 8, 1, 9408, 2)
 DEF_TEST(FLOAT, GPU, 1, 8, 2, 9408, 5)
 #endif
 
+// Performance benchmarks below.
+
+// Computes the mean of a DT_FLOAT tensor of `state.range(1)` bytes across
+// `state.range(0)` single-device CPU workers, with
+// impl_details.pipeline_piece_bytes = `state.range(2)` and, if
+// `state.range(3)` is nonzero, impl_details.wire_data_type = DT_BFLOAT16.
+// Transfers between the simulated workers are in-process copies, so this
+// measures the overhead and overlap of the algorithm rather than the network.
+void BM_RingReduce(::testing::benchmark::State& state) {
+  const int num_workers = state.range(0);
+  const int64_t num_bytes = state.range(1);
+  const TensorShape shape({num_bytes / DataTypeSize(DT_FLOAT)});
+  auto test_env = CreateCollectiveTestEnv(num_workers,
+                                          /*num_devices_per_worker=*/1,
+                                          DEVICE_CPU);
+  std::vector<core::RefCountPtr<CollectiveParams>> col_params;
+  std::vector<Device*> devices(num_workers);
+  std::vector<std::unique_ptr<OpKernel>> ops;
+  std::vector<Tensor> tensors;
+  for (int rank = 0; rank < num_workers; ++rank) {
+    col_params.push_back(CreateCollectiveParams(*test_env, rank, "RingReduce",
+                                                REDUCTION_COLLECTIVE,
+                                                DT_FLOAT, shape));
+    CollectiveParams* cp = col_params.back().get();
+    cp->instance.impl_details.pipeline_piece_bytes = state.range(2);
+    if (state.range(3)) cp->instance.impl_details.wire_data_type = DT_BFLOAT16;
+    TF_CHECK_OK(test_env->device_mgr->LookupDevice(
+        cp->group.members[rank].device.name(), &devices[rank]));
+    ops.push_back(GetAdd(DT_FLOAT, DEVICE_CPU, devices[rank]));
+    cp->merge_op = ops.back().get();
+    ops.push_back(GetDiv(DT_FLOAT, DEVICE_CPU, devices[rank]));
+    cp->final_op = ops.back().get();
+    tensors.emplace_back(DT_FLOAT, shape);
+    tensors.back().flat<float>().setRandom();
+  }
+
+  for (auto s : state) {
+    BlockingCounter counter(num_workers);
+    for (int rank = 0; rank < num_workers; ++rank) {
+      // InitializeCollectiveParams appends to these on every run.
+      col_params[rank]->instance.impl_details.subdiv_permutations.clear();
+      col_params[rank]->subdiv_rank.clear();
+      SchedClosure([&, rank] {
+        TF_CHECK_OK(RunCollective(test_env.get(), col_params[rank].get(),
+                                  devices[rank], &tensors[rank],
+                                  &tensors[rank]));
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+  state.SetBytesProcessed(state.iterations() * num_bytes);
+}
+BENCHMARK(BM_RingReduce)
+    ->UseRealTime()
+    ->ArgsProduct({{2, 4, 8, 16}, {1 << 20, 64 << 20}, {0, 64 << 10}, {0, 1}});
+
 }  // namespace tensorflow
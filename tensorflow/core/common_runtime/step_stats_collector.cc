@@ -17,6 +17,7 @@ limitations under the License.
 #include <memory>
 
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
+#include "tensorflow/core/common_runtime/critical_path_analyzer.h"
 #include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -382,6 +383,17 @@ void StepStatsCollector::BuildCostModel(
   }
 }
 
+void StepStatsCollector::AnalyzeCriticalPath(
+    CriticalPathAnalyzer* analyzer,
+    const std::unordered_map<string, const Graph*>& device_map) {
+  mutex_lock lock(mu_);
+  if (!step_stats_) return;
+  if (!finalized_) {
+    FinalizeInternal();
+  }
+  analyzer->AddStep(*step_stats_, device_map);
+}
+
 void StepStatsCollector::Save(const string& device,
                               NodeExecStats* node_stats_pb) {
   Save(device,
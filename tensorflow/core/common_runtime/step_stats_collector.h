@@ -32,6 +32,7 @@ namespace tensorflow {
 
 class AllocatorMemoryUsed;
 class CostModelManager;
+class CriticalPathAnalyzer;
 class Graph;
 class NodeDef;
 class NodeExecStats;
@@ -166,6 +167,13 @@ class StepStatsCollector : public StepStatsCollectorInterface {
       CostModelManager* cost_model_manager,
       const std::unordered_map<string, const Graph*>& device_map);
 
+  // AnalyzeCriticalPath adds the critical path of the step through the graphs
+  // in device_map, computed from the currently collected DeviceStats, to the
+  // statistics aggregated by analyzer.
+  void AnalyzeCriticalPath(
+      CriticalPathAnalyzer* analyzer,
+      const std::unordered_map<string, const Graph*>& device_map);
+
   // Saves node statistics to the DeviceStats object associated with device.
   // Should be called before Finalize.
   void Save(const string& device, NodeExecStats* node_stats_pb);
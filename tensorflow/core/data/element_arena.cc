@@ -0,0 +1,155 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/element_arena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// The target size of a chunk. Large enough to amortize the allocation of a
+// chunk over many elements and small enough not to overallocate when the
+// arena holds fewer elements than its capacity.
+constexpr int64_t kTargetChunkBytes = 1 << 20;
+
+}  // namespace
+
+bool ElementArena::IsSupported(const DataTypeVector& dtypes,
+                               const std::vector<PartialTensorShape>& shapes,
+                               int64_t max_element_bytes) {
+  if (dtypes.empty() || dtypes.size() != shapes.size()) {
+    return false;
+  }
+  int64_t element_bytes = 0;
+  for (size_t i = 0; i < dtypes.size(); ++i) {
+    if (!DataTypeCanUseMemcpy(dtypes[i]) || !shapes[i].IsFullyDefined()) {
+      return false;
+    }
+    element_bytes += shapes[i].num_elements() * DataTypeSize(dtypes[i]);
+    if (element_bytes > max_element_bytes) {
+      return false;
+    }
+  }
+  return true;
+}
+
+ElementArena::ElementArena(const DataTypeVector& dtypes,
+                           const std::vector<PartialTensorShape>& shapes,
+                           int64_t capacity)
+    : dtypes_(dtypes), capacity_(capacity) {
+  DCHECK_GT(capacity, 0);
+  int64_t element_bytes = 0;
+  for (size_t i = 0; i < dtypes_.size(); ++i) {
+    TensorShape shape;
+    CHECK(shapes[i].AsTensorShape(&shape));
+    component_bytes_.push_back(shape.num_elements() *
+                               DataTypeSize(dtypes_[i]));
+    element_bytes += component_bytes_.back();
+    shapes_.push_back(std::move(shape));
+  }
+  slots_per_chunk_ = std::min(
+      capacity_,
+      std::max<int64_t>(1, kTargetChunkBytes / std::max<int64_t>(
+                                                   1, element_bytes)));
+  chunks_.resize((capacity_ + slots_per_chunk_ - 1) / slots_per_chunk_);
+}
+
+char* ElementArena::SlotData(int64_t slot, int component) const {
+  const std::vector<Tensor>& chunk = chunks_[slot / slots_per_chunk_];
+  DCHECK(!chunk.empty());
+  return const_cast<char*>(chunk[component].tensor_data().data()) +
+         (slot % slots_per_chunk_) * component_bytes_[component];
+}
+
+Status ElementArena::Put(int64_t slot, const std::vector<Tensor>& element) {
+  if (slot < 0 || slot >= capacity_) {
+    return errors::OutOfRange("Slot ", slot, " is out of range [0, ",
+                              capacity_, ").");
+  }
+  if (element.size() != dtypes_.size()) {
+    return errors::InvalidArgument("Expected an element with ",
+                                   dtypes_.size(), " components but got ",
+                                   element.size(), ".");
+  }
+  for (size_t i = 0; i < element.size(); ++i) {
+    if (element[i].dtype() != dtypes_[i] || element[i].shape() != shapes_[i]) {
+      return errors::InvalidArgument(
+          "Expected component ", i, " to be a ", DataTypeString(dtypes_[i]),
+          " tensor of shape ", shapes_[i].DebugString(), " but got a ",
+          DataTypeString(element[i].dtype()), " tensor of shape ",
+          element[i].shape().DebugString(), ".");
+    }
+  }
+  std::vector<Tensor>& chunk = chunks_[slot / slots_per_chunk_];
+  if (chunk.empty()) {
+    // The last chunk only holds the remaining slots.
+    const int64_t chunk_start = slot - slot % slots_per_chunk_;
+    const int64_t num_slots =
+        std::min(slots_per_chunk_, capacity_ - chunk_start);
+    chunk.reserve(dtypes_.size());
+    for (size_t i = 0; i < dtypes_.size(); ++i) {
+      TensorShape chunk_shape = shapes_[i];
+      chunk_shape.InsertDim(0, num_slots);
+      chunk.emplace_back(dtypes_[i], chunk_shape);
+      allocated_bytes_ += chunk.back().TotalBytes();
+    }
+  }
+  for (size_t i = 0; i < element.size(); ++i) {
+    if (component_bytes_[i] > 0) {
+      std::memcpy(SlotData(slot, i), element[i].tensor_data().data(),
+                  component_bytes_[i]);
+    }
+  }
+  return OkStatus();
+}
+
+void ElementArena::Get(int64_t slot, std::vector<Tensor>* element) const {
+  element->clear();
+  element->reserve(dtypes_.size());
+  for (size_t i = 0; i < dtypes_.size(); ++i) {
+    element->emplace_back(dtypes_[i], shapes_[i]);
+    if (component_bytes_[i] > 0) {
+      std::memcpy(const_cast<char*>(element->back().tensor_data().data()),
+                  SlotData(slot, i), component_bytes_[i]);
+    }
+  }
+}
+
+void ElementArena::Copy(int64_t from, int64_t to) {
+  if (from == to) {
+    return;
+  }
+  for (size_t i = 0; i < dtypes_.size(); ++i) {
+    if (component_bytes_[i] > 0) {
+      std::memcpy(SlotData(to, i), SlotData(from, i), component_bytes_[i]);
+    }
+  }
+}
+
+void ElementArena::Clear() {
+  for (std::vector<Tensor>& chunk : chunks_) {
+    chunk.clear();
+  }
+  allocated_bytes_ = 0;
+}
+
+}  // namespace data
+}  // namespace tensorflow
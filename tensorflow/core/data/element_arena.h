@@ -0,0 +1,95 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_CORE_DATA_ELEMENT_ARENA_H_
+#define TENSORFLOW_CORE_DATA_ELEMENT_ARENA_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "tensorflow/core/framework/partial_tensor_shape.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/status.h"
+
+namespace tensorflow {
+namespace data {
+
+// Stores up to `capacity` dataset elements of a fixed signature in numbered
+// slots. Instead of holding on to the tensors of each element, the arena
+// copies their contents into chunks that each hold the slots of many
+// elements, with one tensor per component and chunk. Chunks are allocated
+// when a slot in them is first written and are then reused for the lifetime
+// of the arena, so storing an element makes no allocation.
+//
+// This avoids the per-element allocations and the resulting fragmentation of
+// buffers that hold large numbers of small elements.
+//
+// Not thread-safe.
+class ElementArena {
+ public:
+  // Returns whether elements with the given component dtypes and shapes can
+  // be stored in an arena, i.e. whether all components have a memcpy-able
+  // dtype and a fully defined shape, and an element occupies at most
+  // `max_element_bytes` bytes.
+  static bool IsSupported(const DataTypeVector& dtypes,
+                          const std::vector<PartialTensorShape>& shapes,
+                          int64_t max_element_bytes);
+
+  // REQUIRES: IsSupported(dtypes, shapes, ...) and capacity > 0.
+  ElementArena(const DataTypeVector& dtypes,
+               const std::vector<PartialTensorShape>& shapes,
+               int64_t capacity);
+
+  int64_t capacity() const { return capacity_; }
+
+  // Returns the number of bytes allocated for chunks.
+  int64_t allocated_bytes() const { return allocated_bytes_; }
+
+  // Copies `element` into `slot`, allocating the chunk that holds the slot if
+  // needed. Returns an error if `element` does not match the signature of
+  // the arena.
+  Status Put(int64_t slot, const std::vector<Tensor>& element);
+
+  // Copies the element in `slot` into newly allocated tensors.
+  // REQUIRES: `slot` was written by `Put()`.
+  void Get(int64_t slot, std::vector<Tensor>* element) const;
+
+  // Copies the element in slot `from` into slot `to`.
+  // REQUIRES: both slots were written by `Put()`.
+  void Copy(int64_t from, int64_t to);
+
+  // Releases all chunks.
+  void Clear();
+
+ private:
+  char* SlotData(int64_t slot, int component) const;
+
+  const DataTypeVector dtypes_;
+  std::vector<TensorShape> shapes_;
+  // The number of bytes of each component of an element.
+  std::vector<int64_t> component_bytes_;
+  const int64_t capacity_;
+  int64_t slots_per_chunk_;
+  // `chunks_[i][j]` holds component `j` of the elements in the `i`-th chunk,
+  // or `chunks_[i]` is empty if the chunk has not been allocated.
+  std::vector<std::vector<Tensor>> chunks_;
+  int64_t allocated_bytes_ = 0;
+};
+
+}  // namespace data
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DATA_ELEMENT_ARENA_H_
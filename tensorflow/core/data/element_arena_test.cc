@@ -0,0 +1,206 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/data/element_arena.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+const DataTypeVector& Dtypes() {
+  static const auto* dtypes = new DataTypeVector({DT_INT64, DT_FLOAT});
+  return *dtypes;
+}
+
+const std::vector<PartialTensorShape>& Shapes() {
+  static const auto* shapes = new std::vector<PartialTensorShape>(
+      {PartialTensorShape({}), PartialTensorShape({4})});
+  return *shapes;
+}
+
+std::vector<Tensor> MakeElement(int64_t value) {
+  return {test::AsScalar<int64_t>(value),
+          test::AsTensor<float>({1.0f * value, 2.0f * value, 3.0f * value,
+                                 4.0f * value})};
+}
+
+void ExpectElement(const std::vector<Tensor>& element, int64_t value) {
+  std::vector<Tensor> expected = MakeElement(value);
+  ASSERT_EQ(element.size(), expected.size());
+  test::ExpectTensorEqual<int64_t>(element[0], expected[0]);
+  test::ExpectTensorEqual<float>(element[1], expected[1]);
+}
+
+TEST(ElementArenaTest, IsSupported) {
+  EXPECT_TRUE(ElementArena::IsSupported(Dtypes(), Shapes(), 1024));
+  // 8 + 16 bytes.
+  EXPECT_TRUE(ElementArena::IsSupported(Dtypes(), Shapes(), 24));
+  EXPECT_FALSE(ElementArena::IsSupported(Dtypes(), Shapes(), 23));
+  EXPECT_FALSE(ElementArena::IsSupported({DT_STRING}, {PartialTensorShape({})},
+                                         1024));
+  EXPECT_FALSE(ElementArena::IsSupported(
+      {DT_INT64}, {PartialTensorShape({-1})}, 1024));
+  EXPECT_FALSE(ElementArena::IsSupported({}, {}, 1024));
+}
+
+TEST(ElementArenaTest, PutGetCopy) {
+  ElementArena arena(Dtypes(), Shapes(), /*capacity=*/10);
+  EXPECT_EQ(arena.allocated_bytes(), 0);
+  for (int i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(arena.Put(i, MakeElement(i)));
+  }
+  EXPECT_EQ(arena.allocated_bytes(), 10 * 24);
+  std::vector<Tensor> element;
+  for (int i = 0; i < 10; ++i) {
+    arena.Get(i, &element);
+    ExpectElement(element, i);
+  }
+  arena.Copy(/*from=*/7, /*to=*/2);
+  arena.Get(2, &element);
+  ExpectElement(element, 7);
+
+  // Elements handed out are not affected by later writes to their slot.
+  arena.Get(3, &element);
+  TF_ASSERT_OK(arena.Put(3, MakeElement(42)));
+  ExpectElement(element, 3);
+  EXPECT_EQ(arena.allocated_bytes(), 10 * 24);
+
+  arena.Clear();
+  EXPECT_EQ(arena.allocated_bytes(), 0);
+}
+
+TEST(ElementArenaTest, AllocatesChunksOnDemand) {
+  // Chunks of 1MB hold 43690 elements of 24 bytes.
+  ElementArena arena(Dtypes(), Shapes(), /*capacity=*/1000000);
+  TF_ASSERT_OK(arena.Put(0, MakeElement(0)));
+  const int64_t chunk_bytes = arena.allocated_bytes();
+  EXPECT_GT(chunk_bytes, 0);
+  EXPECT_LE(chunk_bytes, 1 << 20);
+  TF_ASSERT_OK(arena.Put(1, MakeElement(1)));
+  EXPECT_EQ(arena.allocated_bytes(), chunk_bytes);
+  // The last chunk is truncated to the capacity.
+  TF_ASSERT_OK(arena.Put(999999, MakeElement(999999)));
+  EXPECT_EQ(arena.allocated_bytes(), chunk_bytes + (1000000 % 43690) * 24);
+
+  std::vector<Tensor> element;
+  arena.Get(999999, &element);
+  ExpectElement(element, 999999);
+}
+
+TEST(ElementArenaTest, InvalidElements) {
+  ElementArena arena(Dtypes(), Shapes(), /*capacity=*/4);
+  EXPECT_TRUE(errors::IsOutOfRange(arena.Put(4, MakeElement(0))));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      arena.Put(0, {test::AsScalar<int64_t>(0)})));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      arena.Put(0, {test::AsScalar<int64_t>(0),
+                    test::AsTensor<float>({1.0f, 2.0f})})));
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      arena.Put(0, {test::AsScalar<int32>(0),
+                    test::AsTensor<float>({1.0f, 2.0f, 3.0f, 4.0f})})));
+  EXPECT_EQ(arena.allocated_bytes(), 0);
+}
+
+// Returns the resident set size of the process, or 0 if it is unknown.
+int64_t ResidentSetBytes() {
+#if defined(__linux__)
+  // /proc files report a size of 0, so ReadFileToString() cannot read them.
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) return 0;
+  long long size_pages = 0;      // NOLINT(runtime/int)
+  long long resident_pages = 0;  // NOLINT(runtime/int)
+  const int num_read =
+      fscanf(statm, "%lld %lld", &size_pages, &resident_pages);
+  fclose(statm);
+  if (num_read != 2) return 0;
+  return resident_pages * sysconf(_SC_PAGESIZE);
+#else
+  return 0;
+#endif
+}
+
+// Simulates a shuffle buffer of `state.range(0)` elements of the signature
+// above in steady state: every iteration removes a random element and adds
+// a new one in its place. `state.range(1)` selects whether the buffer holds
+// individual tensors (0) or uses an `ElementArena` (1). The label reports the
+// growth of the resident set size while filling the buffer, which is only
+// indicative since it depends on the benchmarks that ran before.
+void BM_ShuffleBuffer(::testing::benchmark::State& state) {
+  const int64_t buffer_size = state.range(0);
+  const bool use_arena = state.range(1);
+  random::PhiloxRandom parent_generator(42);
+  random::SingleSampleAdapter<random::PhiloxRandom> generator(
+      &parent_generator);
+
+  const int64_t rss_before = ResidentSetBytes();
+  std::vector<std::vector<Tensor>> buffer;
+  std::unique_ptr<ElementArena> arena;
+  if (use_arena) {
+    arena = std::make_unique<ElementArena>(Dtypes(), Shapes(), buffer_size);
+  } else {
+    buffer.resize(buffer_size);
+  }
+  for (int64_t i = 0; i < buffer_size; ++i) {
+    if (use_arena) {
+      TF_CHECK_OK(arena->Put(i, MakeElement(i)));
+    } else {
+      buffer[i] = MakeElement(i);
+    }
+  }
+  const int64_t rss_after = ResidentSetBytes();
+
+  int64_t next = buffer_size;
+  for (auto s : state) {
+    const int64_t index = generator() % buffer_size;
+    std::vector<Tensor> element;
+    if (use_arena) {
+      arena->Get(index, &element);
+      TF_CHECK_OK(arena->Put(index, MakeElement(next++)));
+    } else {
+      element = std::move(buffer[index]);
+      buffer[index] = MakeElement(next++);
+    }
+    ::tensorflow::testing::DoNotOptimize(element);
+  }
+  state.SetItemsProcessed(state.iterations());
+  state.SetLabel(strings::StrCat("buffer_rss_mb=",
+                                 (rss_after - rss_before) >> 20));
+}
+
+BENCHMARK(BM_ShuffleBuffer)
+    ->ArgPair(10000, 0)
+    ->ArgPair(10000, 1)
+    ->ArgPair(1000000, 0)
+    ->ArgPair(1000000, 1);
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
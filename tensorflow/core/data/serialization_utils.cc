@@ -97,23 +97,13 @@ Status ReadElementsFromCheckpoint(IteratorContext* ctx,
                                   std::vector<std::vector<Tensor>>* elements) {
   int64_t num_elements;
   TF_RETURN_IF_ERROR(
-      reader->ReadScalar(key_prefix, kNumElements, &num_elements));
+      ReadNumElementsFromCheckpoint(reader, key_prefix, &num_elements));
   DCHECK(elements->empty());
   elements->reserve(num_elements);
   for (int i = 0; i < num_elements; ++i) {
-    std::string element_prefix = absl::StrCat(key_prefix, "::", i);
-    int64_t num_components;
-    TF_RETURN_IF_ERROR(
-        reader->ReadScalar(element_prefix, kNumComponents, &num_components));
     elements->emplace_back();
-    std::vector<Tensor>& element = elements->at(i);
-    element.reserve(num_components);
-    for (int j = 0; j < num_components; ++j) {
-      element.emplace_back();
-      TF_RETURN_IF_ERROR(reader->ReadTensor(
-          ctx->flr(), element_prefix, absl::StrCat(kComponent, "[", j, "]"),
-          &element.back()));
-    }
+    TF_RETURN_IF_ERROR(ReadElementFromCheckpoint(ctx, reader, key_prefix, i,
+                                                 &elements->at(i)));
   }
   return OkStatus();
 }
@@ -122,16 +112,54 @@ Status WriteElementsToCheckpoint(
     IteratorStateWriter* writer, StringPiece key_prefix,
     const std::vector<std::vector<Tensor>>& elements) {
   TF_RETURN_IF_ERROR(
-      writer->WriteScalar(key_prefix, kNumElements, elements.size()));
+      WriteNumElementsToCheckpoint(writer, key_prefix, elements.size()));
   for (int i = 0; i < elements.size(); ++i) {
-    const std::vector<Tensor>& element = elements[i];
-    std::string element_prefix = absl::StrCat(key_prefix, "::", i);
     TF_RETURN_IF_ERROR(
-        writer->WriteScalar(element_prefix, kNumComponents, element.size()));
-    for (int j = 0; j < elements[i].size(); ++j) {
-      TF_RETURN_IF_ERROR(writer->WriteTensor(
-          element_prefix, absl::StrCat(kComponent, "[", j, "]"), element[j]));
-    }
+        WriteElementToCheckpoint(writer, key_prefix, i, elements[i]));
+  }
+  return OkStatus();
+}
+
+Status ReadNumElementsFromCheckpoint(IteratorStateReader* reader,
+                                     StringPiece key_prefix,
+                                     int64_t* num_elements) {
+  return reader->ReadScalar(key_prefix, kNumElements, num_elements);
+}
+
+Status ReadElementFromCheckpoint(IteratorContext* ctx,
+                                 IteratorStateReader* reader,
+                                 StringPiece key_prefix, int64_t index,
+                                 std::vector<Tensor>* element) {
+  std::string element_prefix = absl::StrCat(key_prefix, "::", index);
+  int64_t num_components;
+  TF_RETURN_IF_ERROR(
+      reader->ReadScalar(element_prefix, kNumComponents, &num_components));
+  element->clear();
+  element->reserve(num_components);
+  for (int j = 0; j < num_components; ++j) {
+    element->emplace_back();
+    TF_RETURN_IF_ERROR(reader->ReadTensor(
+        ctx->flr(), element_prefix, absl::StrCat(kComponent, "[", j, "]"),
+        &element->back()));
+  }
+  return OkStatus();
+}
+
+Status WriteNumElementsToCheckpoint(IteratorStateWriter* writer,
+                                    StringPiece key_prefix,
+                                    int64_t num_elements) {
+  return writer->WriteScalar(key_prefix, kNumElements, num_elements);
+}
+
+Status WriteElementToCheckpoint(IteratorStateWriter* writer,
+                                StringPiece key_prefix, int64_t index,
+                                const std::vector<Tensor>& element) {
+  std::string element_prefix = absl::StrCat(key_prefix, "::", index);
+  TF_RETURN_IF_ERROR(
+      writer->WriteScalar(element_prefix, kNumComponents, element.size()));
+  for (int j = 0; j < element.size(); ++j) {
+    TF_RETURN_IF_ERROR(writer->WriteTensor(
+        element_prefix, absl::StrCat(kComponent, "[", j, "]"), element[j]));
   }
   return OkStatus();
 }
@@ -47,6 +47,25 @@ Status WriteElementsToCheckpoint(
     IteratorStateWriter* writer, StringPiece key_prefix,
     const std::vector<std::vector<Tensor>>& elements);
 
+// Counterparts of the functions above that read and write the elements one at
+// a time, for callers that cannot hold all elements in memory at once. The
+// checkpoint format is the same: elements written with
+// WriteNumElementsToCheckpoint and WriteElementToCheckpoint can be read back
+// with ReadElementsFromCheckpoint and vice versa.
+Status ReadNumElementsFromCheckpoint(IteratorStateReader* reader,
+                                     StringPiece key_prefix,
+                                     int64_t* num_elements);
+Status ReadElementFromCheckpoint(IteratorContext* ctx,
+                                 IteratorStateReader* reader,
+                                 StringPiece key_prefix, int64_t index,
+                                 std::vector<Tensor>* element);
+Status WriteNumElementsToCheckpoint(IteratorStateWriter* writer,
+                                    StringPiece key_prefix,
+                                    int64_t num_elements);
+Status WriteElementToCheckpoint(IteratorStateWriter* writer,
+                                StringPiece key_prefix, int64_t index,
+                                const std::vector<Tensor>& element);
+
 // Helper class for reading data from a vector of VariantTensorData objects.
 class VariantTensorDataReader : public IteratorStateReader {
  public:
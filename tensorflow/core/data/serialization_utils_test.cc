@@ -81,6 +81,43 @@ TEST(SerializationUtilsTest, CheckpointElementsRoundTrip) {
   }
 }
 
+TEST(SerializationUtilsTest, CheckpointElementsOneAtATime) {
+  std::vector<std::vector<Tensor>> elements;
+  elements.push_back(CreateTensors<int32>(TensorShape({3}), {{1, 2, 3}}));
+  elements.push_back(CreateTensors<int32>(TensorShape({2}), {{4, 5}}));
+  VariantTensorDataWriter writer;
+  tstring test_prefix = full_name("test_prefix");
+  TF_ASSERT_OK(WriteNumElementsToCheckpoint(&writer, test_prefix,
+                                            elements.size()));
+  for (int i = 0; i < elements.size(); ++i) {
+    TF_ASSERT_OK(
+        WriteElementToCheckpoint(&writer, test_prefix, i, elements[i]));
+  }
+  std::vector<const VariantTensorData*> data;
+  writer.GetData(&data);
+
+  VariantTensorDataReader reader(data);
+  TF_ASSERT_OK_AND_ASSIGN(std::unique_ptr<TestContext> ctx,
+                          TestContext::Create());
+  int64_t num_elements;
+  TF_ASSERT_OK(
+      ReadNumElementsFromCheckpoint(&reader, test_prefix, &num_elements));
+  ASSERT_EQ(num_elements, elements.size());
+  for (int i = 0; i < num_elements; ++i) {
+    std::vector<Tensor> read;
+    TF_ASSERT_OK(ReadElementFromCheckpoint(ctx->iter_ctx(), &reader,
+                                           test_prefix, i, &read));
+    ASSERT_EQ(read.size(), elements[i].size());
+    test::ExpectEqual(read[0], elements[i][0]);
+  }
+
+  // The format matches the one of `WriteElementsToCheckpoint`.
+  std::vector<std::vector<Tensor>> read_elements;
+  TF_ASSERT_OK(ReadElementsFromCheckpoint(ctx->iter_ctx(), &reader, test_prefix,
+                                          &read_elements));
+  ASSERT_EQ(read_elements.size(), elements.size());
+}
+
 TEST(SerializationUtilsTest, VariantTensorDataRoundtrip) {
   VariantTensorDataWriter writer;
   TF_ASSERT_OK(writer.WriteScalar(full_name("Int64"), 24));
@@ -18,6 +18,7 @@ limitations under the License.
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
 #include "tensorflow/core/common_runtime/dma_helper.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_reference.h"
@@ -25,6 +26,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/io/proto_encode_helper.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
@@ -134,8 +136,13 @@ static void EncodeSkeleton(const Tensor& val, io::ProtoEncodeHelper* e) {
 #endif
 }
 
-void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
-                              ::grpc::ByteBuffer* result) {
+namespace {
+
+// Encodes a RecvTensorResponse holding "val" and the other fields of
+// "response", which must not have a tensor yet, into "result".
+void EncodeTensorWithResponseToByteBuffer(const Tensor& val,
+                                          RecvTensorResponse* response,
+                                          ::grpc::ByteBuffer* result) {
   const int kLargeTensorBytes = 1024;
   const int64_t kProtoBufLimitBytes = 1LL << 31;
 
@@ -147,20 +154,14 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
                << ", tensor shape: " << val.shape().AsProto().DebugString();
   }
 
-  RecvTensorResponse response;
-  if (is_dead) {
-    response.set_is_dead(is_dead);
-  }
-  response.set_require_ack(require_ack);
-  response.set_send_start_micros(Env::Default()->NowMicros());
   if (!DataTypeCanUseMemcpy(val.dtype())) {
     // Straightforward but slow path for complicated kinds of tensor data
     // TODO(jeff,sanjay): If this becomes an issue, we could
     // go directly from val -> ByteBuffer, with some effort.
-    val.AsProtoTensorContent(response.mutable_tensor());
+    val.AsProtoTensorContent(response->mutable_tensor());
 
     // Encode full protocol buffer to a ByteBuffer
-    EncodeRecvTensorResponseToByteBuffer(response, result);
+    EncodeRecvTensorResponseToByteBuffer(*response, result);
   } else {
     // skeleton is the encoded TensorProto contents (dtype and shape), but
     // not the actual data
@@ -174,7 +175,7 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
          VarLengthEncodingSize(TensorProto::kTensorContentFieldNumber,
                                tdata.size()));
     string header;  // All of RecvTensorResponse except the tensor() field
-    response.AppendToString(&header);
+    response->AppendToString(&header);
 
     size_t expected_size =
         (header.size() +
@@ -250,5 +251,57 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
   }
 }
 
+}  // namespace
+
+void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
+                              ::grpc::ByteBuffer* result) {
+  RecvTensorResponse response;
+  if (is_dead) {
+    response.set_is_dead(is_dead);
+  }
+  response.set_require_ack(require_ack);
+  response.set_send_start_micros(Env::Default()->NowMicros());
+  EncodeTensorWithResponseToByteBuffer(val, &response, result);
+}
+
+void EncodeTensorToByteBufferAdvertisingRing(bool is_dead, const Tensor& val,
+                                             const SharedMemoryRing& ring,
+                                             ::grpc::ByteBuffer* result) {
+  RecvTensorResponse response;
+  if (is_dead) {
+    response.set_is_dead(is_dead);
+  }
+  response.set_send_start_micros(Env::Default()->NowMicros());
+  SharedMemoryRingAdvertisement advertisement;
+  advertisement.set_ring_name(ring.name());
+  response.mutable_transport_options()->PackFrom(advertisement);
+  EncodeTensorWithResponseToByteBuffer(val, &response, result);
+}
+
+bool EncodeTensorToSharedMemory(bool is_dead, const Tensor& val,
+                                SharedMemoryRing* ring,
+                                ::grpc::ByteBuffer* result,
+                                SharedMemoryTensorLocation* location) {
+  // Below this size the extra slot bookkeeping costs more than sending the
+  // content inline.
+  const int kMinSharedMemoryTensorBytes = 4096;
+
+  if (is_dead || !DataTypeCanUseMemcpy(val.dtype()) ||
+      val.TotalBytes() < kMinSharedMemoryTensorBytes) {
+    return false;
+  }
+  if (!ring->Write(val.tensor_data(), location)) return false;
+
+  // The receiver allocates the tensor from the skeleton, and then copies the
+  // content out of the ring.
+  RecvTensorResponse response;
+  response.mutable_tensor()->set_dtype(val.dtype());
+  val.shape().AsProto(response.mutable_tensor()->mutable_tensor_shape());
+  response.set_send_start_micros(Env::Default()->NowMicros());
+  response.mutable_transport_options()->PackFrom(*location);
+  EncodeRecvTensorResponseToByteBuffer(response, result);
+  return true;
+}
+
 }  // namespace grpc
 }  // namespace tensorflow
@@ -21,6 +21,8 @@ limitations under the License.
 namespace tensorflow {
 class Tensor;
 class RecvTensorResponse;
+class SharedMemoryRing;
+class SharedMemoryTensorLocation;
 
 // TODO(jeff,sanjay): this should not be grpc specific.  Instead of
 // grpc::ByteBuffer*, it should accept an object of an interface type
@@ -49,6 +51,27 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val, bool require_ack,
                               ::grpc::ByteBuffer* result);
 
+// Like EncodeTensorToByteBuffer with require_ack == false, but also names
+// "ring" in RecvTensorResponse::transport_options, so that a receiver on the
+// same host can map it and ask for later tensors to be sent through it.
+void EncodeTensorToByteBufferAdvertisingRing(bool is_dead, const Tensor& val,
+                                             const SharedMemoryRing& ring,
+                                             ::grpc::ByteBuffer* result);
+
+// Like EncodeTensorToByteBuffer, but writes the content of "val" to "ring"
+// and encodes only its dtype and shape, along with the location of the
+// content in RecvTensorResponse::transport_options. The location is also
+// returned in "*location", so that the slot can be released if the response
+// never reaches the receiver.
+//
+// Returns false, leaving *result unchanged, if "val" is dead, is too small
+// to benefit from shared memory, cannot be memcpy'd or does not fit in the
+// free space of "ring". The caller should then use EncodeTensorToByteBuffer.
+bool EncodeTensorToSharedMemory(bool is_dead, const Tensor& val,
+                                SharedMemoryRing* ring,
+                                ::grpc::ByteBuffer* result,
+                                SharedMemoryTensorLocation* location);
+
 }  // namespace grpc
 }  // namespace tensorflow
 
@@ -17,15 +17,31 @@ limitations under the License.
 
 #include "grpcpp/support/byte_buffer.h"
 #include "grpcpp/support/slice.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 #include "tensorflow/core/protobuf/worker.pb.h"
 
 namespace tensorflow {
 
+// Flattens "buf" into a RecvTensorResponse.
+RecvTensorResponse ParseByteBuffer(::grpc::ByteBuffer* buf) {
+  std::vector<::grpc::Slice> slices;
+  (void)buf->Dump(&slices);
+  string tmp;
+  for (const auto& s : slices) {
+    tmp.append(reinterpret_cast<const char*>(s.begin()), s.size());
+  }
+  RecvTensorResponse response;
+  EXPECT_TRUE(response.ParseFromString(tmp));
+  return response;
+}
+
 class GrpcTensorCodingTest : public ::testing::Test {
  public:
   void Validate(const Tensor& t, bool is_dead) {
@@ -100,4 +116,65 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, SharedMemory) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(1 << 20, &ring));
+  ::grpc::ByteBuffer buf;
+
+  SharedMemoryTensorLocation written;
+
+  // Small, dead and non-memcpy-able tensors are sent inline.
+  Tensor small(DT_FLOAT, TensorShape({4}));
+  EXPECT_FALSE(grpc::EncodeTensorToSharedMemory(false, small, ring.get(), &buf,
+                                                &written));
+  Tensor dead(DT_FLOAT, TensorShape({64, 100}));
+  EXPECT_FALSE(grpc::EncodeTensorToSharedMemory(true, dead, ring.get(), &buf,
+                                                &written));
+  Tensor strings(DT_STRING, TensorShape({4096}));
+  EXPECT_FALSE(grpc::EncodeTensorToSharedMemory(false, strings, ring.get(),
+                                                &buf, &written));
+  // So are tensors that do not fit in the ring.
+  Tensor large(DT_FLOAT, TensorShape({1 << 20}));
+  EXPECT_FALSE(grpc::EncodeTensorToSharedMemory(false, large, ring.get(), &buf,
+                                                &written));
+
+  Tensor t(DT_FLOAT, TensorShape({64, 100}));
+  test::FillIota<float>(&t, 1.0f);
+  ASSERT_TRUE(grpc::EncodeTensorToSharedMemory(false, t, ring.get(), &buf,
+                                               &written));
+  RecvTensorResponse response = ParseByteBuffer(&buf);
+  EXPECT_FALSE(response.is_dead());
+  EXPECT_TRUE(response.tensor().tensor_content().empty());
+  SharedMemoryTensorLocation location;
+  ASSERT_TRUE(response.transport_options().UnpackTo(&location));
+  EXPECT_EQ(location.ring_name(), ring->name());
+  EXPECT_EQ(location.sequence(), written.sequence());
+
+  Tensor result(DT_FLOAT, TensorShape(response.tensor().tensor_shape()));
+  EXPECT_EQ(result.TotalBytes(), location.size());
+  TF_ASSERT_OK(ReadFromSharedMemoryRing(
+      location, const_cast<char*>(result.tensor_data().data())));
+  test::ExpectTensorEqual<float>(result, t);
+}
+
+TEST_F(GrpcTensorCodingTest, AdvertiseSharedMemoryRing) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(1 << 20, &ring));
+  ::grpc::ByteBuffer buf;
+
+  // The content is sent inline, along with the name of the ring.
+  for (DataType dtype : {DT_FLOAT, DT_STRING}) {
+    Tensor t(dtype, TensorShape({64, 100}));
+    grpc::EncodeTensorToByteBufferAdvertisingRing(false, t, *ring, &buf);
+    RecvTensorResponse response = ParseByteBuffer(&buf);
+    Tensor result;
+    ASSERT_TRUE(result.FromProto(response.tensor()));
+    EXPECT_EQ(result.dtype(), dtype);
+    EXPECT_EQ(result.shape(), t.shape());
+    SharedMemoryRingAdvertisement advertisement;
+    ASSERT_TRUE(response.transport_options().UnpackTo(&advertisement));
+    EXPECT_EQ(advertisement.ring_name(), ring->name());
+  }
+}
+
 }  // namespace tensorflow
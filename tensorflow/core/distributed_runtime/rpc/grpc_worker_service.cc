@@ -37,6 +37,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service_impl.h"
 #include "tensorflow/core/distributed_runtime/rpc/rpc_response_cache.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
 #include "tensorflow/core/distributed_runtime/worker.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_session.h"
@@ -267,14 +268,16 @@ class GrpcWorkerServiceThread {
   void RecvTensorHandlerRaw(
       WorkerCall<RecvTensorRequest, ::grpc::ByteBuffer>* call) {
     Schedule([this, call]() {
-      CallOptions* call_opts = new CallOptions;
+      // Cancellations are forwarded to `call_opts` even after the response is
+      // sent, because GrpcRecvTensorAsync() frees the shared-memory slot of a
+      // response that is cancelled before it reaches the receiver. The call
+      // keeps `call_opts` alive through its cancel callback.
+      auto call_opts = std::make_shared<CallOptions>();
       call->SetCancelCallback([call_opts]() { call_opts->StartCancel(); });
 
       worker_->GrpcRecvTensorAsync(
-          call_opts, &call->request, &call->response,
-          [call, call_opts](const Status& s) {
-            call->ClearCancelCallback();
-            delete call_opts;
+          call_opts.get(), &call->request, &call->response,
+          [call](const Status& s) {
             if (!s.ok()) {
               VLOG(3) << "Bad response from RecvTensor:" << s;
             }
@@ -447,11 +450,49 @@ void GrpcWorker::GrpcRecvTensorAsync(CallOptions* opts,
 
   bool cache_enabled = (response_cache_ != nullptr && request_id != 0);
 
-  auto do_response = [response, done, cache_enabled](const Tensor& tensor,
-                                                     bool is_dead,
-                                                     const Status& status) {
+  // Receivers on the same host may read the tensor content from shared
+  // memory, once they have mapped our ring. Until then the content is sent
+  // inline, and the ring is advertised to them. Cached responses can be
+  // replayed to retried requests, so they must carry the content themselves.
+  SharedMemoryRing* shared_memory_ring = nullptr;
+  SharedMemoryRing* advertised_ring = nullptr;
+  if (!cache_enabled && request->has_transport_options()) {
+    SharedMemoryRecvTensorOptions shared_memory_options;
+    if (request->transport_options().UnpackTo(&shared_memory_options) &&
+        shared_memory_options.host_id() == SharedMemoryHostId()) {
+      SharedMemoryRing* ring = GetSharedMemorySendRing();
+      if (ring != nullptr &&
+          shared_memory_options.ring_name() == ring->name()) {
+        shared_memory_ring = ring;
+      } else {
+        advertised_ring = ring;
+      }
+    }
+  }
+
+  auto do_response = [opts, response, done, cache_enabled, shared_memory_ring,
+                      advertised_ring](const Tensor& tensor, bool is_dead,
+                                       const Status& status) {
     if (status.ok()) {
-      grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled, response);
+      SharedMemoryTensorLocation location;
+      if (shared_memory_ring != nullptr &&
+          grpc::EncodeTensorToSharedMemory(is_dead, tensor, shared_memory_ring,
+                                           response, &location)) {
+        // The receiver does not read the content if the call is cancelled,
+        // so free its slot right away instead of leaving it to be reclaimed
+        // as abandoned. The service keeps forwarding cancellations to `opts`
+        // after the response is sent.
+        opts->SetCancelCallback([shared_memory_ring, location]() {
+          shared_memory_ring->Release(location);
+        });
+      } else if (advertised_ring != nullptr) {
+        grpc::EncodeTensorToByteBufferAdvertisingRing(is_dead, tensor,
+                                                      *advertised_ring,
+                                                      response);
+      } else {
+        grpc::EncodeTensorToByteBuffer(is_dead, tensor, cache_enabled,
+                                       response);
+      }
     }
     done(status);
   };
@@ -20,6 +20,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/dma_helper.h"
 #include "tensorflow/core/common_runtime/process_util.h"
 #include "tensorflow/core/distributed_runtime/request_id.h"
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
 #include "tensorflow/core/distributed_runtime/tensor_coding.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
 #include "tensorflow/core/distributed_runtime/worker_interface.h"
@@ -31,6 +32,7 @@ limitations under the License.
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/notification.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
 
 namespace tensorflow {
 
@@ -69,6 +71,17 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     req_.set_step_id(step_id);
     req_.set_rendezvous_key(key.data(), key.size());
     req_.set_request_id(GetUniqueRequestId());
+    // Offer to read the content from shared memory if it is received on the
+    // host. The sender only accepts if it runs on the same host and we have
+    // mapped its ring; otherwise it advertises its ring for later calls.
+    if (SharedMemoryRecvTensorEnabled() &&
+        (alloc_attrs.on_host() ||
+         dst_device->attributes().device_type() == DEVICE_CPU)) {
+      SharedMemoryRecvTensorOptions shared_memory_options;
+      shared_memory_options.set_host_id(SharedMemoryHostId());
+      shared_memory_options.set_ring_name(SharedMemoryRingOfPeer(src_worker_));
+      req_.mutable_transport_options()->PackFrom(shared_memory_options);
+    }
   }
 
   void Reset() {
@@ -142,9 +155,12 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
       // Make sure the Rendezvous abort checking is finished before running the
       // callback, which might destroy the current call object.
       abort_checked->WaitForNotification();
-      if (!s.ok()) {
+      // The content must be read even if the call was aborted, to free its
+      // slot in the sender's ring.
+      Status status = s.ok() ? ReadSharedMemoryContent() : s;
+      if (!status.ok()) {
         mutex_lock l(mu_);
-        status_.Update(s);
+        status_.Update(status);
       }
       recv_done();
     };
@@ -167,6 +183,40 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
     abort_checked->Notify();
   }
 
+  // Copies the tensor content into the received tensor if the sender wrote it
+  // to its shared-memory ring instead of the response, or maps the sender's
+  // ring if it advertised it.
+  Status ReadSharedMemoryContent() {
+    const auto& transport_options = resp_.metadata().transport_options();
+    if (transport_options.Is<SharedMemoryRingAdvertisement>()) {
+      SharedMemoryRingAdvertisement advertisement;
+      if (transport_options.UnpackTo(&advertisement)) {
+        MapSharedMemoryRingOfPeer(src_worker_, advertisement.ring_name());
+      }
+      return OkStatus();
+    }
+    if (!transport_options.Is<SharedMemoryTensorLocation>()) {
+      return OkStatus();
+    }
+    SharedMemoryTensorLocation location;
+    if (!transport_options.UnpackTo(&location)) {
+      return errors::Internal("Cannot parse shared-memory location for ",
+                              req_.rendezvous_key());
+    }
+    const Tensor& tensor = resp_.tensor();
+    StringPiece content = tensor.tensor_data();
+    if (!DataTypeCanUseMemcpy(tensor.dtype()) ||
+        static_cast<int64_t>(content.size()) != location.size()) {
+      ReleaseSharedMemoryRingSlot(location);
+      return errors::Internal("Received ", location.size(),
+                              " bytes in shared memory for ",
+                              req_.rendezvous_key(), ", expected ",
+                              content.size());
+    }
+    return ReadFromSharedMemoryRing(location,
+                                    const_cast<char*>(content.data()));
+  }
+
   string src_worker_;
   string src_rel_device_;
   WorkerInterface* wi_;  // Not owned.
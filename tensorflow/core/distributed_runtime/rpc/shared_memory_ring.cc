@@ -0,0 +1,485 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <utility>
+
+#include "absl/container/flat_hash_map.h"
+#include "absl/container/flat_hash_set.h"
+#include "absl/strings/ascii.h"
+#include "absl/strings/match.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/util/env_var.h"
+
+namespace tensorflow {
+
+namespace {
+
+constexpr char kRingNamePrefix[] = "/tf_recv_tensor_";
+constexpr uint64 kRingMagic = 0x676e6952726f5466ULL;  // "fTorRing"
+
+// Slots are aligned to the size of their header, so that the tail of the ring
+// is always either empty or large enough to hold a padding slot.
+constexpr int64_t kSlotAlignment = 64;
+
+// Slots that are neither read nor released within this time are assumed to
+// be abandoned, e.g. because their reader died.
+constexpr int64_t kAbandonedSlotMicros = 60 * 1000 * 1000;
+
+// Slot states.
+enum : uint32 {
+  kSlotFree = 0,     // Read, abandoned or padding; may be reclaimed.
+  kSlotWriting = 1,  // Reserved by the writer, payload not yet complete.
+  kSlotWritten = 2,  // Payload complete, waiting for the reader.
+  kSlotReading = 3,  // A reader is copying the payload out.
+};
+
+// Lives at the start of the shared-memory object, followed by the slots.
+struct RingHeader {
+  uint64 magic;
+  int64_t capacity;
+};
+constexpr int64_t kRingHeaderBytes = kSlotAlignment;
+constexpr int64_t kSlotHeaderBytes = kSlotAlignment;
+static_assert(sizeof(RingHeader) <= kRingHeaderBytes, "RingHeader too large");
+
+int64_t RoundUpToSlotAlignment(int64_t bytes) {
+  return (bytes + kSlotAlignment - 1) / kSlotAlignment * kSlotAlignment;
+}
+
+}  // namespace
+
+// `sequence` and `size` are atomic because readers check them before they
+// claim the slot, while the writer may be reusing it.
+struct SharedMemoryRing::SlotHeader {
+  std::atomic<uint32> state;
+  std::atomic<uint64> sequence;
+  // Size of the slot including this header.
+  std::atomic<int64_t> size;
+  int64_t write_micros;
+};
+static_assert(std::atomic<uint32>::is_always_lock_free &&
+                  std::atomic<uint64>::is_always_lock_free &&
+                  std::atomic<int64_t>::is_always_lock_free,
+              "Slot headers must be lock-free to be shared across processes");
+
+SharedMemoryRing::SharedMemoryRing(const string& name, bool owner, char* base,
+                                   int64_t capacity)
+    : name_(name), owner_(owner), base_(base), capacity_(capacity) {
+  static_assert(sizeof(SlotHeader) <= kSlotHeaderBytes, "SlotHeader too large");
+}
+
+#if defined(__linux__)
+
+Status SharedMemoryRing::Create(int64_t capacity,
+                                std::unique_ptr<SharedMemoryRing>* ring) {
+  if (capacity <= kSlotHeaderBytes) {
+    return errors::InvalidArgument("Shared-memory ring capacity ", capacity,
+                                   " is too small");
+  }
+  capacity = RoundUpToSlotAlignment(capacity);
+  const string name =
+      strings::StrCat(kRingNamePrefix, getpid(), "_",
+                      strings::Hex(random::New64(), strings::kZeroPad16));
+  const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    return errors::Unavailable("shm_open(", name, ") failed: ",
+                               strerror(errno));
+  }
+  const int64_t mapped_bytes = kRingHeaderBytes + capacity;
+  void* base = MAP_FAILED;
+  if (ftruncate(fd, mapped_bytes) == 0) {
+    base = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                0);
+  }
+  const int error = errno;
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return errors::Unavailable("Cannot map shared-memory ring ", name, ": ",
+                               strerror(error));
+  }
+
+  // The object is zero-filled, so all slot states start out as kSlotFree.
+  RingHeader* header = static_cast<RingHeader*>(base);
+  header->capacity = capacity;
+  header->magic = kRingMagic;
+  ring->reset(new SharedMemoryRing(name, /*owner=*/true,
+                                   static_cast<char*>(base), capacity));
+  return OkStatus();
+}
+
+Status SharedMemoryRing::Open(const string& name,
+                              std::unique_ptr<SharedMemoryRing>* ring) {
+  if (!absl::StartsWith(name, kRingNamePrefix)) {
+    return errors::InvalidArgument("Not a shared-memory ring: ", name);
+  }
+  const int fd = shm_open(name.c_str(), O_RDWR, 0);
+  if (fd < 0) {
+    return errors::Unavailable("shm_open(", name, ") failed: ",
+                               strerror(errno));
+  }
+  struct stat st;
+  void* base = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > kRingHeaderBytes) {
+    base = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (base == MAP_FAILED) {
+    return errors::Unavailable("Cannot map shared-memory ring ", name);
+  }
+  const RingHeader* header = static_cast<const RingHeader*>(base);
+  if (header->magic != kRingMagic ||
+      header->capacity != st.st_size - kRingHeaderBytes) {
+    munmap(base, st.st_size);
+    return errors::DataLoss("Corrupted shared-memory ring ", name);
+  }
+  ring->reset(new SharedMemoryRing(name, /*owner=*/false,
+                                   static_cast<char*>(base), header->capacity));
+  return OkStatus();
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+  munmap(base_, kRingHeaderBytes + capacity_);
+  if (owner_) shm_unlink(name_.c_str());
+}
+
+#else  // !defined(__linux__)
+
+Status SharedMemoryRing::Create(int64_t capacity,
+                                std::unique_ptr<SharedMemoryRing>* ring) {
+  return errors::Unimplemented("Shared-memory rings are not supported");
+}
+
+Status SharedMemoryRing::Open(const string& name,
+                              std::unique_ptr<SharedMemoryRing>* ring) {
+  return errors::Unimplemented("Shared-memory rings are not supported");
+}
+
+SharedMemoryRing::~SharedMemoryRing() {}
+
+#endif  // defined(__linux__)
+
+SharedMemoryRing::SlotHeader* SharedMemoryRing::SlotAt(int64_t offset) const {
+  return reinterpret_cast<SlotHeader*>(base_ + kRingHeaderBytes + offset);
+}
+
+void SharedMemoryRing::ReclaimLocked() {
+  int64_t now_micros = -1;
+  while (tail_ < head_) {
+    SlotHeader* slot = SlotAt(tail_ % capacity_);
+    uint32 state = slot->state.load(std::memory_order_acquire);
+    if (state == kSlotWritten) {
+      if (now_micros < 0) now_micros = Env::Default()->NowMicros();
+      if (now_micros - slot->write_micros < kAbandonedSlotMicros) break;
+      // On failure `state` is updated, and the slot is reclaimed only if the
+      // reader finished in the meantime.
+      if (slot->state.compare_exchange_strong(state, kSlotFree,
+                                              std::memory_order_acq_rel)) {
+        VLOG(1) << "Reclaiming abandoned slot "
+                << slot->sequence.load(std::memory_order_relaxed) << " in "
+                << name_;
+        state = kSlotFree;
+      }
+    }
+    if (state != kSlotFree) break;
+    tail_ += slot->size.load(std::memory_order_relaxed);
+  }
+}
+
+bool SharedMemoryRing::Write(StringPiece data,
+                             SharedMemoryTensorLocation* location) {
+  DCHECK(owner_);
+  const int64_t slot_bytes =
+      RoundUpToSlotAlignment(kSlotHeaderBytes + data.size());
+  if (slot_bytes > capacity_) return false;
+
+  SlotHeader* slot;
+  int64_t offset;
+  uint64 sequence;
+  {
+    mutex_lock l(mu_);
+    ReclaimLocked();
+    offset = head_ % capacity_;
+    // Slots are contiguous, so a slot that would cross the end of the ring
+    // starts at offset 0 instead, behind a padding slot.
+    const int64_t padding_bytes =
+        offset + slot_bytes > capacity_ ? capacity_ - offset : 0;
+    if (head_ + padding_bytes + slot_bytes - tail_ > capacity_) return false;
+    if (padding_bytes > 0) {
+      SlotHeader* padding = SlotAt(offset);
+      padding->sequence.store(0, std::memory_order_relaxed);
+      padding->size.store(padding_bytes, std::memory_order_relaxed);
+      padding->state.store(kSlotFree, std::memory_order_release);
+      head_ += padding_bytes;
+      offset = 0;
+    }
+    slot = SlotAt(offset);
+    sequence = next_sequence_++;
+    slot->state.store(kSlotWriting, std::memory_order_relaxed);
+    slot->sequence.store(sequence, std::memory_order_relaxed);
+    slot->size.store(slot_bytes, std::memory_order_relaxed);
+    head_ += slot_bytes;
+  }
+
+  // Copy outside the lock so that large payloads can be written concurrently.
+  std::memcpy(reinterpret_cast<char*>(slot) + kSlotHeaderBytes, data.data(),
+              data.size());
+  slot->write_micros = Env::Default()->NowMicros();
+  location->set_ring_name(name_);
+  location->set_offset(offset);
+  location->set_size(data.size());
+  location->set_sequence(sequence);
+  slot->state.store(kSlotWritten, std::memory_order_release);
+  return true;
+}
+
+Status SharedMemoryRing::AcquireSlot(const SharedMemoryTensorLocation& location,
+                                     SlotHeader** slot) {
+  const int64_t offset = location.offset();
+  const int64_t size = location.size();
+  if (offset < 0 || size < 0 || offset % kSlotAlignment != 0 ||
+      size > capacity_ - kSlotHeaderBytes ||
+      offset > capacity_ - kSlotHeaderBytes - size) {
+    return errors::InvalidArgument("Invalid slot at offset ", offset,
+                                   " with size ", size, " in ", name_);
+  }
+  // Check that `location` is the start of a live slot before writing to it:
+  // an offset into the middle of a slot or a slot that was reclaimed and
+  // reused holds someone else's data. The acquire load of `state` pairs with
+  // the writer's release store, so that the header fields are up to date.
+  *slot = SlotAt(offset);
+  const auto unavailable = [&] {
+    return errors::Unavailable("Slot ", location.sequence(), " in ", name_,
+                               " is no longer available");
+  };
+  if ((*slot)->state.load(std::memory_order_acquire) != kSlotWritten ||
+      (*slot)->sequence.load(std::memory_order_acquire) !=
+          location.sequence() ||
+      (*slot)->size.load(std::memory_order_acquire) !=
+          RoundUpToSlotAlignment(kSlotHeaderBytes + size)) {
+    return unavailable();
+  }
+  uint32 state = kSlotWritten;
+  if (!(*slot)->state.compare_exchange_strong(state, kSlotReading,
+                                              std::memory_order_acquire)) {
+    return unavailable();
+  }
+  if ((*slot)->sequence.load(std::memory_order_relaxed) !=
+      location.sequence()) {
+    // The slot was reclaimed and reused between the checks and the exchange;
+    // leave it to its own reader.
+    (*slot)->state.store(kSlotWritten, std::memory_order_release);
+    return unavailable();
+  }
+  return OkStatus();
+}
+
+Status SharedMemoryRing::Read(const SharedMemoryTensorLocation& location,
+                              char* dst) {
+  SlotHeader* slot;
+  TF_RETURN_IF_ERROR(AcquireSlot(location, &slot));
+  std::memcpy(dst, reinterpret_cast<const char*>(slot) + kSlotHeaderBytes,
+              location.size());
+  slot->state.store(kSlotFree, std::memory_order_release);
+  return OkStatus();
+}
+
+void SharedMemoryRing::Release(const SharedMemoryTensorLocation& location) {
+  SlotHeader* slot;
+  if (AcquireSlot(location, &slot).ok()) {
+    VLOG(1) << "Releasing unread slot " << location.sequence() << " in "
+            << name_;
+    slot->state.store(kSlotFree, std::memory_order_release);
+  }
+}
+
+const string& SharedMemoryHostId() {
+  static const string* host_id = [] {
+    string* id = new string;
+#if defined(__linux__)
+    // Processes share POSIX shared memory if they run under the same kernel
+    // and see the same /dev/shm mount, which rules out separate containers.
+    // Rings are only accessible to their owner, so the effective user must
+    // match too.
+    string boot_id;
+    struct stat st;
+    if (ReadFileToString(Env::Default(), "/proc/sys/kernel/random/boot_id",
+                         &boot_id)
+            .ok() &&
+        stat("/dev/shm", &st) == 0) {
+      *id = strings::StrCat(port::Hostname(), "/",
+                            absl::StripAsciiWhitespace(boot_id), "/",
+                            st.st_dev, ":", st.st_ino, "/", geteuid());
+    }
+#endif
+    return id;
+  }();
+  return *host_id;
+}
+
+namespace {
+
+int64_t SharedMemoryRingBytes() {
+  static const int64_t ring_bytes = [] {
+    int64_t ring_mb = 0;
+    Status s = ReadInt64FromEnvVar("TF_RPC_SHARED_MEMORY_RING_MB", 0, &ring_mb);
+    if (!s.ok()) {
+      LOG(ERROR) << s;
+      return int64_t{0};
+    }
+    return std::max<int64_t>(ring_mb, 0) << 20;
+  }();
+  return ring_bytes;
+}
+
+// Name of the ring returned by GetSharedMemorySendRing(), which is never
+// destroyed and so is unlinked at exit.
+string* send_ring_name = nullptr;
+
+// The rings of other processes that this process reads from. Readers hold a
+// reference to a ring while they copy from it, so that a ring dropped from
+// `rings` is only unmapped once in-flight reads are done.
+struct PeerRings {
+  mutex mu;
+  // Keyed by ring name.
+  absl::flat_hash_map<string, std::shared_ptr<SharedMemoryRing>> rings
+      TF_GUARDED_BY(mu);
+  // Name of the ring mapped for each peer worker.
+  absl::flat_hash_map<string, string> ring_of_peer TF_GUARDED_BY(mu);
+  // Advertised rings that could not be mapped, which are not retried.
+  absl::flat_hash_set<string> unmappable_rings TF_GUARDED_BY(mu);
+};
+
+PeerRings* GetPeerRings() {
+  static PeerRings* peer_rings = new PeerRings;
+  return peer_rings;
+}
+
+// Returns the mapped ring named `ring_name`, mapping it if needed.
+Status GetPeerRingLocked(PeerRings* peer_rings, const string& ring_name,
+                         std::shared_ptr<SharedMemoryRing>* ring)
+    TF_EXCLUSIVE_LOCKS_REQUIRED(peer_rings->mu) {
+  auto it = peer_rings->rings.find(ring_name);
+  if (it == peer_rings->rings.end()) {
+    std::unique_ptr<SharedMemoryRing> opened;
+    TF_RETURN_IF_ERROR(SharedMemoryRing::Open(ring_name, &opened));
+    it = peer_rings->rings.emplace(ring_name, std::move(opened)).first;
+  }
+  *ring = it->second;
+  return OkStatus();
+}
+
+}  // namespace
+
+bool SharedMemoryRecvTensorEnabled() {
+  return SharedMemoryRingBytes() > 0 && !SharedMemoryHostId().empty();
+}
+
+SharedMemoryRing* GetSharedMemorySendRing() {
+  static SharedMemoryRing* ring = []() -> SharedMemoryRing* {
+    if (!SharedMemoryRecvTensorEnabled()) return nullptr;
+    std::unique_ptr<SharedMemoryRing> ring;
+    Status s = SharedMemoryRing::Create(SharedMemoryRingBytes(), &ring);
+    if (!s.ok()) {
+      LOG(WARNING) << "Sending RecvTensor content without shared memory: "
+                   << s;
+      return nullptr;
+    }
+#if defined(__linux__)
+    send_ring_name = new string(ring->name());
+    std::atexit([] { shm_unlink(send_ring_name->c_str()); });
+#endif
+    return ring.release();
+  }();
+  return ring;
+}
+
+string SharedMemoryRingOfPeer(const string& worker) {
+  PeerRings* peer_rings = GetPeerRings();
+  mutex_lock l(peer_rings->mu);
+  auto it = peer_rings->ring_of_peer.find(worker);
+  return it == peer_rings->ring_of_peer.end() ? string() : it->second;
+}
+
+void MapSharedMemoryRingOfPeer(const string& worker, const string& ring_name) {
+  PeerRings* peer_rings = GetPeerRings();
+  mutex_lock l(peer_rings->mu);
+  if (peer_rings->unmappable_rings.contains(ring_name)) return;
+  std::shared_ptr<SharedMemoryRing> ring;
+  Status s = GetPeerRingLocked(peer_rings, ring_name, &ring);
+  if (!s.ok()) {
+    LOG(WARNING) << "Receiving RecvTensor content from " << worker
+                 << " without shared memory: " << s;
+    peer_rings->unmappable_rings.insert(ring_name);
+    return;
+  }
+  string& mapped_name = peer_rings->ring_of_peer[worker];
+  if (mapped_name == ring_name) return;
+  const string previous_name = std::exchange(mapped_name, ring_name);
+  if (previous_name.empty()) return;
+  // The worker restarted with a new ring. Drop the mapping of the old one
+  // unless another worker still uses it; it is unmapped when the last reader
+  // releases it.
+  for (const auto& it : peer_rings->ring_of_peer) {
+    if (it.second == previous_name) return;
+  }
+  VLOG(1) << "Unmapping shared-memory ring " << previous_name << " of "
+          << worker;
+  peer_rings->rings.erase(previous_name);
+}
+
+Status ReadFromSharedMemoryRing(const SharedMemoryTensorLocation& location,
+                                char* dst) {
+  PeerRings* peer_rings = GetPeerRings();
+  std::shared_ptr<SharedMemoryRing> ring;
+  {
+    mutex_lock l(peer_rings->mu);
+    TF_RETURN_IF_ERROR(
+        GetPeerRingLocked(peer_rings, location.ring_name(), &ring));
+  }
+  return ring->Read(location, dst);
+}
+
+void ReleaseSharedMemoryRingSlot(const SharedMemoryTensorLocation& location) {
+  PeerRings* peer_rings = GetPeerRings();
+  std::shared_ptr<SharedMemoryRing> ring;
+  {
+    mutex_lock l(peer_rings->mu);
+    auto it = peer_rings->rings.find(location.ring_name());
+    if (it != peer_rings->rings.end()) ring = it->second;
+  }
+  if (ring != nullptr) ring->Release(location);
+}
+
+}  // namespace tensorflow
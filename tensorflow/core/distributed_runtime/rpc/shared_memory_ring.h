@@ -0,0 +1,141 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_RING_H_
+#define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_RING_H_
+
+#include <memory>
+#include <string>
+
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/stringpiece.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/transport_options.pb.h"
+
+namespace tensorflow {
+
+// A ring buffer of tensor payloads in a named POSIX shared-memory object,
+// used to hand RecvTensor content between workers on the same host without
+// copying it through a loopback socket.
+//
+// The ring has a single writer, the process that created it. Readers map the
+// ring by name, copy a payload out and mark its slot free in the shared
+// header; the writer reclaims free slots in order. The writer frees slots that
+// will not be read (e.g. because the call carrying their location was
+// cancelled) with Release(). Slots that are neither read nor released, e.g.
+// because the reader died, are reclaimed after a timeout.
+//
+// Write(), Read() and Release() are thread-safe.
+class SharedMemoryRing {
+ public:
+  // Creates a ring of at least `capacity` bytes under a new name. The
+  // shared-memory object is unlinked when the ring is destroyed.
+  static Status Create(int64_t capacity,
+                       std::unique_ptr<SharedMemoryRing>* ring);
+
+  // Maps the ring named `name` that was created by another SharedMemoryRing.
+  static Status Open(const string& name,
+                     std::unique_ptr<SharedMemoryRing>* ring);
+
+  ~SharedMemoryRing();
+
+  const string& name() const { return name_; }
+  int64_t capacity() const { return capacity_; }
+
+  // Copies `data` into a free slot and fills in `*location`. Returns false,
+  // leaving the ring unchanged, if `data` does not fit in the free space.
+  // Must only be called on a ring returned by Create().
+  bool Write(StringPiece data, SharedMemoryTensorLocation* location);
+
+  // Copies the payload at `location` into `dst`, which must hold
+  // `location.size()` bytes, and frees its slot.
+  Status Read(const SharedMemoryTensorLocation& location, char* dst);
+
+  // Frees the slot at `location` without reading it. Does nothing if the
+  // payload has already been read or its slot reclaimed.
+  void Release(const SharedMemoryTensorLocation& location);
+
+ private:
+  struct SlotHeader;
+
+  SharedMemoryRing(const string& name, bool owner, char* base,
+                   int64_t capacity);
+
+  SlotHeader* SlotAt(int64_t offset) const;
+
+  // Validates `location` and marks its slot as being read, so that it is
+  // neither read nor reclaimed by anyone else until its state is stored.
+  Status AcquireSlot(const SharedMemoryTensorLocation& location,
+                     SlotHeader** slot);
+
+  // Advances tail_ over the slots that have been read or abandoned.
+  void ReclaimLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  const string name_;
+  const bool owner_;
+  char* const base_;  // Start of the mapping, owned.
+  const int64_t capacity_;
+
+  // Writer state. head_ and tail_ are monotonically increasing byte positions;
+  // the slot at position p starts at offset p % capacity_.
+  mutex mu_;
+  int64_t head_ TF_GUARDED_BY(mu_) = 0;
+  int64_t tail_ TF_GUARDED_BY(mu_) = 0;
+  uint64 next_sequence_ TF_GUARDED_BY(mu_) = 1;
+
+  SharedMemoryRing(const SharedMemoryRing&) = delete;
+  void operator=(const SharedMemoryRing&) = delete;
+};
+
+// Returns an identifier that is equal in two processes only if they should be
+// able to open each other's shared-memory objects, or an empty string if
+// shared memory is not supported.
+const string& SharedMemoryHostId();
+
+// Returns true if RecvTensor may move tensor content through shared memory,
+// which is enabled by setting TF_RPC_SHARED_MEMORY_RING_MB to the size of the
+// per-process ring.
+bool SharedMemoryRecvTensorEnabled();
+
+// Returns the ring this process writes RecvTensor content to, creating it on
+// first use, or nullptr if shared memory is disabled or unavailable.
+SharedMemoryRing* GetSharedMemorySendRing();
+
+// Returns the name of the ring of the peer `worker` that this process has
+// mapped with MapSharedMemoryRingOfPeer(), or an empty string if it has not.
+// Peers only send RecvTensor content through rings the receiver has mapped.
+string SharedMemoryRingOfPeer(const string& worker);
+
+// Maps the ring `ring_name` that the peer `worker` advertised. If `worker`
+// had advertised another ring, e.g. before it restarted, that ring is unmapped
+// once no other worker uses it and reads from it are done. If the ring cannot
+// be mapped, logs a warning and leaves `worker` without a ring, so that its
+// RecvTensor content keeps being sent inline.
+void MapSharedMemoryRingOfPeer(const string& worker, const string& ring_name);
+
+// Copies the payload at `location`, which was written by a ring in this or
+// another process on the same host, into `dst`. Rings that have not been
+// mapped by MapSharedMemoryRingOfPeer() are mapped on first use.
+Status ReadFromSharedMemoryRing(const SharedMemoryTensorLocation& location,
+                                char* dst);
+
+// Frees the slot at `location` without reading it, if its ring is mapped.
+void ReleaseSharedMemoryRingSlot(const SharedMemoryTensorLocation& location);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_SHARED_MEMORY_RING_H_
@@ -0,0 +1,252 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/distributed_runtime/rpc/shared_memory_ring.h"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "absl/strings/str_cat.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class SharedMemoryRingTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    TF_ASSERT_OK(SharedMemoryRing::Create(1024, &writer_));
+    TF_ASSERT_OK(SharedMemoryRing::Open(writer_->name(), &reader_));
+    EXPECT_EQ(reader_->capacity(), writer_->capacity());
+  }
+
+  // Reads `location` through the reader's mapping.
+  string Read(const SharedMemoryTensorLocation& location) {
+    string result(location.size(), '\0');
+    TF_EXPECT_OK(reader_->Read(location, &result[0]));
+    return result;
+  }
+
+  std::unique_ptr<SharedMemoryRing> writer_;
+  std::unique_ptr<SharedMemoryRing> reader_;
+};
+
+TEST_F(SharedMemoryRingTest, WriteAndRead) {
+  SharedMemoryTensorLocation first, second;
+  ASSERT_TRUE(writer_->Write("hello", &first));
+  ASSERT_TRUE(writer_->Write("shared memory", &second));
+  EXPECT_EQ(first.ring_name(), writer_->name());
+  EXPECT_NE(first.sequence(), second.sequence());
+  // Slots can be read in any order, but only once.
+  EXPECT_EQ(Read(second), "shared memory");
+  EXPECT_EQ(Read(first), "hello");
+  string buffer(5, '\0');
+  EXPECT_TRUE(errors::IsUnavailable(reader_->Read(first, &buffer[0])));
+}
+
+TEST_F(SharedMemoryRingTest, FullRingRejectsWrites) {
+  const string payload(250, 'x');
+  SharedMemoryTensorLocation locations[3];
+  ASSERT_TRUE(writer_->Write(payload, &locations[0]));
+  ASSERT_TRUE(writer_->Write(payload, &locations[1]));
+  ASSERT_TRUE(writer_->Write(payload, &locations[2]));
+  SharedMemoryTensorLocation location;
+  EXPECT_FALSE(writer_->Write(payload, &location));
+  EXPECT_FALSE(writer_->Write(string(2000, 'x'), &location));
+
+  // Slots are reclaimed in order, so reading the last one frees nothing.
+  EXPECT_EQ(Read(locations[2]), payload);
+  EXPECT_FALSE(writer_->Write(payload, &location));
+  EXPECT_EQ(Read(locations[0]), payload);
+  EXPECT_TRUE(writer_->Write(payload, &location));
+  EXPECT_EQ(Read(locations[1]), payload);
+  EXPECT_EQ(Read(location), payload);
+}
+
+TEST_F(SharedMemoryRingTest, WrapsAround) {
+  // Writes payloads of varying sizes so that slots regularly need to skip the
+  // end of the ring.
+  for (int i = 0; i < 100; ++i) {
+    const string payload(37 * (i % 11), 'a' + i % 26);
+    SharedMemoryTensorLocation location;
+    ASSERT_TRUE(writer_->Write(payload, &location)) << i;
+    EXPECT_EQ(Read(location), payload);
+  }
+}
+
+TEST_F(SharedMemoryRingTest, RejectsInvalidLocations) {
+  SharedMemoryTensorLocation location;
+  ASSERT_TRUE(writer_->Write("payload", &location));
+  char buffer[16];
+
+  SharedMemoryTensorLocation bad = location;
+  bad.set_offset(location.offset() + 1);
+  EXPECT_TRUE(errors::IsInvalidArgument(reader_->Read(bad, buffer)));
+  bad = location;
+  bad.set_size(writer_->capacity());
+  EXPECT_TRUE(errors::IsInvalidArgument(reader_->Read(bad, buffer)));
+  bad = location;
+  bad.set_sequence(location.sequence() + 1);
+  EXPECT_TRUE(errors::IsUnavailable(reader_->Read(bad, buffer)));
+
+  // A rejected read leaves the slot to its reader.
+  EXPECT_EQ(Read(location), "payload");
+}
+
+TEST_F(SharedMemoryRingTest, RejectsLocationsInsideSlots) {
+  // A payload that looks like a written slot header at an aligned offset.
+  string payload(256, '\0');
+  const uint32 written = 2;
+  const uint64 sequence = 2;
+  const int64_t size = 1 << 20;
+  std::memcpy(&payload[128], &written, sizeof(written));
+  std::memcpy(&payload[136], &sequence, sizeof(sequence));
+  std::memcpy(&payload[144], &size, sizeof(size));
+  SharedMemoryTensorLocation location;
+  ASSERT_TRUE(writer_->Write(payload, &location));
+  ASSERT_EQ(location.sequence(), 1);
+
+  SharedMemoryTensorLocation bad = location;
+  bad.set_offset(location.offset() + 192);
+  bad.set_size(8);
+  bad.set_sequence(sequence);
+  char buffer[8];
+  EXPECT_TRUE(errors::IsUnavailable(reader_->Read(bad, buffer)));
+  reader_->Release(bad);
+
+  // The payload was not modified.
+  EXPECT_EQ(Read(location), payload);
+}
+
+TEST_F(SharedMemoryRingTest, ReleasedSlotsAreReclaimed) {
+  const string payload(250, 'x');
+  SharedMemoryTensorLocation locations[3];
+  for (auto& location : locations) {
+    ASSERT_TRUE(writer_->Write(payload, &location));
+  }
+  SharedMemoryTensorLocation location;
+  EXPECT_FALSE(writer_->Write(payload, &location));
+
+  // A released slot is reclaimed like a read one, and can no longer be read.
+  writer_->Release(locations[0]);
+  string buffer(payload.size(), '\0');
+  EXPECT_TRUE(errors::IsUnavailable(reader_->Read(locations[0], &buffer[0])));
+  EXPECT_TRUE(writer_->Write(payload, &location));
+
+  // Releasing a slot that was already read does nothing.
+  EXPECT_EQ(Read(locations[1]), payload);
+  writer_->Release(locations[1]);
+  EXPECT_EQ(Read(locations[2]), payload);
+  EXPECT_EQ(Read(location), payload);
+}
+
+TEST(SharedMemoryRingOpenTest, RejectsUnknownRings) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      SharedMemoryRing::Open("/some_other_object", &ring)));
+  EXPECT_FALSE(SharedMemoryRing::Open("/tf_recv_tensor_missing", &ring).ok());
+}
+
+TEST(SharedMemoryRingOfPeerTest, OnlyMappedRingsAreUsed) {
+  std::unique_ptr<SharedMemoryRing> ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(1024, &ring));
+  EXPECT_EQ(SharedMemoryRingOfPeer("/job:a/task:0"), "");
+
+  // A ring that cannot be mapped leaves the peer on inline transfers.
+  MapSharedMemoryRingOfPeer("/job:a/task:0", "/tf_recv_tensor_missing");
+  EXPECT_EQ(SharedMemoryRingOfPeer("/job:a/task:0"), "");
+
+  MapSharedMemoryRingOfPeer("/job:a/task:0", ring->name());
+  EXPECT_EQ(SharedMemoryRingOfPeer("/job:a/task:0"), ring->name());
+  EXPECT_EQ(SharedMemoryRingOfPeer("/job:a/task:1"), "");
+
+  SharedMemoryTensorLocation location;
+  ASSERT_TRUE(ring->Write("payload", &location));
+  string result(location.size(), '\0');
+  TF_EXPECT_OK(ReadFromSharedMemoryRing(location, &result[0]));
+  EXPECT_EQ(result, "payload");
+}
+
+// Returns how many times the shared-memory object `name` is mapped in this
+// process.
+int NumMappings(const string& name) {
+  // /proc files report a size of 0, so ReadFileToString() cannot read them.
+  FILE* maps = fopen("/proc/self/maps", "r");
+  CHECK(maps != nullptr);
+  int num_mappings = 0;
+  char line[4096];
+  while (fgets(line, sizeof(line), maps) != nullptr) {
+    if (absl::StrContains(line, name)) ++num_mappings;
+  }
+  fclose(maps);
+  return num_mappings;
+}
+
+TEST(SharedMemoryRingOfPeerTest, UnmapsReplacedRings) {
+  if (SharedMemoryHostId().empty()) {
+    GTEST_SKIP() << "Shared memory is not supported";
+  }
+  std::unique_ptr<SharedMemoryRing> old_ring, new_ring;
+  TF_ASSERT_OK(SharedMemoryRing::Create(1024, &old_ring));
+  TF_ASSERT_OK(SharedMemoryRing::Create(1024, &new_ring));
+  MapSharedMemoryRingOfPeer("/job:b/task:0", old_ring->name());
+  EXPECT_EQ(NumMappings(old_ring->name()), 2);
+
+  // The worker restarts with a new ring.
+  MapSharedMemoryRingOfPeer("/job:b/task:0", new_ring->name());
+  EXPECT_EQ(SharedMemoryRingOfPeer("/job:b/task:0"), new_ring->name());
+  EXPECT_EQ(NumMappings(old_ring->name()), 1);
+  EXPECT_EQ(NumMappings(new_ring->name()), 2);
+
+  SharedMemoryTensorLocation location;
+  ASSERT_TRUE(new_ring->Write("payload", &location));
+  string result(location.size(), '\0');
+  TF_EXPECT_OK(ReadFromSharedMemoryRing(location, &result[0]));
+  EXPECT_EQ(result, "payload");
+}
+
+TEST(SharedMemoryHostIdTest, IncludesEffectiveUser) {
+  const string& host_id = SharedMemoryHostId();
+  if (host_id.empty()) GTEST_SKIP() << "Shared memory is not supported";
+  EXPECT_TRUE(absl::EndsWith(host_id, absl::StrCat("/", geteuid())));
+}
+
+void BM_SharedMemoryRing(::testing::benchmark::State& state) {
+  const int64_t bytes = state.range(0);
+  std::unique_ptr<SharedMemoryRing> writer, reader;
+  TF_CHECK_OK(SharedMemoryRing::Create(bytes + 1024, &writer));
+  TF_CHECK_OK(SharedMemoryRing::Open(writer->name(), &reader));
+  const string payload(bytes, 'x');
+  string result(bytes, '\0');
+  for (auto s : state) {
+    SharedMemoryTensorLocation location;
+    CHECK(writer->Write(payload, &location));
+    TF_CHECK_OK(reader->Read(location, &result[0]));
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+BENCHMARK(BM_SharedMemoryRing)->Range(1 << 10, 1 << 30);
+
+}  // namespace
+}  // namespace tensorflow
@@ -241,6 +241,19 @@ static void BM_RPC(::testing::benchmark::State& state) {
 }
 BENCHMARK(BM_RPC)->ArgPair(30, 2)->ArgPair(30, 1000)->ArgPair(30, 100000);
 
+// Sends a tensor of 1KB to 1GB to a second worker and back in every step.
+// Set TF_RPC_SHARED_MEMORY_RING_MB (e.g. to 4096) to move the tensor content
+// through shared memory instead of the gRPC responses.
+static void BM_RecvTensor(::testing::benchmark::State& state) {
+  const int tensor_size = state.range(0);
+
+  BM_Helper(state, 2 /*width*/, 1 /*num_stages*/, tensor_size,
+            true /*multi-device*/);
+  state.SetBytesProcessed(state.iterations() * 2 * int64_t{tensor_size} *
+                          sizeof(float));
+}
+BENCHMARK(BM_RecvTensor)->RangeMultiplier(8)->Range(256, 256 << 20);
+
 static void BM_SingleDevice(::testing::benchmark::State& state) {
   const int width = state.range(0);
   const int num_stages = state.range(1);
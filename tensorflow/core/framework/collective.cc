@@ -88,6 +88,8 @@ CollInstanceParams& CollInstanceParams::operator=(
         other.impl_details.subdiv_source_rank.begin(),
         other.impl_details.subdiv_source_rank.end());
     impl_details.dependencies = other.impl_details.dependencies;
+    impl_details.pipeline_piece_bytes = other.impl_details.pipeline_piece_bytes;
+    impl_details.wire_data_type = other.impl_details.wire_data_type;
     devices.assign(other.devices.begin(), other.devices.end());
     permutation.assign(other.permutation.begin(), other.permutation.end());
   }
@@ -120,6 +122,14 @@ string CollInstanceParams::ToString() const {
     }
     strings::StrAppend(&v, "}");
   }  // all subdivs
+  if (impl_details.pipeline_piece_bytes > 0) {
+    strings::StrAppend(&v, " pipeline_piece_bytes=",
+                       impl_details.pipeline_piece_bytes);
+  }
+  if (impl_details.wire_data_type != DT_INVALID) {
+    strings::StrAppend(&v, " wire_data_type=",
+                       DataTypeString(impl_details.wire_data_type));
+  }
   if (type == PERMUTE_COLLECTIVE) {
     strings::StrAppend(&v, "}, permute_devices {");
     for (const auto& d : devices) {
@@ -116,6 +116,14 @@ struct CollImplDetails {
                               // e.g. ring or nccl
   float timeout_seconds;      // If non zero, set a completion timeout for the
                               // collective op to detect staleness.
+  // If positive, RingReduce splits each chunk into pieces of at most this many
+  // bytes that travel around the ring independently, so that receiving one
+  // piece overlaps with reducing and forwarding the previous ones.
+  int64_t pipeline_piece_bytes = 0;
+  // If not DT_INVALID, the type in which RingReduce sends data between tasks.
+  // Only DT_BFLOAT16 for DT_FLOAT reductions on CPU is supported; it halves
+  // the bytes on the wire at the cost of precision.
+  DataType wire_data_type = DT_INVALID;
 };
 
 // Data common to all members of a collective instance.
@@ -1490,6 +1490,19 @@ class DatasetBaseIterator : public IteratorBase {
     }
   }
 
+  // When modeling is enabled, this method records a change of `bytes_delta`
+  // bytes and `elements_delta` elements in an internal buffer of this
+  // iterator. It is an alternative to `RecordBufferEnqueue` and
+  // `RecordBufferDequeue` for buffers whose memory is not owned by the
+  // buffered elements, e.g. when elements are copied into an arena.
+  void RecordBufferEvent(IteratorContext* ctx, int64_t bytes_delta,
+                         int64_t elements_delta) {
+    if (collect_resource_usage(ctx)) {
+      node_->record_buffer_event(bytes_delta, elements_delta);
+      DCHECK_GE(node_->buffered_elements(), 0);
+    }
+  }
+
   // When modeling is enabled, this method records the fact that this iterator
   // has produced an element and its size in bytes.
   void RecordElement(IteratorContext* ctx, std::vector<Tensor>* out_tensors) {
@@ -0,0 +1,215 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/calibrated_cost_table.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/grappler/costs/utils.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+bool IsInternalAttr(const string& name) { return absl::StartsWith(name, "_"); }
+
+// Returns the key of `op_info` in the table, or false if the shapes of its
+// inputs are not fully known.
+bool GetKey(const OpInfo& op_info, string* key) {
+  *key = strings::StrCat(op_info.op(), ";", op_info.device().type());
+  std::vector<const string*> attr_names;
+  for (const auto& attr : op_info.attr()) {
+    if (!IsInternalAttr(attr.first)) attr_names.push_back(&attr.first);
+  }
+  std::sort(attr_names.begin(), attr_names.end(),
+            [](const string* a, const string* b) { return *a < *b; });
+  for (const string* name : attr_names) {
+    strings::StrAppend(key, ";", *name, "=",
+                       SummarizeAttrValue(op_info.attr().at(*name)));
+  }
+  for (const auto& input : op_info.inputs()) {
+    if (input.shape().unknown_rank()) return false;
+    strings::StrAppend(key, ";", DataTypeString(input.dtype()), "[");
+    for (const auto& dim : input.shape().dim()) {
+      if (dim.size() < 0) return false;
+      strings::StrAppend(key, dim.size(), ",");
+    }
+    strings::StrAppend(key, "]");
+  }
+  return true;
+}
+
+// Returns the parts of `op_info` that its key is made of.
+OpInfo KeyOpInfo(const OpInfo& op_info) {
+  OpInfo result;
+  result.set_op(op_info.op());
+  for (const auto& attr : op_info.attr()) {
+    if (!IsInternalAttr(attr.first)) {
+      (*result.mutable_attr())[attr.first] = attr.second;
+    }
+  }
+  result.mutable_device()->set_type(op_info.device().type());
+  for (const auto& input : op_info.inputs()) {
+    OpInfo::TensorProperties* result_input = result.add_inputs();
+    result_input->set_dtype(input.dtype());
+    *result_input->mutable_shape() = input.shape();
+  }
+  return result;
+}
+
+}  // namespace
+
+void CalibratedCostTable::AddCostGraph(const CostGraphDef& cost_graph,
+                                       const GraphDef& graph) {
+  AddOpPerformance(CostGraphToOpPerformanceData(cost_graph, graph));
+}
+
+void CalibratedCostTable::AddOpPerformance(
+    const OpPerformanceList& op_performance_list) {
+  for (const OpPerformance& op_performance :
+       op_performance_list.op_performance()) {
+    if (op_performance.compute_cost() > 0) {
+      AddMeasurement(op_performance.op(),
+                     Costs::NanoSeconds(op_performance.compute_cost()));
+    }
+  }
+}
+
+void CalibratedCostTable::AddMeasurement(const OpInfo& op_info,
+                                         Costs::NanoSeconds time) {
+  Merge(op_info, 1, time.count(), 0);
+}
+
+void CalibratedCostTable::Merge(const OpInfo& op_info, int64_t num_samples,
+                                double mean_nanos, double m2) {
+  string key;
+  if (!GetKey(op_info, &key)) return;
+  mutex_lock l(mu_);
+  auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    Entry entry;
+    entry.op = KeyOpInfo(op_info);
+    it = entries_.emplace(std::move(key), std::move(entry)).first;
+  }
+  // Combine the statistics of both sets of samples, as in the parallel
+  // variant of Welford's algorithm.
+  Entry& entry = it->second;
+  const int64_t total_samples = entry.num_samples + num_samples;
+  const double delta = mean_nanos - entry.mean_nanos;
+  entry.m2 += m2 + delta * delta * entry.num_samples * num_samples /
+                       total_samples;
+  entry.mean_nanos += delta * num_samples / total_samples;
+  entry.num_samples = total_samples;
+}
+
+bool CalibratedCostTable::Lookup(const OpInfo& op_info,
+                                 Costs::NanoSeconds* time) const {
+  string key;
+  if (!GetKey(op_info, &key)) return false;
+  tf_shared_lock l(mu_);
+  const auto it = entries_.find(key);
+  if (it == entries_.end()) return false;
+  *time = Costs::NanoSeconds(
+      std::max<int64_t>(1, std::llround(it->second.mean_nanos)));
+  return true;
+}
+
+int CalibratedCostTable::size() const {
+  tf_shared_lock l(mu_);
+  return entries_.size();
+}
+
+void CalibratedCostTable::ToProto(OpCostTable* proto) const {
+  proto->Clear();
+  tf_shared_lock l(mu_);
+  // Sort the entries so that the output is deterministic.
+  std::vector<std::pair<const string*, const Entry*>> sorted_entries;
+  sorted_entries.reserve(entries_.size());
+  for (const auto& it : entries_) {
+    sorted_entries.emplace_back(&it.first, &it.second);
+  }
+  std::sort(sorted_entries.begin(), sorted_entries.end(),
+            [](const auto& a, const auto& b) { return *a.first < *b.first; });
+  for (const auto& it : sorted_entries) {
+    const Entry& entry = *it.second;
+    OpCostTable::Entry* entry_proto = proto->add_entries();
+    *entry_proto->mutable_op() = entry.op;
+    entry_proto->set_num_samples(entry.num_samples);
+    entry_proto->set_mean_nanos(entry.mean_nanos);
+    entry_proto->set_stddev_nanos(std::sqrt(entry.m2 / entry.num_samples));
+  }
+}
+
+Status CalibratedCostTable::MergeFromProto(const OpCostTable& proto) {
+  for (const OpCostTable::Entry& entry : proto.entries()) {
+    if (entry.num_samples() <= 0 || entry.mean_nanos() < 0 ||
+        entry.stddev_nanos() < 0) {
+      return errors::InvalidArgument("Invalid op cost table entry: ",
+                                     entry.ShortDebugString());
+    }
+  }
+  for (const OpCostTable::Entry& entry : proto.entries()) {
+    Merge(entry.op(), entry.num_samples(), entry.mean_nanos(),
+          entry.stddev_nanos() * entry.stddev_nanos() * entry.num_samples());
+  }
+  return OkStatus();
+}
+
+Status CalibratedCostTable::Save(Env* env, const string& path) const {
+  OpCostTable proto;
+  ToProto(&proto);
+  return WriteBinaryProto(env, path, proto);
+}
+
+Status CalibratedCostTable::Load(Env* env, const string& path) {
+  OpCostTable proto;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(env, path, &proto));
+  return MergeFromProto(proto);
+}
+
+std::shared_ptr<const CalibratedCostTable>
+CalibratedCostTable::FromEnvironment() {
+  static const auto* table =
+      new std::shared_ptr<const CalibratedCostTable>([]() {
+        std::shared_ptr<CalibratedCostTable> table;
+        const char* path = std::getenv("TF_GRAPPLER_CALIBRATED_COST_TABLE");
+        if (path == nullptr || *path == '\0') return table;
+        table = std::make_shared<CalibratedCostTable>();
+        const Status status = table->Load(Env::Default(), path);
+        if (!status.ok()) {
+          LOG(WARNING) << "Failed to load calibrated op costs from " << path
+                       << ": " << status;
+          table.reset();
+        } else {
+          VLOG(1) << "Loaded calibrated costs of " << table->size()
+                  << " ops from " << path;
+        }
+        return table;
+      }());
+  return *table;
+}
+
+}  // end namespace grappler
+}  // end namespace tensorflow
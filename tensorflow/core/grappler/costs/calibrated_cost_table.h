@@ -0,0 +1,97 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_GRAPPLER_COSTS_CALIBRATED_COST_TABLE_H_
+#define TENSORFLOW_CORE_GRAPPLER_COSTS_CALIBRATED_COST_TABLE_H_
+
+#include <memory>
+#include <string>
+
+#include "absl/container/flat_hash_map.h"
+#include "tensorflow/core/framework/cost_graph.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/grappler/costs/cost_estimator.h"
+#include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/status.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace grappler {
+
+// A table of op execution times measured on real hardware, keyed by op type,
+// attributes, device type and input types and shapes, which
+// OpLevelCostEstimator consults before its analytic models.
+//
+// Measurements are typically ingested from the cost graphs built by sessions
+// with GraphOptions.build_cost_model set, and saved to a file so that later
+// Grappler runs on the same hardware can load them. Ops whose input shapes are
+// not fully known are neither recorded nor looked up.
+class CalibratedCostTable {
+ public:
+  // Adds the measured compute costs of the nodes of `cost_graph`, collected
+  // while running `graph`. Nodes with a compute cost of zero are skipped,
+  // since cost graphs only have a resolution of a microsecond.
+  void AddCostGraph(const CostGraphDef& cost_graph, const GraphDef& graph);
+
+  // Adds the measured compute costs of `op_performance_list`.
+  void AddOpPerformance(const OpPerformanceList& op_performance_list);
+
+  // Adds a measured execution time of an op.
+  void AddMeasurement(const OpInfo& op_info, Costs::NanoSeconds time);
+
+  // Returns true and sets `*time` to the mean measured execution time if the
+  // table has measurements for `op_info`.
+  bool Lookup(const OpInfo& op_info, Costs::NanoSeconds* time) const;
+
+  // Returns the number of distinct ops in the table.
+  int size() const;
+
+  void ToProto(OpCostTable* proto) const;
+  // Merges the measurements of `proto` into the table.
+  Status MergeFromProto(const OpCostTable& proto);
+
+  // Saves the table to, or merges the table at, `path`.
+  Status Save(Env* env, const string& path) const;
+  Status Load(Env* env, const string& path);
+
+  // Returns the table loaded from the file named by the
+  // TF_GRAPPLER_CALIBRATED_COST_TABLE environment variable, or nullptr if it
+  // is not set or fails to load.
+  static std::shared_ptr<const CalibratedCostTable> FromEnvironment();
+
+ private:
+  struct Entry {
+    OpInfo op;
+    int64_t num_samples = 0;
+    double mean_nanos = 0;
+    // Sum of squared differences from the mean, as in Welford's algorithm.
+    double m2 = 0;
+  };
+
+  // Merges `num_samples` measurements with the given mean and sum of squared
+  // differences into the entry for `op_info`, if it has a key.
+  void Merge(const OpInfo& op_info, int64_t num_samples, double mean_nanos,
+             double m2);
+
+  mutable mutex mu_;
+  absl::flat_hash_map<string, Entry> entries_ TF_GUARDED_BY(mu_);
+};
+
+}  // end namespace grappler
+}  // end namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_GRAPPLER_COSTS_CALIBRATED_COST_TABLE_H_
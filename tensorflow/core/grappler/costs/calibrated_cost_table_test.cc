@@ -0,0 +1,320 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/grappler/costs/calibrated_cost_table.h"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/cc/ops/standard_ops.h"
+#include "tensorflow/core/framework/attr_value_util.h"
+#include "tensorflow/core/grappler/clusters/single_machine.h"
+#include "tensorflow/core/grappler/costs/analytical_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/op_level_cost_estimator.h"
+#include "tensorflow/core/grappler/costs/virtual_scheduler.h"
+#include "tensorflow/core/grappler/grappler_item.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace grappler {
+namespace {
+
+OpInfo MatMulOpInfo(int m, int k, int n) {
+  OpInfo op_info;
+  op_info.set_op("MatMul");
+  SetAttrValue(false, &(*op_info.mutable_attr())["transpose_a"]);
+  SetAttrValue(false, &(*op_info.mutable_attr())["transpose_b"]);
+  op_info.mutable_device()->set_type("CPU");
+  op_info.mutable_device()->set_num_cores(4);
+  op_info.mutable_device()->set_frequency(2600);
+  for (const auto& dims : {std::vector<int>{m, k}, std::vector<int>{k, n}}) {
+    OpInfo::TensorProperties* input = op_info.add_inputs();
+    input->set_dtype(DT_FLOAT);
+    for (int dim : dims) input->mutable_shape()->add_dim()->set_size(dim);
+  }
+  return op_info;
+}
+
+TEST(CalibratedCostTableTest, Lookup) {
+  CalibratedCostTable table;
+  table.AddMeasurement(MatMulOpInfo(8, 16, 32), Costs::NanoSeconds(1000));
+  EXPECT_EQ(table.size(), 1);
+
+  Costs::NanoSeconds time;
+  ASSERT_TRUE(table.Lookup(MatMulOpInfo(8, 16, 32), &time));
+  EXPECT_EQ(time, Costs::NanoSeconds(1000));
+  // Different shapes, attributes or devices are different entries.
+  EXPECT_FALSE(table.Lookup(MatMulOpInfo(8, 16, 64), &time));
+  OpInfo transposed = MatMulOpInfo(8, 16, 32);
+  SetAttrValue(true, &(*transposed.mutable_attr())["transpose_a"]);
+  EXPECT_FALSE(table.Lookup(transposed, &time));
+  OpInfo gpu = MatMulOpInfo(8, 16, 32);
+  gpu.mutable_device()->set_type("GPU");
+  EXPECT_FALSE(table.Lookup(gpu, &time));
+  // Internal attributes and device properties other than the type are not.
+  OpInfo annotated = MatMulOpInfo(8, 16, 32);
+  SetAttrValue("loc:@x", &(*annotated.mutable_attr())["_class"]);
+  annotated.mutable_device()->set_num_cores(8);
+  EXPECT_TRUE(table.Lookup(annotated, &time));
+}
+
+TEST(CalibratedCostTableTest, SkipsUnknownShapes) {
+  CalibratedCostTable table;
+  OpInfo unknown_dim = MatMulOpInfo(-1, 16, 32);
+  table.AddMeasurement(unknown_dim, Costs::NanoSeconds(1000));
+  OpInfo unknown_rank = MatMulOpInfo(8, 16, 32);
+  unknown_rank.mutable_inputs(1)->mutable_shape()->Clear();
+  unknown_rank.mutable_inputs(1)->mutable_shape()->set_unknown_rank(true);
+  table.AddMeasurement(unknown_rank, Costs::NanoSeconds(1000));
+  EXPECT_EQ(table.size(), 0);
+  Costs::NanoSeconds time;
+  EXPECT_FALSE(table.Lookup(unknown_dim, &time));
+}
+
+TEST(CalibratedCostTableTest, AggregatesMeasurements) {
+  CalibratedCostTable table;
+  for (int nanos : {100, 200, 300, 400}) {
+    table.AddMeasurement(MatMulOpInfo(8, 16, 32), Costs::NanoSeconds(nanos));
+  }
+  Costs::NanoSeconds time;
+  ASSERT_TRUE(table.Lookup(MatMulOpInfo(8, 16, 32), &time));
+  EXPECT_EQ(time, Costs::NanoSeconds(250));
+
+  OpCostTable proto;
+  table.ToProto(&proto);
+  ASSERT_EQ(proto.entries_size(), 1);
+  EXPECT_EQ(proto.entries(0).num_samples(), 4);
+  EXPECT_DOUBLE_EQ(proto.entries(0).mean_nanos(), 250);
+  EXPECT_NEAR(proto.entries(0).stddev_nanos(), std::sqrt(12500.0), 1e-6);
+  EXPECT_EQ(proto.entries(0).op().device().num_cores(), 0);
+
+  // Merging a table into another gives the statistics of all samples.
+  CalibratedCostTable merged;
+  merged.AddMeasurement(MatMulOpInfo(8, 16, 32), Costs::NanoSeconds(500));
+  TF_ASSERT_OK(merged.MergeFromProto(proto));
+  merged.ToProto(&proto);
+  ASSERT_EQ(proto.entries_size(), 1);
+  EXPECT_EQ(proto.entries(0).num_samples(), 5);
+  EXPECT_DOUBLE_EQ(proto.entries(0).mean_nanos(), 300);
+  EXPECT_NEAR(proto.entries(0).stddev_nanos(), std::sqrt(20000.0), 1e-6);
+}
+
+TEST(CalibratedCostTableTest, RejectsInvalidEntries) {
+  OpCostTable proto;
+  OpCostTable::Entry* entry = proto.add_entries();
+  *entry->mutable_op() = MatMulOpInfo(8, 16, 32);
+  entry->set_num_samples(0);
+  entry->set_mean_nanos(100);
+  CalibratedCostTable table;
+  EXPECT_FALSE(table.MergeFromProto(proto).ok());
+  EXPECT_EQ(table.size(), 0);
+}
+
+TEST(CalibratedCostTableTest, SaveAndLoad) {
+  CalibratedCostTable table;
+  table.AddMeasurement(MatMulOpInfo(8, 16, 32), Costs::NanoSeconds(1000));
+  table.AddMeasurement(MatMulOpInfo(64, 64, 64), Costs::NanoSeconds(20000));
+  const string path =
+      io::JoinPath(testing::TmpDir(), "calibrated_cost_table.pb");
+  TF_ASSERT_OK(table.Save(Env::Default(), path));
+
+  CalibratedCostTable loaded;
+  TF_ASSERT_OK(loaded.Load(Env::Default(), path));
+  EXPECT_EQ(loaded.size(), 2);
+  Costs::NanoSeconds time;
+  ASSERT_TRUE(loaded.Lookup(MatMulOpInfo(64, 64, 64), &time));
+  EXPECT_EQ(time, Costs::NanoSeconds(20000));
+
+  EXPECT_FALSE(loaded.Load(Env::Default(), path + ".missing").ok());
+}
+
+TEST(CalibratedCostTableTest, OverridesOpLevelCostEstimator) {
+  OpContext op_context;
+  op_context.op_info = MatMulOpInfo(8, 16, 32);
+  OpLevelCostEstimator estimator;
+  estimator.set_calibrated_costs(nullptr);
+  const Costs analytical = estimator.PredictCosts(op_context);
+
+  const Costs::NanoSeconds measured(analytical.execution_time.count() * 10 + 7);
+  auto table = std::make_shared<CalibratedCostTable>();
+  table->AddMeasurement(op_context.op_info, measured);
+  estimator.set_calibrated_costs(table);
+  const Costs calibrated = estimator.PredictCosts(op_context);
+  EXPECT_EQ(calibrated.execution_time, measured);
+  EXPECT_EQ(calibrated.compute_time, calibrated.execution_time);
+  EXPECT_EQ(calibrated.memory_time, Costs::Duration(0));
+  EXPECT_FALSE(calibrated.inaccurate);
+  EXPECT_EQ(calibrated.max_memory, analytical.max_memory);
+
+  // Ops without measurements keep their analytical costs.
+  op_context.op_info = MatMulOpInfo(8, 16, 64);
+  EXPECT_EQ(estimator.PredictCosts(op_context).execution_time,
+            OpLevelCostEstimator().PredictCosts(op_context).execution_time);
+}
+
+// Compares the step times predicted with and without calibration against
+// the step times measured on this machine, for a few graphs whose ops the
+// analytical models handle poorly. The comparison is logged for inspection;
+// no wall-clock bound is asserted.
+class CalibrationAccuracyTest : public ::testing::Test {
+ public:
+  void SetUp() override {
+    cluster_ = std::make_unique<SingleMachine>(5 /* timeout_s */,
+                                               3 /* num_cpu_cores */,
+                                               0 /* num_gpus */);
+    TF_CHECK_OK(cluster_->Provision());
+  }
+
+  void TearDown() override {
+    if (cluster_) {
+      TF_CHECK_OK(cluster_->Shutdown());
+    }
+    cluster_.reset();
+  }
+
+ protected:
+  struct Accuracy {
+    double measured_micros = 0;
+    double analytical_micros = 0;
+    double calibrated_micros = 0;
+  };
+
+  // Runs `item` a few times to measure its mean step time and to calibrate a
+  // cost table, then predicts its step time with and without the table.
+  Accuracy Evaluate(const GrapplerItem& item) {
+    constexpr int kWarmupSteps = 2;
+    constexpr int kSteps = 10;
+    TF_CHECK_OK(cluster_->Initialize(item));
+    for (int i = 0; i < kWarmupSteps; ++i) {
+      TF_CHECK_OK(cluster_->Run(item.graph, item.feed, item.fetch, nullptr));
+    }
+    auto table = std::make_shared<CalibratedCostTable>();
+    Accuracy accuracy;
+    for (int i = 0; i < kSteps; ++i) {
+      RunMetadata metadata;
+      const uint64 start_micros = Env::Default()->NowMicros();
+      TF_CHECK_OK(cluster_->Run(item.graph, item.feed, item.fetch, &metadata));
+      accuracy.measured_micros += Env::Default()->NowMicros() - start_micros;
+      table->AddCostGraph(metadata.cost_graph(), item.graph);
+    }
+    accuracy.measured_micros /= kSteps;
+    accuracy.analytical_micros = PredictMicros(item, nullptr);
+    accuracy.calibrated_micros = PredictMicros(item, table);
+    return accuracy;
+  }
+
+  double PredictMicros(const GrapplerItem& item,
+                       std::shared_ptr<const CalibratedCostTable> table) {
+    auto node_estimator = std::make_unique<OpLevelCostEstimator>();
+    node_estimator->set_calibrated_costs(std::move(table));
+    AnalyticalCostEstimator estimator(
+        cluster_.get(), std::move(node_estimator),
+        ReadyNodeManagerFactory("FirstReady"), /*use_static_shapes=*/true,
+        /*use_aggressive_shape_inference=*/true);
+    TF_CHECK_OK(estimator.Initialize(item));
+    RunMetadata metadata;
+    Costs costs;
+    TF_CHECK_OK(estimator.PredictCosts(item.graph, &metadata, &costs));
+    return costs.execution_time.count() / 1000.0;
+  }
+
+  std::unique_ptr<SingleMachine> cluster_;
+};
+
+GrapplerItem MatMulChain() {
+  Scope s = Scope::NewRootScope();
+  Output x = ops::RandomUniform(s.WithOpName("x"), {256, 256}, DT_FLOAT);
+  for (int i = 0; i < 4; ++i) {
+    Output w = ops::RandomUniform(s.WithOpName(strings::StrCat("w", i)),
+                                  {256, 256}, DT_FLOAT);
+    x = ops::MatMul(s.WithOpName(strings::StrCat("matmul", i)), x, w);
+  }
+  ops::Identity(s.WithOpName("out"), x);
+  GrapplerItem item;
+  item.fetch.push_back("out");
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  return item;
+}
+
+GrapplerItem RandomGather() {
+  Scope s = Scope::NewRootScope();
+  Output params =
+      ops::RandomUniform(s.WithOpName("params"), {100000, 64}, DT_FLOAT);
+  Output indices = ops::RandomUniformInt(
+      s.WithOpName("indices"), ops::Const(s, {16384}),
+      ops::Const(s, 0), ops::Const(s, 100000));
+  Output gather = ops::GatherV2(s.WithOpName("gather"), params, indices,
+                                ops::Const(s, 0));
+  ops::Sum(s.WithOpName("out"), gather, ops::Const(s, {0, 1}));
+  GrapplerItem item;
+  item.fetch.push_back("out");
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  return item;
+}
+
+GrapplerItem StringHashing() {
+  Scope s = Scope::NewRootScope();
+  Output x = ops::RandomUniform(s.WithOpName("x"), {65536}, DT_FLOAT);
+  Output str = ops::AsString(s.WithOpName("as_string"), x);
+  Output hash = ops::StringToHashBucketFast(s.WithOpName("hash"), str, 1024);
+  ops::Max(s.WithOpName("out"), hash, ops::Const(s, 0));
+  GrapplerItem item;
+  item.fetch.push_back("out");
+  TF_CHECK_OK(s.ToGraphDef(&item.graph));
+  return item;
+}
+
+TEST_F(CalibrationAccuracyTest, Report) {
+  const std::vector<std::pair<string, GrapplerItem>> items = {
+      {"MatMulChain", MatMulChain()},
+      {"RandomGather", RandomGather()},
+      {"StringHashing", StringHashing()},
+  };
+  string report = strings::StrCat(
+      "\n", "graph          measured_us  analytical_us (error)  ",
+      "calibrated_us (error)\n");
+  for (const auto& it : items) {
+    const Accuracy accuracy = Evaluate(it.second);
+    const auto relative_error = [&accuracy](double predicted_micros) {
+      return std::abs(predicted_micros - accuracy.measured_micros) /
+             accuracy.measured_micros;
+    };
+    strings::StrAppend(
+        &report,
+        strings::Printf("%-14s %11.1f  %13.1f (%5.2f)  %13.1f (%5.2f)\n",
+                        it.first.c_str(), accuracy.measured_micros,
+                        accuracy.analytical_micros,
+                        relative_error(accuracy.analytical_micros),
+                        accuracy.calibrated_micros,
+                        relative_error(accuracy.calibrated_micros)));
+    // Step times include the session's overheads and vary from machine to
+    // machine and run to run, so the accuracy is only reported, not checked
+    // against the measured time.
+    EXPECT_GT(accuracy.calibrated_micros, 0);
+  }
+  LOG(INFO) << "Step time prediction accuracy:" << report;
+}
+
+}  // namespace
+}  // namespace grappler
+}  // namespace tensorflow
@@ -41,6 +41,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/grappler/costs/calibrated_cost_table.h"
 #include "tensorflow/core/grappler/costs/cost_estimator.h"
 #include "tensorflow/core/grappler/costs/op_context.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
@@ -655,9 +656,31 @@ OpLevelCostEstimator::OpLevelCostEstimator() {
 
   // By default, use sum of memory_time and compute_time for execution_time.
   compute_memory_overlap_ = false;
+  calibrated_costs_ = CalibratedCostTable::FromEnvironment();
 }
 
 Costs OpLevelCostEstimator::PredictCosts(const OpContext& op_context) const {
+  Costs costs = PredictAnalyticalCosts(op_context);
+  Costs::NanoSeconds measured_time;
+  if (calibrated_costs_ != nullptr &&
+      calibrated_costs_->Lookup(op_context.op_info, &measured_time)) {
+    VLOG(1) << "Operation " << op_context.op_info.op() << " took "
+            << measured_time.count() << " ns when calibrated, predicted "
+            << costs.execution_time.count() << " ns.";
+    // Measured times include both compute and memory accesses.
+    costs.compute_time = measured_time;
+    costs.execution_time = measured_time;
+    costs.memory_time = 0;
+    costs.intermediate_memory_time = 0;
+    costs.intermediate_memory_read_time = 0;
+    costs.intermediate_memory_write_time = 0;
+    costs.inaccurate = false;
+  }
+  return costs;
+}
+
+Costs OpLevelCostEstimator::PredictAnalyticalCosts(
+    const OpContext& op_context) const {
   Costs costs;
   NodeCosts node_costs;
   if (PredictNodeCosts(op_context, &node_costs).ok()) {
@@ -19,12 +19,15 @@ limitations under the License.
 #include <cstdint>
 #include <functional>
 #include <map>
+#include <memory>
 #include <numeric>
 #include <set>
+#include <utility>
 #include <vector>
 
 #include "absl/status/status.h"
 #include "absl/status/statusor.h"
+#include "tensorflow/core/grappler/costs/calibrated_cost_table.h"
 #include "tensorflow/core/grappler/costs/cost_estimator.h"
 #include "tensorflow/core/grappler/costs/op_context.h"
 #include "tensorflow/core/grappler/costs/op_performance_data.pb.h"
@@ -101,12 +104,25 @@ class OpLevelCostEstimator {
   OpLevelCostEstimator();
   virtual ~OpLevelCostEstimator() {}
 
+  // Returns the measured time of the op from the calibrated cost table if it
+  // has one, and its analytical estimate otherwise.
   virtual Costs PredictCosts(const OpContext& op_context) const;
 
   // Returns basic device performance info.
   virtual DeviceInfo GetDeviceInfo(const DeviceProperties& device) const;
 
+  // Sets the table of measured op times consulted before the analytical
+  // models, or clears it if `calibrated_costs` is null. Defaults to the table
+  // named by the TF_GRAPPLER_CALIBRATED_COST_TABLE environment variable.
+  void set_calibrated_costs(
+      std::shared_ptr<const CalibratedCostTable> calibrated_costs) {
+    calibrated_costs_ = std::move(calibrated_costs);
+  }
+
  protected:
+  // Predicts the costs of an op with the analytical models only.
+  Costs PredictAnalyticalCosts(const OpContext& op_context) const;
+
   // TODO(dyoon): Consider to remove PredictOpCountBasedCosts() with OpInfo.
   // Naive cost estimate based on the given operations count and total
   // input/output tensor sizes of the given op_info combined.
@@ -335,6 +351,7 @@ class OpLevelCostEstimator {
   // compute_time and memory_time, instead of sum of those two.
   bool compute_memory_overlap_;
   std::set<string> persistent_ops_;
+  std::shared_ptr<const CalibratedCostTable> calibrated_costs_;
 
  private:
   friend class OpLevelCostEstimatorTest;
@@ -2787,6 +2787,147 @@ bool FindFusedBatchMatMul(RemapperContext* ctx, int node_index,
   return found_op_type_match;
 }
 
+// Finds scaled dot-product attention rooted at the second BatchMatMul:
+//   BatchMatMul(Softmax([Add](Mul(BatchMatMul(query, key), scale), mask)),
+//               value)
+// which is replaced by _FusedScaledDotProductAttention on CPU.
+bool FindFusedScaledDotProductAttention(
+    RemapperContext* ctx, int node_index,
+    std::map<string, int>* matched_nodes_map,
+    std::set<int>* remove_node_indices, float* scale) {
+  using utils::MatchingDirection;
+  using utils::NodeStatus;
+
+  const auto* node_def = ctx->graph_view.GetNode(node_index)->node();
+  if (!IsAnyBatchMatMul(*node_def) || !NodeIsOnCpu(node_def) ||
+      !HasDataType(node_def, DT_FLOAT)) {
+    return false;
+  }
+
+  // clang-format off
+  utils::OpTypePattern scores_pattern =
+    {"Mul", "scale", NodeStatus::kRemove,
+      {
+        {"BatchMatMul|BatchMatMulV2", "qk", NodeStatus::kRemove,
+          {
+            {"*", "query", NodeStatus::kRemain},
+            {"*", "key", NodeStatus::kRemain}
+          }
+        },
+        {"Const", "scale_value", NodeStatus::kRemain}
+      }
+    };
+  utils::OpTypePattern masked_pattern =
+    {"BatchMatMul|BatchMatMulV2", "output", NodeStatus::kReplace,
+      {
+        {"Softmax", "softmax", NodeStatus::kRemove,
+          {
+            {"Add|AddV2", "mask_add", NodeStatus::kRemove,
+              {
+                scores_pattern,
+                {"*", "mask", NodeStatus::kRemain}
+              }
+            }
+          }
+        },
+        {"*", "value", NodeStatus::kRemain}
+      }
+    };
+  utils::OpTypePattern unmasked_pattern =
+    {"BatchMatMul|BatchMatMulV2", "output", NodeStatus::kReplace,
+      {
+        {"Softmax", "softmax", NodeStatus::kRemove, {scores_pattern}},
+        {"*", "value", NodeStatus::kRemain}
+      }
+    };
+  // clang-format on
+
+  utils::SubGraphMatcher<MatchingDirection::kFollowInputs> graph_matcher(
+      &(ctx->graph_view));
+  matched_nodes_map->clear();
+  remove_node_indices->clear();
+  bool found_op_type_match = graph_matcher.GetMatchedNodes(
+      masked_pattern, ctx->nodes_to_preserve,
+      ctx->graph_view.GetNode(node_index), matched_nodes_map,
+      remove_node_indices);
+  if (!found_op_type_match) {
+    matched_nodes_map->clear();
+    remove_node_indices->clear();
+    found_op_type_match = graph_matcher.GetMatchedNodes(
+        unmasked_pattern, ctx->nodes_to_preserve,
+        ctx->graph_view.GetNode(node_index), matched_nodes_map,
+        remove_node_indices);
+  }
+  if (!found_op_type_match) return false;
+
+  // The kernel computes softmax(scale * query * key^T + mask) * value, so
+  // query must not be adjointed, key may be, and value must not be.
+  const auto* qk_node_def =
+      ctx->graph_view.GetNode(matched_nodes_map->at("qk"))->node();
+  if (!HasDataType(qk_node_def, DT_FLOAT)) return false;
+  bool adj_x = false;
+  bool adj_y = false;
+  if ((TryGetNodeAttr(*qk_node_def, "adj_x", &adj_x) && adj_x) ||
+      (TryGetNodeAttr(*node_def, "adj_x", &adj_x) && adj_x) ||
+      (TryGetNodeAttr(*node_def, "adj_y", &adj_y) && adj_y)) {
+    return false;
+  }
+
+  // The scale must be a scalar.
+  Tensor scale_tensor;
+  const auto* scale_node_def =
+      ctx->graph_view.GetNode(matched_nodes_map->at("scale_value"))->node();
+  if (!scale_tensor.FromProto(scale_node_def->attr().at("value").tensor()) ||
+      scale_tensor.dtype() != DT_FLOAT || scale_tensor.NumElements() != 1) {
+    return false;
+  }
+  *scale = scale_tensor.flat<float>()(0);
+
+  // The kernel does not broadcast query, key and value against each other, and
+  // only broadcasts the mask to the shape of the scores.
+  if (!ctx->inferred_graph_properties) return false;
+  const auto& qk_props =
+      ctx->graph_properties.GetInputProperties(qk_node_def->name());
+  const auto& output_props =
+      ctx->graph_properties.GetInputProperties(node_def->name());
+  const auto& scores_props =
+      ctx->graph_properties.GetOutputProperties(qk_node_def->name());
+  if (qk_props.size() != 2 || output_props.size() != 2 ||
+      scores_props.empty()) {
+    return false;
+  }
+  const TensorShapeProto& query_shape = qk_props[0].shape();
+  const TensorShapeProto& key_shape = qk_props[1].shape();
+  const TensorShapeProto& value_shape = output_props[1].shape();
+  const int rank = Rank(query_shape);
+  if (rank < 2 || Rank(key_shape) != rank || Rank(value_shape) != rank) {
+    return false;
+  }
+  const auto same_dim = [](const TensorShapeProto::Dim& lhs,
+                           const TensorShapeProto::Dim& rhs) {
+    return (IsKnown(lhs) || IsKnownSymbolically(lhs)) &&
+           lhs.size() == rhs.size();
+  };
+  for (int i = 0; i < rank - 2; ++i) {
+    if (!same_dim(query_shape.dim(i), key_shape.dim(i)) ||
+        !same_dim(query_shape.dim(i), value_shape.dim(i))) {
+      return false;
+    }
+  }
+  if (matched_nodes_map->count("mask")) {
+    const auto* mask_add_node_def =
+        ctx->graph_view.GetNode(matched_nodes_map->at("mask_add"))->node();
+    const auto& mask_add_props =
+        ctx->graph_properties.GetOutputProperties(mask_add_node_def->name());
+    if (mask_add_props.empty() ||
+        !ShapesSymbolicallyEqual(mask_add_props[0].shape(),
+                                 scores_props[0].shape())) {
+      return false;
+    }
+  }
+  return true;
+}
+
 // Helper function to check if the reduction axes for a given input
 // shape align with instance normalization's mean computation.
 // Mean reduction axes for instance norm are expected to be:
@@ -4142,6 +4283,56 @@ Status AddFusedBatchMatMul(RemapperContext* ctx,
   return OkStatus();
 }
 
+Status AddFusedScaledDotProductAttention(
+    RemapperContext* ctx, const std::map<string, int>& matched_nodes_map,
+    const std::set<int>& remove_node_indices, float scale,
+    std::vector<bool>* invalidated_nodes, std::vector<bool>* nodes_to_delete) {
+  const auto* output_node =
+      ctx->graph_view.GetNode(matched_nodes_map.at("output"))->node();
+  const auto* qk_node =
+      ctx->graph_view.GetNode(matched_nodes_map.at("qk"))->node();
+
+  NodeDef fused_node;
+  fused_node.set_name(output_node->name());
+  fused_node.set_op("_FusedScaledDotProductAttention");
+  fused_node.set_device(output_node->device());
+  fused_node.add_input(qk_node->input(0));
+  fused_node.add_input(qk_node->input(1));
+  fused_node.add_input(output_node->input(1));
+  int num_args = 0;
+  if (matched_nodes_map.count("mask")) {
+    // Pass the mask by the input of the Add that is not the scaled scores.
+    const auto* mask_add_node =
+        ctx->graph_view.GetNode(matched_nodes_map.at("mask_add"))->node();
+    const auto* scale_node =
+        ctx->graph_view.GetNode(matched_nodes_map.at("scale"))->node();
+    const bool scores_first =
+        ParseTensorName(mask_add_node->input(0)).node() == scale_node->name();
+    fused_node.add_input(mask_add_node->input(scores_first ? 1 : 0));
+    num_args = 1;
+  }
+
+  auto* attr = fused_node.mutable_attr();
+  (*attr)["T"] = output_node->attr().at("T");
+  SetAttrValue(num_args, &(*attr)["num_args"]);
+  SetAttrValue(scale, &(*attr)["scale"]);
+  bool adj_key = false;
+  TryGetNodeAttr(*qk_node, "adj_y", &adj_key);
+  SetAttrValue(adj_key, &(*attr)["adj_key"]);
+
+  utils::Mutation* mutation = ctx->graph_view.GetMutationBuilder();
+  Status status;
+  mutation->AddNode(std::move(fused_node), &status);
+  TF_RETURN_IF_ERROR(status);
+  TF_RETURN_IF_ERROR(mutation->Apply());
+  (*invalidated_nodes)[matched_nodes_map.at("output")] = true;
+
+  for (const auto& node_idx : remove_node_indices) {
+    (*nodes_to_delete)[node_idx] = true;
+  }
+  return OkStatus();
+}
+
 // Helper function to get data of type T from a given tensor and
 // return them in a vector and casted to type U.
 // Note - use this function only when type cast is safe from T to U.
@@ -4442,6 +4633,7 @@ Status ReplaceSoftplusTanhAndMulWithMish(
 //   (3) Fusing Conv2D biasadd and relu on GPU
 //   (4) INTEL_MKL specific: Conv2D -> Add or Conv2D -> BiasAdd -> Add.
 //   (5) Fusing side output and/or activation into FusedBatchNormGrad.
+//   (6) Fusing scaled dot-product attention.
 bool RequiresInferredShapes(const RemapperContext& ctx, int node_index,
                             const Cluster* cluster) {
   // Candidate for a FusedBatchNorm splitting.
@@ -4579,17 +4771,25 @@ bool RequiresInferredShapes(const RemapperContext& ctx, int node_index,
     return true;
   };
 
+  // Candidate for a _FusedScaledDotProductAttention fusion.
+  const auto is_attention_candidate = [&]() -> bool {
+    if (!IsAnyBatchMatMul(*node_def) || !NodeIsOnCpu(node_def)) return false;
+    if (node_view->NumRegularFanins() < 1) return false;
+    const auto& bmm_fanin_0 = node_view->GetRegularFanin(0);
+    return IsSoftmax(*bmm_fanin_0.node_view()->node());
+  };
+
   if (IsMKLEnabled())
     return is_batch_norm_candidate() || is_batch_norm_fusion_candidate() ||
            IsContractionWithAdd(ctx, node_index) ||
            is_act_biasadd_conv_candidate() || IsBiasAdd(*node_def) ||
-           IsTranspose(*node_def);
+           IsTranspose(*node_def) || is_attention_candidate();
 
   return is_act_biasadd_conv_candidate() || is_batch_norm_candidate() ||
          is_batch_norm_fusion_candidate() ||
          is_batch_norm_grad_fusion_candidate() ||
          is_matmul_gelu_exact_fusion_candidate() ||
-         is_act_biasadd_matmul_candidate();
+         is_act_biasadd_matmul_candidate() || is_attention_candidate();
 }
 }  // namespace
 
@@ -4836,6 +5036,19 @@ Status Remapper::Optimize(Cluster* cluster, const GrapplerItem& item,
       continue;
     }
 
+    // Remap BatchMatMul+Mul+(Add)+Softmax+BatchMatMul into the
+    // _FusedScaledDotProductAttention.
+    float attention_scale = 1.0f;
+    if (allow_non_differentiable_rewrites &&
+        FindFusedScaledDotProductAttention(&ctx, i, &matched_nodes_map,
+                                           &remove_node_indices,
+                                           &attention_scale)) {
+      TF_RETURN_IF_ERROR(AddFusedScaledDotProductAttention(
+          &ctx, matched_nodes_map, remove_node_indices, attention_scale,
+          &invalidated_nodes, &nodes_to_delete));
+      continue;
+    }
+
     // Remap {Conv2D,DepthwiseConv2D,MatMul}+BiasAdd into the
     // _Fused{Conv2D,DepthwiseConv2dNative,MatMul}
     ContractionWithBiasAdd contract_with_bias;
@@ -2878,5 +2878,134 @@ TEST_F(RemapperFuseFusedConvWithFusedActivation, Conv3D_BF16) {
   RunTest<3, DT_BFLOAT16>();
 }
 
+class RemapperFuseScaledDotProductAttentionTest : public RemapperTest {
+ public:
+  void RunTest(bool with_mask, bool adj_key) {
+    using ::tensorflow::ops::Placeholder;
+
+    tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+    const std::vector<int64_t> qv_dims = {2, 4, 40, 8};
+    const std::vector<int64_t> key_dims =
+        adj_key ? qv_dims : std::vector<int64_t>{2, 4, 8, 40};
+    const std::vector<int64_t> mask_dims = {2, 1, 1, 40};
+
+    auto query = Placeholder(s.WithOpName("query"), DT_FLOAT,
+                             Placeholder::Shape(PartialTensorShape(qv_dims)));
+    auto key = Placeholder(s.WithOpName("key"), DT_FLOAT,
+                           Placeholder::Shape(PartialTensorShape(key_dims)));
+    auto value = Placeholder(s.WithOpName("value"), DT_FLOAT,
+                             Placeholder::Shape(PartialTensorShape(qv_dims)));
+    auto mask = Placeholder(s.WithOpName("mask"), DT_FLOAT,
+                            Placeholder::Shape(PartialTensorShape(mask_dims)));
+
+    auto qk = ops::BatchMatMulV2(s.WithOpName("qk"), query, key,
+                                 ops::BatchMatMulV2::AdjY(adj_key));
+    auto scale = ops::Const(s.WithOpName("scale"), 0.35f, {});
+    Output scores = ops::Mul(s.WithOpName("scaled_qk"), qk, scale);
+    if (with_mask) {
+      scores = ops::AddV2(s.WithOpName("masked_qk"), mask, scores);
+    }
+    auto softmax = ops::Softmax(s.WithOpName("softmax"), scores);
+    auto attention =
+        ops::BatchMatMulV2(s.WithOpName("attention"), softmax, value);
+    auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+    auto mask_t = GenerateRandomTensor<DT_FLOAT>(TensorShape(mask_dims));
+    // Mask out a few keys entirely.
+    for (int i = 0; i < mask_t.NumElements(); i += 7) {
+      mask_t.flat<float>()(i) = -1e9f;
+    }
+
+    GrapplerItem item;
+    item.fetch = {"fetch"};
+    item.feed = {
+        {"query", GenerateRandomTensor<DT_FLOAT>(TensorShape(qv_dims))},
+        {"key", GenerateRandomTensor<DT_FLOAT>(TensorShape(key_dims))},
+        {"value", GenerateRandomTensor<DT_FLOAT>(TensorShape(qv_dims))},
+        {"mask", mask_t}};
+    TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+
+    // Place all nodes on CPU.
+    for (int i = 0; i < item.graph.node_size(); ++i) {
+      item.graph.mutable_node(i)->set_device("/device:CPU:0");
+    }
+
+    Remapper optimizer(RewriterConfig::ON);
+    GraphDef output;
+    TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+
+    int found = 0;
+    for (const NodeDef& node : output.node()) {
+      EXPECT_NE(node.op(), "Softmax");
+      if (node.name() == "attention") {
+        EXPECT_EQ(node.op(), "_FusedScaledDotProductAttention");
+        ASSERT_EQ(node.input_size(), with_mask ? 4 : 3);
+        EXPECT_EQ(node.input(0), "query");
+        EXPECT_EQ(node.input(1), "key");
+        EXPECT_EQ(node.input(2), "value");
+        if (with_mask) EXPECT_EQ(node.input(3), "mask");
+        EXPECT_EQ(node.attr().at("num_args").i(), with_mask ? 1 : 0);
+        EXPECT_FLOAT_EQ(node.attr().at("scale").f(), 0.35f);
+        EXPECT_EQ(node.attr().at("adj_key").b(), adj_key);
+        found++;
+      }
+    }
+    EXPECT_EQ(found, 1);
+
+    auto tensors_expected = EvaluateNodes(item.graph, item.fetch, item.feed);
+    ASSERT_EQ(tensors_expected.size(), 1);
+    auto tensors = EvaluateNodes(output, item.fetch, item.feed);
+    ASSERT_EQ(tensors.size(), 1);
+    test::ExpectClose(tensors[0], tensors_expected[0], 1e-5, 1e-5);
+  }
+};
+
+TEST_F(RemapperFuseScaledDotProductAttentionTest, Masked) {
+  RunTest(/*with_mask=*/true, /*adj_key=*/true);
+}
+
+TEST_F(RemapperFuseScaledDotProductAttentionTest, Unmasked) {
+  RunTest(/*with_mask=*/false, /*adj_key=*/true);
+}
+
+TEST_F(RemapperFuseScaledDotProductAttentionTest, TransposedKey) {
+  RunTest(/*with_mask=*/true, /*adj_key=*/false);
+}
+
+TEST_F(RemapperTest, DoNotFuseAttentionWithBroadcastValue) {
+  using ::tensorflow::ops::Placeholder;
+  tensorflow::Scope s = tensorflow::Scope::NewRootScope();
+
+  auto query = Placeholder(s.WithOpName("query"), DT_FLOAT,
+                           ops::Placeholder::Shape({2, 16, 8}));
+  auto key = Placeholder(s.WithOpName("key"), DT_FLOAT,
+                         ops::Placeholder::Shape({2, 16, 8}));
+  auto value = Placeholder(s.WithOpName("value"), DT_FLOAT,
+                           ops::Placeholder::Shape({1, 16, 8}));
+  auto qk = ops::BatchMatMulV2(s.WithOpName("qk"), query, key,
+                               ops::BatchMatMulV2::AdjY(true));
+  auto scale = ops::Const(s.WithOpName("scale"), 0.35f, {});
+  auto scores = ops::Mul(s.WithOpName("scaled_qk"), qk, scale);
+  auto softmax = ops::Softmax(s.WithOpName("softmax"), scores);
+  auto attention =
+      ops::BatchMatMulV2(s.WithOpName("attention"), softmax, value);
+  auto fetch = ops::Identity(s.WithOpName("fetch"), attention);
+
+  GrapplerItem item;
+  item.fetch = {"fetch"};
+  TF_ASSERT_OK(s.ToGraphDef(&item.graph));
+  for (int i = 0; i < item.graph.node_size(); ++i) {
+    item.graph.mutable_node(i)->set_device("/device:CPU:0");
+  }
+
+  Remapper optimizer(RewriterConfig::ON);
+  GraphDef output;
+  TF_ASSERT_OK(optimizer.Optimize(nullptr, item, &output));
+  for (const NodeDef& node : output.node()) {
+    EXPECT_NE(node.op(), "_FusedScaledDotProductAttention");
+  }
+}
+
 }  // namespace grappler
 }  // namespace tensorflow
@@ -307,6 +307,12 @@ BatchFunctionKernel::BatchFunctionKernel(OpKernelConstruction* c)
     has_attribute_enable_large_batch_splitting_ = false;
   }
 
+  OP_REQUIRES_OK(c, c->GetAttr("length_bucketing_dim", &length_bucketing_dim_));
+  OP_REQUIRES_OK(c, c->GetAttr("allowed_lengths", &allowed_lengths_));
+  OP_REQUIRES_OK(
+      c, c->GetAttr("length_bucketed_outputs", &length_bucketed_outputs_));
+  OP_REQUIRES_OK(c, ValidateLengthBucketing(c->num_outputs()));
+
   // Helper function `SetAdaptiveBatchSchedulerOptions` calls
   // `OP_REQUIRES_OK`, which exits the current function upon error.
   // So validate status of `op-kernel-construction`.
@@ -413,6 +419,7 @@ void BatchFunctionKernel::ComputeAsync(OpKernelContext* c, DoneCallback done) {
       if (session_metadata) {
         new_resource->set_session_metadata(*session_metadata);
       }
+      SetLengthBucketingOptions(new_resource.get());
       *r = new_resource.release();
       return OkStatus();
     };
@@ -430,6 +437,7 @@ void BatchFunctionKernel::ComputeAsync(OpKernelContext* c, DoneCallback done) {
       if (session_metadata) {
         new_resource->set_session_metadata(*session_metadata);
       }
+      SetLengthBucketingOptions(new_resource.get());
       *r = new_resource.release();
       return OkStatus();
     };
@@ -559,6 +567,53 @@ Status BatchFunctionKernel::ValidateAllowedBatchSizes() const {
   return OkStatus();
 }
 
+Status BatchFunctionKernel::ValidateLengthBucketing(int num_outputs) const {
+  if (length_bucketing_dim_ < 0) {
+    if (!allowed_lengths_.empty() || !length_bucketed_outputs_.empty()) {
+      return errors::InvalidArgument(
+          "allowed_lengths and length_bucketed_outputs require "
+          "length_bucketing_dim to be set");
+    }
+    return OkStatus();
+  }
+  if (length_bucketing_dim_ == 0) {
+    return errors::InvalidArgument(
+        "length_bucketing_dim can not be the batch dimension 0");
+  }
+  if (allowed_lengths_.empty()) {
+    return errors::InvalidArgument(
+        "allowed_lengths must not be empty when length_bucketing_dim is set");
+  }
+  for (size_t i = 0; i < allowed_lengths_.size(); ++i) {
+    if (allowed_lengths_[i] <= 0 ||
+        (i > 0 && allowed_lengths_[i] <= allowed_lengths_[i - 1])) {
+      return errors::InvalidArgument(
+          "allowed_lengths entries must be positive and monotonically "
+          "increasing");
+    }
+  }
+  for (int32 output : length_bucketed_outputs_) {
+    if (output < 0 || output >= num_outputs) {
+      return errors::InvalidArgument("length_bucketed_outputs entry ", output,
+                                     " is not the index of one of the ",
+                                     num_outputs, " outputs");
+    }
+  }
+  return OkStatus();
+}
+
+void BatchFunctionKernel::SetLengthBucketingOptions(
+    serving::BatchResourceBase* resource) const {
+  if (length_bucketing_dim_ < 0) {
+    return;
+  }
+  serving::BatchResourceBase::LengthBucketingOptions options;
+  options.ragged_dim = length_bucketing_dim_;
+  options.allowed_lengths = allowed_lengths_;
+  options.trimmed_outputs = length_bucketed_outputs_;
+  resource->set_length_bucketing_options(std::move(options));
+}
+
 // Initialize vars by reading from op-kernel-construction.
 // Vars
 // - enable_adaptive_batch_threads_
@@ -38,6 +38,10 @@ namespace internal {
 class BatchFunctionKernelTestAccess;
 }
 
+namespace serving {
+class BatchResourceBase;
+}
+
 // Records the usage of attribute `enable_large_batch_splitting`.
 void RecordBatchSplitUsage(
     std::optional<bool> maybe_enable_large_batch_splitting,
@@ -79,6 +83,16 @@ class BatchFunctionKernel : public AsyncOpKernel {
   // to `max_batch_size_`.
   Status ValidateAllowedBatchSizes() const;
 
+  // Validates the length bucketing attributes. Without `length_bucketing_dim`
+  // the others must be empty; with it, `allowed_lengths_` must be positive and
+  // increase monotonically, and `length_bucketed_outputs_` must be indices of
+  // outputs.
+  Status ValidateLengthBucketing(int num_outputs) const;
+
+  // Enables length bucketing on a newly created `resource` if
+  // `length_bucketing_dim_` is set.
+  void SetLengthBucketingOptions(serving::BatchResourceBase* resource) const;
+
   // Creates the function handle if it isn't initialized yet; and re-use it
   // afterwards.
   Status GetOrCreateFunctionHandle(OpKernelContext* c,
@@ -114,6 +128,9 @@ class BatchFunctionKernel : public AsyncOpKernel {
   bool enable_large_batch_splitting_;
   bool has_attribute_enable_large_batch_splitting_;
   bool enable_adaptive_batch_threads_ = false;
+  int32 length_bucketing_dim_;
+  std::vector<int32> allowed_lengths_;
+  std::vector<int32> length_bucketed_outputs_;
 
   mutex mu_;
 
@@ -15,13 +15,17 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/batch_kernels.h"
 
+#include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <random>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include <gtest/gtest.h>
 #include "absl/strings/match.h"
+#include "absl/strings/str_format.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/framework/function.h"
 #include "tensorflow/core/framework/tensor_shape.h"
@@ -31,6 +35,8 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/status.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/platform/threadpool.h"
 #include "tensorflow/core/protobuf/config.pb.h"
 #include "tsl/platform/blocking_counter.h"
 #include "tsl/platform/status.h"
@@ -251,4 +257,203 @@ INSTANTIATE_TEST_SUITE_P(BatchFunctionKernelParallelWarmupTestSuite,
                          BatchFunctionKernelParallelWarmupTest,
                          ::testing::Bool());
 
+// A BatchFunction whose float input of shape [1, length, hidden] may be
+// bucketed along dimension 1. The function returns `func_op` of the batched
+// input and the batched input itself.
+class LengthBucketingTestState : public OpsTestBase {
+ public:
+  // Init test fixture with a batch kernel instance. Kernels with the same
+  // `shared_name` batch their calls together.
+  Status Init(const string &shared_name, int max_batch_size,
+              int length_bucketing_dim,
+              const std::vector<int32> &allowed_lengths,
+              const std::vector<int32> &length_bucketed_outputs,
+              const string &func_op = "Identity") {
+    static auto *const cpu_device = []() {
+      auto device =
+          DeviceFactory::NewDevice("CPU", {}, "/job:a/replica:0/task:0");
+      return device.release();
+    }();
+    device_ = cpu_device;
+
+    NameAttrList f;
+    f.set_name("length_bucketed_func");
+    TF_RETURN_IF_ERROR(flib_def_->AddFunctionDef(FunctionDefHelper::Define(
+        /*Function*/ "length_bucketed_func",
+        /*Inputs*/ {"input1:float"},
+        /*Outputs*/ {"output1:float", "output2:float"},
+        /*Attribute*/ {},
+        // Node info
+        {{{"output1"}, func_op, {"input1"}, {{"T", DT_FLOAT}}},
+         {{"output2"}, "Identity", {"input1"}, {{"T", DT_FLOAT}}}})));
+
+    pflr_ = std::make_unique<ProcessFunctionLibraryRuntime>(
+        device_mgr_.get(), Env::Default(), /*config=*/nullptr,
+        TF_GRAPH_DEF_VERSION, flib_def_.get(), OptimizerOptions(),
+        /*thread_pool=*/nullptr, /*parent=*/nullptr,
+        /*session_metadata=*/nullptr,
+        Rendezvous::Factory{[](const int64, const DeviceMgr *device_mgr,
+                               tsl::core::RefCountPtr<Rendezvous> *r) {
+          *r = tsl::core::RefCountPtr<Rendezvous>(
+              new IntraProcessRendezvous(device_mgr));
+          return OkStatus();
+        }});
+
+    TF_CHECK_OK(NodeDefBuilder("LengthBucketedBatch", "BatchFunction")
+                    .Attr("max_batch_size", max_batch_size)
+                    .Attr("num_batch_threads", 4)
+                    .Attr("batch_timeout_micros", 1000)
+                    .Attr("max_enqueued_batches", 100)
+                    .Attr("shared_name", shared_name)
+                    .Attr("length_bucketing_dim", length_bucketing_dim)
+                    .Attr("allowed_lengths", allowed_lengths)
+                    .Attr("length_bucketed_outputs", length_bucketed_outputs)
+                    .Attr("Tin", {DT_FLOAT})
+                    .Input({NodeDefBuilder::NodeOut({"n1", 0, DT_FLOAT})})
+                    .Attr("Tcaptured", std::vector<DataType>{})
+                    .Input(std::vector<NodeDefBuilder::NodeOut>{})
+                    .Attr("Tout", {DT_FLOAT, DT_FLOAT})
+                    .Attr("f", f)
+                    .Finalize(node_def()));
+    return InitOp();
+  }
+
+  void TestBody() override {}
+};
+
+// Returns the values of a [1, length, 2] input, which are all non-zero.
+std::vector<float> LengthBucketingInput(int length) {
+  std::vector<float> values(2 * length);
+  for (size_t i = 0; i < values.size(); ++i) values[i] = i + 1;
+  return values;
+}
+
+TEST(BatchFunctionLengthBucketingTest, PadsInputsAndTrimsDeclaredOutputs) {
+  // Two calls fall in each of the buckets 4 and 8, and fill a batch of it.
+  const std::vector<int> lengths = {1, 3, 5, 8};
+  const std::vector<int> buckets = {4, 4, 8, 8};
+  tsl::BlockingCounter blocking_counter(lengths.size());
+  for (size_t i = 0; i < lengths.size(); ++i) {
+    Env::Default()->SchedClosure([&, i]() {
+      LengthBucketingTestState test;
+      TF_CHECK_OK(test.Init("pads_inputs_and_trims_declared_outputs",
+                            /*max_batch_size=*/2, /*length_bucketing_dim=*/1,
+                            /*allowed_lengths=*/{4, 8},
+                            /*length_bucketed_outputs=*/{0}));
+      const std::vector<float> input = LengthBucketingInput(lengths[i]);
+      test.AddInputFromArray<float>(TensorShape({1, lengths[i], 2}), input);
+      TF_CHECK_OK(test.RunOpKernel());
+
+      // The declared output is trimmed back to the length of the call.
+      test::ExpectTensorEqual<float>(
+          *test.GetOutput(0),
+          test::AsTensor<float>(input, TensorShape({1, lengths[i], 2})));
+      // The other output keeps the zero padding of the bucket.
+      std::vector<float> padded = input;
+      padded.resize(2 * buckets[i], 0.0f);
+      test::ExpectTensorEqual<float>(
+          *test.GetOutput(1),
+          test::AsTensor<float>(padded, TensorShape({1, buckets[i], 2})));
+      blocking_counter.DecrementCount();
+    });
+  }
+  blocking_counter.Wait();
+}
+
+TEST(BatchFunctionLengthBucketingTest, RejectsInputsLongerThanAllowed) {
+  LengthBucketingTestState test;
+  TF_ASSERT_OK(test.Init("rejects_inputs_longer_than_allowed",
+                         /*max_batch_size=*/2, /*length_bucketing_dim=*/1,
+                         /*allowed_lengths=*/{4, 8},
+                         /*length_bucketed_outputs=*/{0}));
+  test.AddInputFromArray<float>(TensorShape({1, 9, 2}),
+                                LengthBucketingInput(9));
+  const Status status = test.RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+  EXPECT_TRUE(absl::StrContains(status.message(),
+                                "exceeds the largest allowed length 8"));
+}
+
+TEST(BatchFunctionLengthBucketingTest, ValidatesAttributes) {
+  auto init = [](int length_bucketing_dim,
+                 const std::vector<int32> &allowed_lengths,
+                 const std::vector<int32> &length_bucketed_outputs) {
+    LengthBucketingTestState test;
+    return test.Init("validates_attributes", /*max_batch_size=*/2,
+                     length_bucketing_dim, allowed_lengths,
+                     length_bucketed_outputs);
+  };
+  TF_EXPECT_OK(init(1, {4, 8}, {0, 1}));
+  TF_EXPECT_OK(init(-1, {}, {}));
+  // No allowed lengths.
+  EXPECT_TRUE(errors::IsInvalidArgument(init(1, {}, {})));
+  // Allowed lengths not increasing.
+  EXPECT_TRUE(errors::IsInvalidArgument(init(1, {8, 4}, {})));
+  // Not an output index.
+  EXPECT_TRUE(errors::IsInvalidArgument(init(1, {4, 8}, {2})));
+  // Bucketing the batch dimension.
+  EXPECT_TRUE(errors::IsInvalidArgument(init(0, {4, 8}, {})));
+  // Allowed lengths without a ragged dimension.
+  EXPECT_TRUE(errors::IsInvalidArgument(init(-1, {4, 8}, {})));
+}
+
+// Runs 256 concurrent calls of a BatchFunction computing `Tanh`, in batches
+// of up to 16, whose inputs have a long-tailed length distribution (8..512).
+// Without bucketing (state.range(0) == 0), every call pads its input to the
+// longest length 512; with it, the kernel pads to the buckets {32, 64, 128,
+// 256, 512}. The label reports the fraction of the computed elements that
+// hold actual data.
+void BM_LengthBucketedBatchFunction(::testing::benchmark::State &state) {
+  const bool bucketed = state.range(0) == 1;
+  constexpr int kNumCalls = 256;
+  constexpr int kHiddenSize = 64;
+  constexpr int kMaxLength = 512;
+  const std::vector<int32> allowed_lengths = {32, 64, 128, 256, kMaxLength};
+
+  std::mt19937 random(/*seed=*/42);
+  std::lognormal_distribution<double> length_distribution(/*m=*/4.0,
+                                                          /*s=*/0.7);
+  std::vector<std::unique_ptr<LengthBucketingTestState>> calls;
+  int64_t actual_elements = 0;
+  int64_t padded_elements = 0;
+  for (int i = 0; i < kNumCalls; ++i) {
+    const int64_t length = std::clamp<int64_t>(
+        static_cast<int64_t>(length_distribution(random)), 8, kMaxLength);
+    const int64_t padded_length =
+        bucketed ? *std::lower_bound(allowed_lengths.begin(),
+                                     allowed_lengths.end(), length)
+                 : kMaxLength;
+    actual_elements += length;
+    padded_elements += padded_length;
+
+    calls.push_back(std::make_unique<LengthBucketingTestState>());
+    TF_CHECK_OK(calls.back()->Init(
+        bucketed ? "bm_bucketed" : "bm_padded", /*max_batch_size=*/16,
+        /*length_bucketing_dim=*/bucketed ? 1 : -1,
+        bucketed ? allowed_lengths : std::vector<int32>{},
+        bucketed ? std::vector<int32>{0} : std::vector<int32>{}, "Tanh"));
+    calls.back()->AddInputFromArray<float>(
+        TensorShape({1, bucketed ? length : kMaxLength, kHiddenSize}),
+        std::vector<float>((bucketed ? length : kMaxLength) * kHiddenSize,
+                           0.5f));
+  }
+
+  thread::ThreadPool pool(Env::Default(), "calls", kNumCalls);
+  for (auto s : state) {
+    tsl::BlockingCounter blocking_counter(kNumCalls);
+    for (auto &call : calls) {
+      pool.Schedule([&call, &blocking_counter]() {
+        TF_CHECK_OK(call->RunOpKernel());
+        blocking_counter.DecrementCount();
+      });
+    }
+    blocking_counter.Wait();
+  }
+  state.SetItemsProcessed(state.iterations() * kNumCalls);
+  state.SetLabel(absl::StrFormat(
+      "%s, utilization %.1f%%", bucketed ? "bucketed" : "padded to 512",
+      100.0 * actual_elements / padded_elements));
+}
+BENCHMARK(BM_LengthBucketedBatchFunction)->Arg(0)->Arg(1)->UseRealTime();
+
 }  // namespace tensorflow
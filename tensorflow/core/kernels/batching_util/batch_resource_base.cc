@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <iterator>
 #include <memory>
@@ -256,6 +257,9 @@ BatchResourceBase::BatchTask::CreateSplitTask(
   task->status = this->status;
   task->is_partial = true;
   task->start_time = this->start_time;
+  task->deadline_time_micros = this->deadline_time_micros;
+  task->length = this->length;
+  task->padded_length = this->padded_length;
   task->request_cost = this->request_cost;
 
   return task;
@@ -313,6 +317,10 @@ Status BatchResourceBase::RegisterInput(
   if (batcher_queue_options_.enable_priority_queue) {
     batch_components->criticality = tsl::criticality::GetCriticality();
   }
+  if (context->deadline().has_value()) {
+    batch_components->deadline_time_micros =
+        absl::ToUnixMicros(*context->deadline());
+  }
 
   OpInputList tensors;
   TF_RETURN_IF_ERROR(context->input_list("in_tensors", &tensors));
@@ -399,8 +407,16 @@ Status BatchResourceBase::RegisterInput(
   }
 
   BatcherQueueT* batcher_queue;
-  TF_RETURN_IF_ERROR(
-      LookupOrCreateBatcherQueue(batcher_queue_name, &batcher_queue));
+  if (length_bucketing_options_.ragged_dim >= 0) {
+    TF_RETURN_IF_ERROR(PadToLengthBucket(batch_components.get()));
+    TF_RETURN_IF_ERROR(LookupOrCreateBatcherQueue(
+        absl::StrCat(batcher_queue_name, "/length_",
+                     batch_components->padded_length),
+        &batcher_queue));
+  } else {
+    TF_RETURN_IF_ERROR(
+        LookupOrCreateBatcherQueue(batcher_queue_name, &batcher_queue));
+  }
 
   if (!session_metadata().name().empty()) {
     absl::MutexLock lock(&outstanding_batch_mu_);
@@ -733,6 +749,97 @@ Status BatchResourceBase::ConcatInputTensors(
   return OkStatus();
 }
 
+/*static*/ int64_t BatchResourceBase::GetLengthBucket(
+    const std::vector<int32>& allowed_lengths, int64_t length) {
+  for (int32 allowed_length : allowed_lengths) {
+    if (allowed_length >= length) {
+      return allowed_length;
+    }
+  }
+  return -1;
+}
+
+/*static*/ Status BatchResourceBase::PadOrTrimDimension(const Tensor& input,
+                                                        int dim,
+                                                        int64_t length,
+                                                        Tensor* output) {
+  if (dim < 0 || dim >= input.dims()) {
+    return errors::InvalidArgument("Cannot resize dimension ", dim,
+                                   " of a tensor of shape ",
+                                   input.shape().DebugString());
+  }
+  if (!DataTypeCanUseMemcpy(input.dtype())) {
+    return errors::InvalidArgument("Cannot pad tensors of type ",
+                                   DataTypeString(input.dtype()));
+  }
+  TensorShape output_shape = input.shape();
+  output_shape.set_dim(dim, length);
+  *output = Tensor(input.dtype(), output_shape);
+  if (output->NumElements() == 0) {
+    return OkStatus();
+  }
+
+  // View both tensors as [outer, length * inner] matrices and copy row by row.
+  int64_t num_rows = 1;
+  for (int i = 0; i < dim; ++i) {
+    num_rows *= input.dim_size(i);
+  }
+  int64_t inner_bytes = DataTypeSize(input.dtype());
+  for (int i = dim + 1; i < input.dims(); ++i) {
+    inner_bytes *= input.dim_size(i);
+  }
+  const int64_t input_row_bytes = input.dim_size(dim) * inner_bytes;
+  const int64_t output_row_bytes = length * inner_bytes;
+  const int64_t copy_bytes = std::min(input_row_bytes, output_row_bytes);
+  const char* src = input.tensor_data().data();
+  char* dst = const_cast<char*>(output->tensor_data().data());
+  for (int64_t row = 0; row < num_rows; ++row) {
+    if (copy_bytes > 0) {
+      std::memcpy(dst, src + row * input_row_bytes, copy_bytes);
+    }
+    std::memset(dst + copy_bytes, 0, output_row_bytes - copy_bytes);
+    dst += output_row_bytes;
+  }
+  return OkStatus();
+}
+
+Status BatchResourceBase::PadToLengthBucket(BatchTask* task) const {
+  const int dim = length_bucketing_options_.ragged_dim;
+  if (dim == 0) {
+    return errors::InvalidArgument(
+        "The ragged dimension of length bucketing can not be the batch "
+        "dimension 0");
+  }
+  for (const Tensor& input : task->inputs) {
+    if (input.dims() <= dim ||
+        input.dim_size(dim) != task->inputs[0].dim_size(dim)) {
+      return errors::InvalidArgument(
+          "With length bucketing, batching input tensors must have equal "
+          "sizes in dimension ",
+          dim, "; got a tensor of shape ", input.shape().DebugString());
+    }
+  }
+  task->length = task->inputs[0].dim_size(dim);
+  task->padded_length =
+      GetLengthBucket(length_bucketing_options_.allowed_lengths, task->length);
+  if (task->padded_length < 0) {
+    return errors::InvalidArgument(
+        "Batching input tensors have size ", task->length, " in dimension ",
+        dim, ", which exceeds the largest allowed length ",
+        length_bucketing_options_.allowed_lengths.back());
+  }
+  if (task->padded_length == task->length) {
+    return OkStatus();
+  }
+  for (Tensor& input : task->inputs) {
+    Tensor padded;
+    TF_RETURN_IF_ERROR(
+        PadOrTrimDimension(input, dim, task->padded_length, &padded));
+    input = std::move(padded);
+  }
+  return OkStatus();
+}
+
 Status BatchResourceBase::SplitOutputTensors(
     const std::vector<Tensor>& combined_outputs, BatchT* batch) const {
   DCHECK_GE(batch->num_tasks(), 1);
@@ -762,6 +869,9 @@ Status BatchResourceBase::SplitOutputTensors(
 
   // Split each element of `combined_outputs` according to task sizes
   // within the batch, and use this to populate context outputs.
+  const int ragged_dim = length_bucketing_options_.ragged_dim;
+  const std::vector<int32>& trimmed_outputs =
+      length_bucketing_options_.trimmed_outputs;
   for (int i = 0, iter_limit = combined_outputs.size(); i < iter_limit; ++i) {
     const Tensor& output_tensor = combined_outputs[i];
     if (output_tensor.shape().dims() == 0) {
@@ -774,6 +884,19 @@ Status BatchResourceBase::SplitOutputTensors(
           "Batched output tensor's 0th dimension does not equal the sum of "
           "the 0th dimension sizes of the input tensors");
     }
+    // All tasks of a batch come from the queue of one padded length.
+    const bool trim =
+        std::find(trimmed_outputs.begin(), trimmed_outputs.end(), i) !=
+        trimmed_outputs.end();
+    if (trim && (output_tensor.dims() <= ragged_dim ||
+                 output_tensor.dim_size(ragged_dim) !=
+                     batch->task(0).padded_length)) {
+      return errors::FailedPrecondition(
+          "Length-bucketed output ", i, " has shape ",
+          output_tensor.shape().DebugString(), ", whose dimension ",
+          ragged_dim, " is not the padded length ",
+          batch->task(0).padded_length);
+    }
 
     std::vector<Tensor> split_tensor;
     const Status split_status = tensor::Split(
@@ -794,6 +917,12 @@ Status BatchResourceBase::SplitOutputTensors(
     // Ignore a possible final split_tensors entry containing the padding.
     for (int j = 0; j < batch->num_tasks(); ++j) {
       BatchTask& task = *(batch->mutable_task(j));
+      if (trim && task.padded_length > task.length) {
+        Tensor trimmed;
+        TF_RETURN_IF_ERROR(PadOrTrimDimension(split_tensor[j], ragged_dim,
+                                              task.length, &trimmed));
+        split_tensor[j] = std::move(trimmed);
+      }
       if (task.is_partial) {
         std::vector<Tensor>& tensor_vector = (*task.output)[task.split_index];
         tensor_vector[i] = std::move(split_tensor[j]);
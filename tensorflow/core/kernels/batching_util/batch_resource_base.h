@@ -94,8 +94,19 @@ class BatchResourceBase : public ResourceBase {
 
     uint64 start_time;
 
+    // The deadline of the request in microseconds since the Unix epoch, or 0
+    // if it has none.
+    uint64 deadline_time_micros = 0;
+
+    // With length bucketing, the size of the inputs along the ragged dimension
+    // before and after padding. Both are 0 otherwise.
+    int64_t length = 0;
+    int64_t padded_length = 0;
+
     size_t size() const override { return inputs[0].shape().dim_size(0); }
 
+    uint64 deadline_micros() const override { return deadline_time_micros; }
+
     // Create a split task from this one. The caller needs to setup the inputs
     // of the new task
     std::unique_ptr<BatchTask> CreateSplitTask(
@@ -159,6 +170,36 @@ class BatchResourceBase : public ResourceBase {
 
   const SessionMetadata& session_metadata() const { return session_metadata_; }
 
+  // Options for batching tasks whose inputs have different sizes along one
+  // "ragged" dimension, e.g. the sequence length of [batch, length, ...]
+  // inputs, as long as all inputs of a task have the same size along it.
+  //
+  // Each task is zero-padded along the ragged dimension to the smallest allowed
+  // length that fits it, and is batched only with tasks padded to the same
+  // length, in a separate queue per length. Tasks longer than every allowed
+  // length are rejected. The outputs listed in `trimmed_outputs` are trimmed
+  // back to the task's length along the ragged dimension; other outputs are
+  // returned as computed.
+  struct LengthBucketingOptions {
+    // The ragged dimension of the batched inputs. Must be at least 1;
+    // bucketing is disabled if negative.
+    int ragged_dim = -1;
+
+    // The lengths tasks are padded to, in increasing order.
+    std::vector<int32> allowed_lengths;
+
+    // Indices of the outputs that have the padded length along the ragged
+    // dimension.
+    std::vector<int32> trimmed_outputs;
+  };
+
+  // Enables length bucketing. Must be called before any input is registered.
+  // BatchFunctionKernel calls it for the `length_bucketing_dim`,
+  // `allowed_lengths` and `length_bucketed_outputs` attrs.
+  void set_length_bucketing_options(LengthBucketingOptions options) {
+    length_bucketing_options_ = std::move(options);
+  }
+
   using CreateBatchTaskFn =
       std::function<StatusOr<std::unique_ptr<BatchTask>>()>;
 
@@ -241,6 +282,16 @@ class BatchResourceBase : public ResourceBase {
       std::vector<std::unique_ptr<CostMeasurement>>& batch_cost_measurements,
       int64_t processed_size, BatchT& batch);
 
+  // Returns the smallest entry in `allowed_lengths` that is greater than or
+  // equal to `length`, or -1 if there is none.
+  static int64_t GetLengthBucket(const std::vector<int32>& allowed_lengths,
+                                 int64_t length);
+
+  // Sets `output` to a copy of `input` whose dimension `dim` is resized to
+  // `length`, by truncating it or padding it with zeros.
+  static Status PadOrTrimDimension(const Tensor& input, int dim,
+                                   int64_t length, Tensor* output);
+
  private:
   // Implementation of calling the process batch function.
   virtual void ProcessFuncBatchImpl(
@@ -263,6 +314,9 @@ class BatchResourceBase : public ResourceBase {
   Status SplitOutputTensors(const std::vector<Tensor>& combined_outputs,
                             BatchT* batch) const;
 
+  // Pads the inputs of `task` along the ragged dimension to its length bucket.
+  Status PadToLengthBucket(BatchTask* task) const;
+
   void ProcessFuncBatch(std::unique_ptr<BatchT> batch) const;
 
   // Processes a batch of one or more BatchTask entries.
@@ -285,6 +339,8 @@ class BatchResourceBase : public ResourceBase {
 
   SessionMetadata session_metadata_;
 
+  LengthBucketingOptions length_bucketing_options_;
+
   absl::Mutex outstanding_batch_mu_;
   int num_outstanding_batched_items_ TF_GUARDED_BY(outstanding_batch_mu_) = 0;
 
@@ -29,7 +29,9 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/request_cost.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 
 namespace tensorflow {
 namespace serving {
@@ -241,6 +243,60 @@ TEST(SplitBatchCostsAndRecordMetricsTest, SplitOnlyNonZeroCostTypes) {
           /*processed_size=*/20, /*input_size=*/9, /*padding_size=*/10)));
 }
 
+TEST(LengthBucketingTest, GetLengthBucket) {
+  const std::vector<int32> allowed_lengths = {8, 16, 32};
+  EXPECT_EQ(BatchResourceBase::GetLengthBucket(allowed_lengths, 1), 8);
+  EXPECT_EQ(BatchResourceBase::GetLengthBucket(allowed_lengths, 8), 8);
+  EXPECT_EQ(BatchResourceBase::GetLengthBucket(allowed_lengths, 9), 16);
+  EXPECT_EQ(BatchResourceBase::GetLengthBucket(allowed_lengths, 32), 32);
+  // Longer tasks have no bucket.
+  EXPECT_EQ(BatchResourceBase::GetLengthBucket(allowed_lengths, 33), -1);
+  EXPECT_EQ(BatchResourceBase::GetLengthBucket({}, 5), -1);
+}
+
+TEST(LengthBucketingTest, PadDimension) {
+  Tensor input = test::AsTensor<int32>({1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12},
+                                       TensorShape({2, 3, 2}));
+  Tensor padded;
+  TF_ASSERT_OK(BatchResourceBase::PadOrTrimDimension(input, /*dim=*/1,
+                                                     /*length=*/4, &padded));
+  test::ExpectTensorEqual<int32>(
+      padded, test::AsTensor<int32>(
+                  {1, 2, 3, 4, 5, 6, 0, 0, 7, 8, 9, 10, 11, 12, 0, 0},
+                  TensorShape({2, 4, 2})));
+
+  Tensor trimmed;
+  TF_ASSERT_OK(BatchResourceBase::PadOrTrimDimension(padded, /*dim=*/1,
+                                                     /*length=*/3, &trimmed));
+  test::ExpectTensorEqual<int32>(trimmed, input);
+}
+
+TEST(LengthBucketingTest, TrimDimension) {
+  Tensor input =
+      test::AsTensor<float>({1, 2, 3, 4, 5, 6}, TensorShape({2, 3}));
+  Tensor trimmed;
+  TF_ASSERT_OK(BatchResourceBase::PadOrTrimDimension(input, /*dim=*/1,
+                                                     /*length=*/1, &trimmed));
+  test::ExpectTensorEqual<float>(
+      trimmed, test::AsTensor<float>({1, 4}, TensorShape({2, 1})));
+
+  Tensor empty;
+  TF_ASSERT_OK(BatchResourceBase::PadOrTrimDimension(input, /*dim=*/1,
+                                                     /*length=*/0, &empty));
+  EXPECT_EQ(empty.shape(), TensorShape({2, 0}));
+}
+
+TEST(LengthBucketingTest, PadDimensionInvalid) {
+  Tensor input(DT_FLOAT, TensorShape({2, 3}));
+  Tensor output;
+  EXPECT_FALSE(
+      BatchResourceBase::PadOrTrimDimension(input, /*dim=*/2, 4, &output).ok());
+  Tensor strings(DT_STRING, TensorShape({2, 3}));
+  EXPECT_FALSE(
+      BatchResourceBase::PadOrTrimDimension(strings, /*dim=*/1, 4, &output)
+          .ok());
+}
+
 }  // namespace
 }  // namespace serving
 }  // namespace tensorflow
@@ -64,6 +64,11 @@ class BatchTask {
   // Returns the size of the task, in terms of how much it contributes to the
   // size of a batch. (A batch's size is the sum of its task sizes.)
   virtual size_t size() const = 0;
+
+  // Returns the absolute time, in microseconds on the scheduler's clock, by
+  // which the task should be done, or 0 if the task has no deadline. Only
+  // used by schedulers that support deadline scheduling.
+  virtual uint64 deadline_micros() const { return 0; }
 };
 
 // A thread-safe collection of BatchTasks, to be executed together in some
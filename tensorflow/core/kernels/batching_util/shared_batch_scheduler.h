@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <stddef.h>
 
+#include <algorithm>
 #include <deque>
 #include <functional>
 #include <list>
@@ -97,6 +98,13 @@ namespace serving {
 // For bulk processing jobs and throughput-oriented benchmarks, you may want to
 // set the maximum queue size to a large value.
 //
+// Queues created with `enable_deadline_scheduling` are instead served
+// earliest-deadline-first: whenever a batch thread becomes available, it takes
+// the schedulable batch whose earliest task deadline (see
+// BatchTask::deadline_micros()) is soonest, across all such queues. The other
+// queues, and batches without deadlines, are served round-robin when no batch
+// with a deadline is schedulable.
+//
 // TODO(b/26539183): Support queue servicing policies other than round-robin.
 // E.g. let each queue specify a "share" (an int >= 1), so e.g. with queues A
 // and B having shares 1 and 2 respectively, the servicing pattern is ABBABB...
@@ -240,6 +248,18 @@ class SharedBatchScheduler
     PriorityQueueOptions high_priority_queue_options;
     // A subset of queue options for low priority input.
     PriorityQueueOptions low_priority_queue_options;
+
+    // If true, the open batch is also closed once the earliest deadline of its
+    // tasks, minus the estimated time to process a batch of its size, is
+    // reached, so that tail tasks don't miss their deadline waiting for the
+    // batch to fill up or time out. The estimate is a moving average of the
+    // duration of `process_batch_callback` for past batches of similar size.
+    // Batches of such queues are also scheduled earliest-deadline-first (see
+    // the class documentation above). Tasks without a deadline are batched as
+    // if this option were false.
+    //
+    // Must be false if `enable_lazy_split` is true.
+    bool enable_deadline_scheduling = false;
   };
   Status AddQueue(const QueueOptions& options,
                   std::function<void(std::unique_ptr<Batch<TaskType>>)>
@@ -293,6 +313,9 @@ class SharedBatchScheduler
   // Threads that process batches obtained from the queues.
   std::vector<std::unique_ptr<PeriodicFunction>> batch_threads_;
 
+  // The number of queues in 'queues_' with deadline scheduling enabled.
+  int num_deadline_queues_ TF_GUARDED_BY(mu_) = 0;
+
   SharedBatchScheduler(const SharedBatchScheduler&) = delete;
   void operator=(const SharedBatchScheduler&) = delete;
 };
@@ -377,6 +400,11 @@ class Queue {
   // Batches are guaranteed to form at task enqueue time.
   std::unique_ptr<Batch<TaskType>> ScheduleBatchWithEagerSplit();
 
+  // Returns the earliest task deadline of the batch that ScheduleBatch() would
+  // return at this time, or 0 if there is no such batch, it has no deadline,
+  // or deadline scheduling is disabled.
+  uint64 SchedulableBatchDeadlineMicros() const;
+
   // Processes a batch that has been returned earlier by ScheduleBatch().
   void ProcessBatch(std::unique_ptr<Batch<TaskType>> batch);
 
@@ -389,6 +417,10 @@ class Queue {
 
   bool closed() const TF_NO_THREAD_SAFETY_ANALYSIS { return closed_.load(); }
 
+  bool deadline_scheduling() const {
+    return options_.enable_deadline_scheduling;
+  }
+
  private:
   // Computes the max_execution_batch_size of the queue based on queue options.
   static size_t GetMaxExecutionBatchSize(
@@ -444,6 +476,20 @@ class Queue {
   // Returns the number of enqueued batches.
   int64 num_enqueued_batches() const TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Returns the index into 'processing_micros_by_size_' for batches of
+  // `batch_size`.
+  static int ProcessingTimeBucket(size_t batch_size);
+
+  // Returns the estimated time to process a batch of `batch_size`, or 0 if no
+  // batch of at most that size has been processed yet.
+  uint64 EstimatedProcessingMicros(size_t batch_size) const
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Updates the processing time estimate with a batch of `batch_size` that
+  // took `micros` to process.
+  void RecordProcessingMicros(size_t batch_size, uint64 micros)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   // Gets the appropriate batches.
   std::deque<std::unique_ptr<Batch<TaskType>>>& GetBatches()
       TF_EXCLUSIVE_LOCKS_REQUIRED(mu_);
@@ -510,6 +556,16 @@ class Queue {
   // task.
   uint64 open_batch_start_time_micros_ TF_GUARDED_BY(mu_);
 
+  // The earliest deadline of the tasks in the open batch in
+  // 'high_priority_batches_', or 0 if none has a deadline. Used iff
+  // `QueueOptions.enable_deadline_scheduling` is true.
+  uint64 open_batch_deadline_micros_ TF_GUARDED_BY(mu_) = 0;
+
+  // Moving averages of the time to process a batch, indexed by
+  // ProcessingTimeBucket() of the batch size. 0 for buckets without
+  // samples. Used iff `QueueOptions.enable_deadline_scheduling` is true.
+  std::vector<uint64> processing_micros_by_size_ TF_GUARDED_BY(mu_);
+
   // Whether this queue contains a batch that is eligible to be scheduled.
   // Used to keep track of when to call 'schedulable_batch_callback_'.
   bool schedulable_batch_ TF_GUARDED_BY(mu_) = false;
@@ -646,6 +702,11 @@ Status SharedBatchScheduler<TaskType>::AddQueueAfterRewritingOptions(
         "enable_large_batch_splitting is enabled.");
   }
 
+  if (options.enable_deadline_scheduling && options.enable_lazy_split) {
+    return errors::InvalidArgument(
+        "enable_deadline_scheduling is not supported with enable_lazy_split.");
+  }
+
   if (options.enable_large_batch_splitting &&
       (options.input_batch_size_limit < options.max_execution_batch_size)) {
     return errors::InvalidArgument(
@@ -670,6 +731,9 @@ Status SharedBatchScheduler<TaskType>::AddQueueAfterRewritingOptions(
   {
     mutex_lock l(mu_);
     queues_.push_back(std::move(internal_queue));
+    if (options.enable_deadline_scheduling) {
+      ++num_deadline_queues_;
+    }
     if (next_queue_to_schedule_ == queues_.end()) {
       next_queue_to_schedule_ = queues_.begin();
     }
@@ -708,6 +772,30 @@ void SharedBatchScheduler<TaskType>::GetNextWorkItem_Locked(
     BatchUniquePtr* batch_to_process_out) {
   BatchUniquePtr batch_to_process;
   internal::Queue<TaskType>* queue_for_batch = nullptr;
+
+  // Serve the schedulable batch with the earliest deadline first.
+  if (num_deadline_queues_ > 0) {
+    uint64 earliest_deadline_micros = 0;
+    for (const auto& queue : queues_) {
+      if (!queue->deadline_scheduling()) continue;
+      const uint64 deadline_micros = queue->SchedulableBatchDeadlineMicros();
+      if (deadline_micros > 0 && (queue_for_batch == nullptr ||
+                                  deadline_micros < earliest_deadline_micros)) {
+        queue_for_batch = queue.get();
+        earliest_deadline_micros = deadline_micros;
+      }
+    }
+    if (queue_for_batch != nullptr) {
+      batch_to_process = queue_for_batch->ScheduleBatch();
+      if (BatchExists(batch_to_process)) {
+        *queue_for_batch_out = queue_for_batch;
+        *batch_to_process_out = std::move(batch_to_process);
+        return;
+      }
+      queue_for_batch = nullptr;
+    }
+  }
+
   const int num_queues = queues_.size();
   for (int num_queues_tried = 0;
        !BatchExists(batch_to_process) && num_queues_tried < num_queues;
@@ -732,6 +820,9 @@ void SharedBatchScheduler<TaskType>::GetNextWorkItem_Locked(
         !BatchExists(batch_to_process)) {
       // We've encountered a closed queue with no work to do. Drop it.
       DCHECK_NE(queue_for_batch, next_queue_to_schedule_->get());
+      if ((*next_queue_to_schedule_)->deadline_scheduling()) {
+        --num_deadline_queues_;
+      }
       next_queue_to_schedule_ = queues_.erase(next_queue_to_schedule_);
     } else {
       ++next_queue_to_schedule_;
@@ -966,6 +1057,14 @@ Status Queue<TaskType>::ScheduleWithoutOrEagerSplit(
           },
           profiler::ContextType::kSharedBatchScheduler,
           batches.back()->traceme_context_id());
+      if (options_.enable_deadline_scheduling) {
+        const uint64 deadline_micros = output_tasks[i]->deadline_micros();
+        if (deadline_micros > 0 &&
+            (open_batch_deadline_micros_ == 0 ||
+             deadline_micros < open_batch_deadline_micros_)) {
+          open_batch_deadline_micros_ = deadline_micros;
+        }
+      }
       batches.back()->AddTask(std::move(output_tasks[i]));
     }
 
@@ -1091,6 +1190,28 @@ Queue<TaskType>::ScheduleBatchWithEagerSplit() {
   return batch_to_schedule;
 }
 
+template <typename TaskType>
+uint64 Queue<TaskType>::SchedulableBatchDeadlineMicros() const {
+  if (!options_.enable_deadline_scheduling) {
+    return 0;
+  }
+  mutex_lock l(mu_);
+  const std::deque<std::unique_ptr<Batch<TaskType>>>& batches = GetBatches();
+  if (batches.size() == 1) {
+    return IsOpenBatchSchedulable() ? open_batch_deadline_micros_ : 0;
+  }
+  const Batch<TaskType>& batch = *batches.front();
+  uint64 earliest_deadline_micros = 0;
+  for (int i = 0; i < batch.num_tasks(); ++i) {
+    const uint64 deadline_micros = batch.task(i).deadline_micros();
+    if (deadline_micros > 0 && (earliest_deadline_micros == 0 ||
+                                deadline_micros < earliest_deadline_micros)) {
+      earliest_deadline_micros = deadline_micros;
+    }
+  }
+  return earliest_deadline_micros;
+}
+
 template <typename TaskType>
 typename SharedBatchScheduler<TaskType>::BatchUniquePtr
 Queue<TaskType>::ScheduleBatch() {
@@ -1133,10 +1254,17 @@ void Queue<TaskType>::ProcessBatch(std::unique_ptr<Batch<TaskType>> batch) {
       },
       profiler::ContextType::kSharedBatchScheduler,
       batch->traceme_context_id());
+  const size_t batch_size = batch->size();
+  const uint64 start_time_micros =
+      options_.enable_deadline_scheduling ? env_->NowMicros() : 0;
   process_batch_callback_(std::move(batch));
 
   {
     mutex_lock l(mu_);
+    if (options_.enable_deadline_scheduling) {
+      RecordProcessingMicros(batch_size,
+                             env_->NowMicros() - start_time_micros);
+    }
     --num_batches_being_processed_;
     if (empty_notification_ != nullptr && IsEmptyInternal()) {
       empty_notification_->Notify();
@@ -1189,6 +1317,7 @@ void Queue<TaskType>::StartNewBatch() {
   std::deque<std::unique_ptr<Batch<TaskType>>>& batches = GetBatches();
   batches.back()->Close();
   batches.emplace_back(new Batch<TaskType>(++traceme_context_id_counter_));
+  open_batch_deadline_micros_ = 0;
 }
 
 template <typename TaskType>
@@ -1208,9 +1337,19 @@ bool Queue<TaskType>::IsOpenBatchSchedulableAfterEagerSplit() const {
   if (open_batch->empty()) {
     return false;
   }
-  return closed_ || open_batch->size() >= max_execution_batch_size() ||
-         env_->NowMicros() >=
-             open_batch_start_time_micros_ + options_.batch_timeout_micros;
+  if (closed_ || open_batch->size() >= max_execution_batch_size()) {
+    return true;
+  }
+  const uint64 now_micros = env_->NowMicros();
+  if (now_micros >=
+      open_batch_start_time_micros_ + options_.batch_timeout_micros) {
+    return true;
+  }
+  // Close the batch early if waiting any longer would make its most urgent
+  // task miss its deadline.
+  return open_batch_deadline_micros_ > 0 &&
+         now_micros + EstimatedProcessingMicros(open_batch->size()) >=
+             open_batch_deadline_micros_;
 }
 
 template <typename TaskType>
@@ -1245,6 +1384,45 @@ int64 Queue<TaskType>::num_enqueued_batches() const {
   return GetBatches().size();
 }
 
+template <typename TaskType>
+int Queue<TaskType>::ProcessingTimeBucket(size_t batch_size) {
+  // Batch sizes are bucketed by powers of two.
+  int bucket = 0;
+  while ((size_t{1} << bucket) < batch_size) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+template <typename TaskType>
+uint64 Queue<TaskType>::EstimatedProcessingMicros(size_t batch_size) const {
+  // Until a batch of this size is processed, assume it takes as long as the
+  // largest smaller batch.
+  for (int bucket =
+           std::min(ProcessingTimeBucket(batch_size),
+                    static_cast<int>(processing_micros_by_size_.size()) - 1);
+       bucket >= 0; --bucket) {
+    if (processing_micros_by_size_[bucket] > 0) {
+      return processing_micros_by_size_[bucket];
+    }
+  }
+  return 0;
+}
+
+template <typename TaskType>
+void Queue<TaskType>::RecordProcessingMicros(size_t batch_size,
+                                             uint64 micros) {
+  const int bucket = ProcessingTimeBucket(batch_size);
+  if (bucket >= processing_micros_by_size_.size()) {
+    processing_micros_by_size_.resize(bucket + 1, 0);
+  }
+  uint64& estimate = processing_micros_by_size_[bucket];
+  micros = std::max<uint64>(micros, 1);
+  // An exponential moving average, which follows changes in processing time
+  // within a few batches.
+  estimate = estimate == 0 ? micros : (3 * estimate + micros) / 4;
+}
+
 template <typename TaskType>
 std::deque<std::unique_ptr<Batch<TaskType>>>& Queue<TaskType>::GetBatches() {
   return high_priority_batches_;
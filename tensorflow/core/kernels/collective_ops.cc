@@ -775,6 +775,13 @@ class CollectiveReduceV2OpKernel : public CollectiveOpV2Kernel {
     OP_REQUIRES_OK(c, c->GetAttr("final_op", &final_op_name));
     OP_REQUIRES_OK(
         c, c->GetAttr("max_subdivs_per_device", &max_subdivs_per_device_));
+    OP_REQUIRES_OK(
+        c, c->GetAttr("pipeline_piece_bytes", &pipeline_piece_bytes_));
+    string wire_data_type;
+    OP_REQUIRES_OK(c, c->GetAttr("wire_data_type", &wire_data_type));
+    if (wire_data_type == "bfloat16") {
+      wire_data_type_ = DT_BFLOAT16;
+    }
     // Prepare OpKernels for reduction and final operations.
     // The merge_op takes two inputs
     NodeDef sub_node;
@@ -805,6 +812,9 @@ class CollectiveReduceV2OpKernel : public CollectiveOpV2Kernel {
         done_with_cleanup);
     col_params->instance.impl_details.max_subdivs_per_device =
         max_subdivs_per_device_;
+    col_params->instance.impl_details.pipeline_piece_bytes =
+        pipeline_piece_bytes_;
+    col_params->instance.impl_details.wire_data_type = wire_data_type_;
     col_params->instance.shape = c->input(0).shape();
     col_params->merge_op = merge_op_.get();
     col_params->final_op = final_op_.get();
@@ -825,6 +835,8 @@ class CollectiveReduceV2OpKernel : public CollectiveOpV2Kernel {
 
  private:
   int max_subdivs_per_device_;
+  int64_t pipeline_piece_bytes_;
+  DataType wire_data_type_ = DT_INVALID;
   std::unique_ptr<OpKernel> merge_op_;
   std::unique_ptr<OpKernel> final_op_;
 };
@@ -0,0 +1,194 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/csv_tokenizer.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <cstring>
+
+#include "absl/numeric/bits.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/raw_coding.h"
+
+namespace tensorflow {
+namespace csv {
+namespace {
+
+#if !defined(__SSE2__)
+// Returns a word with the high bit set in the lowest byte of `word` that is
+// zero. Higher bytes may be falsely flagged, but never lower ones.
+inline uint64 ZeroBytes(uint64 word) {
+  return (word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL;
+}
+
+inline uint64 Broadcast(char c) {
+  return 0x0101010101010101ULL * static_cast<uint8>(c);
+}
+#endif
+
+// The longest decimals that are parsed without strings::safe_strto*. They fit
+// in a uint64 and are much shorter than what safe_strtof and safe_strtod
+// reject as too long.
+constexpr int kMaxFastDigits = 19;
+
+// A field of the form -?[0-9]+(\.[0-9]+)? with at most kMaxFastDigits digits.
+struct PlainDecimal {
+  bool negative = false;
+  uint64 digits = 0;
+  int num_digits = 0;
+  int num_fraction_digits = 0;
+};
+
+// Returns true and fills `*decimal` if `field` is a plain decimal.
+bool ParsePlainDecimal(StringPiece field, PlainDecimal* decimal) {
+  const char* p = field.data();
+  const char* const end = p + field.size();
+  if (p != end && *p == '-') {
+    decimal->negative = true;
+    ++p;
+  }
+  const char* const integer_begin = p;
+  for (; p != end && static_cast<uint8>(*p - '0') < 10; ++p) {
+    decimal->digits = decimal->digits * 10 + (*p - '0');
+    if (++decimal->num_digits > kMaxFastDigits) return false;
+  }
+  if (p == integer_begin) return false;
+  if (p != end && *p == '.') {
+    const char* const fraction_begin = ++p;
+    for (; p != end && static_cast<uint8>(*p - '0') < 10; ++p) {
+      decimal->digits = decimal->digits * 10 + (*p - '0');
+      if (++decimal->num_digits > kMaxFastDigits) return false;
+    }
+    if (p == fraction_begin) return false;
+    decimal->num_fraction_digits = p - fraction_begin;
+  }
+  return p == end;
+}
+
+// Powers of ten that are exactly representable in each type.
+constexpr float kFloatPowersOfTen[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f,
+                                       1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+constexpr double kDoublePowersOfTen[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+}  // namespace
+
+size_t FindUnquotedFieldEnd(StringPiece data, size_t pos, char delim,
+                            bool use_quote_delim) {
+  const char* const begin = data.data();
+  const size_t size = data.size();
+  // Without quote handling, quotes are looked for as a second delimiter.
+  const char quote = use_quote_delim ? '"' : delim;
+#if defined(__SSE2__)
+  const __m128i delims = _mm_set1_epi8(delim);
+  const __m128i quotes = _mm_set1_epi8(quote);
+  const __m128i newlines = _mm_set1_epi8('\n');
+  const __m128i returns = _mm_set1_epi8('\r');
+  for (; size - pos >= 16; pos += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + pos));
+    const __m128i matches =
+        _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, delims),
+                                  _mm_cmpeq_epi8(bytes, quotes)),
+                     _mm_or_si128(_mm_cmpeq_epi8(bytes, newlines),
+                                  _mm_cmpeq_epi8(bytes, returns)));
+    const uint32 mask = _mm_movemask_epi8(matches);
+    if (mask != 0) return pos + absl::countr_zero(mask);
+  }
+#else
+  const uint64 delims = Broadcast(delim);
+  const uint64 quotes = Broadcast(quote);
+  const uint64 newlines = Broadcast('\n');
+  const uint64 returns = Broadcast('\r');
+  for (; size - pos >= 8; pos += 8) {
+    const uint64 word = core::DecodeFixed64(begin + pos);
+    const uint64 matches = ZeroBytes(word ^ delims) | ZeroBytes(word ^ quotes) |
+                           ZeroBytes(word ^ newlines) |
+                           ZeroBytes(word ^ returns);
+    if (matches != 0) return pos + (absl::countr_zero(matches) >> 3);
+  }
+#endif
+  for (; pos < size; ++pos) {
+    const char c = begin[pos];
+    if (c == delim || c == quote || c == '\n' || c == '\r') return pos;
+  }
+  return size;
+}
+
+size_t FindQuote(StringPiece data, size_t pos) {
+  if (pos >= data.size()) return data.size();
+  const void* quote = std::memchr(data.data() + pos, '"', data.size() - pos);
+  return quote == nullptr ? data.size()
+                          : static_cast<const char*>(quote) - data.data();
+}
+
+bool ParseNumber(StringPiece field, int32* value) {
+  PlainDecimal decimal;
+  // Nine digits always fit in an int32.
+  if (ParsePlainDecimal(field, &decimal) && decimal.num_digits <= 9 &&
+      decimal.num_fraction_digits == 0) {
+    const int32 magnitude = static_cast<int32>(decimal.digits);
+    *value = decimal.negative ? -magnitude : magnitude;
+    return true;
+  }
+  return strings::safe_strto32(field, value);
+}
+
+bool ParseNumber(StringPiece field, int64_t* value) {
+  PlainDecimal decimal;
+  // Eighteen digits always fit in an int64.
+  if (ParsePlainDecimal(field, &decimal) && decimal.num_digits <= 18 &&
+      decimal.num_fraction_digits == 0) {
+    const int64_t magnitude = static_cast<int64_t>(decimal.digits);
+    *value = decimal.negative ? -magnitude : magnitude;
+    return true;
+  }
+  return strings::safe_strto64(field, value);
+}
+
+// When both the digits and the power of ten are exact in the floating-point
+// type, a single division is correctly rounded, and so gives the same result
+// as the general conversion.
+
+bool ParseNumber(StringPiece field, float* value) {
+  PlainDecimal decimal;
+  if (ParsePlainDecimal(field, &decimal) && decimal.digits <= (1 << 24) &&
+      decimal.num_fraction_digits <= 10) {
+    const float magnitude = static_cast<float>(decimal.digits) /
+                            kFloatPowersOfTen[decimal.num_fraction_digits];
+    *value = decimal.negative ? -magnitude : magnitude;
+    return true;
+  }
+  return strings::safe_strtof(field, value);
+}
+
+bool ParseNumber(StringPiece field, double* value) {
+  PlainDecimal decimal;
+  if (ParsePlainDecimal(field, &decimal) && decimal.digits <= (1ULL << 53) &&
+      decimal.num_fraction_digits <= 22) {
+    const double magnitude = static_cast<double>(decimal.digits) /
+                             kDoublePowersOfTen[decimal.num_fraction_digits];
+    *value = decimal.negative ? -magnitude : magnitude;
+    return true;
+  }
+  return strings::safe_strtod(field, value);
+}
+
+}  // namespace csv
+}  // namespace tensorflow
@@ -0,0 +1,56 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_CORE_KERNELS_CSV_TOKENIZER_H_
+#define TENSORFLOW_CORE_KERNELS_CSV_TOKENIZER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/core/platform/stringpiece.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace csv {
+
+// Scanning and number parsing shared by the DecodeCSV op and CsvDataset.
+//
+// Fields are located by skipping over whole runs of ordinary bytes, 16 at a
+// time with SSE2, rather than by testing each byte against every special
+// character, and fields are parsed in place in the input buffer.
+
+// Returns the position of the first byte of `data` at or after `pos` that ends
+// or invalidates an unquoted field: `delim`, '\n', '\r' or, if
+// `use_quote_delim` is set, '"'. Returns `data.size()` if there is none.
+size_t FindUnquotedFieldEnd(StringPiece data, size_t pos, char delim,
+                            bool use_quote_delim);
+
+// Returns the position of the first '"' of `data` at or after `pos`, or
+// `data.size()` if there is none.
+size_t FindQuote(StringPiece data, size_t pos);
+
+// Parses a numeric field into `*value`. These accept exactly what
+// strings::safe_strto32, safe_strto64, safe_strtof and safe_strtod accept, and
+// return the same values, but parse plain decimals like "-12.375" without
+// going through the general conversion.
+bool ParseNumber(StringPiece field, int32* value);
+bool ParseNumber(StringPiece field, int64_t* value);
+bool ParseNumber(StringPiece field, float* value);
+bool ParseNumber(StringPiece field, double* value);
+
+}  // namespace csv
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_CORE_KERNELS_CSV_TOKENIZER_H_
@@ -0,0 +1,213 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/csv_tokenizer.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace csv {
+namespace {
+
+TEST(CsvTokenizerTest, FindUnquotedFieldEnd) {
+  // Long enough to cover both the vectorized loop and the tail.
+  const string padding(37, 'a');
+  for (const char end : {',', '\n', '\r', '"'}) {
+    const string data = strings::StrCat(padding, string(1, end), padding);
+    EXPECT_EQ(FindUnquotedFieldEnd(data, 0, ',', true), padding.size());
+    EXPECT_EQ(FindUnquotedFieldEnd(data, 5, ',', true), padding.size());
+    EXPECT_EQ(FindUnquotedFieldEnd(data, padding.size() + 1, ',', true),
+              data.size());
+  }
+  const string quoted = strings::StrCat(padding, "\"", padding, ";");
+  EXPECT_EQ(FindUnquotedFieldEnd(quoted, 0, ';', false), quoted.size() - 1);
+  EXPECT_EQ(FindUnquotedFieldEnd(quoted, 0, ',', false), quoted.size());
+  EXPECT_EQ(FindUnquotedFieldEnd("", 0, ',', true), 0);
+}
+
+TEST(CsvTokenizerTest, FindQuote) {
+  const string data = strings::StrCat(string(20, 'a'), "\"b\"");
+  EXPECT_EQ(FindQuote(data, 0), 20);
+  EXPECT_EQ(FindQuote(data, 21), 22);
+  EXPECT_EQ(FindQuote(data, 23), data.size());
+  EXPECT_EQ(FindQuote(data, data.size()), data.size());
+}
+
+// The fast paths must agree with strings::safe_strto*, on both the inputs they
+// handle and the ones they leave to it.
+TEST(CsvTokenizerTest, ParseNumberMatchesSafeStrto) {
+  const std::vector<string> fields = {"0",
+                                      "-0",
+                                      "7",
+                                      "-123",
+                                      "2147483647",
+                                      "-2147483648",
+                                      "2147483648",
+                                      "123456789012345678",
+                                      "9223372036854775807",
+                                      "-9223372036854775809",
+                                      "99999999999999999999",
+                                      "1.5",
+                                      "-12.375",
+                                      "0.1",
+                                      "3.14159265358979",
+                                      "16777217",
+                                      "0.0000000001",
+                                      "1e5",
+                                      "1.",
+                                      ".5",
+                                      "+3",
+                                      " 7",
+                                      "7 ",
+                                      "0x1F",
+                                      "inf",
+                                      "nan",
+                                      "1,5",
+                                      "-",
+                                      ""};
+  for (const string& field : fields) {
+    int32 i32, expected_i32;
+    const bool i32_ok = strings::safe_strto32(field, &expected_i32);
+    EXPECT_EQ(ParseNumber(field, &i32), i32_ok) << field;
+    if (i32_ok) EXPECT_EQ(i32, expected_i32) << field;
+
+    int64_t i64, expected_i64;
+    const bool i64_ok = strings::safe_strto64(field, &expected_i64);
+    EXPECT_EQ(ParseNumber(field, &i64), i64_ok) << field;
+    if (i64_ok) EXPECT_EQ(i64, expected_i64) << field;
+
+    float f, expected_f;
+    const bool f_ok = strings::safe_strtof(field, &expected_f);
+    EXPECT_EQ(ParseNumber(field, &f), f_ok) << field;
+    if (f_ok) EXPECT_EQ(std::memcmp(&f, &expected_f, sizeof(f)), 0) << field;
+
+    double d, expected_d;
+    const bool d_ok = strings::safe_strtod(field, &expected_d);
+    EXPECT_EQ(ParseNumber(field, &d), d_ok) << field;
+    if (d_ok) EXPECT_EQ(std::memcmp(&d, &expected_d, sizeof(d)), 0) << field;
+  }
+}
+
+TEST(CsvTokenizerTest, ParseNumberRandomDecimals) {
+  random::PhiloxRandom philox(17);
+  random::SimplePhilox rnd(&philox);
+  for (int i = 0; i < 100000; ++i) {
+    string field = rnd.OneIn(2) ? "-" : "";
+    for (int d = rnd.Uniform(12); d >= 0; --d) field += '0' + rnd.Uniform(10);
+    if (rnd.OneIn(2)) {
+      field += '.';
+      for (int d = rnd.Uniform(12); d >= 0; --d) field += '0' + rnd.Uniform(10);
+    }
+    float f, expected_f;
+    ASSERT_TRUE(ParseNumber(field, &f)) << field;
+    ASSERT_TRUE(strings::safe_strtof(field, &expected_f)) << field;
+    ASSERT_EQ(std::memcmp(&f, &expected_f, sizeof(f)), 0) << field;
+    double d, expected_d;
+    ASSERT_TRUE(ParseNumber(field, &d)) << field;
+    ASSERT_TRUE(strings::safe_strtod(field, &expected_d)) << field;
+    ASSERT_EQ(std::memcmp(&d, &expected_d, sizeof(d)), 0) << field;
+  }
+}
+
+constexpr int kNumRecords = 1024;
+
+// Returns the field of column `col` of a record. Numeric CSVs only have float
+// columns; mixed ones cycle through int64, float, string, quoted string with
+// escaped quotes and double columns.
+string MakeField(random::SimplePhilox* rnd, int col, bool mixed) {
+  switch (mixed ? col % 5 : 1) {
+    case 0:
+      return strings::StrCat(rnd->Uniform64(1000000000));
+    case 1:
+      return strings::StrCat(rnd->Uniform(100000) / 1000.0f - 50.0f);
+    case 2:
+      return string(1 + rnd->Uniform(16), 'a' + rnd->Uniform(26));
+    case 3:
+      return strings::StrCat("\"", string(rnd->Uniform(16), 'x'),
+                             ", \"\"y\"\"\"");
+    default:
+      return strings::StrCat(rnd->Uniform(100000) / 1000.0 - 50.0);
+  }
+}
+
+DataType ColumnType(int col, bool mixed) {
+  static constexpr DataType kMixedTypes[] = {DT_INT64, DT_FLOAT, DT_STRING,
+                                             DT_STRING, DT_DOUBLE};
+  return mixed ? kMixedTypes[col % 5] : DT_FLOAT;
+}
+
+// Returns a DecodeCSV graph over kNumRecords records of `num_cols` columns,
+// and sets `*num_bytes` to their total size.
+Graph* DecodeCSV(int num_cols, bool mixed, int64_t* num_bytes) {
+  random::PhiloxRandom philox(301);
+  random::SimplePhilox rnd(&philox);
+  Tensor records(DT_STRING, TensorShape({kNumRecords}));
+  *num_bytes = 0;
+  for (int i = 0; i < kNumRecords; ++i) {
+    string record;
+    for (int col = 0; col < num_cols; ++col) {
+      if (col > 0) record += ',';
+      record += MakeField(&rnd, col, mixed);
+    }
+    *num_bytes += record.size();
+    records.vec<tstring>()(i) = record;
+  }
+
+  Graph* g = new Graph(OpRegistry::Global());
+  std::vector<NodeBuilder::NodeOut> record_defaults;
+  for (int col = 0; col < num_cols; ++col) {
+    record_defaults.emplace_back(test::graph::Constant(
+        g, Tensor(ColumnType(col, mixed), TensorShape({0}))));
+  }
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DecodeCSV")
+                  .Input(test::graph::Constant(g, records))
+                  .Input(record_defaults)
+                  .Finalize(g, &ret));
+  return g;
+}
+
+void BM_DecodeCSV(::testing::benchmark::State& state) {
+  const int num_cols = state.range(0);
+  const bool mixed = state.range(1);
+  int64_t num_bytes;
+  test::Benchmark("cpu", DecodeCSV(num_cols, mixed, &num_bytes),
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetBytesProcessed(state.iterations() * num_bytes);
+}
+
+BENCHMARK(BM_DecodeCSV)
+    ->UseRealTime()
+    ->ArgPair(16, false)
+    ->ArgPair(256, false)
+    ->ArgPair(16, true)
+    ->ArgPair(256, true);
+
+}  // namespace
+}  // namespace csv
+}  // namespace tensorflow
@@ -17,6 +17,7 @@ limitations under the License.
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <string>
 #include <utility>
@@ -50,6 +51,8 @@ namespace data {
 /* static */ constexpr const char* const CacheDatasetOp::kFileName;
 /* static */ constexpr const char* const CacheDatasetOp::kOutputTypes;
 /* static */ constexpr const char* const CacheDatasetOp::kOutputShapes;
+/* static */ constexpr const char* const CacheDatasetOp::kMemoryBudgetBytes;
+/* static */ constexpr const char* const CacheDatasetOp::kSpillDirectory;
 
 namespace {
 
@@ -66,6 +69,7 @@ constexpr char kMemoryDatasetPrefix[] = "Memory";
 constexpr char kMemoryCache[] = "MemoryCache";
 constexpr char kCacheCompleted[] = "cache_completed";
 constexpr char kIndex[] = "index";
+constexpr char kTFDataCachePrefetch[] = "tf_data_cache_prefetch";
 constexpr char kImpl[] = "Impl";
 constexpr char kCacheDataset[] = "CacheDataset";
 constexpr char kIncompleteCacheErrorMessage[] =
@@ -74,6 +78,38 @@ constexpr char kIncompleteCacheErrorMessage[] =
     "contents of the dataset  will be discarded. This can happen if you have "
     "an input pipeline similar to `dataset.cache().take(k).repeat()`. You "
     "should use `dataset.take(k).cache().repeat()` instead.";
+
+// Writes the elements of `cache`, which is either a `MemoryCache` or a
+// `MemoryCacheBuilder`, to the checkpoint one at a time, so that spilled
+// elements are never all read back into memory at once.
+template <typename Cache>
+Status WriteCacheToCheckpoint(IteratorStateWriter* writer,
+                              const string& key_prefix, Cache* cache) {
+  TF_RETURN_IF_ERROR(
+      WriteNumElementsToCheckpoint(writer, key_prefix, cache->size()));
+  int64_t index = 0;
+  return cache->ForEachElement([&](const std::vector<Tensor>& element) {
+    return WriteElementToCheckpoint(writer, key_prefix, index++, element);
+  });
+}
+
+// Adds the elements in the checkpoint to `builder` one at a time, so that the
+// restored elements are subject to its memory budget.
+Status ReadCacheFromCheckpoint(IteratorContext* ctx,
+                               IteratorStateReader* reader,
+                               const string& key_prefix,
+                               MemoryCacheBuilder* builder) {
+  int64_t num_elements;
+  TF_RETURN_IF_ERROR(
+      ReadNumElementsFromCheckpoint(reader, key_prefix, &num_elements));
+  for (int64_t i = 0; i < num_elements; ++i) {
+    std::vector<Tensor> element;
+    TF_RETURN_IF_ERROR(
+        ReadElementFromCheckpoint(ctx, reader, key_prefix, i, &element));
+    TF_RETURN_IF_ERROR(builder->Add(std::move(element)));
+  }
+  return OkStatus();
+}
 }  // namespace
 
 class PartialCache {
@@ -730,10 +766,12 @@ class CacheDatasetOp::FileDatasetV2 : public CacheDatasetOp::FileDatasetBase {
 class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
  public:
   explicit MemoryDatasetBase(OpKernelContext* ctx, const DatasetBase* input,
-                             std::shared_ptr<MemoryCache> cache)
+                             std::shared_ptr<MemoryCache> cache,
+                             const MemoryCacheBuilder::Options& cache_options)
       : DatasetBase(DatasetContext(ctx)),
         input_(input),
-        cache_(std::move(cache)) {
+        cache_(std::move(cache)),
+        cache_options_(cache_options) {
     input_->Ref();
   }
 
@@ -796,6 +834,18 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
   }
 
  protected:
+  // Returns the attrs that recreate the memory budget and spill directory of
+  // the cache when the dataset is serialized.
+  std::vector<std::pair<StringPiece, AttrValue>> CacheOptionsAttrs(
+      DatasetGraphDefBuilder* b) const {
+    AttrValue memory_budget_bytes;
+    b->BuildAttrValue(cache_options_.memory_budget_bytes, &memory_budget_bytes);
+    AttrValue spill_directory;
+    b->BuildAttrValue(cache_options_.spill_directory, &spill_directory);
+    return {{kMemoryBudgetBytes, memory_budget_bytes},
+            {kSpillDirectory, spill_directory}};
+  }
+
   class MemoryIterator : public DatasetIterator<MemoryDatasetBase> {
    public:
     explicit MemoryIterator(const Params& params, MemoryCache* cache)
@@ -825,8 +875,7 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
       mutex_lock l(mu_);
       if (cache_->IsCompleted()) {
         TF_RETURN_IF_ERROR(writer->WriteScalar(prefix(), kCacheCompleted, ""));
-        TF_RETURN_IF_ERROR(
-            WriteElementsToCheckpoint(writer, prefix(), cache_->data()));
+        TF_RETURN_IF_ERROR(WriteCacheToCheckpoint(writer, prefix(), cache_));
       }
       return SaveInput(ctx, writer, iterator_);
     }
@@ -837,10 +886,10 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
       iterator_.reset();
       cache_->Reset();
       if (reader->Contains(prefix(), kCacheCompleted)) {
-        std::vector<std::vector<Tensor>> temp_cache;
+        MemoryCacheBuilder builder(cache_, dataset()->cache_options_);
         TF_RETURN_IF_ERROR(
-            ReadElementsFromCheckpoint(ctx, reader, prefix(), &temp_cache));
-        cache_->Complete(std::move(temp_cache));
+            ReadCacheFromCheckpoint(ctx, reader, prefix(), &builder));
+        TF_RETURN_IF_ERROR(builder.Complete());
       }
       TF_RETURN_IF_ERROR(InitializeIterator(ctx));
       return RestoreInput(ctx, reader, iterator_);
@@ -850,11 +899,13 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
     class MemoryWriterIterator : public DatasetIterator<MemoryDatasetBase> {
      public:
       explicit MemoryWriterIterator(const Params& params, MemoryCache* cache)
-          : DatasetIterator<MemoryDatasetBase>(params), cache_(cache) {}
+          : DatasetIterator<MemoryDatasetBase>(params),
+            cache_(cache),
+            builder_(cache, params.dataset->cache_options_) {}
 
       ~MemoryWriterIterator() override {
         mutex_lock l(mu_);
-        if (!temp_cache_.empty() && !cache_->IsCompleted()) {
+        if (!builder_.empty() && !cache_->IsCompleted()) {
           LOG(WARNING) << kIncompleteCacheErrorMessage;
           cache_->Reset();
         }
@@ -874,16 +925,18 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
         if (*end_of_sequence) {
           if (!cache_->IsCompleted()) {
             VLOG(2) << "Finalizing the cache because EOF has been reached.";
-            cache_->Complete(std::move(temp_cache_));
+            TF_RETURN_IF_ERROR(builder_.Complete());
           }
           return OkStatus();
         }
-        RecordBufferEnqueue(ctx, *out_tensors);
-        temp_cache_.emplace_back(*out_tensors);
-        if (temp_cache_.size() == dataset()->input_->Cardinality()) {
+        TF_RETURN_IF_ERROR(builder_.Add(std::vector<Tensor>(*out_tensors)));
+        if (!builder_.spilling()) {
+          RecordBufferEnqueue(ctx, *out_tensors);
+        }
+        if (builder_.size() == dataset()->input_->Cardinality()) {
           VLOG(2) << "Finalizing the cache because its size matches the "
                      "expected input cardinality.";
-          cache_->Complete(std::move(temp_cache_));
+          TF_RETURN_IF_ERROR(builder_.Complete());
         }
         return OkStatus();
       }
@@ -900,7 +953,7 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
         mutex_lock l(mu_);
         if (!cache_->IsCompleted()) {
           TF_RETURN_IF_ERROR(
-              WriteElementsToCheckpoint(writer, prefix(), temp_cache_));
+              WriteCacheToCheckpoint(writer, prefix(), &builder_));
         }
         return SaveInput(ctx, writer, input_impl_);
       }
@@ -909,8 +962,9 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                              IteratorStateReader* reader) override {
         mutex_lock l(mu_);
         if (!reader->Contains(prefix(), kCacheCompleted)) {
+          builder_.Reset();
           TF_RETURN_IF_ERROR(
-              ReadElementsFromCheckpoint(ctx, reader, prefix(), &temp_cache_));
+              ReadCacheFromCheckpoint(ctx, reader, prefix(), &builder_));
         }
         return RestoreInput(ctx, reader, input_impl_);
       }
@@ -919,9 +973,14 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
       mutex mu_;
       std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_);
       MemoryCache* const cache_ TF_GUARDED_BY(mu_);  // not owned.
-      std::vector<std::vector<Tensor>> temp_cache_ TF_GUARDED_BY(mu_);
+      MemoryCacheBuilder builder_ TF_GUARDED_BY(mu_);
     };  // MemoryWriterIterator
 
+    // Elements that were spilled to disk because they exceeded the memory
+    // budget of the cache are read sequentially by a background thread,
+    // which stays up to `kSpillPrefetchBufferSize` elements ahead of the
+    // consumer. Spill files are memory-mapped, so buffered tensors of
+    // memcpy-able dtypes alias the page cache rather than the heap.
     class MemoryReaderIterator : public DatasetIterator<MemoryDatasetBase> {
      public:
       explicit MemoryReaderIterator(const Params& params, MemoryCache* cache)
@@ -929,6 +988,8 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
             cache_(cache),
             index_(0) {}
 
+      ~MemoryReaderIterator() override { StopPrefetchThread(); }
+
       Status Initialize(IteratorContext* ctx) override {
         // The memory allocated for the cache is owned by the parent
         // dataset but performance modeling uses the iterator abstraction and
@@ -936,7 +997,7 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
         // is that this is incorrect if there are concurrent instances of this
         // iterator.
         tf_shared_lock l(mu_);
-        for (size_t i = 0; i < cache_->size(); ++i) {
+        for (size_t i = 0; i < cache_->num_in_memory(); ++i) {
           RecordBufferEnqueue(ctx, cache_->at(i));
         }
         return OkStatus();
@@ -946,13 +1007,18 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
                              std::vector<Tensor>* out_tensors,
                              bool* end_of_sequence) override {
         mutex_lock l(mu_);
-        if (index_ < cache_->size()) {
+        if (index_ < cache_->num_in_memory()) {
           const std::vector<Tensor>& cache_tensors = cache_->at(index_);
           out_tensors->insert(out_tensors->begin(), cache_tensors.begin(),
                               cache_tensors.end());
           index_++;
           *end_of_sequence = false;
           return OkStatus();
+        } else if (index_ < cache_->size()) {
+          TF_RETURN_IF_ERROR(GetNextSpilled(ctx, l, out_tensors));
+          index_++;
+          *end_of_sequence = false;
+          return OkStatus();
         } else {
           *end_of_sequence = true;
           return OkStatus();
@@ -975,6 +1041,7 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
 
       Status RestoreInternal(IteratorContext* ctx,
                              IteratorStateReader* reader) override {
+        StopPrefetchThread();
         mutex_lock l(mu_);
         {
           // kIndex will not be set if we are restoring from a checkpoint
@@ -989,9 +1056,90 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
       }
 
      private:
+      static constexpr size_t kSpillPrefetchBufferSize = 16;
+
+      Status GetNextSpilled(IteratorContext* ctx, mutex_lock& l,
+                            std::vector<Tensor>* out_tensors)
+          TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (!prefetch_thread_) {
+          const size_t start = index_ - cache_->num_in_memory();
+          prefetch_thread_ = ctx->StartThread(
+              kTFDataCachePrefetch,
+              [this, start, segments = cache_->spilled()]() mutable {
+                PrefetchThread(start, std::move(segments));
+              });
+        }
+        while (prefetch_buffer_.empty() && !prefetch_done_) {
+          cond_var_.wait(l);
+        }
+        if (prefetch_buffer_.empty()) {
+          TF_RETURN_IF_ERROR(prefetch_status_);
+          return errors::DataLoss("Expected ", cache_->size(),
+                                  " cached elements but found only ", index_);
+        }
+        std::vector<Tensor>& element = prefetch_buffer_.front();
+        out_tensors->insert(out_tensors->begin(),
+                            std::make_move_iterator(element.begin()),
+                            std::make_move_iterator(element.end()));
+        prefetch_buffer_.pop_front();
+        cond_var_.notify_all();
+        return OkStatus();
+      }
+
+      void PrefetchThread(size_t start,
+                          std::vector<SpilledCacheSegment> segments) {
+        SpilledCacheReader reader(std::move(segments));
+        Status s = reader.Seek(start);
+        while (true) {
+          std::vector<Tensor> element;
+          bool end_of_sequence = false;
+          if (s.ok()) {
+            s = reader.GetNext(&element, &end_of_sequence);
+          }
+          mutex_lock l(mu_);
+          if (!s.ok() || end_of_sequence) {
+            prefetch_status_ = s;
+            prefetch_done_ = true;
+            cond_var_.notify_all();
+            return;
+          }
+          while (!cancelled_ &&
+                 prefetch_buffer_.size() >= kSpillPrefetchBufferSize) {
+            cond_var_.wait(l);
+          }
+          if (cancelled_) {
+            return;
+          }
+          prefetch_buffer_.push_back(std::move(element));
+          cond_var_.notify_all();
+        }
+      }
+
+      void StopPrefetchThread() TF_LOCKS_EXCLUDED(mu_) {
+        {
+          mutex_lock l(mu_);
+          cancelled_ = true;
+          cond_var_.notify_all();
+        }
+        // Joins the thread.
+        prefetch_thread_.reset();
+        mutex_lock l(mu_);
+        cancelled_ = false;
+        prefetch_done_ = false;
+        prefetch_status_ = OkStatus();
+        prefetch_buffer_.clear();
+      }
+
       mutex mu_;
+      condition_variable cond_var_;
       MemoryCache* const cache_ TF_GUARDED_BY(mu_);  // not owned.
       size_t index_ TF_GUARDED_BY(mu_);
+      // Only started once the reader reaches the spilled elements.
+      std::unique_ptr<Thread> prefetch_thread_;
+      std::deque<std::vector<Tensor>> prefetch_buffer_ TF_GUARDED_BY(mu_);
+      Status prefetch_status_ TF_GUARDED_BY(mu_);
+      bool prefetch_done_ TF_GUARDED_BY(mu_) = false;
+      bool cancelled_ TF_GUARDED_BY(mu_) = false;
     };  // MemoryReaderIterator
 
     Status InitializeIterator(IteratorContext* ctx)
@@ -1019,6 +1167,7 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
   mutable mutex mu_;
   const DatasetBase* const input_;
   const std::shared_ptr<MemoryCache> cache_;
+  const MemoryCacheBuilder::Options cache_options_;
   mutable std::unique_ptr<PartialCache> partial_cache_ TF_GUARDED_BY(mu_);
 };  // MemoryDatasetBase
 
@@ -1028,8 +1177,9 @@ class CacheDatasetOp::MemoryDatasetBase : public DatasetBase {
 class CacheDatasetOp::MemoryDataset : public CacheDatasetOp::MemoryDatasetBase {
  public:
   MemoryDataset(OpKernelContext* ctx, const DatasetBase* input,
-                MemoryCacheManager* manager, ResourceHandle&& resource_handle)
-      : MemoryDatasetBase(ctx, input, manager->get()),
+                MemoryCacheManager* manager, ResourceHandle&& resource_handle,
+                const MemoryCacheBuilder::Options& cache_options)
+      : MemoryDatasetBase(ctx, input, manager->get(), cache_options),
         manager_(manager),
         resource_handle_(std::move(resource_handle)),
         resource_mgr_(ctx->resource_manager()) {}
@@ -1051,8 +1201,8 @@ class CacheDatasetOp::MemoryDataset : public CacheDatasetOp::MemoryDatasetBase {
     TF_RETURN_IF_ERROR(b->AddInputDataset(ctx, input_, &input_node));
     Node* filename_node = nullptr;
     TF_RETURN_IF_ERROR(b->AddScalar(tstring(""), &filename_node));
-    TF_RETURN_IF_ERROR(
-        b->AddDataset(this, {input_node, filename_node}, output));
+    TF_RETURN_IF_ERROR(b->AddDataset(this, {input_node, filename_node},
+                                     CacheOptionsAttrs(b), output));
     return OkStatus();
   }
 
@@ -1070,8 +1220,9 @@ class CacheDatasetOp::MemoryDatasetV2
  public:
   MemoryDatasetV2(OpKernelContext* ctx, const DatasetBase* input,
                   MemoryCacheManager* manager, ResourceHandle&& resource_handle,
-                  bool owns_resource)
-      : MemoryDatasetBase(ctx, input, manager->get()),
+                  bool owns_resource,
+                  const MemoryCacheBuilder::Options& cache_options)
+      : MemoryDatasetBase(ctx, input, manager->get(), cache_options),
         manager_(manager),
         owns_resource_(owns_resource),
         resource_handle_(std::move(resource_handle)),
@@ -1100,8 +1251,9 @@ class CacheDatasetOp::MemoryDatasetV2
     Tensor handle(DT_RESOURCE, TensorShape({}));
     handle.scalar<ResourceHandle>()() = resource_handle_;
     TF_RETURN_IF_ERROR(b->AddTensor(handle, &resource_handle_node));
-    TF_RETURN_IF_ERROR(b->AddDataset(
-        this, {input_node, filename_node, resource_handle_node}, output));
+    TF_RETURN_IF_ERROR(
+        b->AddDataset(this, {input_node, filename_node, resource_handle_node},
+                      CacheOptionsAttrs(b), output));
     return OkStatus();
   }
 
@@ -1114,7 +1266,19 @@ class CacheDatasetOp::MemoryDatasetV2
 
 CacheDatasetOp::CacheDatasetOp(OpKernelConstruction* ctx)
     : UnaryDatasetOpKernel(ctx),
-      op_version_(ctx->def().op() == kCacheDataset ? 1 : 2) {}
+      op_version_(ctx->def().op() == kCacheDataset ? 1 : 2) {
+  if (ctx->HasAttr(kMemoryBudgetBytes)) {
+    OP_REQUIRES_OK(ctx,
+                   ctx->GetAttr(kMemoryBudgetBytes, &memory_budget_bytes_));
+  }
+  OP_REQUIRES(
+      ctx, memory_budget_bytes_ >= 0,
+      errors::InvalidArgument("Memory budget must be non-negative but is ",
+                              memory_budget_bytes_, "."));
+  if (ctx->HasAttr(kSpillDirectory)) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr(kSpillDirectory, &spill_directory_));
+  }
+}
 
 void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
                                  DatasetBase** output) {
@@ -1122,6 +1286,9 @@ void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
   tstring filename;
   OP_REQUIRES_OK(ctx, ParseScalarArgument<tstring>(ctx, kFileName, &filename));
   if (filename.empty()) {
+    MemoryCacheBuilder::Options cache_options;
+    cache_options.memory_budget_bytes = memory_budget_bytes_;
+    cache_options.spill_directory = spill_directory_;
     static std::atomic<int64_t> resource_id_counter(0);
     const string& container = ctx->resource_manager()->default_container();
     auto name = strings::StrCat(ctx->op_kernel().name(), "/", kMemoryCache, "_",
@@ -1147,7 +1314,7 @@ void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
       }
       // Ownership of manager is transferred onto `MemoryDatasetV2`.
       *output = new MemoryDatasetV2(ctx, input, manager, std::move(handle),
-                                    owns_resource);
+                                    owns_resource, cache_options);
     } else {
       MemoryCacheManager* manager;
       OP_REQUIRES_OK(
@@ -1159,7 +1326,8 @@ void CacheDatasetOp::MakeDataset(OpKernelContext* ctx, DatasetBase* input,
       auto handle =
           MakeResourceHandle<MemoryCacheManager>(ctx, container, name);
       // Ownership of manager is transferred onto `MemoryDataset`.
-      *output = new MemoryDataset(ctx, input, manager, std::move(handle));
+      *output = new MemoryDataset(ctx, input, manager, std::move(handle),
+                                  cache_options);
     }
   } else {
     if (op_version_ == 2) {
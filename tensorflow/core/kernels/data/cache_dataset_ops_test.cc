@@ -33,10 +33,13 @@ class CacheDatasetParams : public DatasetParams {
   CacheDatasetParams(T input_dataset_params, string filename,
                      DataTypeVector output_dtypes,
                      std::vector<PartialTensorShape> output_shapes,
-                     string node_name)
+                     string node_name, int64_t memory_budget_bytes = 0,
+                     string spill_directory = "")
       : DatasetParams(std::move(output_dtypes), std::move(output_shapes),
                       std::move(node_name)),
-        filename_(filename) {
+        filename_(filename),
+        memory_budget_bytes_(memory_budget_bytes),
+        spill_directory_(std::move(spill_directory)) {
     input_dataset_params_.push_back(std::make_unique<T>(input_dataset_params));
     iterator_prefix_ =
         name_utils::IteratorPrefix(input_dataset_params.dataset_type(),
@@ -57,7 +60,9 @@ class CacheDatasetParams : public DatasetParams {
   Status GetAttributes(AttributeVector* attr_vector) const override {
     *attr_vector = {{"output_types", output_dtypes_},
                     {"output_shapes", output_shapes_},
-                    {"metadata", ""}};
+                    {"metadata", ""},
+                    {CacheDatasetOp::kMemoryBudgetBytes, memory_budget_bytes_},
+                    {CacheDatasetOp::kSpillDirectory, spill_directory_}};
     return OkStatus();
   }
 
@@ -67,6 +72,8 @@ class CacheDatasetParams : public DatasetParams {
 
  private:
   string filename_;
+  int64_t memory_budget_bytes_;
+  string spill_directory_;
 };
 
 class CacheDatasetOpTest : public DatasetOpsTestBase {
@@ -150,6 +157,35 @@ CacheDatasetParams CacheDatasetParams4() {
                             kNodeName);
 }
 
+// Test case 5: cache data in memory with a budget of one element, so that the
+// remaining elements are spilled to disk.
+CacheDatasetParams CacheDatasetParams5() {
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{3, 3, 1},
+                                            {0, 1, 2, 3, 4, 5, 6, 7, 8})},
+      /*node_name=*/"tensor_slice");
+  return CacheDatasetParams(
+      std::move(tensor_slice_dataset_params),
+      /*filename=*/"",
+      /*output_dtypes=*/{DT_INT64},
+      /*output_shapes=*/{PartialTensorShape({3, 1})}, kNodeName,
+      /*memory_budget_bytes=*/3 * sizeof(int64_t),
+      /*spill_directory=*/io::JoinPath(testing::TmpDir(), "cache_spill"));
+}
+
+// Test case 6: invalid memory budget.
+CacheDatasetParams InvalidMemoryBudgetCacheDatasetParams() {
+  auto tensor_slice_dataset_params = TensorSliceDatasetParams(
+      /*components=*/{CreateTensor<int64_t>(TensorShape{3, 3, 1},
+                                            {0, 1, 2, 3, 4, 5, 6, 7, 8})},
+      /*node_name=*/"tensor_slice");
+  return CacheDatasetParams(std::move(tensor_slice_dataset_params),
+                            /*filename=*/"",
+                            /*output_dtypes=*/{DT_INT64},
+                            /*output_shapes=*/{PartialTensorShape({3, 1})},
+                            kNodeName, /*memory_budget_bytes=*/-1);
+}
+
 std::vector<GetNextTestCase<CacheDatasetParams>> GetNextTestCases() {
   return {{/*dataset_params=*/CacheDatasetParams1(),
            /*expected_outputs=*/
@@ -162,7 +198,11 @@ std::vector<GetNextTestCase<CacheDatasetParams>> GetNextTestCases() {
            CreateTensors<int64_t>(TensorShape({3, 1}),
                                   {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}})},
           {/*dataset_params=*/CacheDatasetParams4(),
-           /*expected_outputs=*/{}}};
+           /*expected_outputs=*/{}},
+          {/*dataset_params=*/CacheDatasetParams5(),
+           /*expected_outputs=*/
+           CreateTensors<int64_t>(TensorShape({3, 1}),
+                                  {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}})}};
 }
 
 class ParameterizedGetNextTest : public CacheDatasetOpTest,
@@ -303,7 +343,12 @@ IteratorSaveAndRestoreTestCases() {
                                   {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}})},
           {/*dataset_params=*/CacheDatasetParams4(),
            /*breakpoints=*/{0, 2, 4, 11},
-           /*expected_outputs=*/{}}};
+           /*expected_outputs=*/{}},
+          {/*dataset_params=*/CacheDatasetParams5(),
+           /*breakpoints=*/{0, 2, 4, 11},
+           /*expected_outputs=*/
+           CreateTensors<int64_t>(TensorShape({3, 1}),
+                                  {{0, 1, 2}, {3, 4, 5}, {6, 7, 8}})}};
 }
 
 class ParameterizedIteratorSaveAndRestoreTest
@@ -370,6 +415,12 @@ INSTANTIATE_TEST_CASE_P(CacheDatasetOpTest,
                         ParameterizedIteratorSaveAndRestoreTest,
                         ::testing::ValuesIn(IteratorSaveAndRestoreTestCases()));
 
+TEST_F(CacheDatasetOpTest, InvalidMemoryBudget) {
+  auto dataset_params = InvalidMemoryBudgetCacheDatasetParams();
+  EXPECT_EQ(Initialize(dataset_params).code(),
+            absl::StatusCode::kInvalidArgument);
+}
+
 }  // namespace
 }  // namespace data
 }  // namespace tensorflow
@@ -14,6 +14,12 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/kernels/data/cache_ops.h"
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/partial_tensor_shape.h"
@@ -22,22 +28,87 @@ limitations under the License.
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
 
 namespace tensorflow {
 namespace data {
 namespace {
 
 constexpr char kMemoryCache[] = "MemoryCache";
+constexpr char kSpillFilePrefix[] = "tf_data_cache_spill_";
+
+// Spilled elements are keyed by their zero-padded index within the segment
+// and component, so that the keys sort in the order the elements were written.
+string SpillKey(size_t index, size_t component) {
+  return strings::Printf("%016zx_%08zx", index, component);
+}
+
+void DeleteSpillFiles(const SpilledCacheSegment& segment) {
+  Env* env = Env::Default();
+  std::vector<string> files;
+  Status s = env->GetMatchingPaths(strings::StrCat(segment.prefix, ".*"),
+                                   &files);
+  if (!s.ok()) {
+    LOG(WARNING) << "Failed to get matching files on " << segment.prefix
+                 << ".* : " << s.ToString();
+  }
+  for (const string& path : files) {
+    s = env->DeleteFile(path);
+    if (!s.ok()) {
+      LOG(WARNING) << "Failed to delete " << path << " : " << s.ToString();
+    }
+  }
+}
+
+Status ForEachSpilledElement(
+    const std::vector<SpilledCacheSegment>& segments,
+    const std::function<Status(const std::vector<Tensor>&)>& fn) {
+  SpilledCacheReader reader(segments);
+  while (true) {
+    std::vector<Tensor> element;
+    bool end_of_sequence = false;
+    TF_RETURN_IF_ERROR(reader.GetNext(&element, &end_of_sequence));
+    if (end_of_sequence) {
+      return OkStatus();
+    }
+    TF_RETURN_IF_ERROR(fn(element));
+  }
+}
 
 }  // namespace
 
+MemoryCacheManager::MemoryCacheManager()
+    : cache_(std::make_shared<MemoryCache>()) {}
+
 string MemoryCacheManager::DebugString() const { return kMemoryCache; }
 
+MemoryCache::~MemoryCache() {
+  for (const SpilledCacheSegment& segment : spilled_) {
+    DeleteSpillFiles(segment);
+  }
+}
+
 void MemoryCache::Complete(std::vector<std::vector<Tensor>>&& cache) {
+  Complete(std::move(cache), {});
+}
+
+void MemoryCache::Complete(std::vector<std::vector<Tensor>>&& cache,
+                           std::vector<SpilledCacheSegment>&& spilled) {
   mutex_lock l(mu_);
   if (!completed_) {
     cache_ = std::move(cache);
+    spilled_ = std::move(spilled);
+    num_spilled_ = 0;
+    for (const SpilledCacheSegment& segment : spilled_) {
+      num_spilled_ += segment.num_elements;
+    }
     completed_ = true;
+  } else {
+    for (const SpilledCacheSegment& segment : spilled) {
+      DeleteSpillFiles(segment);
+    }
   }
 }
 
@@ -50,6 +121,11 @@ void MemoryCache::Reset() {
   mutex_lock l(mu_);
   completed_ = false;
   cache_.clear();
+  for (const SpilledCacheSegment& segment : spilled_) {
+    DeleteSpillFiles(segment);
+  }
+  spilled_.clear();
+  num_spilled_ = 0;
 }
 
 const std::vector<Tensor>& MemoryCache::at(int64_t index) {
@@ -59,15 +135,203 @@ const std::vector<Tensor>& MemoryCache::at(int64_t index) {
 }
 
 size_t MemoryCache::size() {
+  tf_shared_lock l(mu_);
+  return cache_.size() + num_spilled_;
+}
+
+size_t MemoryCache::num_in_memory() {
   tf_shared_lock l(mu_);
   return cache_.size();
 }
 
+std::vector<SpilledCacheSegment> MemoryCache::spilled() {
+  tf_shared_lock l(mu_);
+  return spilled_;
+}
+
 const std::vector<std::vector<Tensor>>& MemoryCache::data() {
   tf_shared_lock l(mu_);
   return cache_;
 }
 
+Status MemoryCache::ForEachElement(
+    const std::function<Status(const std::vector<Tensor>&)>& fn) {
+  std::vector<SpilledCacheSegment> spilled;
+  {
+    tf_shared_lock l(mu_);
+    for (const std::vector<Tensor>& element : cache_) {
+      TF_RETURN_IF_ERROR(fn(element));
+    }
+    spilled = spilled_;
+  }
+  return ForEachSpilledElement(spilled, fn);
+}
+
+MemoryCacheBuilder::MemoryCacheBuilder(MemoryCache* cache,
+                                       const Options& options)
+    : cache_(cache), options_(options) {}
+
+MemoryCacheBuilder::~MemoryCacheBuilder() { Reset(); }
+
+Status MemoryCacheBuilder::Add(std::vector<Tensor>&& element) {
+  int64_t bytes = 0;
+  for (const Tensor& t : element) {
+    bytes += t.TotalBytes();
+  }
+  const int64_t budget = options_.memory_budget_bytes;
+  // Once an element has been spilled, all subsequent ones are spilled too so
+  // that the in-memory elements form a prefix of the cache.
+  if (num_spilled_ == 0 && (budget <= 0 || memory_bytes_ + bytes <= budget)) {
+    memory_bytes_ += bytes;
+    in_memory_.push_back(std::move(element));
+    return OkStatus();
+  }
+  if (!writer_) {
+    Env* env = Env::Default();
+    if (spill_prefix_.empty()) {
+      const string& directory = options_.spill_directory;
+      if (directory.empty()) {
+        if (!env->LocalTempFilename(&spill_prefix_)) {
+          return errors::Unavailable(
+              "Failed to create a local temporary file for spilling elements "
+              "of the in-memory cache.");
+        }
+      } else {
+        TF_RETURN_IF_ERROR(env->RecursivelyCreateDir(directory));
+        spill_prefix_ = io::JoinPath(
+            directory, strings::StrCat(kSpillFilePrefix, random::New64()));
+      }
+      VLOG(2) << "Memory budget of " << budget << " bytes exhausted after "
+              << in_memory_.size() << " elements; spilling to "
+              << spill_prefix_;
+    }
+    SpilledCacheSegment segment;
+    segment.prefix = strings::StrCat(spill_prefix_, "_", spilled_.size());
+    BundleWriter::Options options;
+    options.data_alignment = EIGEN_MAX_ALIGN_BYTES;
+    auto writer = std::make_unique<BundleWriter>(env, segment.prefix, options);
+    TF_RETURN_IF_ERROR(writer->status());
+    writer_ = std::move(writer);
+    spilled_.push_back(std::move(segment));
+  }
+  SpilledCacheSegment& segment = spilled_.back();
+  for (size_t i = 0; i < element.size(); ++i) {
+    TF_RETURN_IF_ERROR(writer_->Add(SpillKey(segment.num_elements, i),
+                                    element[i]));
+  }
+  ++segment.num_elements;
+  ++num_spilled_;
+  if (options_.max_segment_elements > 0 &&
+      static_cast<int64_t>(segment.num_elements) >=
+          options_.max_segment_elements) {
+    // The next element opens a new segment.
+    TF_RETURN_IF_ERROR(FinishSegment());
+  }
+  return OkStatus();
+}
+
+Status MemoryCacheBuilder::FinishSegment() {
+  if (!writer_) {
+    return OkStatus();
+  }
+  Status s = writer_->Finish();
+  writer_.reset();
+  return s;
+}
+
+Status MemoryCacheBuilder::ForEachElement(
+    const std::function<Status(const std::vector<Tensor>&)>& fn) {
+  TF_RETURN_IF_ERROR(FinishSegment());
+  for (const std::vector<Tensor>& element : in_memory_) {
+    TF_RETURN_IF_ERROR(fn(element));
+  }
+  return ForEachSpilledElement(spilled_, fn);
+}
+
+Status MemoryCacheBuilder::Complete() {
+  TF_RETURN_IF_ERROR(FinishSegment());
+  cache_->Complete(std::move(in_memory_), std::move(spilled_));
+  in_memory_.clear();
+  spilled_.clear();
+  num_spilled_ = 0;
+  memory_bytes_ = 0;
+  return OkStatus();
+}
+
+void MemoryCacheBuilder::Reset() {
+  // Any segment still being written is deleted below along with the others.
+  writer_.reset();
+  for (const SpilledCacheSegment& segment : spilled_) {
+    DeleteSpillFiles(segment);
+  }
+  in_memory_.clear();
+  spilled_.clear();
+  num_spilled_ = 0;
+  memory_bytes_ = 0;
+}
+
+SpilledCacheReader::SpilledCacheReader(
+    std::vector<SpilledCacheSegment> segments)
+    : segments_(std::move(segments)) {}
+
+Status SpilledCacheReader::Seek(size_t index) {
+  size_t segment = 0;
+  while (segment < segments_.size() &&
+         index >= segments_[segment].num_elements) {
+    index -= segments_[segment].num_elements;
+    ++segment;
+  }
+  return OpenSegment(segment, index);
+}
+
+Status SpilledCacheReader::OpenSegment(size_t segment,
+                                       size_t index_in_segment) {
+  segment_ = segment;
+  index_in_segment_ = index_in_segment;
+  reader_.reset();
+  if (segment_ >= segments_.size()) {
+    return OkStatus();
+  }
+  BundleReader::Options options;
+  options.use_memory_mapped_data = true;
+  reader_ = std::make_unique<BundleReader>(
+      Env::Default(), segments_[segment_].prefix, options);
+  TF_RETURN_IF_ERROR(reader_->status());
+  reader_->Seek(SpillKey(index_in_segment_, 0));
+  return OkStatus();
+}
+
+Status SpilledCacheReader::GetNext(std::vector<Tensor>* element,
+                                   bool* end_of_sequence) {
+  while (segment_ < segments_.size() &&
+         index_in_segment_ >= segments_[segment_].num_elements) {
+    TF_RETURN_IF_ERROR(OpenSegment(segment_ + 1, 0));
+  }
+  if (segment_ >= segments_.size()) {
+    *end_of_sequence = true;
+    return OkStatus();
+  }
+  if (!reader_) {
+    TF_RETURN_IF_ERROR(OpenSegment(segment_, index_in_segment_));
+  }
+  *end_of_sequence = false;
+  element->clear();
+  while (reader_->Valid() &&
+         reader_->key() == SpillKey(index_in_segment_, element->size())) {
+    Tensor t;
+    TF_RETURN_IF_ERROR(reader_->ReadCurrent(&t));
+    element->push_back(std::move(t));
+    reader_->Next();
+  }
+  TF_RETURN_IF_ERROR(reader_->status());
+  if (element->empty()) {
+    return errors::DataLoss("Spilled cache element ", index_in_segment_,
+                            " is missing from ", segments_[segment_].prefix);
+  }
+  ++index_in_segment_;
+  return OkStatus();
+}
+
 AnonymousMemoryCacheHandleOp::AnonymousMemoryCacheHandleOp(
     OpKernelConstruction* ctx)
     : AnonymousResourceOp<MemoryCacheManager>(ctx,
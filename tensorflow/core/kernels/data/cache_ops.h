@@ -16,51 +16,182 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 #define TENSORFLOW_CORE_KERNELS_DATA_CACHE_OPS_H_
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "tensorflow/core/data/dataset_utils.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
 namespace tensorflow {
 namespace data {
 
+// A range of consecutive cache elements that did not fit in the memory budget
+// of a `MemoryCacheBuilder` and were spilled to a tensor bundle on local disk.
+struct SpilledCacheSegment {
+  std::string prefix;
+  size_t num_elements = 0;
+};
+
 // A thread-safe data structure for caching dataset elements.
 //
 // The expected use is that a single `MemoryWriterIterator` populates the
 // cache with dataset elements. Once all elements are cached, the cache can
 // be used by one or more `MemoryReaderIterator`s.
+//
+// If the cache is built with a memory budget, the leading elements are held in
+// memory until the budget is exhausted and the remaining ones are spilled to
+// disk (see `MemoryCacheBuilder`). The in-memory elements always precede the
+// spilled ones.
 class MemoryCache {
  public:
   MemoryCache() = default;
+  ~MemoryCache();
 
   // Marks the cache as completed.
   void Complete(std::vector<std::vector<Tensor>>&& cache);
 
+  // Marks the cache as completed, with `cache` held in memory and followed by
+  // the elements of `spilled`. The cache takes ownership of the spill files.
+  void Complete(std::vector<std::vector<Tensor>>&& cache,
+                std::vector<SpilledCacheSegment>&& spilled);
+
   // Returns whether the cache is completed.
   bool IsCompleted();
 
   // Resets the cache.
   void Reset();
 
-  // Returns the element at the given index.
+  // Returns the element at the given index, which must be less than
+  // `num_in_memory()`.
   const std::vector<Tensor>& at(int64_t index);
 
-  // Returns the size of the cache.
+  // Returns the size of the cache, including spilled elements.
   size_t size();
 
-  // Returns a reference to the cache's data. The returned reference will be
-  // invalidated by any call to Reset().
+  // Returns the number of elements held in memory.
+  size_t num_in_memory();
+
+  // Returns the segments holding the elements that follow the in-memory ones.
+  std::vector<SpilledCacheSegment> spilled();
+
+  // Returns a reference to the cache's in-memory data. The returned reference
+  // will be invalidated by any call to Reset().
   const std::vector<std::vector<Tensor>>& data();
 
+  // Calls `fn` on each element of the cache in order. Spilled elements are
+  // read back one at a time.
+  Status ForEachElement(
+      const std::function<Status(const std::vector<Tensor>&)>& fn);
+
  private:
   mutex mu_;
   // Determines whether all elements of the dataset have been cached.
   bool completed_ TF_GUARDED_BY(mu_) = false;
   std::vector<std::vector<Tensor>> cache_ TF_GUARDED_BY(mu_);
+  std::vector<SpilledCacheSegment> spilled_ TF_GUARDED_BY(mu_);
+  size_t num_spilled_ TF_GUARDED_BY(mu_) = 0;
+};
+
+// Accumulates the elements of a `MemoryCache`, holding them in memory until
+// the memory budget is exhausted and appending the remainder to spill files.
+// Spill files are tensor bundles on the local file system whose tensor data is
+// aligned so that they can be read back through a memory mapping.
+//
+// Not thread-safe.
+class MemoryCacheBuilder {
+ public:
+  struct Options {
+    // The maximum number of bytes of tensor data to hold in memory. A value
+    // of 0 means that all elements are held in memory.
+    int64_t memory_budget_bytes = 0;
+
+    // The directory in which to spill elements that exceed the budget. If
+    // empty, a local temporary directory is used.
+    std::string spill_directory;
+
+    // The maximum number of elements per spill segment. A segment's index is
+    // held in memory until the segment is finished, so spilled elements are
+    // split across segments to bound its size. A value of 0 means that all
+    // spilled elements go to one segment.
+    int64_t max_segment_elements = 1 << 16;
+  };
+
+  MemoryCacheBuilder(MemoryCache* cache, const Options& options);
+
+  // Deletes any spill files that were not handed over to the cache.
+  ~MemoryCacheBuilder();
+
+  // Appends `element` to the cache being built.
+  Status Add(std::vector<Tensor>&& element);
+
+  // Returns the number of elements added so far.
+  size_t size() const { return in_memory_.size() + num_spilled_; }
+
+  // Returns true if no element has been added.
+  bool empty() const { return size() == 0; }
+
+  // Returns true once the memory budget has been exhausted, after which all
+  // added elements are spilled.
+  bool spilling() const { return num_spilled_ > 0; }
+
+  // Calls `fn` on each element added so far in order. Spilled elements are
+  // read back one at a time. Elements added afterwards go to a new spill
+  // segment.
+  Status ForEachElement(
+      const std::function<Status(const std::vector<Tensor>&)>& fn);
+
+  // Hands the added elements over to the cache and marks it as completed.
+  Status Complete();
+
+  // Discards all added elements.
+  void Reset();
+
+ private:
+  // Finishes the spill segment being written, if any.
+  Status FinishSegment();
+
+  MemoryCache* const cache_;  // Not owned.
+  const Options options_;
+  std::string spill_prefix_;
+  int64_t memory_bytes_ = 0;
+  std::vector<std::vector<Tensor>> in_memory_;
+  std::vector<SpilledCacheSegment> spilled_;
+  size_t num_spilled_ = 0;
+  std::unique_ptr<BundleWriter> writer_;
+};
+
+// Reads the spilled elements of a `MemoryCache` in order. Spill files are
+// memory-mapped, so tensors of memcpy-able dtypes alias the mapping instead of
+// being copied.
+//
+// Not thread-safe.
+class SpilledCacheReader {
+ public:
+  explicit SpilledCacheReader(std::vector<SpilledCacheSegment> segments);
+
+  // Positions the reader at the `index`-th spilled element.
+  Status Seek(size_t index);
+
+  // Reads the next element, setting `*end_of_sequence` when all spilled
+  // elements have been read.
+  Status GetNext(std::vector<Tensor>* element, bool* end_of_sequence);
+
+ private:
+  Status OpenSegment(size_t segment, size_t index_in_segment);
+
+  const std::vector<SpilledCacheSegment> segments_;
+  size_t segment_ = 0;
+  size_t index_in_segment_ = 0;
+  std::unique_ptr<BundleReader> reader_;
 };
 
 // A resource wrapping a shared instance of a memory cache.
 class MemoryCacheManager : public ResourceBase {
  public:
-  MemoryCacheManager() : cache_(std::make_shared<MemoryCache>()) {}
+  MemoryCacheManager();
 
   string DebugString() const override;
 
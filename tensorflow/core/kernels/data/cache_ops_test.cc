@@ -0,0 +1,266 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/data/cache_ops.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/path.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
+
+namespace tensorflow {
+namespace data {
+namespace {
+
+// Returns an element with a float vector of `num_floats` values and a string
+// scalar, both derived from `index`.
+std::vector<Tensor> MakeElement(int index, int num_floats = 4) {
+  Tensor floats(DT_FLOAT, TensorShape({num_floats}));
+  floats.flat<float>().setConstant(static_cast<float>(index));
+  Tensor str(DT_STRING, TensorShape({}));
+  str.scalar<tstring>()() = strings::StrCat("element_", index);
+  return {floats, str};
+}
+
+int64_t ElementBytes(const std::vector<Tensor>& element) {
+  int64_t bytes = 0;
+  for (const Tensor& t : element) {
+    bytes += t.TotalBytes();
+  }
+  return bytes;
+}
+
+void ExpectElementsEqual(const std::vector<std::vector<Tensor>>& elements,
+                         int begin, int end) {
+  ASSERT_EQ(elements.size(), end - begin);
+  for (int i = begin; i < end; ++i) {
+    std::vector<Tensor> expected = MakeElement(i);
+    ASSERT_EQ(elements[i - begin].size(), expected.size());
+    test::ExpectTensorEqual<float>(elements[i - begin][0], expected[0]);
+    test::ExpectTensorEqual<tstring>(elements[i - begin][1], expected[1]);
+  }
+}
+
+MemoryCacheBuilder::Options SpillOptions(int num_in_memory) {
+  MemoryCacheBuilder::Options options;
+  options.memory_budget_bytes = num_in_memory * ElementBytes(MakeElement(0));
+  options.spill_directory = io::JoinPath(testing::TmpDir(), "cache_spill");
+  return options;
+}
+
+std::vector<std::vector<Tensor>> ReadSpilled(MemoryCache* cache,
+                                             size_t start) {
+  SpilledCacheReader reader(cache->spilled());
+  TF_EXPECT_OK(reader.Seek(start));
+  std::vector<std::vector<Tensor>> elements;
+  while (true) {
+    std::vector<Tensor> element;
+    bool end_of_sequence = false;
+    TF_EXPECT_OK(reader.GetNext(&element, &end_of_sequence));
+    if (end_of_sequence) break;
+    elements.push_back(std::move(element));
+  }
+  return elements;
+}
+
+// Returns the elements of a `MemoryCache` or `MemoryCacheBuilder`.
+template <typename Cache>
+std::vector<std::vector<Tensor>> AllElements(Cache* cache) {
+  std::vector<std::vector<Tensor>> elements;
+  TF_EXPECT_OK(cache->ForEachElement([&](const std::vector<Tensor>& element) {
+    elements.push_back(element);
+    return OkStatus();
+  }));
+  return elements;
+}
+
+TEST(MemoryCacheTest, NoBudgetKeepsAllElementsInMemory) {
+  MemoryCache cache;
+  MemoryCacheBuilder builder(&cache, MemoryCacheBuilder::Options());
+  for (int i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(builder.Add(MakeElement(i)));
+  }
+  EXPECT_FALSE(builder.spilling());
+  TF_ASSERT_OK(builder.Complete());
+  EXPECT_TRUE(cache.IsCompleted());
+  EXPECT_EQ(cache.size(), 10);
+  EXPECT_EQ(cache.num_in_memory(), 10);
+  EXPECT_TRUE(cache.spilled().empty());
+  ExpectElementsEqual(cache.data(), 0, 10);
+}
+
+TEST(MemoryCacheTest, SpillsElementsOverBudget) {
+  MemoryCache cache;
+  MemoryCacheBuilder builder(&cache, SpillOptions(/*num_in_memory=*/3));
+  for (int i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(builder.Add(MakeElement(i)));
+    EXPECT_EQ(builder.spilling(), i >= 3);
+  }
+  TF_ASSERT_OK(builder.Complete());
+  EXPECT_TRUE(builder.empty());
+  EXPECT_EQ(cache.size(), 10);
+  EXPECT_EQ(cache.num_in_memory(), 3);
+  ExpectElementsEqual(cache.data(), 0, 3);
+  ExpectElementsEqual(ReadSpilled(&cache, 0), 3, 10);
+  ExpectElementsEqual(ReadSpilled(&cache, 4), 7, 10);
+  ExpectElementsEqual(AllElements(&cache), 0, 10);
+}
+
+TEST(MemoryCacheTest, ForEachElementWhileSpilling) {
+  MemoryCache cache;
+  MemoryCacheBuilder builder(&cache, SpillOptions(/*num_in_memory=*/2));
+  for (int i = 0; i < 5; ++i) {
+    TF_ASSERT_OK(builder.Add(MakeElement(i)));
+  }
+  ExpectElementsEqual(AllElements(&builder), 0, 5);
+
+  // Elements added afterwards go to a new spill segment.
+  for (int i = 5; i < 8; ++i) {
+    TF_ASSERT_OK(builder.Add(MakeElement(i)));
+  }
+  TF_ASSERT_OK(builder.Complete());
+  EXPECT_EQ(cache.spilled().size(), 2);
+  ExpectElementsEqual(ReadSpilled(&cache, 0), 2, 8);
+  ExpectElementsEqual(ReadSpilled(&cache, 3), 5, 8);
+  ExpectElementsEqual(ReadSpilled(&cache, 6), 8, 8);
+}
+
+TEST(MemoryCacheTest, SpillsToMultipleSegments) {
+  MemoryCache cache;
+  MemoryCacheBuilder::Options options = SpillOptions(/*num_in_memory=*/2);
+  options.max_segment_elements = 3;
+  MemoryCacheBuilder builder(&cache, options);
+  for (int i = 0; i < 10; ++i) {
+    TF_ASSERT_OK(builder.Add(MakeElement(i)));
+  }
+  TF_ASSERT_OK(builder.Complete());
+  const std::vector<SpilledCacheSegment> spilled = cache.spilled();
+  ASSERT_EQ(spilled.size(), 3);
+  EXPECT_EQ(spilled[0].num_elements, 3);
+  EXPECT_EQ(spilled[1].num_elements, 3);
+  EXPECT_EQ(spilled[2].num_elements, 2);
+  ExpectElementsEqual(ReadSpilled(&cache, 0), 2, 10);
+  ExpectElementsEqual(ReadSpilled(&cache, 3), 5, 10);
+  ExpectElementsEqual(ReadSpilled(&cache, 6), 8, 10);
+  ExpectElementsEqual(AllElements(&cache), 0, 10);
+}
+
+TEST(MemoryCacheTest, ResetDeletesSpillFiles) {
+  MemoryCacheBuilder::Options options = SpillOptions(/*num_in_memory=*/1);
+  options.spill_directory =
+      io::JoinPath(testing::TmpDir(), "cache_spill_reset");
+  MemoryCache cache;
+  {
+    MemoryCacheBuilder builder(&cache, options);
+    for (int i = 0; i < 3; ++i) {
+      TF_ASSERT_OK(builder.Add(MakeElement(i)));
+    }
+    TF_ASSERT_OK(builder.Complete());
+  }
+  std::vector<string> children;
+  TF_ASSERT_OK(Env::Default()->GetChildren(options.spill_directory, &children));
+  EXPECT_FALSE(children.empty());
+
+  cache.Reset();
+  TF_ASSERT_OK(Env::Default()->GetChildren(options.spill_directory, &children));
+  EXPECT_TRUE(children.empty());
+}
+
+TEST(MemoryCacheTest, IncompleteBuilderDeletesSpillFiles) {
+  MemoryCacheBuilder::Options options = SpillOptions(/*num_in_memory=*/1);
+  options.spill_directory =
+      io::JoinPath(testing::TmpDir(), "cache_spill_incomplete");
+  MemoryCache cache;
+  {
+    MemoryCacheBuilder builder(&cache, options);
+    for (int i = 0; i < 3; ++i) {
+      TF_ASSERT_OK(builder.Add(MakeElement(i)));
+    }
+  }
+  EXPECT_FALSE(cache.IsCompleted());
+  std::vector<string> children;
+  TF_ASSERT_OK(Env::Default()->GetChildren(options.spill_directory, &children));
+  EXPECT_TRUE(children.empty());
+}
+
+// Measures the throughput of a second epoch over a cache of 64MB of float
+// elements of `state.range(0)` KB each:
+//   mode 0: in-memory cache,
+//   mode 1: hybrid cache holding half of the elements in memory,
+//   mode 2: hybrid cache with all elements spilled (memory-mapped reads),
+//   mode 3: file cache layout read through a regular `BundleReader`.
+void BM_CacheSecondEpoch(::testing::benchmark::State& state) {
+  const int element_kb = state.range(0);
+  const int mode = state.range(1);
+  const int num_floats = element_kb * 1024 / sizeof(float);
+  const int num_elements = (64 << 10) / element_kb;
+  const int64_t element_bytes = ElementBytes(MakeElement(0, num_floats));
+
+  MemoryCacheBuilder::Options options;
+  options.spill_directory = io::JoinPath(testing::TmpDir(), "cache_bm");
+  if (mode == 1) {
+    options.memory_budget_bytes = element_bytes * num_elements / 2;
+  } else if (mode >= 2) {
+    options.memory_budget_bytes = 1;
+  }
+  MemoryCache cache;
+  MemoryCacheBuilder builder(&cache, options);
+  for (int i = 0; i < num_elements; ++i) {
+    TF_CHECK_OK(builder.Add(MakeElement(i, num_floats)));
+  }
+  TF_CHECK_OK(builder.Complete());
+
+  for (auto s : state) {
+    int64_t checksum = 0;
+    for (size_t i = 0; i < cache.num_in_memory(); ++i) {
+      checksum += cache.at(i)[0].NumElements();
+    }
+    if (mode == 3) {
+      BundleReader reader(Env::Default(), cache.spilled()[0].prefix);
+      TF_CHECK_OK(reader.status());
+      for (reader.Seek(""), reader.Next(); reader.Valid(); reader.Next()) {
+        Tensor t;
+        TF_CHECK_OK(reader.ReadCurrent(&t));
+        checksum += t.NumElements();
+      }
+    } else {
+      SpilledCacheReader reader(cache.spilled());
+      while (true) {
+        std::vector<Tensor> element;
+        bool end_of_sequence = false;
+        TF_CHECK_OK(reader.GetNext(&element, &end_of_sequence));
+        if (end_of_sequence) break;
+        checksum += element[0].NumElements();
+      }
+    }
+    ::tensorflow::testing::DoNotOptimize(checksum);
+  }
+  state.SetBytesProcessed(state.iterations() * num_elements * element_bytes);
+}
+
+BENCHMARK(BM_CacheSecondEpoch)->ArgsProduct({{16, 256, 4096}, {0, 1, 2, 3}});
+
+}  // namespace
+}  // namespace data
+}  // namespace tensorflow
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/framework/dataset.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/shape_inference.h"
+#include "tensorflow/core/kernels/csv_tokenizer.h"
 #include "tensorflow/core/lib/io/inputstream_interface.h"
 #include "tensorflow/core/lib/io/random_inputstream.h"
 #include "tensorflow/core/lib/io/zlib_compression_options.h"
@@ -520,8 +521,9 @@ class CSVDatasetOp : public DatasetOpKernel {
             }
           }
 
-          char ch = buffer_[pos_];
-          if (ch == '"') {
+          // Skip ahead to the next quote, or to the end of the buffer.
+          pos_ = csv::FindQuote(buffer_, pos_);
+          if (pos_ < buffer_.size()) {
             // When we encounter a quote, we look ahead to the next character to
             // decide what to do
             pos_++;
@@ -560,9 +562,6 @@ class CSVDatasetOp : public DatasetOpKernel {
               parse_result.Update(errors::InvalidArgument(
                   "Quote inside a string has to be escaped by another quote"));
             }
-
-          } else {
-            pos_++;
           }
         }
       }
@@ -657,8 +656,13 @@ class CSVDatasetOp : public DatasetOpKernel {
             }
           }
 
-          char ch = buffer_[pos_];
+          // Skip ahead to the next delimiter, line break or quote, or to the
+          // end of the buffer.
+          pos_ = csv::FindUnquotedFieldEnd(buffer_, pos_, dataset()->delim_,
+                                           dataset()->use_quote_delim_);
+          if (pos_ >= buffer_.size()) continue;
 
+          char ch = buffer_[pos_];
           if (ch == dataset()->delim_) {
             parse_result.Update(UnquotedFieldToOutput(
                 ctx, StringPiece(&buffer_[start], pos_ - start), out_tensors,
@@ -677,12 +681,10 @@ class CSVDatasetOp : public DatasetOpKernel {
             if (ch == '\r') SkipNewLineIfNecessary();
             return parse_result;
           }
-          if (dataset()->use_quote_delim_ && ch == '"') {
-            // Take note of the error, but keep going to end of field.
-            parse_result.Update(errors::InvalidArgument(
-                "Unquoted fields cannot have quotes inside"));
-          }
-          // Otherwise, go to next character
+          // Otherwise `ch` is a quote. Take note of the error, but keep going
+          // to end of field.
+          parse_result.Update(errors::InvalidArgument(
+              "Unquoted fields cannot have quotes inside"));
           pos_++;
         }
       }
@@ -730,7 +732,7 @@ class CSVDatasetOp : public DatasetOpKernel {
                   dataset()->record_defaults_[output_idx].flat<int32>()(0);
             } else {
               int32_t value;
-              if (!strings::safe_strto32(field, &value)) {
+              if (!csv::ParseNumber(field, &value)) {
                 return errors::InvalidArgument(
                     "Field ", output_idx,
                     " in record is not a valid int32: ", field);
@@ -745,7 +747,7 @@ class CSVDatasetOp : public DatasetOpKernel {
                   dataset()->record_defaults_[output_idx].flat<int64_t>()(0);
             } else {
               int64_t value;
-              if (!strings::safe_strto64(field, &value)) {
+              if (!csv::ParseNumber(field, &value)) {
                 return errors::InvalidArgument(
                     "Field ", output_idx,
                     " in record is not a valid int64: ", field);
@@ -760,7 +762,7 @@ class CSVDatasetOp : public DatasetOpKernel {
                   dataset()->record_defaults_[output_idx].flat<float>()(0);
             } else {
               float value;
-              if (!strings::safe_strtof(field, &value)) {
+              if (!csv::ParseNumber(field, &value)) {
                 return errors::InvalidArgument(
                     "Field ", output_idx,
                     " in record is not a valid float: ", field);
@@ -775,7 +777,7 @@ class CSVDatasetOp : public DatasetOpKernel {
                   dataset()->record_defaults_[output_idx].flat<double>()(0);
             } else {
               double value;
-              if (!strings::safe_strtod(field, &value)) {
+              if (!csv::ParseNumber(field, &value)) {
                 return errors::InvalidArgument(
                     "Field ", output_idx,
                     " in record is not a valid double: ", field);
@@ -789,7 +791,7 @@ class CSVDatasetOp : public DatasetOpKernel {
               component.scalar<tstring>()() =
                   dataset()->record_defaults_[output_idx].flat<tstring>()(0);
             } else {
-              component.scalar<tstring>()() = string(field);
+              component.scalar<tstring>()() = field;
             }
             break;
           }
@@ -24,6 +24,7 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/core/data/dataset_utils.h"
+#include "tensorflow/core/data/element_arena.h"
 #include "tensorflow/core/data/name_utils.h"
 #include "tensorflow/core/data/serialization_utils.h"
 #include "tensorflow/core/framework/dataset.h"
@@ -61,6 +62,10 @@ namespace data {
 
 const int64_t kLogIntervalMicros = 10 * 1000000;  // 10 seconds.
 const int64_t kMaxEpochsInBuffer = 3;
+// Elements of at most this many bytes are stored in an `ElementArena` if they
+// have a fixed signature. Larger elements gain little from avoiding their
+// per-element allocations and cost more to copy in and out of the arena.
+const int64_t kMaxArenaElementBytes = 4096;
 
 constexpr char kNumRandomSamples[] = "num_random_samples";
 constexpr char kDataProduced[] = "data_produced";
@@ -191,6 +196,13 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
           generator_(&parent_generator_) {
       if (params.dataset->buffer_size_ == kUnknownCardinality) {
         buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>();
+      } else if (ElementArena::IsSupported(params.dataset->output_dtypes(),
+                                           params.dataset->output_shapes(),
+                                           kMaxArenaElementBytes)) {
+        buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>();
+        arena_ = std::make_unique<ElementArena>(
+            params.dataset->output_dtypes(), params.dataset->output_shapes(),
+            params.dataset->buffer_size_);
       } else {
         buffer_ = std::make_unique<std::vector<std::vector<Tensor>>>(
             params.dataset->buffer_size_);
@@ -224,11 +236,17 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       // slice, and then remove the element from the slice.
       int64_t offset =
           Random() % (slices_.front()->end - slices_.front()->start);
-      int64_t index = (slices_.front()->start + offset) % buffer_->size();
-      *out_tensors = std::move(buffer_->at(index));
-      this->RecordBufferDequeue(ctx, *out_tensors);
-      std::swap(buffer_->at(index),
-                buffer_->at(slices_.front()->start % buffer_->size()));
+      int64_t index = (slices_.front()->start + offset) % BufferCapacity();
+      int64_t start_index = slices_.front()->start % BufferCapacity();
+      if (arena_) {
+        arena_->Get(index, out_tensors);
+        arena_->Copy(start_index, index);
+        this->RecordBufferEvent(ctx, /*bytes_delta=*/0, /*elements_delta=*/-1);
+      } else {
+        *out_tensors = std::move(buffer_->at(index));
+        this->RecordBufferDequeue(ctx, *out_tensors);
+        std::swap(buffer_->at(index), buffer_->at(start_index));
+      }
       slices_.front()->start++;
       num_elements_--;
       return OkStatus();
@@ -273,8 +291,22 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       TF_RETURN_IF_ERROR(writer->WriteScalar(prefix(), kEpoch, epoch_));
       TF_RETURN_IF_ERROR(
           writer->WriteScalar(prefix(), kNumElements, num_elements_));
-      TF_RETURN_IF_ERROR(WriteElementsToCheckpoint(
-          writer, absl::StrCat(prefix(), kColon, "buffer"), *buffer_));
+      if (arena_) {
+        // Uses the same layout as `buffer_`, in which slots that hold no
+        // element are empty.
+        std::vector<std::vector<Tensor>> elements(arena_->capacity());
+        for (const auto& slice : slices_) {
+          for (int64_t i = slice->start; i < slice->end; ++i) {
+            arena_->Get(i % arena_->capacity(),
+                        &elements[i % arena_->capacity()]);
+          }
+        }
+        TF_RETURN_IF_ERROR(WriteElementsToCheckpoint(
+            writer, absl::StrCat(prefix(), kColon, "buffer"), elements));
+      } else {
+        TF_RETURN_IF_ERROR(WriteElementsToCheckpoint(
+            writer, absl::StrCat(prefix(), kColon, "buffer"), *buffer_));
+      }
       TF_RETURN_IF_ERROR(
           writer->WriteScalar(prefix(), kSlicesSize, slices_.size()));
       for (size_t i = 0; i < slices_.size(); ++i) {
@@ -339,11 +371,15 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       TF_RETURN_IF_ERROR(ReadElementsFromCheckpoint(
           ctx, reader, absl::StrCat(prefix(), kColon, "buffer"),
           buffer_.get()));
-      for (const auto& element : *buffer_) {
-        RecordBufferEnqueue(ctx, element);
-      }
-      if (!IsShuffleAll()) {
-        buffer_->resize(dataset()->buffer_size_);
+      if (arena_) {
+        TF_RETURN_IF_ERROR(MoveBufferToArena(ctx));
+      } else {
+        for (const auto& element : *buffer_) {
+          RecordBufferEnqueue(ctx, element);
+        }
+        if (!IsShuffleAll()) {
+          buffer_->resize(dataset()->buffer_size_);
+        }
       }
       slices_.clear();
       for (size_t i = 0; i < slices_size; ++i) {
@@ -411,6 +447,28 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       return dataset()->buffer_size_ == kUnknownCardinality;
     }
 
+    // Returns the number of slots of the shuffle buffer.
+    int64_t BufferCapacity() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      return arena_ ? arena_->capacity() : buffer_->size();
+    }
+
+    // Moves the elements restored into `buffer_` into `arena_`, keeping their
+    // slots.
+    Status MoveBufferToArena(IteratorContext* ctx)
+        TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      arena_->Clear();
+      int64_t num_elements = 0;
+      for (size_t i = 0; i < buffer_->size(); ++i) {
+        if (!buffer_->at(i).empty()) {
+          TF_RETURN_IF_ERROR(arena_->Put(i, buffer_->at(i)));
+          ++num_elements;
+        }
+      }
+      buffer_->clear();
+      this->RecordBufferEvent(ctx, arena_->allocated_bytes(), num_elements);
+      return OkStatus();
+    }
+
     // Fills the shuffle buffer, preparing the buffer for sampling.
     Status FillBuffer(IteratorContext* ctx) TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       int64_t start_micros = EnvTime::NowMicros();
@@ -435,7 +493,7 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
           slices_.back()->reached_end_of_sequence = true;
         }
         if (!end_of_input_sequence) {
-          AddToShuffleBuffer(ctx, std::move(input_element));
+          TF_RETURN_IF_ERROR(AddToShuffleBuffer(ctx, std::move(input_element)));
           continue;
         }
         input_impl_.reset();
@@ -472,7 +530,7 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
         // we need to add to the buffer.
         return true;
       }
-      return num_elements_ < buffer_->size();
+      return num_elements_ < BufferCapacity();
     }
 
     Status PrepareNextEpoch(IteratorContext* ctx)
@@ -492,23 +550,36 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
       return OkStatus();
     }
 
-    void AddToShuffleBuffer(IteratorContext* ctx, std::vector<Tensor>&& element)
+    Status AddToShuffleBuffer(IteratorContext* ctx,
+                              std::vector<Tensor>&& element)
         TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
       data_produced_ = true;
       if (num_elements_ == 0) {
         VLOG(1) << "Starting to fill up shuffle buffer of size: "
                 << BufferSizeString();
       }
-      this->RecordBufferEnqueue(ctx, element);
-      if (num_elements_ == buffer_->size()) {
-        DCHECK(IsShuffleAll());
-        buffer_->push_back(element);
+      if (arena_) {
+        // The arena accounts for the chunks it allocates rather than for the
+        // bytes of the elements copied into them.
+        const int64_t allocated_bytes = arena_->allocated_bytes();
+        TF_RETURN_IF_ERROR(arena_->Put(
+            slices_.back()->end % arena_->capacity(), element));
+        this->RecordBufferEvent(ctx,
+                                arena_->allocated_bytes() - allocated_bytes,
+                                /*elements_delta=*/1);
       } else {
-        size_t index = slices_.back()->end % buffer_->size();
-        buffer_->at(index) = std::move(element);
+        this->RecordBufferEnqueue(ctx, element);
+        if (num_elements_ == buffer_->size()) {
+          DCHECK(IsShuffleAll());
+          buffer_->push_back(element);
+        } else {
+          size_t index = slices_.back()->end % buffer_->size();
+          buffer_->at(index) = std::move(element);
+        }
       }
       num_elements_++;
       slices_.back()->end++;
+      return OkStatus();
     }
 
     void ClearEmptySlices() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
@@ -530,6 +601,9 @@ class ShuffleDatasetOpBase::ShuffleDatasetBase : public DatasetBase {
     SeedGenerator* const seed_generator_ TF_GUARDED_BY(mu_);  // Not owned.
     std::unique_ptr<std::vector<std::vector<Tensor>>> buffer_
         TF_GUARDED_BY(mu_);
+    // If set, holds the elements of the shuffle buffer instead of `buffer_`,
+    // which is then only used while restoring from a checkpoint.
+    std::unique_ptr<ElementArena> arena_ TF_GUARDED_BY(mu_);
     std::unique_ptr<IteratorBase> input_impl_ TF_GUARDED_BY(mu_) = nullptr;
     int64_t epoch_ TF_GUARDED_BY(mu_) = 0;
     int64_t num_elements_ TF_GUARDED_BY(mu_) = 0;
@@ -43,6 +43,8 @@ constexpr char kCurrentFileIndex[] = "current_file_index";
 constexpr char kOffset[] = "offset";
 constexpr char kGcsFsPrefix[] = "gs://";
 constexpr char kS3FsPrefix[] = "s3://";
+// Maximum number of records the iterator reads from the file at once.
+constexpr int kRecordsPerBatch = 256;
 constexpr int64_t kCloudTpuBlockSize = 127LL << 20;  // 127MB.
 constexpr int64_t kS3BlockSize = kCloudTpuBlockSize;
 
@@ -135,19 +137,22 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
       do {
         // We are currently processing a file, so try to read the next record.
         if (reader_) {
-          out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
-                                    TensorShape({}));
-          Status s =
-              reader_->ReadRecord(&out_tensors->back().scalar<tstring>()());
+          Status s;
+          if (next_record_ == records_.size()) {
+            next_record_ = 0;
+            s = reader_->ReadRecords(kRecordsPerBatch, &records_);
+          }
           if (s.ok()) {
+            out_tensors->emplace_back(ctx->allocator({}), DT_STRING,
+                                      TensorShape({}));
+            tstring& record = out_tensors->back().scalar<tstring>()();
+            record = std::move(ConsumeRecordLocked());
             static monitoring::CounterCell* bytes_counter =
                 metrics::GetTFDataBytesReadCounter(kDatasetType);
-            bytes_counter->IncrementBy(
-                out_tensors->back().scalar<tstring>()().size());
+            bytes_counter->IncrementBy(record.size());
             *end_of_sequence = false;
             return OkStatus();
           }
-          out_tensors->pop_back();
           if (!errors::IsOutOfRange(s)) {
             // In case of other errors e.g., DataLoss, we still move forward
             // the file index so that it works with ignore_errors.
@@ -181,10 +186,21 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
         // We are currently processing a file, so try to skip reading
         // the next (num_to_skip - *num_skipped) record.
         if (reader_) {
+          // Records already read into `records_` are skipped first.
+          while (*num_skipped < num_to_skip &&
+                 next_record_ < records_.size()) {
+            ConsumeRecordLocked();
+            ++*num_skipped;
+          }
+          if (*num_skipped == num_to_skip) {
+            *end_of_sequence = false;
+            return OkStatus();
+          }
           int last_num_skipped;
           Status s = reader_->SkipRecords(num_to_skip - *num_skipped,
                                           &last_num_skipped);
           *num_skipped += last_num_skipped;
+          next_offset_ = reader_->TellOffset();
           if (s.ok()) {
             *end_of_sequence = false;
             return OkStatus();
@@ -228,7 +244,7 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
 
       if (reader_) {
         TF_RETURN_IF_ERROR(
-            writer->WriteScalar(prefix(), kOffset, reader_->TellOffset()));
+            writer->WriteScalar(prefix(), kOffset, next_offset_));
       }
       return OkStatus();
     }
@@ -246,6 +262,7 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
         TF_RETURN_IF_ERROR(reader->ReadScalar(prefix(), kOffset, &offset));
         TF_RETURN_IF_ERROR(SetupStreamsLocked(ctx->env()));
         TF_RETURN_IF_ERROR(reader_->SeekOffset(offset));
+        next_offset_ = offset;
       }
       return OkStatus();
     }
@@ -269,15 +286,27 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
         TF_RETURN_IF_ERROR(
             reader_->SeekOffset(dataset()->byte_offsets_[current_file_index_]));
       }
+      next_offset_ = reader_->TellOffset();
       return OkStatus();
     }
 
     // Resets all reader streams.
     void ResetStreamsLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      records_.clear();
+      next_record_ = 0;
       reader_.reset();
       file_.reset();
     }
 
+    // Returns the next record of `records_` and advances `next_offset_` past
+    // it. The record may be moved from.
+    tstring& ConsumeRecordLocked() TF_EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+      tstring& record = records_[next_record_++];
+      next_offset_ += io::RecordReader::kHeaderSize + record.size() +
+                      io::RecordReader::kFooterSize;
+      return record;
+    }
+
     mutex mu_;
     size_t current_file_index_ TF_GUARDED_BY(mu_) = 0;
 
@@ -285,6 +314,12 @@ class TFRecordDatasetOp::Dataset : public DatasetBase {
     // we must destroy `reader_` before `file_`.
     std::unique_ptr<RandomAccessFile> file_ TF_GUARDED_BY(mu_);
     std::unique_ptr<io::SequentialRecordReader> reader_ TF_GUARDED_BY(mu_);
+    // Records read from `reader_` but not yet returned, starting at index
+    // `next_record_`. `next_offset_` is the file offset of that record, which
+    // is where a restored iterator resumes.
+    std::vector<tstring> records_ TF_GUARDED_BY(mu_);
+    size_t next_record_ TF_GUARDED_BY(mu_) = 0;
+    uint64 next_offset_ TF_GUARDED_BY(mu_) = 0;
   };
 
   const std::vector<string> filenames_;
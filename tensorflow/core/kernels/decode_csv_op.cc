@@ -14,13 +14,16 @@ limitations under the License.
 ==============================================================================*/
 
 // See docs in ../ops/parsing_ops.cc.
+#include <algorithm>
+#include <deque>
 #include <vector>
+
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/csv_tokenizer.h"
 #include "tensorflow/core/lib/core/errors.h"
-#include "tensorflow/core/lib/strings/numbers.h"
 
 namespace tensorflow {
 
@@ -81,10 +84,13 @@ class DecodeCSVOp : public OpKernel {
       OP_REQUIRES_OK(ctx, output.allocate(i, records->shape(), &out));
     }
 
+    std::vector<StringPiece> fields;
+    std::deque<string> unescaped;
     for (int64_t i = 0; i < records_size; ++i) {
       const StringPiece record(records_t(i));
-      std::vector<string> fields;
-      ExtractFields(ctx, record, &fields);
+      fields.clear();
+      unescaped.clear();
+      OP_REQUIRES_OK(ctx, ExtractFields(record, &fields, &unescaped));
       OP_REQUIRES(ctx, fields.size() == out_type_.size(),
                   errors::InvalidArgument("Expect ", out_type_.size(),
                                           " fields but have ", fields.size(),
@@ -106,7 +112,7 @@ class DecodeCSVOp : public OpKernel {
               output[f]->flat<int32>()(i) = record_defaults[f].flat<int32>()(0);
             } else {
               int32_t value;
-              OP_REQUIRES(ctx, strings::safe_strto32(fields[f], &value),
+              OP_REQUIRES(ctx, csv::ParseNumber(fields[f], &value),
                           errors::InvalidArgument(
                               "Field ", f, " in record ", i,
                               " is not a valid int32: ", fields[f]));
@@ -127,7 +133,7 @@ class DecodeCSVOp : public OpKernel {
                   record_defaults[f].flat<int64_t>()(0);
             } else {
               int64_t value;
-              OP_REQUIRES(ctx, strings::safe_strto64(fields[f], &value),
+              OP_REQUIRES(ctx, csv::ParseNumber(fields[f], &value),
                           errors::InvalidArgument(
                               "Field ", f, " in record ", i,
                               " is not a valid int64: ", fields[f]));
@@ -146,7 +152,7 @@ class DecodeCSVOp : public OpKernel {
               output[f]->flat<float>()(i) = record_defaults[f].flat<float>()(0);
             } else {
               float value;
-              OP_REQUIRES(ctx, strings::safe_strtof(fields[f], &value),
+              OP_REQUIRES(ctx, csv::ParseNumber(fields[f], &value),
                           errors::InvalidArgument(
                               "Field ", f, " in record ", i,
                               " is not a valid float: ", fields[f]));
@@ -166,7 +172,7 @@ class DecodeCSVOp : public OpKernel {
                   record_defaults[f].flat<double>()(0);
             } else {
               double value;
-              OP_REQUIRES(ctx, strings::safe_strtod(fields[f], &value),
+              OP_REQUIRES(ctx, csv::ParseNumber(fields[f], &value),
                           errors::InvalidArgument(
                               "Field ", f, " in record ", i,
                               " is not a valid double: ", fields[f]));
@@ -185,7 +191,7 @@ class DecodeCSVOp : public OpKernel {
               output[f]->flat<tstring>()(i) =
                   record_defaults[f].flat<tstring>()(0);
             } else {
-              output[f]->flat<tstring>()(i) = std::move(fields[f]);
+              output[f]->flat<tstring>()(i) = fields[f];
             }
             break;
           }
@@ -206,14 +212,17 @@ class DecodeCSVOp : public OpKernel {
   bool select_all_cols_;
   string na_value_;
 
-  void ExtractFields(OpKernelContext* ctx, StringPiece input,
-                     std::vector<string>* result) {
-    int64_t current_idx = 0;
+  // Splits `input` into `fields`, which point into `input` unless they are
+  // quoted fields with escaped quotes, whose unescaped contents are kept in
+  // `unescaped`.
+  Status ExtractFields(StringPiece input, std::vector<StringPiece>* fields,
+                       std::deque<string>* unescaped) {
+    size_t current_idx = 0;
     int64_t num_fields_parsed = 0;
     int64_t selector_idx = 0;  // Keep track of index into select_cols
 
     if (!input.empty()) {
-      while (static_cast<size_t>(current_idx) < input.size()) {
+      while (current_idx < input.size()) {
         if (input[current_idx] == '\n' || input[current_idx] == '\r') {
           current_idx++;
           continue;
@@ -230,57 +239,65 @@ class DecodeCSVOp : public OpKernel {
         }
 
         // This is the body of the field;
-        string field;
+        StringPiece field;
         if (!quoted) {
-          while (static_cast<size_t>(current_idx) < input.size() &&
-                 input[current_idx] != delim_) {
-            OP_REQUIRES(ctx,
-                        (!use_quote_delim_ || input[current_idx] != '"') &&
-                            input[current_idx] != '\n' &&
-                            input[current_idx] != '\r',
-                        errors::InvalidArgument(
-                            "Unquoted fields cannot have quotes/CRLFs inside"));
-            if (include) field += input[current_idx];
-            current_idx++;
+          const size_t end = csv::FindUnquotedFieldEnd(
+              input, current_idx, delim_, use_quote_delim_);
+          if (end < input.size() && input[end] != delim_) {
+            return errors::InvalidArgument(
+                "Unquoted fields cannot have quotes/CRLFs inside");
           }
+          field = input.substr(current_idx, end - current_idx);
 
           // Go to next field or the end
-          current_idx++;
-        } else if (use_quote_delim_) {
+          current_idx = end + 1;
+        } else {
           // Quoted field needs to be ended with '"' and delim or end
-          while (
-              (static_cast<size_t>(current_idx) < input.size() - 1) &&
-              (input[current_idx] != '"' || input[current_idx + 1] != delim_)) {
-            if (input[current_idx] != '"') {
-              if (include) field += input[current_idx];
-              current_idx++;
-            } else {
-              OP_REQUIRES(
-                  ctx, input[current_idx + 1] == '"',
-                  errors::InvalidArgument("Quote inside a string has to be "
-                                          "escaped by another quote"));
-              if (include) field += '"';
-              current_idx += 2;
+          const size_t begin = current_idx;
+          string* field_unescaped = nullptr;
+          while (current_idx < input.size() - 1) {
+            const size_t quote = std::min(csv::FindQuote(input, current_idx),
+                                          input.size() - 1);
+            if (field_unescaped != nullptr) {
+              field_unescaped->append(input.data() + current_idx,
+                                      quote - current_idx);
+            }
+            current_idx = quote;
+            if (current_idx == input.size() - 1 ||
+                input[current_idx + 1] == delim_) {
+              break;
             }
+            if (input[current_idx + 1] != '"') {
+              return errors::InvalidArgument(
+                  "Quote inside a string has to be escaped by another quote");
+            }
+            if (field_unescaped == nullptr) {
+              unescaped->emplace_back(input.data() + begin,
+                                      current_idx - begin);
+              field_unescaped = &unescaped->back();
+            }
+            field_unescaped->push_back('"');
+            current_idx += 2;
           }
 
-          OP_REQUIRES(
-              ctx,
-              (static_cast<size_t>(current_idx) < input.size() &&
-               input[current_idx] == '"' &&
-               (static_cast<size_t>(current_idx) == input.size() - 1 ||
-                input[current_idx + 1] == delim_)),
-              errors::InvalidArgument("Quoted field has to end with quote "
-                                      "followed by delim or end"));
+          if (current_idx >= input.size() || input[current_idx] != '"' ||
+              (current_idx != input.size() - 1 &&
+               input[current_idx + 1] != delim_)) {
+            return errors::InvalidArgument(
+                "Quoted field has to end with quote followed by delim or end");
+          }
+          field = field_unescaped != nullptr
+                      ? StringPiece(*field_unescaped)
+                      : input.substr(begin, current_idx - begin);
 
           current_idx += 2;
         }
 
         num_fields_parsed++;
         if (include) {
-          result->push_back(field);
+          fields->push_back(field);
           selector_idx++;
-          if (selector_idx == select_cols_.size()) return;
+          if (selector_idx == select_cols_.size()) return OkStatus();
         }
       }
 
@@ -289,8 +306,9 @@ class DecodeCSVOp : public OpKernel {
                                    static_cast<size_t>(num_fields_parsed));
       // Check if the last field is missing
       if (include && input[input.size() - 1] == delim_)
-        result->push_back(string());
+        fields->push_back(StringPiece());
     }
+    return OkStatus();
   }
 };
 
@@ -0,0 +1,357 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Implements scaled dot-product attention as a single op:
+//   softmax(scale * query * key^T + mask) * value
+//
+// The op is created by the Grappler remapper from the BatchMatMul, Mul,
+// (Add,) Softmax, BatchMatMul subgraph. Instead of materializing the
+// [L_q, L_k] attention scores, each block of query rows is processed against
+// blocks of key and value rows with an online softmax, keeping only one block
+// of scores and the running output of the query block in memory.
+//
+// Currently supported only on CPU device.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "Eigen/Core"  // from @eigen_archive
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// The number of query rows and key rows processed together. A block of scores
+// takes 16KB of float, which stays in the L1/L2 cache together with the
+// running output.
+constexpr int64_t kQueryBlockSize = 32;
+constexpr int64_t kKeyBlockSize = 128;
+
+// Strides to read an optional mask that is broadcast to the shape of the
+// attention scores, [batch..., L_q, L_k].
+struct MaskStrides {
+  // Per batch dimension; 0 for broadcast dimensions.
+  gtl::InlinedVector<int64_t, 4> batch;
+  int64_t query = 0;
+  int64_t key = 0;
+};
+
+}  // namespace
+
+template <typename T>
+class FusedScaledDotProductAttentionOp : public OpKernel {
+ public:
+  explicit FusedScaledDotProductAttentionOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("scale", &scale_));
+    OP_REQUIRES_OK(context, context->GetAttr("adj_key", &adj_key_));
+    int num_args;
+    OP_REQUIRES_OK(context, context->GetAttr("num_args", &num_args));
+    OP_REQUIRES(context, num_args <= 1,
+                errors::InvalidArgument(
+                    "_FusedScaledDotProductAttention supports at most one "
+                    "mask argument, got ",
+                    num_args));
+    has_mask_ = num_args == 1;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& query = context->input(0);
+    const Tensor& key = context->input(1);
+    const Tensor& value = context->input(2);
+
+    const int rank = query.dims();
+    OP_REQUIRES(context, rank >= 2,
+                errors::InvalidArgument("query must be at least rank 2: ",
+                                        query.shape().DebugString()));
+    OP_REQUIRES(
+        context, key.dims() == rank && value.dims() == rank,
+        errors::InvalidArgument(
+            "query, key and value must have the same rank: ",
+            query.shape().DebugString(), " vs. ", key.shape().DebugString(),
+            " vs. ", value.shape().DebugString()));
+    int64_t batch_size = 1;
+    for (int i = 0; i < rank - 2; ++i) {
+      OP_REQUIRES(context,
+                  key.dim_size(i) == query.dim_size(i) &&
+                      value.dim_size(i) == query.dim_size(i),
+                  errors::InvalidArgument(
+                      "query, key and value must have the same batch "
+                      "dimensions: ",
+                      query.shape().DebugString(), " vs. ",
+                      key.shape().DebugString(), " vs. ",
+                      value.shape().DebugString()));
+      batch_size *= query.dim_size(i);
+    }
+
+    const int64_t query_length = query.dim_size(rank - 2);
+    const int64_t depth = query.dim_size(rank - 1);
+    const int64_t key_length = key.dim_size(adj_key_ ? rank - 2 : rank - 1);
+    const int64_t key_depth = key.dim_size(adj_key_ ? rank - 1 : rank - 2);
+    const int64_t value_depth = value.dim_size(rank - 1);
+    OP_REQUIRES(context, key_depth == depth,
+                errors::InvalidArgument(
+                    "query and key must have the same depth: ",
+                    query.shape().DebugString(), " vs. ",
+                    key.shape().DebugString()));
+    OP_REQUIRES(context, value.dim_size(rank - 2) == key_length,
+                errors::InvalidArgument(
+                    "key and value must have the same length: ",
+                    key.shape().DebugString(), " vs. ",
+                    value.shape().DebugString()));
+
+    MaskStrides mask_strides;
+    const T* mask_data = nullptr;
+    if (has_mask_) {
+      const Tensor& mask = context->input(3);
+      OP_REQUIRES_OK(context,
+                     GetMaskStrides(query.shape(), query_length, key_length,
+                                    mask.shape(), &mask_strides));
+      mask_data = mask.flat<T>().data();
+    }
+
+    TensorShape output_shape = query.shape();
+    output_shape.set_dim(rank - 1, value_depth);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+    if (key_length == 0) {
+      // Matches BatchMatMul with an empty inner dimension.
+      output->flat<T>().setZero();
+      return;
+    }
+
+    Args args;
+    args.query = query.flat<T>().data();
+    args.key = key.flat<T>().data();
+    args.value = value.flat<T>().data();
+    args.mask = mask_data;
+    args.mask_strides = &mask_strides;
+    args.output = output->flat<T>().data();
+    args.query_length = query_length;
+    args.key_length = key_length;
+    args.depth = depth;
+    args.value_depth = value_depth;
+    for (int i = 0; i < rank - 2; ++i) {
+      args.batch_dims.push_back(query.dim_size(i));
+    }
+
+    // Work is split into (batch, query block) units.
+    const int64_t num_query_blocks =
+        (query_length + kQueryBlockSize - 1) / kQueryBlockSize;
+    const int64_t cost_per_unit =
+        kQueryBlockSize * key_length * (2 * (depth + value_depth) + 20);
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers,
+          batch_size * num_query_blocks, cost_per_unit,
+          [this, &args, num_query_blocks](int64_t start, int64_t limit) {
+            ComputeBlocks(args, num_query_blocks, start, limit);
+          });
+  }
+
+ private:
+  using Matrix =
+      Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+  using ConstMatrixMap =
+      Eigen::Map<const Matrix, Eigen::Unaligned, Eigen::OuterStride<>>;
+  using MatrixMap = Eigen::Map<Matrix, Eigen::Unaligned, Eigen::OuterStride<>>;
+
+  struct Args {
+    const T* query;
+    const T* key;
+    const T* value;
+    const T* mask;
+    const MaskStrides* mask_strides;
+    T* output;
+    gtl::InlinedVector<int64_t, 4> batch_dims;
+    int64_t query_length;
+    int64_t key_length;
+    int64_t depth;
+    int64_t value_depth;
+  };
+
+  // Computes the strides to broadcast `mask_shape` to the attention scores,
+  // aligning their trailing dimensions.
+  static Status GetMaskStrides(const TensorShape& query_shape,
+                               int64_t query_length, int64_t key_length,
+                               const TensorShape& mask_shape,
+                               MaskStrides* strides) {
+    const int rank = query_shape.dims();
+    const int mask_rank = mask_shape.dims();
+    if (mask_rank > rank) {
+      return errors::InvalidArgument("mask has a higher rank than query: ",
+                                     mask_shape.DebugString(), " vs. ",
+                                     query_shape.DebugString());
+    }
+    strides->batch.assign(rank - 2, 0);
+    int64_t stride = 1;
+    for (int i = rank - 1; i >= rank - mask_rank; --i) {
+      const int64_t mask_dim = mask_shape.dim_size(i - (rank - mask_rank));
+      const int64_t scores_dim = i == rank - 1   ? key_length
+                                 : i == rank - 2 ? query_length
+                                                 : query_shape.dim_size(i);
+      if (mask_dim != 1 && mask_dim != scores_dim) {
+        return errors::InvalidArgument(
+            "mask of shape ", mask_shape.DebugString(),
+            " can not be broadcast to the attention scores of query ",
+            query_shape.DebugString());
+      }
+      const int64_t dim_stride = mask_dim == 1 ? 0 : stride;
+      if (i == rank - 1) {
+        strides->key = dim_stride;
+      } else if (i == rank - 2) {
+        strides->query = dim_stride;
+      } else {
+        strides->batch[i] = dim_stride;
+      }
+      stride *= mask_dim;
+    }
+    return OkStatus();
+  }
+
+  // Computes the units [start, limit) of (batch, query block) pairs.
+  void ComputeBlocks(const Args& args, int64_t num_query_blocks, int64_t start,
+                     int64_t limit) const {
+    const int64_t depth = args.depth;
+    const int64_t value_depth = args.value_depth;
+    const int64_t key_length = args.key_length;
+    const T kNegativeInfinity = -std::numeric_limits<T>::infinity();
+
+    Matrix scaled_query(kQueryBlockSize, depth);
+    Matrix scores(kQueryBlockSize, kKeyBlockSize);
+    Matrix accumulator(kQueryBlockSize, value_depth);
+    std::vector<T> row_max(kQueryBlockSize);
+    std::vector<T> row_sum(kQueryBlockSize);
+
+    for (int64_t unit = start; unit < limit; ++unit) {
+      const int64_t batch = unit / num_query_blocks;
+      const int64_t query_begin = (unit % num_query_blocks) * kQueryBlockSize;
+      const int64_t num_queries =
+          std::min(kQueryBlockSize, args.query_length - query_begin);
+
+      const T* query = args.query + (batch * args.query_length + query_begin) *
+                                        args.depth;
+      const T* key = args.key + batch * key_length * depth;
+      const T* value = args.value + batch * key_length * value_depth;
+      const T* mask = args.mask;
+      if (mask != nullptr) {
+        int64_t remaining = batch;
+        for (int i = args.batch_dims.size() - 1; i >= 0; --i) {
+          mask +=
+              (remaining % args.batch_dims[i]) * args.mask_strides->batch[i];
+          remaining /= args.batch_dims[i];
+        }
+        mask += query_begin * args.mask_strides->query;
+      }
+
+      // Folding the scale into the query block is cheaper than scaling the
+      // scores.
+      auto query_block = scaled_query.topRows(num_queries);
+      query_block.noalias() = ConstMatrixMap(query, num_queries, depth,
+                                             Eigen::OuterStride<>(depth)) *
+                              static_cast<T>(scale_);
+      auto output_block = accumulator.topRows(num_queries);
+      output_block.setZero();
+      std::fill(row_max.begin(), row_max.end(), kNegativeInfinity);
+      std::fill(row_sum.begin(), row_sum.end(), T(0));
+
+      for (int64_t key_begin = 0; key_begin < key_length;
+           key_begin += kKeyBlockSize) {
+        const int64_t num_keys =
+            std::min(kKeyBlockSize, key_length - key_begin);
+        auto scores_block = scores.topLeftCorner(num_queries, num_keys);
+        if (adj_key_) {
+          scores_block.noalias() =
+              query_block *
+              ConstMatrixMap(key + key_begin * depth, num_keys, depth,
+                             Eigen::OuterStride<>(depth))
+                  .transpose();
+        } else {
+          scores_block.noalias() =
+              query_block * ConstMatrixMap(key + key_begin, depth, num_keys,
+                                           Eigen::OuterStride<>(key_length));
+        }
+
+        if (mask != nullptr) {
+          const MaskStrides& strides = *args.mask_strides;
+          for (int64_t i = 0; i < num_queries; ++i) {
+            const T* mask_row =
+                mask + i * strides.query + key_begin * strides.key;
+            for (int64_t j = 0; j < num_keys; ++j) {
+              scores_block(i, j) += mask_row[j * strides.key];
+            }
+          }
+        }
+
+        // Online softmax: rescale what was accumulated so far to the new row
+        // maximum, then add this block.
+        for (int64_t i = 0; i < num_queries; ++i) {
+          auto row = scores_block.row(i);
+          const T block_max = row.maxCoeff();
+          const T new_max = std::max(row_max[i], block_max);
+          if (new_max == kNegativeInfinity) {
+            // Fully masked so far; the block adds nothing.
+            row.setZero();
+            continue;
+          }
+          const T correction = std::exp(row_max[i] - new_max);
+          row = (row.array() - new_max).exp();
+          row_sum[i] = row_sum[i] * correction + row.sum();
+          row_max[i] = new_max;
+          output_block.row(i) *= correction;
+        }
+        output_block.noalias() +=
+            scores_block *
+            ConstMatrixMap(value + key_begin * value_depth, num_keys,
+                           value_depth, Eigen::OuterStride<>(value_depth));
+      }
+
+      T* output =
+          args.output + (batch * args.query_length + query_begin) * value_depth;
+      for (int64_t i = 0; i < num_queries; ++i) {
+        // Fully masked rows divide by zero, like Softmax.
+        MatrixMap(output + i * value_depth, 1, value_depth,
+                  Eigen::OuterStride<>(value_depth)) =
+            output_block.row(i) / row_sum[i];
+      }
+    }
+  }
+
+  float scale_;
+  bool adj_key_;
+  bool has_mask_;
+};
+
+#define REGISTER_CPU(T)                                             \
+  REGISTER_KERNEL_BUILDER(Name("_FusedScaledDotProductAttention")   \
+                              .Device(DEVICE_CPU)                   \
+                              .TypeConstraint<T>("T"),              \
+                          FusedScaledDotProductAttentionOp<T>);
+
+TF_CALL_float(REGISTER_CPU);
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
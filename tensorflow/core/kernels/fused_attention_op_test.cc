@@ -0,0 +1,237 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Computes softmax(scale * query * key^T + mask) * value one row at a time.
+// `query`, `key` and `value` have shape [batch, length, depth], and `mask`, if
+// not empty, [batch, 1, key_length].
+Tensor ReferenceAttention(const Tensor& query, const Tensor& key,
+                          const Tensor& value, const Tensor* mask,
+                          float scale) {
+  const int64_t batch = query.dim_size(0);
+  const int64_t query_length = query.dim_size(1);
+  const int64_t key_length = key.dim_size(1);
+  const int64_t depth = query.dim_size(2);
+  const int64_t value_depth = value.dim_size(2);
+  auto q = query.tensor<float, 3>();
+  auto k = key.tensor<float, 3>();
+  auto v = value.tensor<float, 3>();
+
+  Tensor output(DT_FLOAT, TensorShape({batch, query_length, value_depth}));
+  auto out = output.tensor<float, 3>();
+  std::vector<float> scores(key_length);
+  for (int64_t b = 0; b < batch; ++b) {
+    for (int64_t i = 0; i < query_length; ++i) {
+      float max_score = -std::numeric_limits<float>::infinity();
+      for (int64_t j = 0; j < key_length; ++j) {
+        float score = 0;
+        for (int64_t d = 0; d < depth; ++d) score += q(b, i, d) * k(b, j, d);
+        score *= scale;
+        if (mask != nullptr) score += mask->tensor<float, 3>()(b, 0, j);
+        scores[j] = score;
+        max_score = std::max(max_score, score);
+      }
+      float sum = 0;
+      for (int64_t j = 0; j < key_length; ++j) {
+        scores[j] = std::exp(scores[j] - max_score);
+        sum += scores[j];
+      }
+      for (int64_t d = 0; d < value_depth; ++d) {
+        float result = 0;
+        for (int64_t j = 0; j < key_length; ++j) {
+          result += scores[j] * v(b, j, d);
+        }
+        out(b, i, d) = result / sum;
+      }
+    }
+  }
+  return output;
+}
+
+class FusedScaledDotProductAttentionOpTest : public OpsTestBase {
+ protected:
+  void RunAttention(int64_t batch, int64_t query_length, int64_t key_length,
+                    int64_t depth, int64_t value_depth, bool with_mask) {
+    constexpr float kScale = 0.125f;
+    TF_ASSERT_OK(NodeDefBuilder("attention", "_FusedScaledDotProductAttention")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(with_mask ? 1 : 0, DT_FLOAT))
+                     .Attr("T", DT_FLOAT)
+                     .Attr("num_args", with_mask ? 1 : 0)
+                     .Attr("scale", kScale)
+                     .Attr("adj_key", true)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+
+    Tensor query(DT_FLOAT, TensorShape({batch, query_length, depth}));
+    Tensor key(DT_FLOAT, TensorShape({batch, key_length, depth}));
+    Tensor value(DT_FLOAT, TensorShape({batch, key_length, value_depth}));
+    Tensor mask(DT_FLOAT, TensorShape({batch, 1, key_length}));
+    query.flat<float>().setRandom();
+    key.flat<float>().setRandom();
+    value.flat<float>().setRandom();
+    mask.flat<float>().setRandom();
+    // Mask out every third key, including the whole first key block.
+    for (int64_t i = 0; i < mask.NumElements(); ++i) {
+      if (i % 3 == 0 || i % key_length < 128) mask.flat<float>()(i) = -1e9f;
+    }
+    if (key_length <= 128) mask.flat<float>().setZero();
+
+    AddInputFromArray<float>(query.shape(), query.flat<float>());
+    AddInputFromArray<float>(key.shape(), key.flat<float>());
+    AddInputFromArray<float>(value.shape(), value.flat<float>());
+    if (with_mask) AddInputFromArray<float>(mask.shape(), mask.flat<float>());
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected = ReferenceAttention(query, key, value,
+                                         with_mask ? &mask : nullptr, kScale);
+    test::ExpectClose(*GetOutput(0), expected, 1e-5, 1e-5);
+  }
+};
+
+TEST_F(FusedScaledDotProductAttentionOpTest, SingleBlock) {
+  RunAttention(/*batch=*/2, /*query_length=*/5, /*key_length=*/7,
+               /*depth=*/4, /*value_depth=*/3, /*with_mask=*/false);
+}
+
+TEST_F(FusedScaledDotProductAttentionOpTest, MultipleBlocks) {
+  RunAttention(/*batch=*/3, /*query_length=*/70, /*key_length=*/300,
+               /*depth=*/16, /*value_depth=*/8, /*with_mask=*/false);
+}
+
+TEST_F(FusedScaledDotProductAttentionOpTest, MaskedMultipleBlocks) {
+  RunAttention(/*batch=*/2, /*query_length=*/33, /*key_length=*/257,
+               /*depth=*/8, /*value_depth=*/8, /*with_mask=*/true);
+}
+
+TEST_F(FusedScaledDotProductAttentionOpTest, InvalidShapes) {
+  TF_ASSERT_OK(NodeDefBuilder("attention", "_FusedScaledDotProductAttention")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(0, DT_FLOAT))
+                   .Attr("T", DT_FLOAT)
+                   .Attr("num_args", 0)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({1, 2, 3}), std::vector<float>(6));
+  AddInputFromArray<float>(TensorShape({1, 2, 4}), std::vector<float>(8));
+  AddInputFromArray<float>(TensorShape({1, 2, 3}), std::vector<float>(6));
+  EXPECT_FALSE(RunOpKernel().ok());
+}
+
+// Performance benchmarks below.
+
+// Builds a self-attention graph over inputs of shape
+// [batch, num_heads, length, depth], either as separate BatchMatMulV2, Mul,
+// Softmax and BatchMatMulV2 nodes or as a single fused node.
+static Graph* Attention(int batch, int num_heads, int length, int depth,
+                        bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, TensorShape({batch, num_heads, length, depth}));
+  input.flat<float>().setRandom();
+  Node* query = test::graph::Constant(g, input);
+  Node* key = test::graph::Constant(g, input);
+  Node* value = test::graph::Constant(g, input);
+  const float scale = 1.0f / std::sqrt(static_cast<float>(depth));
+
+  Node* output;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("attention"),
+                            "_FusedScaledDotProductAttention")
+                    .Input(query)
+                    .Input(key)
+                    .Input(value)
+                    .Input(std::vector<NodeBuilder::NodeOut>())
+                    .Attr("T", DT_FLOAT)
+                    .Attr("num_args", 0)
+                    .Attr("scale", scale)
+                    .Attr("adj_key", true)
+                    .Finalize(g, &output));
+    return g;
+  }
+
+  Tensor scale_tensor(DT_FLOAT, TensorShape({}));
+  scale_tensor.scalar<float>()() = scale;
+  Node* scores;
+  TF_CHECK_OK(NodeBuilder(g->NewName("qk"), "BatchMatMulV2")
+                  .Input(query)
+                  .Input(key)
+                  .Attr("T", DT_FLOAT)
+                  .Attr("adj_y", true)
+                  .Finalize(g, &scores));
+  TF_CHECK_OK(NodeBuilder(g->NewName("scale"), "Mul")
+                  .Input(scores)
+                  .Input(test::graph::Constant(g, scale_tensor))
+                  .Attr("T", DT_FLOAT)
+                  .Finalize(g, &scores));
+  TF_CHECK_OK(NodeBuilder(g->NewName("softmax"), "Softmax")
+                  .Input(scores)
+                  .Attr("T", DT_FLOAT)
+                  .Finalize(g, &scores));
+  TF_CHECK_OK(NodeBuilder(g->NewName("attention"), "BatchMatMulV2")
+                  .Input(scores)
+                  .Input(value)
+                  .Attr("T", DT_FLOAT)
+                  .Finalize(g, &output));
+  return g;
+}
+
+#define BM_Attention(B, H, L, D, FUSED, LABEL)                                \
+  static void BM_Attention_##LABEL##_##B##_##H##_##L##_##D(                   \
+      ::testing::benchmark::State& state) {                                   \
+    test::Benchmark("cpu", Attention(B, H, L, D, FUSED),                      \
+                    /*old_benchmark_api=*/false)                              \
+        .Run(state);                                                          \
+    /* Two matrix multiplications of 2 * L * L * D flops each. */             \
+    state.SetItemsProcessed(state.iterations() * int64_t{4} * B * H * L * L * \
+                            D);                                               \
+  }                                                                           \
+  BENCHMARK(BM_Attention_##LABEL##_##B##_##H##_##L##_##D)                     \
+      ->UseRealTime()                                                         \
+      ->MeasureProcessCPUTime();
+
+#define BM_AttentionFusedAndUnfused(B, H, L, D) \
+  BM_Attention(B, H, L, D, false, Unfused);     \
+  BM_Attention(B, H, L, D, true, Fused);
+
+BM_AttentionFusedAndUnfused(1, 8, 128, 64);
+BM_AttentionFusedAndUnfused(1, 8, 512, 64);
+BM_AttentionFusedAndUnfused(1, 8, 1024, 64);
+BM_AttentionFusedAndUnfused(1, 8, 2048, 64);
+BM_AttentionFusedAndUnfused(1, 4, 4096, 64);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,287 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/image_ops.cc
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/op_requires.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/cleanup.h"
+#include "tensorflow/core/lib/jpeg/jpeg_mem.h"
+#include "tensorflow/core/lib/png/png_io.h"
+#include "tensorflow/core/platform/errors.h"
+#include "tensorflow/core/platform/stringpiece.h"
+#include "tensorflow/core/platform/tstring.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+namespace {
+
+// Magic bytes of the formats that can be decoded in place. See
+// decode_image_op.cc.
+static const char kPngMagicBytes[] = "\x89\x50\x4E\x47\x0D\x0A\x1A\x0A";
+static const char kJpegMagicBytes[] = "\xff\xd8\xff";
+
+// Rough number of cycles spent per byte of decoded output, used to decide
+// how many images each thread decodes.
+constexpr int64_t kDecodeCostPerByte = 50;
+
+enum class ImageFormat { kJpeg, kPng };
+
+// The format and decoded size of one image of the batch.
+struct ImageHeader {
+  ImageFormat format = ImageFormat::kJpeg;
+  int height = 0;
+  int width = 0;
+  // The JPEG DCT scaling denominator; always 1 for PNG.
+  int ratio = 1;
+};
+
+// Returns the size of a JPEG dimension after libjpeg scales it by 1 / ratio.
+int ScaledSize(int size, int ratio) { return (size + ratio - 1) / ratio; }
+
+// Returns the largest JPEG scaling denominator that keeps the image at least
+// `target_height` x `target_width`. A target of zero leaves that dimension
+// unconstrained, and no target at all disables scaling.
+int ChooseRatio(int height, int width, int target_height, int target_width) {
+  if (target_height == 0 && target_width == 0) return 1;
+  for (int ratio : {8, 4, 2}) {
+    if (ScaledSize(height, ratio) >= target_height &&
+        ScaledSize(width, ratio) >= target_width) {
+      return ratio;
+    }
+  }
+  return 1;
+}
+
+// Decodes a batch of JPEG and PNG images into one zero-padded uint8 tensor.
+//
+// Unlike mapping `DecodeImage` over the elements of a dataset, the images are
+// decoded concurrently on the intra-op thread pool, and each one is written
+// straight into its slice of the output, so that no per-image buffers are
+// allocated or copied.
+class DecodeImageBatchOp : public OpKernel {
+ public:
+  explicit DecodeImageBatchOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("channels", &channels_));
+    OP_REQUIRES(context, channels_ == 1 || channels_ == 3 || channels_ == 4,
+                errors::InvalidArgument("`channels` must be 1, 3 or 4 but got ",
+                                        channels_));
+    OP_REQUIRES_OK(context, context->GetAttr("target_height", &target_height_));
+    OP_REQUIRES_OK(context, context->GetAttr("target_width", &target_width_));
+    OP_REQUIRES(context, target_height_ >= 0 && target_width_ >= 0,
+                errors::InvalidArgument(
+                    "`target_height` and `target_width` must be non-negative "
+                    "but got ",
+                    target_height_, " and ", target_width_));
+    OP_REQUIRES_OK(context, context->GetAttr("fancy_upscaling",
+                                             &flags_.fancy_upscaling));
+    string dct_method;
+    OP_REQUIRES_OK(context, context->GetAttr("dct_method", &dct_method));
+    OP_REQUIRES(
+        context,
+        (dct_method.empty() || dct_method == "INTEGER_FAST" ||
+         dct_method == "INTEGER_ACCURATE"),
+        errors::InvalidArgument("dct_method must be one of "
+                                "{'', 'INTEGER_FAST', 'INTEGER_ACCURATE'}"));
+    flags_.dct_method =
+        dct_method == "INTEGER_ACCURATE" ? JDCT_ISLOW : JDCT_IFAST;
+    flags_.components = channels_;
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& contents = context->input(0);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(contents.shape()),
+                errors::InvalidArgument("`contents` must be 1-D but got shape ",
+                                        contents.shape().DebugString()));
+    const auto contents_vec = contents.vec<tstring>();
+    const int64_t batch_size = contents_vec.size();
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+
+    // Read the headers first, so that the output can be allocated once.
+    std::vector<ImageHeader> headers(batch_size);
+    std::vector<Status> statuses(batch_size);
+    Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
+          /*cost_per_unit=*/10000, [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              statuses[i] = ReadHeader(contents_vec(i), &headers[i]);
+            }
+          });
+    int max_height = 0;
+    int max_width = 0;
+    for (int64_t i = 0; i < batch_size; ++i) {
+      OP_REQUIRES_OK(context, statuses[i]);
+      max_height = std::max(max_height, headers[i].height);
+      max_width = std::max(max_width, headers[i].width);
+    }
+    OP_REQUIRES(
+        context,
+        static_cast<int64_t>(max_width) * channels_ <=
+            std::numeric_limits<int>::max(),
+        errors::InvalidArgument("Images are too wide for int: ", max_width));
+
+    Tensor* images = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({batch_size, max_height, max_width,
+                                       channels_}),
+                       &images));
+    Tensor* image_shapes = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, TensorShape({batch_size, 3}),
+                                            &image_shapes));
+    auto image_shapes_mat = image_shapes->matrix<int32>();
+    for (int64_t i = 0; i < batch_size; ++i) {
+      image_shapes_mat(i, 0) = headers[i].height;
+      image_shapes_mat(i, 1) = headers[i].width;
+      image_shapes_mat(i, 2) = channels_;
+    }
+    if (images->NumElements() == 0) return;
+
+    const int stride = max_width * channels_;
+    const int64_t image_size = static_cast<int64_t>(max_height) * stride;
+    uint8* images_data = images->flat<uint8>().data();
+    Shard(worker_threads->num_threads, worker_threads->workers, batch_size,
+          image_size * kDecodeCostPerByte, [&](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) {
+              uint8* image = images_data + i * image_size;
+              statuses[i] = Decode(contents_vec(i), headers[i], stride, image);
+              // Pad the rest of the slice with zeros.
+              const int row_size = headers[i].width * channels_;
+              for (int y = 0; y < headers[i].height; ++y) {
+                std::memset(image + static_cast<int64_t>(y) * stride + row_size,
+                            0, stride - row_size);
+              }
+              std::memset(
+                  image + static_cast<int64_t>(headers[i].height) * stride, 0,
+                  static_cast<int64_t>(max_height - headers[i].height) *
+                      stride);
+            }
+          });
+    for (int64_t i = 0; i < batch_size; ++i) {
+      OP_REQUIRES_OK(context, statuses[i]);
+    }
+  }
+
+ private:
+  // Fills `header` with the format and decoded size of `input`.
+  Status ReadHeader(StringPiece input, ImageHeader* header) const {
+    if (input.empty()) return errors::InvalidArgument("Input is empty.");
+    if (input.size() > std::numeric_limits<int>::max()) {
+      return errors::InvalidArgument("Input contents are too large for int: ",
+                                     input.size());
+    }
+    if (absl::StartsWith(input, kJpegMagicBytes)) {
+      if (channels_ == 4) {
+        return errors::InvalidArgument("JPEG does not support 4 channels");
+      }
+      int width, height;
+      if (!jpeg::GetImageInfo(input.data(), input.size(), &width, &height,
+                              nullptr)) {
+        return errors::InvalidArgument("Invalid JPEG header.");
+      }
+      header->format = ImageFormat::kJpeg;
+      header->ratio = ChooseRatio(height, width, target_height_, target_width_);
+      header->height = ScaledSize(height, header->ratio);
+      header->width = ScaledSize(width, header->ratio);
+      return OkStatus();
+    }
+    if (absl::StartsWith(input, kPngMagicBytes)) {
+      png::DecodeContext decode;
+      if (!png::CommonInitDecode(input, channels_, 8, &decode)) {
+        return errors::InvalidArgument(
+            "Invalid PNG. Failed to initialize decoder.");
+      }
+      const png_uint_32 width = decode.width;
+      const png_uint_32 height = decode.height;
+      png::CommonFreeDecode(&decode);
+      // Same limits as `DecodePng`.
+      if (width == 0 || width >= (1LL << 27) || height == 0 ||
+          height >= (1LL << 27) ||
+          static_cast<int64_t>(width) * height >= (1LL << 29)) {
+        return errors::InvalidArgument("PNG size too large for int: ", width,
+                                       " by ", height);
+      }
+      header->format = ImageFormat::kPng;
+      header->height = height;
+      header->width = width;
+      return OkStatus();
+    }
+    return errors::InvalidArgument(
+        "Unknown image file format. JPEG or PNG required.");
+  }
+
+  // Decodes `input` into `image`, whose rows are `stride` bytes apart.
+  Status Decode(StringPiece input, const ImageHeader& header, int stride,
+                uint8* image) const {
+    if (header.format == ImageFormat::kJpeg) {
+      jpeg::UncompressFlags flags = flags_;
+      flags.ratio = header.ratio;
+      flags.stride = stride;
+      const uint8* decoded = jpeg::Uncompress(
+          input.data(), input.size(), flags, nullptr /* nwarn */,
+          [&](int width, int height, int channels) -> uint8* {
+            if (width != header.width || height != header.height ||
+                channels != channels_) {
+              return nullptr;
+            }
+            return image;
+          });
+      if (decoded == nullptr) {
+        return errors::InvalidArgument(
+            "jpeg::Uncompress failed. Invalid JPEG data.");
+      }
+      return OkStatus();
+    }
+    png::DecodeContext decode;
+    if (!png::CommonInitDecode(input, channels_, 8, &decode)) {
+      return errors::InvalidArgument(
+          "Invalid PNG. Failed to initialize decoder.");
+    }
+    auto cleanup =
+        gtl::MakeCleanup([&decode]() { png::CommonFreeDecode(&decode); });
+    if (decode.width != static_cast<png_uint_32>(header.width) ||
+        decode.height != static_cast<png_uint_32>(header.height)) {
+      return errors::InvalidArgument("Invalid PNG data, size ", input.size());
+    }
+    if (!png::CommonFinishDecode(reinterpret_cast<png_bytep>(image), stride,
+                                 &decode)) {
+      return errors::InvalidArgument("Invalid PNG data, size ", input.size());
+    }
+    return OkStatus();
+  }
+
+  int channels_;
+  int target_height_;
+  int target_width_;
+  jpeg::UncompressFlags flags_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("DecodeImageBatch").Device(DEVICE_CPU),
+                        DecodeImageBatchOp);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,224 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <vector>
+
+#include "absl/strings/match.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/jpeg/jpeg_mem.h"
+#include "tensorflow/core/lib/png/png_io.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns an RGB gradient image of the given size.
+std::vector<uint8> MakeImage(int height, int width) {
+  std::vector<uint8> image(height * width * 3);
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint8* pixel = &image[(y * width + x) * 3];
+      pixel[0] = 255 * y / height;
+      pixel[1] = 255 * x / width;
+      pixel[2] = 128;
+    }
+  }
+  return image;
+}
+
+tstring EncodeJpeg(int height, int width) {
+  jpeg::CompressFlags flags;
+  flags.format = jpeg::FORMAT_RGB;
+  flags.quality = 90;
+  return jpeg::Compress(MakeImage(height, width).data(), width, height, flags);
+}
+
+tstring EncodePng(int height, int width) {
+  tstring png;
+  CHECK(png::WriteImageToBuffer(MakeImage(height, width).data(), width, height,
+                                width * 3, 3, 8, -1, &png, nullptr));
+  return png;
+}
+
+class DecodeImageBatchOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(int channels, int target_height, int target_width) {
+    TF_ASSERT_OK(NodeDefBuilder("decode_op", "DecodeImageBatch")
+                     .Input(FakeInput(DT_STRING))
+                     .Attr("channels", channels)
+                     .Attr("target_height", target_height)
+                     .Attr("target_width", target_width)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Checks that image `i` of the output is `expected`, padded with zeros.
+  void ExpectImage(int i, const uint8* expected, int height, int width) {
+    const Tensor& images = *GetOutput(0);
+    const auto images_tensor = images.tensor<uint8, 4>();
+    for (int y = 0; y < images.dim_size(1); ++y) {
+      for (int x = 0; x < images.dim_size(2); ++x) {
+        for (int c = 0; c < 3; ++c) {
+          const uint8 value = y < height && x < width
+                                  ? expected[(y * width + x) * 3 + c]
+                                  : 0;
+          ASSERT_EQ(images_tensor(i, y, x, c), value)
+              << "image " << i << " at " << y << ", " << x << ", " << c;
+        }
+      }
+    }
+  }
+};
+
+// Decodes `jpeg` like `DecodeJpeg` does.
+std::unique_ptr<uint8[]> DecodeJpeg(const tstring& jpeg, int ratio) {
+  jpeg::UncompressFlags flags;
+  flags.components = 3;
+  flags.ratio = ratio;
+  flags.dct_method = JDCT_IFAST;
+  return std::unique_ptr<uint8[]>(jpeg::Uncompress(
+      jpeg.data(), jpeg.size(), flags, nullptr, nullptr, nullptr, nullptr));
+}
+
+TEST_F(DecodeImageBatchOpTest, DecodesPaddedBatch) {
+  MakeOp(3, 0, 0);
+  const tstring jpeg_a = EncodeJpeg(24, 32);
+  const tstring jpeg_b = EncodeJpeg(40, 16);
+  const tstring png = EncodePng(10, 20);
+  AddInputFromArray<tstring>(TensorShape({3}), {jpeg_a, jpeg_b, png});
+  TF_ASSERT_OK(RunOpKernel());
+
+  EXPECT_EQ(GetOutput(0)->shape(), TensorShape({3, 40, 32, 3}));
+  test::ExpectTensorEqual<int32>(
+      *GetOutput(1),
+      test::AsTensor<int32>({24, 32, 3, 40, 16, 3, 10, 20, 3}, {3, 3}));
+  ExpectImage(0, DecodeJpeg(jpeg_a, 1).get(), 24, 32);
+  ExpectImage(1, DecodeJpeg(jpeg_b, 1).get(), 40, 16);
+  ExpectImage(2, MakeImage(10, 20).data(), 10, 20);
+}
+
+TEST_F(DecodeImageBatchOpTest, DownscalesJpegToTarget) {
+  // 1/2 is the smallest scale that keeps the image at least 16x16.
+  MakeOp(3, 16, 16);
+  const tstring jpeg = EncodeJpeg(64, 48);
+  AddInputFromArray<tstring>(TensorShape({1}), {jpeg});
+  TF_ASSERT_OK(RunOpKernel());
+
+  EXPECT_EQ(GetOutput(0)->shape(), TensorShape({1, 32, 24, 3}));
+  ExpectImage(0, DecodeJpeg(jpeg, 2).get(), 32, 24);
+}
+
+TEST_F(DecodeImageBatchOpTest, EmptyBatch) {
+  MakeOp(3, 0, 0);
+  AddInputFromArray<tstring>(TensorShape({0}), {});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(GetOutput(0)->shape(), TensorShape({0, 0, 0, 3}));
+  EXPECT_EQ(GetOutput(1)->shape(), TensorShape({0, 3}));
+}
+
+TEST_F(DecodeImageBatchOpTest, FailsForUnknownFormat) {
+  MakeOp(3, 0, 0);
+  AddInputFromArray<tstring>(TensorShape({2}),
+                             {EncodeJpeg(8, 8), "not an image"});
+  Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status));
+  EXPECT_TRUE(absl::StrContains(status.message(), "Unknown image file format"));
+}
+
+TEST_F(DecodeImageBatchOpTest, FailsForFourChannelJpeg) {
+  MakeOp(4, 0, 0);
+  AddInputFromArray<tstring>(TensorShape({1}), {EncodeJpeg(8, 8)});
+  Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status));
+}
+
+Tensor MakeJpegs(int batch_size, int size) {
+  Tensor contents(DT_STRING, TensorShape({batch_size}));
+  contents.flat<tstring>().setConstant(EncodeJpeg(size, size));
+  return contents;
+}
+
+// Decodes `batch_size` images with one DecodeImageBatch op.
+Graph* DecodeBatch(int batch_size, int size) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DecodeImageBatch")
+                  .Input(test::graph::Constant(g, MakeJpegs(batch_size, size)))
+                  .Attr("channels", 3)
+                  .Finalize(g, &ret));
+  return g;
+}
+
+// Decodes `batch_size` images with one DecodeImage op each, which run
+// concurrently, as when mapping `decode_image` over a dataset.
+Graph* DecodeEach(int batch_size, int size) {
+  Graph* g = new Graph(OpRegistry::Global());
+  const Tensor jpeg(EncodeJpeg(size, size));
+  for (int i = 0; i < batch_size; ++i) {
+    Node* ret;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "DecodeImage")
+                    .Input(test::graph::Constant(g, jpeg))
+                    .Attr("channels", 3)
+                    .Attr("expand_animations", false)
+                    .Finalize(g, &ret));
+  }
+  return g;
+}
+
+// Both benchmarks use every core: the batched op on the intra-op thread pool,
+// and the per-image ops on the inter-op thread pool. Items are images.
+void BM_DecodeImageBatch(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+  const int size = state.range(1);
+  test::Benchmark("cpu", DecodeBatch(batch_size, size),
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+void BM_DecodeImageEach(::testing::benchmark::State& state) {
+  const int batch_size = state.range(0);
+  const int size = state.range(1);
+  test::Benchmark("cpu", DecodeEach(batch_size, size),
+                  /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations() * batch_size);
+}
+
+BENCHMARK(BM_DecodeImageBatch)
+    ->UseRealTime()
+    ->ArgPair(32, 64)
+    ->ArgPair(32, 224)
+    ->ArgPair(128, 224)
+    ->ArgPair(32, 512);
+BENCHMARK(BM_DecodeImageEach)
+    ->UseRealTime()
+    ->ArgPair(32, 64)
+    ->ArgPair(32, 224)
+    ->ArgPair(128, 224)
+    ->ArgPair(32, 512);
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,16 +15,23 @@ limitations under the License.
 
 // Tests kernels of lookup ops.
 
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/lookup_interface.h"
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/shape_inference_testutil.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 namespace {
@@ -100,5 +107,211 @@ TEST_F(LookupOpsTest, AnonymousHashTable_RefCounting) {
   EXPECT_FALSE(alive);
 }
 
+class ShardedMutableHashTableTest : public OpsTestBase {
+ protected:
+  // Creates a table through `op_name` with the sharded kernel label and
+  // returns it in `table`, which the caller must Unref.
+  void CreateTable(const string& op_name, DataType key_dtype,
+                   DataType value_dtype, const TensorShape& value_shape,
+                   lookup::LookupInterface** table) {
+    NodeDefBuilder builder("table", op_name);
+    builder.Attr("key_dtype", key_dtype)
+        .Attr("value_dtype", value_dtype)
+        .Attr("_kernel", "sharded");
+    if (op_name == "MutableHashTableOfTensorsV2") {
+      builder.Attr("value_shape", value_shape);
+    }
+    TF_ASSERT_OK(builder.Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    TF_ASSERT_OK(RunOpKernel());
+    TF_ASSERT_OK(LookupResource(
+        context_.get(), GetOutput(0)->scalar<ResourceHandle>()(), table));
+  }
+};
+
+TEST_F(ShardedMutableHashTableTest, InsertFindRemoveScalars) {
+  lookup::LookupInterface* table = nullptr;
+  CreateTable("MutableHashTableV2", DT_INT64, DT_FLOAT, TensorShape(), &table);
+  ASSERT_NE(table, nullptr);
+  core::ScopedUnref unref(table);
+
+  // Duplicate keys within a batch resolve to the last value, as in
+  // MutableHashTableOfScalars.
+  TF_ASSERT_OK(table->Insert(
+      context_.get(), test::AsTensor<int64_t>({1, 2, 3, 2}),
+      test::AsTensor<float>({1.0f, 2.0f, 3.0f, 20.0f})));
+  EXPECT_EQ(table->size(), 3);
+
+  Tensor values(DT_FLOAT, TensorShape({4}));
+  TF_ASSERT_OK(table->Find(context_.get(),
+                           test::AsTensor<int64_t>({3, 4, 2, 1}), &values,
+                           test::AsScalar<float>(-1.0f)));
+  test::ExpectTensorEqual<float>(
+      values, test::AsTensor<float>({3.0f, -1.0f, 20.0f, 1.0f}));
+
+  // A full-size default provides one default value per key.
+  Tensor pair(DT_FLOAT, TensorShape({2}));
+  TF_ASSERT_OK(table->Find(context_.get(), test::AsTensor<int64_t>({5, 1}),
+                           &pair, test::AsTensor<float>({-5.0f, -6.0f})));
+  test::ExpectTensorEqual<float>(pair, test::AsTensor<float>({-5.0f, 1.0f}));
+
+  TF_ASSERT_OK(table->Remove(context_.get(), test::AsTensor<int64_t>({2, 7})));
+  EXPECT_EQ(table->size(), 2);
+  TF_ASSERT_OK(table->Find(context_.get(),
+                           test::AsTensor<int64_t>({1, 2, 3, 4}), &values,
+                           test::AsScalar<float>(0.0f)));
+  test::ExpectTensorEqual<float>(
+      values, test::AsTensor<float>({1.0f, 0.0f, 3.0f, 0.0f}));
+}
+
+TEST_F(ShardedMutableHashTableTest, InsertFindTensors) {
+  lookup::LookupInterface* table = nullptr;
+  CreateTable("MutableHashTableOfTensorsV2", DT_STRING, DT_INT64,
+              TensorShape({2}), &table);
+  ASSERT_NE(table, nullptr);
+  core::ScopedUnref unref(table);
+
+  TF_ASSERT_OK(table->Insert(
+      context_.get(), test::AsTensor<tstring>({"a", "b"}),
+      test::AsTensor<int64_t>({1, 2, 3, 4}, TensorShape({2, 2}))));
+  EXPECT_EQ(table->size(), 2);
+  EXPECT_EQ(table->value_shape(), TensorShape({2}));
+
+  Tensor values(DT_INT64, TensorShape({3, 2}));
+  TF_ASSERT_OK(table->Find(context_.get(),
+                           test::AsTensor<tstring>({"b", "c", "a"}), &values,
+                           test::AsTensor<int64_t>({-1, -2})));
+  test::ExpectTensorEqual<int64_t>(
+      values,
+      test::AsTensor<int64_t>({3, 4, -1, -2, 1, 2}, TensorShape({3, 2})));
+}
+
+TEST_F(ShardedMutableHashTableTest, LargeBatch) {
+  lookup::LookupInterface* table = nullptr;
+  CreateTable("MutableHashTableV2", DT_INT64, DT_INT64, TensorShape(), &table);
+  ASSERT_NE(table, nullptr);
+  core::ScopedUnref unref(table);
+
+  constexpr int64_t kNumKeys = 100000;
+  Tensor keys(DT_INT64, TensorShape({kNumKeys}));
+  Tensor values(DT_INT64, TensorShape({kNumKeys}));
+  for (int64_t i = 0; i < kNumKeys; ++i) {
+    keys.flat<int64_t>()(i) = i * 7919;
+    values.flat<int64_t>()(i) = i;
+  }
+  TF_ASSERT_OK(table->Insert(context_.get(), keys, values));
+  EXPECT_EQ(table->size(), kNumKeys);
+
+  Tensor found(DT_INT64, TensorShape({kNumKeys}));
+  TF_ASSERT_OK(
+      table->Find(context_.get(), keys, &found, test::AsScalar<int64_t>(-1)));
+  test::ExpectTensorEqual<int64_t>(found, values);
+
+  // Importing replaces the previous contents.
+  TF_ASSERT_OK(table->ImportValues(context_.get(), test::AsTensor<int64_t>({0}),
+                                   test::AsTensor<int64_t>({42})));
+  EXPECT_EQ(table->size(), 1);
+}
+
+// Builds a MutableHashTableV2 (value_dim == 0) or MutableHashTableOfTensorsV2
+// node sharing a table named `shared_name`.
+static Node* MutableHashTable(Graph* g, bool sharded, int value_dim) {
+  Node* ret;
+  NodeBuilder builder(g->NewName("table"), value_dim == 0
+                                               ? "MutableHashTableV2"
+                                               : "MutableHashTableOfTensorsV2");
+  builder.Attr("shared_name", "bench_table")
+      .Attr("key_dtype", DT_INT64)
+      .Attr("value_dtype", DT_FLOAT);
+  if (value_dim > 0) {
+    builder.Attr("value_shape", TensorShape({value_dim}));
+  }
+  if (sharded) {
+    builder.Attr("_kernel", "sharded");
+  }
+  TF_CHECK_OK(builder.Finalize(g, &ret));
+  return ret;
+}
+
+static Tensor RandomKeys(int64_t num_keys, int64_t table_size) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor keys(DT_INT64, TensorShape({num_keys}));
+  for (int64_t i = 0; i < num_keys; ++i) {
+    keys.flat<int64_t>()(i) = rnd.Uniform64(table_size);
+  }
+  return keys;
+}
+
+static Tensor RandomValues(int64_t num_keys, int value_dim) {
+  Tensor values(DT_FLOAT, value_dim == 0 ? TensorShape({num_keys})
+                                         : TensorShape({num_keys, value_dim}));
+  values.flat<float>().setRandom();
+  return values;
+}
+
+// Runs `num_finders` concurrent LookupTableFindV2 ops and `num_inserters`
+// concurrent LookupTableInsertV2 ops against one pre-populated table.
+static void BM_MutableHashTable(::testing::benchmark::State& state) {
+  const bool sharded = state.range(0);
+  const int num_finders = state.range(1);
+  const int num_inserters = state.range(2);
+  const int value_dim = state.range(3);
+  constexpr int64_t kTableSize = 1 << 18;
+  constexpr int64_t kBatchSize = 4096;
+
+  Graph* init = new Graph(OpRegistry::Global());
+  {
+    Tensor keys(DT_INT64, TensorShape({kTableSize}));
+    for (int64_t i = 0; i < kTableSize; ++i) keys.flat<int64_t>()(i) = i;
+    Node* import;
+    TF_CHECK_OK(NodeBuilder(init->NewName("import"), "LookupTableImportV2")
+                    .Input(MutableHashTable(init, sharded, value_dim))
+                    .Input(test::graph::Constant(init, keys))
+                    .Input(test::graph::Constant(
+                        init, RandomValues(kTableSize, value_dim)))
+                    .Finalize(init, &import));
+  }
+
+  Graph* g = new Graph(OpRegistry::Global());
+  Node* table = MutableHashTable(g, sharded, value_dim);
+  Tensor default_tensor(DT_FLOAT, value_dim == 0 ? TensorShape({})
+                                                 : TensorShape({value_dim}));
+  default_tensor.flat<float>().setZero();
+  Node* default_value = test::graph::Constant(g, default_tensor);
+  for (int i = 0; i < num_finders; ++i) {
+    Node* find;
+    TF_CHECK_OK(NodeBuilder(g->NewName("find"), "LookupTableFindV2")
+                    .Input(table)
+                    .Input(test::graph::Constant(
+                        g, RandomKeys(kBatchSize, kTableSize)))
+                    .Input(default_value)
+                    .Finalize(g, &find));
+  }
+  for (int i = 0; i < num_inserters; ++i) {
+    Node* insert;
+    TF_CHECK_OK(NodeBuilder(g->NewName("insert"), "LookupTableInsertV2")
+                    .Input(table)
+                    .Input(test::graph::Constant(
+                        g, RandomKeys(kBatchSize, kTableSize)))
+                    .Input(test::graph::Constant(
+                        g, RandomValues(kBatchSize, value_dim)))
+                    .Finalize(g, &insert));
+  }
+
+  test::Benchmark("cpu", g, /*options=*/nullptr, init, /*rendez=*/nullptr, "",
+                  /*old_benchmark_api=*/false)
+      .Run(state);
+  state.SetItemsProcessed(state.iterations() * (num_finders + num_inserters) *
+                          kBatchSize);
+  state.SetLabel(sharded ? "sharded" : "single_lock");
+}
+
+// Args: sharded, num_finders, num_inserters, value_dim (0 for scalars).
+BENCHMARK(BM_MutableHashTable)
+    ->UseRealTime()
+    ->ArgsProduct({{0, 1}, {1, 4, 16, 64}, {0}, {0, 64}})
+    ->ArgsProduct({{0, 1}, {4, 16, 64}, {1, 4}, {0, 64}});
+
 }  // namespace
 }  // namespace tensorflow
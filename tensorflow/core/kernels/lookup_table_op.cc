@@ -16,10 +16,14 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <array>
+#include <functional>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "absl/hash/hash.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/variant.h"
@@ -27,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/random.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace lookup {
@@ -408,6 +413,394 @@ class MutableHashTableOfTensors final : public LookupInterface {
   std::unordered_map<K, ValueArray> table_ TF_GUARDED_BY(mu_);
 };
 
+// Kernel label that selects the ShardedMutableHashTable implementation of the
+// MutableHashTable ops, i.e. nodes whose `_kernel` attr is set to this value.
+constexpr char kShardedMutableHashTableLabel[] = "sharded";
+
+// Lookup table that partitions its keys over a fixed number of open-addressing
+// hash maps, each guarded by its own reader/writer lock. Behaves identical to
+// MutableHashTableOfScalars (kVectorValues == false) and
+// MutableHashTableOfTensors (kVectorValues == true), except that concurrent
+// Find, Insert and Remove calls only contend when they touch the same shard.
+//
+// Batched operations hash the whole key tensor once, group the keys by shard
+// and visit every shard under a single lock acquisition. Large batches are
+// spread over the intra-op threadpool.
+template <class K, class V, bool kVectorValues>
+class ShardedMutableHashTable final : public LookupInterface {
+ public:
+  ShardedMutableHashTable(OpKernelContext* ctx, OpKernel* kernel) {
+    if (kVectorValues) {
+      OP_REQUIRES_OK(ctx,
+                     GetNodeAttr(kernel->def(), "value_shape", &value_shape_));
+      OP_REQUIRES(
+          ctx, TensorShapeUtils::IsVector(value_shape_),
+          errors::InvalidArgument("Default value must be a vector, got shape ",
+                                  value_shape_.DebugString()));
+    }
+  }
+
+  size_t size() const override {
+    size_t ret = 0;
+    for (const TableShard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      ret += shard.map.size();
+    }
+    return ret;
+  }
+
+  Status Find(OpKernelContext* ctx, const Tensor& key, Tensor* value,
+              const Tensor& default_value) override {
+    const auto key_values = key.flat<K>();
+    const int64_t num_keys = key_values.size();
+    const int64_t value_dim = ValueDim();
+    auto value_matrix = value->shaped<V, 2>({num_keys, value_dim});
+    const auto default_flat = default_value.flat<V>();
+
+    // is_full_size_default is true:
+    //   Each key has an independent default value, key_values(i)
+    //   corresponding uses the i-th row of default_value as its default.
+    //
+    // is_full_size_default is false:
+    //   All keys share the first row of default_value as default value.
+    const bool is_full_size_default =
+        (default_flat.size() == value_matrix.size());
+
+    std::vector<int64_t> offsets;
+    std::vector<int64_t> order;
+    GroupByShard(key_values, &offsets, &order);
+    ForEachShard(
+        ctx, offsets, kFindCostPerKey + value_dim,
+        [&](int s, int64_t begin, int64_t end) {
+          const TableShard& shard = shards_[s];
+          tf_shared_lock l(shard.mu);
+          for (int64_t k = begin; k < end; ++k) {
+            const int64_t i = order[k];
+            auto it = shard.map.find(SubtleMustCopyIfIntegral(key_values(i)));
+            if (it != shard.map.end()) {
+              for (int64_t j = 0; j < value_dim; ++j) {
+                value_matrix(i, j) = ValueAt(it->second, j);
+              }
+            } else {
+              const int64_t default_row = is_full_size_default ? i : 0;
+              for (int64_t j = 0; j < value_dim; ++j) {
+                value_matrix(i, j) = default_flat(default_row * value_dim + j);
+              }
+            }
+          }
+        });
+    return OkStatus();
+  }
+
+  Status Insert(OpKernelContext* ctx, const Tensor& keys,
+                const Tensor& values) override {
+    const auto key_values = keys.flat<K>();
+    const auto value_matrix =
+        values.shaped<V, 2>({key_values.size(), ValueDim()});
+
+    std::vector<int64_t> offsets;
+    std::vector<int64_t> order;
+    GroupByShard(key_values, &offsets, &order);
+    ForEachShard(ctx, offsets, kInsertCostPerKey + ValueDim(),
+                 [&](int s, int64_t begin, int64_t end) {
+                   TableShard* shard = &shards_[s];
+                   mutex_lock l(shard->mu);
+                   InsertIntoShard(key_values, value_matrix, order, begin, end,
+                                   shard);
+                 });
+    return OkStatus();
+  }
+
+  Status Remove(OpKernelContext* ctx, const Tensor& keys) override {
+    const auto key_values = keys.flat<K>();
+
+    std::vector<int64_t> offsets;
+    std::vector<int64_t> order;
+    GroupByShard(key_values, &offsets, &order);
+    ForEachShard(ctx, offsets, kInsertCostPerKey,
+                 [&](int s, int64_t begin, int64_t end) {
+                   TableShard& shard = shards_[s];
+                   mutex_lock l(shard.mu);
+                   for (int64_t k = begin; k < end; ++k) {
+                     shard.map.erase(
+                         SubtleMustCopyIfIntegral(key_values(order[k])));
+                   }
+                 });
+    return OkStatus();
+  }
+
+  Status ImportValues(OpKernelContext* ctx, const Tensor& keys,
+                      const Tensor& values) override {
+    const auto key_values = keys.flat<K>();
+    const auto value_matrix =
+        values.shaped<V, 2>({key_values.size(), ValueDim()});
+
+    std::vector<int64_t> offsets;
+    std::vector<int64_t> order;
+    GroupByShard(key_values, &offsets, &order);
+
+    // Hold every shard lock so that readers never observe a partially
+    // replaced table.
+    std::vector<mutex_lock> locks;
+    locks.reserve(kNumShards);
+    for (TableShard& shard : shards_) {
+      locks.emplace_back(shard.mu);
+    }
+    ImportLocked(ctx, key_values, value_matrix, offsets, order);
+    return OkStatus();
+  }
+
+  Status ExportValues(OpKernelContext* ctx) override {
+    std::vector<tf_shared_lock> locks;
+    locks.reserve(kNumShards);
+    for (const TableShard& shard : shards_) {
+      locks.emplace_back(shard.mu);
+    }
+    const int64_t size = SizeLocked();
+
+    Tensor* keys;
+    Tensor* values;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("keys", TensorShape({size}), &keys));
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("values", ExportedValuesShape(size), &values));
+    ExportKeysAndValuesLocked(keys, values);
+    return OkStatus();
+  }
+
+  DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
+
+  DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
+
+  TensorShape key_shape() const final { return TensorShape(); }
+
+  TensorShape value_shape() const override { return value_shape_; }
+
+  int64_t MemoryUsed() const override {
+    int64_t ret = 0;
+    for (const TableShard& shard : shards_) {
+      tf_shared_lock l(shard.mu);
+      // One control byte plus one slot per bucket.
+      ret += shard.map.capacity() * (1 + sizeof(std::pair<K, StoredValue>));
+    }
+    return sizeof(ShardedMutableHashTable) + ret;
+  }
+
+  Status AsGraphDef(GraphDefBuilder* builder, Node** out) const override {
+    std::vector<tf_shared_lock> locks;
+    locks.reserve(kNumShards);
+    for (const TableShard& shard : shards_) {
+      locks.emplace_back(shard.mu);
+    }
+    const int64_t size = SizeLocked();
+    Tensor keys(key_dtype(), TensorShape({size}));
+    Tensor values(value_dtype(), ExportedValuesShape(size));
+    ExportKeysAndValuesLocked(&keys, &values);
+
+    // See MutableHashTableOfScalars::AsGraphDef for why the node name is made
+    // unique. The kernel label keeps the restored table sharded.
+    const GraphDefBuilder::Options table_opts =
+        builder->opts()
+            .WithName(UniqueNodeName("ShardedMutableHashTableFromGraphDef"))
+            .WithAttr("use_node_name_sharing", true)
+            .WithAttr("key_dtype", key_dtype())
+            .WithAttr("value_dtype", value_dtype())
+            .WithAttr("_kernel", kShardedMutableHashTableLabel);
+    Node* table =
+        kVectorValues
+            ? ops::SourceOp("MutableHashTableOfTensorsV2",
+                            table_opts.WithAttr("value_shape", value_shape_))
+            : ops::SourceOp("MutableHashTableV2", table_opts);
+    Node* keys_node = ops::SourceOp(
+        "Const",
+        builder->opts().WithAttr("dtype", key_dtype()).WithAttr("value", keys));
+    Node* values_node =
+        ops::SourceOp("Const", builder->opts()
+                                   .WithAttr("dtype", value_dtype())
+                                   .WithAttr("value", values));
+    Node* import_table =
+        ops::TernaryOp("LookupTableImportV2", table, keys_node, values_node,
+                       builder->opts()
+                           .WithAttr("Tin", key_dtype())
+                           .WithAttr("Tout", value_dtype()));
+    *out = ops::UnaryOp("Identity", table,
+                        builder->opts().WithControlInput(import_table));
+    return OkStatus();
+  }
+
+ private:
+  typedef gtl::InlinedVector<V, 4> ValueArray;
+  typedef typename std::conditional<kVectorValues, ValueArray, V>::type
+      StoredValue;
+
+  struct TableShard {
+    mutable mutex mu;
+    absl::flat_hash_map<K, StoredValue> map TF_GUARDED_BY(mu);
+  };
+
+  // Must be a power of two; the shard is picked from the top hash bits so
+  // that the bits used by the per-shard flat_hash_map stay well distributed.
+  static constexpr int kLog2NumShards = 6;
+  static constexpr int kNumShards = 1 << kLog2NumShards;
+
+  // Batches with fewer keys than this are processed on the calling thread.
+  static constexpr int64_t kMinKeysForParallelism = 16384;
+
+  // Rough per-key costs, in cycles, used to shard work over the threadpool.
+  static constexpr int64_t kFindCostPerKey = 50;
+  static constexpr int64_t kInsertCostPerKey = 100;
+
+  int64_t ValueDim() const {
+    return kVectorValues ? value_shape_.dim_size(0) : 1;
+  }
+
+  TensorShape ExportedValuesShape(int64_t size) const {
+    if (kVectorValues) return TensorShape({size, value_shape_.dim_size(0)});
+    return TensorShape({size});
+  }
+
+  static int ShardIndex(const K& key) {
+    const size_t hash = absl::Hash<K>()(key);
+    return static_cast<int>(hash >> (sizeof(size_t) * 8 - kLog2NumShards));
+  }
+
+  static const V& ValueAt(const StoredValue& value, int64_t j) {
+    if constexpr (kVectorValues) {
+      return value[j];
+    } else {
+      return value;
+    }
+  }
+
+  static StoredValue MakeValue(typename TTypes<V>::ConstMatrix value_matrix,
+                               int64_t i) {
+    if constexpr (kVectorValues) {
+      ValueArray value_vec(value_matrix.dimension(1));
+      for (int64_t j = 0; j < value_matrix.dimension(1); ++j) {
+        value_vec[j] = SubtleMustCopyIfIntegral(value_matrix(i, j));
+      }
+      return value_vec;
+    } else {
+      return SubtleMustCopyIfIntegral(value_matrix(i, 0));
+    }
+  }
+
+  // Groups the indices [0, key_values.size()) by the shard that owns the
+  // corresponding key. On return, the keys owned by shard `s` are at indices
+  // (*order)[(*offsets)[s]], ..., (*order)[(*offsets)[s + 1] - 1], in their
+  // original relative order so that the last duplicate still wins on insert.
+  static void GroupByShard(typename TTypes<K>::ConstFlat key_values,
+                           std::vector<int64_t>* offsets,
+                           std::vector<int64_t>* order) {
+    const int64_t num_keys = key_values.size();
+    std::vector<uint8> shard_ids(num_keys);
+    offsets->assign(kNumShards + 1, 0);
+    for (int64_t i = 0; i < num_keys; ++i) {
+      shard_ids[i] = ShardIndex(key_values(i));
+      ++(*offsets)[shard_ids[i] + 1];
+    }
+    for (int s = 0; s < kNumShards; ++s) {
+      (*offsets)[s + 1] += (*offsets)[s];
+    }
+    std::vector<int64_t> next(offsets->begin(), offsets->end() - 1);
+    order->resize(num_keys);
+    for (int64_t i = 0; i < num_keys; ++i) {
+      (*order)[next[shard_ids[i]]++] = i;
+    }
+  }
+
+  // Calls `fn(s, begin, end)` for every shard `s` that owns at least one key,
+  // where [begin, end) is the shard's range in the `order` computed by
+  // GroupByShard. Shards are processed in parallel on the intra-op threadpool
+  // when the batch is large enough to amortize the scheduling overhead.
+  static void ForEachShard(
+      OpKernelContext* ctx, const std::vector<int64_t>& offsets,
+      int64_t cost_per_key,
+      const std::function<void(int, int64_t, int64_t)>& fn) {
+    auto work = [&offsets, &fn](int64_t start, int64_t limit) {
+      for (int64_t s = start; s < limit; ++s) {
+        if (offsets[s] < offsets[s + 1]) {
+          fn(static_cast<int>(s), offsets[s], offsets[s + 1]);
+        }
+      }
+    };
+    const int64_t num_keys = offsets.back();
+    if (ctx == nullptr || num_keys < kMinKeysForParallelism) {
+      work(0, kNumShards);
+      return;
+    }
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, kNumShards,
+          cost_per_key * num_keys / kNumShards, work);
+  }
+
+  static void InsertIntoShard(typename TTypes<K>::ConstFlat key_values,
+                              typename TTypes<V>::ConstMatrix value_matrix,
+                              const std::vector<int64_t>& order, int64_t begin,
+                              int64_t end, TableShard* shard)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(shard->mu) {
+    for (int64_t k = begin; k < end; ++k) {
+      const int64_t i = order[k];
+      shard->map.insert_or_assign(SubtleMustCopyIfIntegral(key_values(i)),
+                                  MakeValue(value_matrix, i));
+    }
+  }
+
+  // Replaces the contents of every shard. The caller must hold all shard
+  // locks exclusively.
+  void ImportLocked(OpKernelContext* ctx,
+                    typename TTypes<K>::ConstFlat key_values,
+                    typename TTypes<V>::ConstMatrix value_matrix,
+                    const std::vector<int64_t>& offsets,
+                    const std::vector<int64_t>& order)
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    for (TableShard& shard : shards_) {
+      shard.map.clear();
+    }
+    ForEachShard(ctx, offsets, kInsertCostPerKey + ValueDim(),
+                 [&](int s, int64_t begin, int64_t end) {
+                   InsertIntoShard(key_values, value_matrix, order, begin, end,
+                                   &shards_[s]);
+                 });
+  }
+
+  // The caller must hold all shard locks.
+  int64_t SizeLocked() const TF_NO_THREAD_SAFETY_ANALYSIS {
+    int64_t size = 0;
+    for (const TableShard& shard : shards_) {
+      size += shard.map.size();
+    }
+    return size;
+  }
+
+  // Writes all keys and values into `keys` and `values`, which must have
+  // SizeLocked() rows. The caller must hold all shard locks.
+  void ExportKeysAndValuesLocked(Tensor* keys, Tensor* values) const
+      TF_NO_THREAD_SAFETY_ANALYSIS {
+    const int64_t value_dim = ValueDim();
+    auto keys_data = keys->flat<K>();
+    auto values_data = values->shaped<V, 2>({keys_data.size(), value_dim});
+    int64_t i = 0;
+    for (const TableShard& shard : shards_) {
+      for (auto it = shard.map.begin(); it != shard.map.end(); ++it, ++i) {
+        keys_data(i) = it->first;
+        for (int64_t j = 0; j < value_dim; ++j) {
+          values_data(i, j) = ValueAt(it->second, j);
+        }
+      }
+    }
+  }
+
+  TensorShape value_shape_;
+  std::array<TableShard, kNumShards> shards_;
+};
+
+template <class K, class V>
+using ShardedMutableHashTableOfScalars = ShardedMutableHashTable<K, V, false>;
+
+template <class K, class V>
+using ShardedMutableHashTableOfTensors = ShardedMutableHashTable<K, V, true>;
+
 namespace {
 
 template <typename T>
@@ -1201,6 +1594,63 @@ REGISTER_KERNEL(tstring, int64_t);
 
 #undef REGISTER_KERNEL
 
+// Register the sharded MutableHashTable and MutableHashTableOfTensors ops,
+// selected by setting the `_kernel` attr of the table op to "sharded".
+#define REGISTER_KERNEL(key_dtype, value_dtype)                                \
+  REGISTER_KERNEL_BUILDER(                                                     \
+      Name("MutableHashTableV2")                                               \
+          .Device(DEVICE_CPU)                                                  \
+          .TypeConstraint<key_dtype>("key_dtype")                              \
+          .TypeConstraint<value_dtype>("value_dtype")                          \
+          .Label(lookup::kShardedMutableHashTableLabel),                       \
+      LookupTableOp<                                                           \
+          lookup::ShardedMutableHashTableOfScalars<key_dtype, value_dtype>,    \
+          key_dtype, value_dtype>)                                             \
+  REGISTER_KERNEL_BUILDER(                                                     \
+      Name("AnonymousMutableHashTable")                                        \
+          .Device(DEVICE_CPU)                                                  \
+          .TypeConstraint<key_dtype>("key_dtype")                              \
+          .TypeConstraint<value_dtype>("value_dtype")                          \
+          .Label(lookup::kShardedMutableHashTableLabel),                       \
+      AnonymousLookupTableOp<                                                  \
+          lookup::ShardedMutableHashTableOfScalars<key_dtype, value_dtype>,    \
+          key_dtype, value_dtype>)                                             \
+  REGISTER_KERNEL_BUILDER(                                                     \
+      Name("MutableHashTableOfTensorsV2")                                      \
+          .Device(DEVICE_CPU)                                                  \
+          .TypeConstraint<key_dtype>("key_dtype")                              \
+          .TypeConstraint<value_dtype>("value_dtype")                          \
+          .Label(lookup::kShardedMutableHashTableLabel),                       \
+      LookupTableOp<                                                           \
+          lookup::ShardedMutableHashTableOfTensors<key_dtype, value_dtype>,    \
+          key_dtype, value_dtype>)                                             \
+  REGISTER_KERNEL_BUILDER(                                                     \
+      Name("AnonymousMutableHashTableOfTensors")                               \
+          .Device(DEVICE_CPU)                                                  \
+          .TypeConstraint<key_dtype>("key_dtype")                              \
+          .TypeConstraint<value_dtype>("value_dtype")                          \
+          .Label(lookup::kShardedMutableHashTableLabel),                       \
+      AnonymousLookupTableOp<                                                  \
+          lookup::ShardedMutableHashTableOfTensors<key_dtype, value_dtype>,    \
+          key_dtype, value_dtype>)
+
+
+REGISTER_KERNEL(int32, double);
+REGISTER_KERNEL(int32, float);
+REGISTER_KERNEL(int32, int32);
+REGISTER_KERNEL(int64_t, double);
+REGISTER_KERNEL(int64_t, float);
+REGISTER_KERNEL(int64_t, int32);
+REGISTER_KERNEL(int64_t, int64_t);
+REGISTER_KERNEL(int64_t, tstring);
+REGISTER_KERNEL(tstring, bool);
+REGISTER_KERNEL(tstring, double);
+REGISTER_KERNEL(tstring, float);
+REGISTER_KERNEL(tstring, int32);
+REGISTER_KERNEL(tstring, int64_t);
+
+#undef REGISTER_KERNEL
+
 // Register the MutableDenseHashTable op.
 #define REGISTER_KERNEL(key_dtype, value_dtype)                             \
   REGISTER_KERNEL_BUILDER(                                                  \
@@ -18,7 +18,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_KERNELS_SEGMENT_REDUCTION_OPS_IMPL_H_
 #define TENSORFLOW_CORE_KERNELS_SEGMENT_REDUCTION_OPS_IMPL_H_
 
+#include <algorithm>
 #include <cstdint>
+#include <vector>
 
 #include "tensorflow/core/framework/op_requires.h"
 #include "tensorflow/core/platform/types.h"
@@ -77,6 +79,27 @@ Status ValidateSparseSegmentReduction(OpKernelContext* context,
                                       const Tensor& indices,
                                       const Tensor& segment_ids,
                                       bool has_num_segments);
+
+// Splits segments into at most `max_blocks` blocks of consecutive segments
+// with about the same number of rows, where segment `i` has rows
+// [segment_begin[i], segment_begin[i + 1]). Returns the first segment of each
+// block, followed by the number of segments. Blocks may be empty.
+inline std::vector<int64_t> BalancedSegmentBlocks(
+    const std::vector<int64_t>& segment_begin, int64_t max_blocks) {
+  const int64_t num_segments = segment_begin.size() - 1;
+  const int64_t num_blocks =
+      std::max<int64_t>(1, std::min(num_segments, max_blocks));
+  const int64_t num_rows = segment_begin.back() - segment_begin.front();
+  std::vector<int64_t> blocks(num_blocks + 1);
+  for (int64_t b = 0; b < num_blocks; ++b) {
+    blocks[b] = std::lower_bound(segment_begin.begin(), segment_begin.end() - 1,
+                                 segment_begin.front() +
+                                     num_rows * b / num_blocks) -
+                segment_begin.begin();
+  }
+  blocks[num_blocks] = num_segments;
+  return blocks;
+}
 }  // namespace internal
 
 // This operator handles reducing segments along the first dimension.
@@ -126,81 +149,110 @@ class SegmentReductionOp : public OpKernel {
                 errors::InvalidArgument("segment ids must be >= 0"));
     auto output_flat = output->flat_outer_dims<T>();
 
-    Eigen::IndexList<Eigen::type2index<0> > dims_to_reduce;
-    Index start = 0, end = 1;
-
-    Index uninitialized_index = 0;  // Index from which the output is not set.
-    Index out_index = internal::SubtleMustCopy(segment_vec(start));
-
-    // TODO(agarwal): if this loop becomes a bottleneck, consider sharding it
-    // across threads.
-    Eigen::DSizes<Eigen::DenseIndex, 1> out_slice_shape(num_col);
-    while (end <= num_indices) {
-      // We initialize next_index to 0 to avoid "warning: 'next_index' may be
-      // used uninitialized in this function" in the Mac build (since the
-      // compiler isn't smart enough to realize the code is safe).
-      Index next_index = 0;
-      if (end < num_indices) {
-        next_index = internal::SubtleMustCopy(segment_vec(end));
-        if (out_index == next_index) {
-          ++end;
-          continue;
+    // Finds the segments, checking that their ids are increasing and in range,
+    // so that they can then be reduced in parallel.
+    std::vector<int64_t> segment_begin;
+    std::vector<Index> segment_out_index;
+    {
+      Index start = 0, end = 1;
+      Index out_index = internal::SubtleMustCopy(segment_vec(start));
+      while (end <= num_indices) {
+        // We initialize next_index to 0 to avoid "warning: 'next_index' may be
+        // used uninitialized in this function" in the Mac build (since the
+        // compiler isn't smart enough to realize the code is safe).
+        Index next_index = 0;
+        if (end < num_indices) {
+          next_index = internal::SubtleMustCopy(segment_vec(end));
+          if (out_index == next_index) {
+            ++end;
+            continue;
+          }
+          // We have a new segment here.  Verify that the segment ids are
+          // growing.
+          OP_REQUIRES(
+              context, out_index < next_index,
+              errors::InvalidArgument("segment ids are not increasing"));
         }
-        // We have a new segment here.  Verify that the segment ids are growing.
-        OP_REQUIRES(context, out_index < next_index,
-                    errors::InvalidArgument("segment ids are not increasing"));
-      }
-
-      // Process segment [start, end)
-      const T* in_slice_ptr = &input_flat(start, 0);
-      typedef Eigen::TensorMap<Eigen::Tensor<T, 1, Eigen::RowMajor>,
-                               Eigen::Unaligned>
-          OutT;
 
-      OP_REQUIRES(
-          context, FastBoundsCheck(out_index, output_rows),
-          errors::InvalidArgument(
-              "Segment id ", out_index, " out of range [0, ", output_rows,
-              "), possibly because 'segment_ids' input is not sorted."));
-
-      // If there is a gap between two indices, we need to set that gap to the
-      // default value.
-      if (out_index > uninitialized_index) {
-        Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
-            out_index - uninitialized_index, num_col);
-        Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>, Eigen::Unaligned>
-            gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
-        gap_slice.setConstant(T(default_value));
+        OP_REQUIRES(
+            context, FastBoundsCheck(out_index, output_rows),
+            errors::InvalidArgument(
+                "Segment id ", out_index, " out of range [0, ", output_rows,
+                "), possibly because 'segment_ids' input is not sorted."));
+        segment_begin.push_back(start);
+        segment_out_index.push_back(out_index);
+
+        if (end >= num_indices) break;
+        start = end;
+        ++end;
+        out_index = next_index;
       }
+    }
+    segment_begin.push_back(num_indices);
 
-      T* out_slice_ptr = &output_flat(out_index, 0);
-      OutT out_slice(out_slice_ptr, out_slice_shape);
-      // We don't use out_slice.device(context->eigen_device<Device>)
-      // because these pieces of work are likely to be very small and
-      // the context switching overhead dwarfs any benefit we get from
-      // using another thread to do this work.
-      if (start == end - 1) {
-        typedef Eigen::TensorMap<Eigen::Tensor<const T, 1, Eigen::RowMajor>,
-                                 Eigen::Unaligned>
-            InT;
-        InT in_slice(in_slice_ptr, out_slice_shape);
-        out_slice = in_slice;
-      } else {
-        Eigen::DSizes<Eigen::DenseIndex, 2> in_slice_shape(end - start,
-                                                           num_col);
-        typedef Eigen::TensorMap<Eigen::Tensor<const T, 2, Eigen::RowMajor>,
+    const int64_t num_segments = segment_out_index.size();
+    const std::vector<int64_t> blocks = internal::BalancedSegmentBlocks(
+        segment_begin,
+        4 * context->device()->tensorflow_cpu_worker_threads()->num_threads);
+    const int64_t num_blocks = blocks.size() - 1;
+    Eigen::IndexList<Eigen::type2index<0> > dims_to_reduce;
+    Eigen::DSizes<Eigen::DenseIndex, 1> out_slice_shape(num_col);
+    auto reduce_segments = [&](int64_t first_block, int64_t last_block) {
+      for (int64_t s = blocks[first_block]; s < blocks[last_block]; ++s) {
+        const int64_t start = segment_begin[s];
+        const int64_t end = segment_begin[s + 1];
+        const Index out_index = segment_out_index[s];
+        // Index from which the output is not set by the previous segment.
+        const Index uninitialized_index =
+            s == 0 ? 0 : segment_out_index[s - 1] + 1;
+
+        // Process segment [start, end)
+        const T* in_slice_ptr = &input_flat(start, 0);
+        typedef Eigen::TensorMap<Eigen::Tensor<T, 1, Eigen::RowMajor>,
                                  Eigen::Unaligned>
-            InT;
-        InT in_slice(in_slice_ptr, in_slice_shape);
+            OutT;
+
+        // If there is a gap between two indices, we need to set that gap to
+        // the default value.
+        if (out_index > uninitialized_index) {
+          Eigen::DSizes<Eigen::DenseIndex, 2> gap_slice_shape(
+              out_index - uninitialized_index, num_col);
+          Eigen::TensorMap<Eigen::Tensor<T, 2, Eigen::RowMajor>,
+                           Eigen::Unaligned>
+              gap_slice(&output_flat(uninitialized_index, 0), gap_slice_shape);
+          gap_slice.setConstant(T(default_value));
+        }
 
-        out_slice = in_slice.reduce(dims_to_reduce, Reducer());
+        T* out_slice_ptr = &output_flat(out_index, 0);
+        OutT out_slice(out_slice_ptr, out_slice_shape);
+        // Blocks of segments are reduced in parallel, and each segment on
+        // one thread, since segments are likely to be small.
+        if (start == end - 1) {
+          typedef Eigen::TensorMap<Eigen::Tensor<const T, 1, Eigen::RowMajor>,
+                                   Eigen::Unaligned>
+              InT;
+          InT in_slice(in_slice_ptr, out_slice_shape);
+          out_slice = in_slice;
+        } else {
+          Eigen::DSizes<Eigen::DenseIndex, 2> in_slice_shape(end - start,
+                                                             num_col);
+          typedef Eigen::TensorMap<Eigen::Tensor<const T, 2, Eigen::RowMajor>,
+                                   Eigen::Unaligned>
+              InT;
+          InT in_slice(in_slice_ptr, in_slice_shape);
+
+          out_slice = in_slice.reduce(dims_to_reduce, Reducer());
+        }
       }
-      if (end >= num_indices) break;
-      start = end;
-      ++end;
-      uninitialized_index = out_index + 1;
-      out_index = next_index;
-    }
+    };
+
+    const int64_t rows_per_block = num_indices / num_blocks;
+    const Eigen::TensorOpCost cost(
+        /*bytes_loaded=*/sizeof(T) * num_col * rows_per_block,
+        /*bytes_stored=*/sizeof(T) * num_col * (num_segments / num_blocks),
+        /*compute_cycles=*/num_col * rows_per_block);
+    context->eigen_device<Device>().parallelFor(num_blocks, cost,
+                                                reduce_segments);
   }
 };
 
@@ -372,9 +424,12 @@ struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
     // output row, the row only fills with InitialValueF() will keep 0.
     // Length of non-zero elements is `num_reductions`.
     std::vector<Index> row_counter(num_segments, 0);
+    // The validated segment ids, which may not be read again from the input.
+    std::vector<Index> segment_ids_copy(N);
 
     for (int64_t i = 0; i < N; ++i) {
       Index j = internal::SubtleMustCopy(segment_ids(i));
+      segment_ids_copy[i] = j;
       if (j < 0) {
         --num_real_segment;
         continue;
@@ -390,36 +445,54 @@ struct UnsortedSegmentFunctor<CPUDevice, T, Index, InitialValueF, ReductionF> {
     // Nothing to reduce. All output values equal to `InitialValueF()`.
     if (num_reductions == 0) return;
 
-    // Parallelize by `num_segments`. It's simple, efficient and safe
-    // (no data dependency):
+    // Lists the input rows of each segment, in order, so that rows can be
+    // reduced in parallel by segment, and each worker only visits the rows of
+    // its own segments:
     //
-    //   input   segment_ids                 num_segments  operation
-    //   | a0 |  | 0 |            worker 1:  |0|           f(a0, a1)
-    //   | b0 |  | 1 |            worker 2:  |1|           f(b0, b1)
-    // N | c0 |  | 2 |       -->  worker 3:  |2|           f(c0)
+    //   input   segment_ids     rows          worker 1:  f(a0, a1)
+    //   | a0 |  | 0 |         0: | 0 | 4 |     worker 2:  f(b0, b1)
+    //   | b0 |  | 1 |   -->   1: | 1 | 3 |     worker 3:  f(c0)
+    // N | c0 |  | 2 |         2: | 2 |
     //   | b1 |  | 1 |
     //   | a1 |  | 0 |
     //
-    // TODO(intel-tf): Balance workload in `row_counter` to make parallelism
-    //                 more efficient.
+    // Rows are reduced in their order in the input, and blocks of segments
+    // with about the same number of rows are assigned to workers.
+    std::vector<int64_t> segment_begin(num_segments + 1, 0);
+    for (int64_t j = 0; j < num_segments; ++j) {
+      segment_begin[j + 1] = segment_begin[j] + row_counter[j];
+    }
+    std::vector<int64_t> segment_rows(num_real_segment);
+    {
+      std::vector<int64_t> next_row(segment_begin.begin(),
+                                    segment_begin.end() - 1);
+      for (int64_t i = 0; i < N; ++i) {
+        const Index j = segment_ids_copy[i];
+        if (j >= 0) segment_rows[next_row[j]++] = i;
+      }
+    }
+    const std::vector<int64_t> blocks = internal::BalancedSegmentBlocks(
+        segment_begin,
+        4 * ctx->device()->tensorflow_cpu_worker_threads()->num_threads);
+    const int64_t num_blocks = blocks.size() - 1;
+
     auto reductionWorker = [&](int64_t begin, int64_t end) -> void {
-      for (int64_t i = 0; i < N; i++) {
-        Index j = internal::SubtleMustCopy(segment_ids(i));
-        // If `j` is in work scope of this worker, do the reduction.
-        if (j >= begin && j < end) {
-          reduction(data.template chip<0>(i), output.template chip<0>(j));
+      for (int64_t j = blocks[begin]; j < blocks[end]; ++j) {
+        for (int64_t k = segment_begin[j]; k < segment_begin[j + 1]; ++k) {
+          reduction(data.template chip<0>(segment_rows[k]),
+                    output.template chip<0>(j));
         }
       }
     };
 
     // Reduction functors includes Sum, Max, Min, etc. Simply consider it
     // will cost 5 cycles per operation.
-    const int64_t kAverTaskSize = num_real_segment / num_segments;
+    const int64_t kAverTaskSize = num_real_segment / num_blocks;
     const int64_t compute_cycles = 5 * inner_dim * kAverTaskSize;
     const int64_t input_bytes = sizeof(T) * inner_dim * kAverTaskSize;
     const int64_t output_bytes = sizeof(T) * inner_dim * kAverTaskSize;
     const Eigen::TensorOpCost cost(input_bytes, output_bytes, compute_cycles);
-    cpu_device.parallelFor(num_segments, cost, reductionWorker);
+    cpu_device.parallelFor(num_blocks, cost, reductionWorker);
   }
 };
 
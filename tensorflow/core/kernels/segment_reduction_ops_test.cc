@@ -13,6 +13,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <cmath>
 #include <functional>
 #include <vector>
 
@@ -181,6 +182,110 @@ BM_Reduce_Arg(64, 32, 2);
 BM_Reduce_Arg(4096, 32, 2);
 BM_Reduce_Arg(4096, 128, 2);
 
+// Benchmarks SegmentSum (if `sorted`) or UnsortedSegmentSum of 65536 rows of
+// `num_cols` columns into `num_segments` segments. Segment lengths follow a
+// power law with exponent `skew`: with 1 all segments have the same length,
+// and with larger exponents the first segments are much longer than the
+// others. Unsorted segment ids are shuffled.
+static void BM_SkewedSegmentReduction(::testing::benchmark::State& state,
+                                      bool sorted) {
+  const int num_segments = state.range(0);
+  const int num_cols = state.range(1);
+  const int skew = state.range(2);
+  const int num_rows = 65536;
+  std::unique_ptr<Device> device(
+      DeviceFactory::NewDevice("CPU", {}, "/job:a/replica:0/task:0"));
+
+  gtl::InlinedVector<TensorValue, 4> reduction_inputs;
+  Tensor input(DT_FLOAT, TensorShape({num_rows, num_cols}));
+  input.flat<float>().setRandom();
+  reduction_inputs.push_back({nullptr, &input});
+
+  Tensor segment_ids(DT_INT32, TensorShape({num_rows}));
+  auto segment_ids_flat = segment_ids.flat<int32>();
+  for (int i = 0; i < num_rows; ++i) {
+    // Shuffle rows by a multiplier coprime with `num_rows`.
+    const int row = sorted ? i : (i * 40503) % num_rows;
+    segment_ids_flat(row) = static_cast<int32>(
+        num_segments * std::pow(static_cast<double>(i) / num_rows, skew));
+  }
+  reduction_inputs.push_back({nullptr, &segment_ids});
+  Tensor num_segments_t(DT_INT32, TensorShape({}));
+  num_segments_t.scalar<int32>()() = num_segments;
+  if (!sorted) reduction_inputs.push_back({nullptr, &num_segments_t});
+
+  NodeDefBuilder builder("reduction",
+                         sorted ? "SegmentSum" : "UnsortedSegmentSum");
+  builder.Input(FakeInput(DT_FLOAT)).Input(FakeInput(DT_INT32));
+  if (!sorted) builder.Input(FakeInput(DT_INT32));
+  NodeDef reduction_node_def;
+  TF_CHECK_OK(builder.Finalize(&reduction_node_def));
+  Status status;
+  std::unique_ptr<OpKernel> reduction_op(
+      CreateOpKernel(DEVICE_CPU, device.get(), cpu_allocator(),
+                     reduction_node_def, TF_GRAPH_DEF_VERSION, &status));
+  TF_CHECK_OK(status);
+
+  OpKernelContext::Params params;
+  params.device = device.get();
+  params.frame_iter = FrameAndIter(0, 0);
+  params.inputs = reduction_inputs;
+  params.op_kernel = reduction_op.get();
+  std::vector<AllocatorAttributes> attrs;
+  test::SetOutputAttrs(&params, &attrs);
+
+  std::unique_ptr<OpKernelContext> reduction_context(
+      new OpKernelContext(&params));
+
+  reduction_op->Compute(reduction_context.get());
+  TF_CHECK_OK(reduction_context->status());
+  for (auto s : state) {
+    delete reduction_context->release_output(0).tensor;
+    reduction_op->Compute(reduction_context.get());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          num_rows * num_cols * sizeof(float));
+}
+
+static void BM_SkewedSegmentSum(::testing::benchmark::State& state) {
+  BM_SkewedSegmentReduction(state, /*sorted=*/true);
+}
+
+static void BM_SkewedUnsortedSegmentSum(::testing::benchmark::State& state) {
+  BM_SkewedSegmentReduction(state, /*sorted=*/false);
+}
+
+// Arguments are the number of segments, the inner dimension and the skew.
+BENCHMARK(BM_SkewedSegmentSum)
+    ->UseRealTime()
+    ->Args({64, 16, 1})
+    ->Args({64, 16, 4})
+    ->Args({64, 64, 1})
+    ->Args({64, 64, 4})
+    ->Args({64, 256, 1})
+    ->Args({64, 256, 4})
+    ->Args({4096, 16, 1})
+    ->Args({4096, 16, 4})
+    ->Args({4096, 64, 1})
+    ->Args({4096, 64, 4})
+    ->Args({4096, 256, 1})
+    ->Args({4096, 256, 4});
+
+BENCHMARK(BM_SkewedUnsortedSegmentSum)
+    ->UseRealTime()
+    ->Args({64, 16, 1})
+    ->Args({64, 16, 4})
+    ->Args({64, 64, 1})
+    ->Args({64, 64, 4})
+    ->Args({64, 256, 1})
+    ->Args({64, 256, 4})
+    ->Args({4096, 16, 1})
+    ->Args({4096, 16, 4})
+    ->Args({4096, 64, 1})
+    ->Args({4096, 64, 4})
+    ->Args({4096, 256, 1})
+    ->Args({4096, 256, 4});
+
 template <DataType T>
 static void SparseSegmentMeanGradHelper(::testing::benchmark::State& state,
                                         float uniqueness, int size) {
@@ -19,11 +19,15 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/sparse_tensor_dense_matmul_op.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "tensorflow/core/framework/bounds_check.h"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/kernels/fill_functor.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -250,23 +254,26 @@ Status MOutOfBoundsError(int64_t m, std::size_t i, int lhs_index_a,
                                  "] out of bounds (>=", out_dim0, ")");
 }
 
+// Vectorize certain operations above this size.
+constexpr std::size_t kNumVectorize = 32;
+
+// Products with fewer multiply-adds than this are computed on one thread, in
+// the order of the entries of A.
+constexpr int64_t kMinMultiplyAddsForCsr = 32 * 1024;
+
 template <typename T, typename Tsum, typename Tindices, bool ADJ_A, bool ADJ_B>
 Status SparseTensorDenseMatMulImpl(
     typename TTypes<Tsum>::Matrix out,
     typename TTypes<Tindices>::ConstMatrix a_indices,
     typename TTypes<T>::ConstVec a_values, typename TTypes<T>::ConstMatrix b) {
-  // Vectorize certain operations above this size.
-  static constexpr std::size_t kNumVectorize = 32;
-
   const std::size_t nnz = a_values.size();
   const std::size_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
   const std::size_t lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
   const int lhs_index_a = ADJ_A ? 1 : 0;
   const int rhs_index_a = ADJ_A ? 0 : 1;
 
-  // TODO(ebrevdo): After many failed experiments, can't find a multi-threaded
-  // approach that achieves the performance of the single threaded
-  // one.  Perhaps Eigen threadpool implementation is just too slow?
+  // Large products are sharded over rows of a CSR copy of A instead, see
+  // SparseTensorDenseMatMulCsrImpl below.
 
   if (rhs_right < kNumVectorize) {
     // Disable vectorization if the RHS of output is too small
@@ -321,6 +328,131 @@ Status SparseTensorDenseMatMulImpl(
   }
   return OkStatus();
 }
+
+// Computes the same product as SparseTensorDenseMatMulImpl on the intra-op
+// threads.
+//
+// A is first converted to CSR by a stable counting sort of its entries by
+// output row, so that blocks of rows with about the same number of entries
+// can be accumulated independently. Each row is accumulated by AXPYs of rows
+// of B (materializing the adjoint of B once if needed), in the order of the
+// entries in `a_indices`, so that results match the single-threaded
+// implementation.
+template <typename T, typename Tsum, typename Tindices, bool ADJ_A, bool ADJ_B>
+Status SparseTensorDenseMatMulCsrImpl(
+    OpKernelContext* ctx, typename TTypes<Tsum>::Matrix out,
+    typename TTypes<Tindices>::ConstMatrix a_indices,
+    typename TTypes<T>::ConstVec a_values, typename TTypes<T>::ConstMatrix b) {
+  const std::size_t nnz = a_values.size();
+  const int64_t out_rows = out.dimension(0);
+  const std::size_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
+  const std::size_t lhs_right = (ADJ_B ? b.dimension(1) : b.dimension(0));
+  const int lhs_index_a = ADJ_A ? 1 : 0;
+  const int rhs_index_a = ADJ_A ? 0 : 1;
+
+  // Checks the indices in the same order as SparseTensorDenseMatMulImpl, and
+  // counts the entries of each row.
+  std::vector<Tindices> entry_rows(nnz);
+  std::vector<Tindices> entry_cols(nnz);
+  std::vector<int64_t> row_begin(out_rows + 1, 0);
+  for (std::size_t i = 0; i < nnz; ++i) {
+    const Tindices m = internal::SubtleMustCopy(a_indices(i, lhs_index_a));
+    const Tindices k = internal::SubtleMustCopy(a_indices(i, rhs_index_a));
+    if (!FastBoundsCheck(k, lhs_right)) {
+      return KOutOfBoundsError(k, i, rhs_index_a, lhs_right);
+    }
+    if (!FastBoundsCheck(m, out_rows)) {
+      return MOutOfBoundsError(m, i, lhs_index_a, out_rows);
+    }
+    entry_rows[i] = m;
+    entry_cols[i] = k;
+    ++row_begin[m + 1];
+  }
+  for (int64_t m = 0; m < out_rows; ++m) row_begin[m + 1] += row_begin[m];
+  std::vector<Tindices> csr_cols(nnz);
+  std::vector<Tsum> csr_values(nnz);
+  {
+    std::vector<int64_t> row_end(row_begin.begin(), row_begin.end() - 1);
+    for (std::size_t i = 0; i < nnz; ++i) {
+      const int64_t pos = row_end[entry_rows[i]]++;
+      csr_cols[pos] = entry_cols[i];
+      csr_values[pos] =
+          static_cast<Tsum>(ADJ_A ? MaybeConj(a_values(i)) : a_values(i));
+    }
+  }
+
+  // Rows of B, or of its adjoint, are contiguous in `b_rows`.
+  const T* b_rows = b.data();
+  Tensor b_adjoint_t;
+  if (ADJ_B) {
+    TF_RETURN_IF_ERROR(ctx->allocate_temp(
+        DataTypeToEnum<T>::value,
+        TensorShape({static_cast<int64_t>(lhs_right),
+                     static_cast<int64_t>(rhs_right)}),
+        &b_adjoint_t));
+    Eigen::array<int, 2> shuffle{1, 0};
+    b_adjoint_t.matrix<T>().device(ctx->eigen_device<CPUDevice>()) =
+        b.shuffle(shuffle).conjugate();
+    b_rows = b_adjoint_t.matrix<T>().data();
+  }
+
+  // Splits the rows into blocks with about the same number of entries.
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *ctx->device()->tensorflow_cpu_worker_threads();
+  const int64_t num_blocks =
+      std::min<int64_t>(out_rows, 4 * worker_threads.num_threads);
+  std::vector<int64_t> block_begin(num_blocks + 1);
+  for (int64_t j = 0; j <= num_blocks; ++j) {
+    block_begin[j] =
+        std::lower_bound(row_begin.begin(), row_begin.end(),
+                         static_cast<int64_t>(nnz) * j / num_blocks) -
+        row_begin.begin();
+  }
+  block_begin[num_blocks] = out_rows;
+
+  using OutRow = Eigen::Map<Eigen::Array<Tsum, Eigen::Dynamic, 1>>;
+  using BRow = Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>>;
+  auto accumulate_blocks = [&](int64_t first_block, int64_t last_block) {
+    for (int64_t m = block_begin[first_block]; m < block_begin[last_block];
+         ++m) {
+      Tsum* out_row = &out(m, 0);
+      for (int64_t pos = row_begin[m]; pos < row_begin[m + 1]; ++pos) {
+        const Tsum a_value = csr_values[pos];
+        const T* b_row = b_rows + csr_cols[pos] * rhs_right;
+        if (rhs_right < kNumVectorize) {
+          for (std::size_t n = 0; n < rhs_right; ++n) {
+            out_row[n] += a_value * static_cast<Tsum>(b_row[n]);
+          }
+        } else {
+          OutRow(out_row, rhs_right) +=
+              BRow(b_row, rhs_right).template cast<Tsum>() * a_value;
+        }
+      }
+    }
+  };
+  const int64_t cost_per_block =
+      std::max<int64_t>(1, nnz / num_blocks) * rhs_right;
+  Shard(worker_threads.num_threads, worker_threads.workers, num_blocks,
+        cost_per_block, accumulate_blocks);
+  return OkStatus();
+}
+
+// Computes `out` += A * B, with the CSR implementation if the product is
+// large enough to be worth multiple threads.
+template <typename T, typename Tsum, typename Tindices, bool ADJ_A, bool ADJ_B>
+Status SparseTensorDenseMatMulCpu(
+    OpKernelContext* ctx, typename TTypes<Tsum>::Matrix out,
+    typename TTypes<Tindices>::ConstMatrix a_indices,
+    typename TTypes<T>::ConstVec a_values, typename TTypes<T>::ConstMatrix b) {
+  const int64_t rhs_right = (ADJ_B ? b.dimension(0) : b.dimension(1));
+  if (ctx->device()->tensorflow_cpu_worker_threads()->num_threads > 1 &&
+      a_values.size() * rhs_right >= kMinMultiplyAddsForCsr) {
+    return SparseTensorDenseMatMulCsrImpl<T, Tsum, Tindices, ADJ_A, ADJ_B>(
+        ctx, out, a_indices, a_values, b);
+  }
+  return SparseTensorDenseMatMulImpl<T, Tsum, Tindices, ADJ_A, ADJ_B>(
+      out, a_indices, a_values, b);
+}
 }  // namespace
 
 template <typename T, typename Tindices, bool ADJ_A, bool ADJ_B>
@@ -338,8 +470,8 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
       auto temp_out = temp_out_t.matrix<Tsum>();
       temp_out.setZero();
       TF_RETURN_IF_ERROR(
-          SparseTensorDenseMatMulImpl<T, Tsum, Tindices, ADJ_A, ADJ_B>(
-              temp_out, a_indices, a_values, b));
+          SparseTensorDenseMatMulCpu<T, Tsum, Tindices, ADJ_A, ADJ_B>(
+              ctx, temp_out, a_indices, a_values, b));
       out = temp_out.template cast<T>();
     } else {
       out.setZero();
@@ -348,8 +480,8 @@ struct SparseTensorDenseMatMulFunctor<CPUDevice, T, Tindices, ADJ_A, ADJ_B> {
       auto out_workaround =
           *reinterpret_cast<typename TTypes<Tsum>::Matrix*>(&out);
       TF_RETURN_IF_ERROR(
-          SparseTensorDenseMatMulImpl<T, Tsum, Tindices, ADJ_A, ADJ_B>(
-              out_workaround, a_indices, a_values, b));
+          SparseTensorDenseMatMulCpu<T, Tsum, Tindices, ADJ_A, ADJ_B>(
+              ctx, out_workaround, a_indices, a_values, b));
     }
     return OkStatus();
   }
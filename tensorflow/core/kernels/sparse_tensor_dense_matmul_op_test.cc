@@ -120,4 +120,20 @@ BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, false, true);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, false);
 BM_SparseTensorDenseMatmul(16384, 4096, 4096, 4096, true, true);
 
+// Wide-and-deep style inputs: a batch of 4096 rows over a 65536 column
+// vocabulary, with 0.01%, 0.1% and 1% of entries present, multiplied by
+// embeddings of increasing width.
+BM_SparseTensorDenseMatmul(26843, 4096, 65536, 16, false, false);
+BM_SparseTensorDenseMatmul(26843, 4096, 65536, 64, false, false);
+BM_SparseTensorDenseMatmul(26843, 4096, 65536, 256, false, false);
+BM_SparseTensorDenseMatmul(268435, 4096, 65536, 16, false, false);
+BM_SparseTensorDenseMatmul(268435, 4096, 65536, 64, false, false);
+BM_SparseTensorDenseMatmul(268435, 4096, 65536, 256, false, false);
+BM_SparseTensorDenseMatmul(2684354, 4096, 65536, 16, false, false);
+BM_SparseTensorDenseMatmul(2684354, 4096, 65536, 64, false, false);
+BM_SparseTensorDenseMatmul(2684354, 4096, 65536, 256, false, false);
+BM_SparseTensorDenseMatmul(268435, 4096, 65536, 64, true, false);
+BM_SparseTensorDenseMatmul(268435, 4096, 65536, 64, false, true);
+BM_SparseTensorDenseMatmul(268435, 4096, 65536, 64, true, true);
+
 }  // end namespace tensorflow
@@ -13,9 +13,11 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
 #include <functional>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "absl/container/flat_hash_map.h"
 #include "tensorflow/core/framework/bounds_check.h"
@@ -26,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace {
@@ -68,6 +71,173 @@ struct UniqueOpHashMap<bfloat16, TIndex> {
   using map_type = std::unordered_map<bfloat16, TIndex>;
 };
 
+// Vectors with at least this many elements are uniquified on multiple threads,
+// if the device has more than one.
+constexpr int64_t kParallelUniqueMinElements = 64 * 1024;
+
+// The maximum number of partitions of the parallel implementation, so that
+// partitions fit in a `uint8`.
+constexpr int kMaxUniquePartitions = 256;
+
+// Returns the partition of `key`. Keys that are equal as map keys of
+// `UniqueOpHashMap` have the same partition.
+template <typename T>
+inline int UniquePartition(const T& key, int num_partitions) {
+  // `std::hash` is the identity for integers, so mix the bits of the hash
+  // before scaling it to the number of partitions.
+  const uint64 h = static_cast<uint64>(hash<T>{}(key)) * 0x9E3779B97F4A7C15ULL;
+  return static_cast<int>(((h >> 32) * num_partitions) >> 32);
+}
+
+// Computes the outputs of `UniqueOp` for a vector `Tin` on the worker
+// threads of the device. The outputs are identical to those of the sequential
+// implementation: unique elements are ordered by their first occurrence.
+//
+// Elements are hash-partitioned, so that the elements of each partition can
+// be uniquified independently, by position order, into partition-local
+// indices. The input is also split into contiguous chunks, and the number of
+// unique elements first occurring in each chunk and partition gives, by
+// prefix sums, the global index of each first occurrence.
+template <typename T, typename TIndex>
+void ParallelUnique(OpKernelContext* context,
+                    typename TTypes<T>::ConstFlat Tin,
+                    const TensorShape& input_shape, int64_t axis,
+                    typename TTypes<TIndex>::Vec idx_vec) {
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *context->device()->tensorflow_cpu_worker_threads();
+  // The input has at most kint32max elements.
+  const int32 N = static_cast<int32>(Tin.size());
+  const int num_partitions =
+      std::min(worker_threads.num_threads, kMaxUniquePartitions);
+  const int num_chunks = num_partitions;
+  const int32 chunk_size = Eigen::divup<int32>(N, num_chunks);
+  const auto chunk_begin = [N, chunk_size](int c) {
+    return std::min<int64_t>(N, static_cast<int64_t>(c) * chunk_size);
+  };
+  // Runs `fn(i)` for each `i` in [0, num_tasks), in parallel.
+  const auto parallel_for = [&worker_threads, chunk_size](
+                                int num_tasks,
+                                const std::function<void(int)>& fn) {
+    Shard(worker_threads.num_threads, worker_threads.workers, num_tasks,
+          /*cost_per_unit=*/100 * static_cast<int64_t>(chunk_size),
+          [&fn](int64_t begin, int64_t end) {
+            for (int64_t i = begin; i < end; ++i) fn(i);
+          });
+  };
+
+  // Partitions the elements, and counts the elements of each chunk in each
+  // partition.
+  std::vector<uint8> partition_of(N);
+  std::vector<int32> chunk_partition_sizes(num_chunks * num_partitions, 0);
+  parallel_for(num_chunks, [&](int c) {
+    int32* sizes = &chunk_partition_sizes[c * num_partitions];
+    for (int32 i = chunk_begin(c); i < chunk_begin(c + 1); ++i) {
+      const int p = UniquePartition(Tin(i), num_partitions);
+      partition_of[i] = p;
+      ++sizes[p];
+    }
+  });
+
+  // Lists the positions of the elements of each partition, in order.
+  std::vector<int32> partition_begin(num_partitions + 1, 0);
+  std::vector<int32> chunk_partition_offsets(num_chunks * num_partitions);
+  for (int p = 0, offset = 0; p < num_partitions; ++p) {
+    partition_begin[p] = offset;
+    for (int c = 0; c < num_chunks; ++c) {
+      chunk_partition_offsets[c * num_partitions + p] = offset;
+      offset += chunk_partition_sizes[c * num_partitions + p];
+    }
+  }
+  partition_begin[num_partitions] = N;
+  std::vector<int32> positions(N);
+  parallel_for(num_chunks, [&](int c) {
+    int32* offsets = &chunk_partition_offsets[c * num_partitions];
+    for (int32 i = chunk_begin(c); i < chunk_begin(c + 1); ++i) {
+      positions[offsets[partition_of[i]]++] = i;
+    }
+  });
+
+  // Uniquifies each partition, writing partition-local indices to `idx_vec`,
+  // and counts the unique elements first occurring in each chunk.
+  const bool with_counts = context->num_outputs() > 2;
+  std::vector<std::vector<TIndex>> partition_counts(num_partitions);
+  std::vector<int32> chunk_partition_firsts(num_chunks * num_partitions, 0);
+  parallel_for(num_partitions, [&](int p) {
+    typename UniqueOpHashMap<T, TIndex>::map_type uniq;
+    uniq.reserve(partition_begin[p + 1] - partition_begin[p]);
+    std::vector<TIndex>& counts = partition_counts[p];
+    for (int32 k = partition_begin[p]; k < partition_begin[p + 1]; ++k) {
+      const int32 i = positions[k];
+      auto it = uniq.emplace(Tin(i), static_cast<TIndex>(uniq.size()));
+      idx_vec(i) = it.first->second;
+      if (it.second) {
+        ++chunk_partition_firsts[(i / chunk_size) * num_partitions + p];
+        if (with_counts) counts.push_back(0);
+      }
+      if (with_counts) ++counts[it.first->second];
+    }
+  });
+
+  // Each element is the first occurrence of a unique element iff its local
+  // index is the number of unique elements of its partition that occurred
+  // before it. Computes the global index of the first unique element of each
+  // chunk, and the next local index of each partition at the start of each
+  // chunk.
+  std::vector<int64_t> chunk_first_indices(num_chunks);
+  int64_t uniq_size = 0;
+  for (int c = 0; c < num_chunks; ++c) {
+    chunk_first_indices[c] = uniq_size;
+    for (int p = 0; p < num_partitions; ++p) {
+      uniq_size += chunk_partition_firsts[c * num_partitions + p];
+    }
+  }
+  std::vector<std::vector<TIndex>> partition_indices(num_partitions);
+  for (int p = 0; p < num_partitions; ++p) {
+    int32 local_size = 0;
+    for (int c = 0; c < num_chunks; ++c) {
+      const int32 firsts = chunk_partition_firsts[c * num_partitions + p];
+      chunk_partition_firsts[c * num_partitions + p] = local_size;
+      local_size += firsts;
+    }
+    partition_indices[p].resize(local_size);
+  }
+
+  TensorShape output_shape(input_shape);
+  output_shape.set_dim(axis, uniq_size);
+  Tensor* output = nullptr;
+  OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+  auto Tout = output->flat<T>();
+  parallel_for(num_chunks, [&](int c) {
+    int32* next_local_indices = &chunk_partition_firsts[c * num_partitions];
+    int64_t index = chunk_first_indices[c];
+    for (int32 i = chunk_begin(c); i < chunk_begin(c + 1); ++i) {
+      const int p = partition_of[i];
+      if (idx_vec(i) == next_local_indices[p]) {
+        partition_indices[p][next_local_indices[p]++] = index;
+        Tout(index++) = Tin(i);
+      }
+    }
+  });
+  parallel_for(num_chunks, [&](int c) {
+    for (int32 i = chunk_begin(c); i < chunk_begin(c + 1); ++i) {
+      idx_vec(i) = partition_indices[partition_of[i]][idx_vec(i)];
+    }
+  });
+
+  if (with_counts) {
+    Tensor* count_output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(2, TensorShape({uniq_size}),
+                                            &count_output));
+    auto count_output_vec = count_output->template vec<TIndex>();
+    parallel_for(num_partitions, [&](int p) {
+      for (size_t k = 0; k < partition_counts[p].size(); ++k) {
+        count_output_vec(partition_indices[p][k]) = partition_counts[p][k];
+      }
+    });
+  }
+}
+
 // `UniqueOp` computes the unique elements in the input tensor.
 //
 // * `T` is the element type.
@@ -149,6 +319,12 @@ class UniqueOp : public OpKernel {
       // to them as in the general case.
       auto Tin = input.flat<T>();
       const int64_t N = static_cast<int64_t>(Tin.size());
+      if (N >= kParallelUniqueMinElements &&
+          context->device()->tensorflow_cpu_worker_threads()->num_threads >
+              1) {
+        ParallelUnique<T, TIndex>(context, Tin, input.shape(), axis, idx_vec);
+        return;
+      }
 
       typename UniqueOpHashMap<T, TIndex>::map_type uniq;
       uniq.reserve(2 * N);
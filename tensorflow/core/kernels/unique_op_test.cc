@@ -13,12 +13,20 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <cstdlib>
 #include <functional>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
+#include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
@@ -28,8 +36,10 @@ limitations under the License.
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/public/session_options.h"
 
 namespace tensorflow {
 
@@ -37,6 +47,109 @@ namespace {
 
 const int kMaxStrLen = 40;
 
+class UniqueOpTest : public OpsTestBase {
+ protected:
+  void SetUp() override {
+    // Use several threads, so that large inputs are uniquified in parallel.
+    SessionOptions options;
+    options.config.set_intra_op_parallelism_threads(4);
+    SetDevice(DEVICE_CPU, DeviceFactory::NewDevice("CPU", options,
+                                                   "/job:a/replica:0/task:0"));
+  }
+
+  void MakeOp(const string& op, DataType type, bool with_axis) {
+    NodeDefBuilder builder("unique", op);
+    builder.Input(FakeInput(type));
+    if (with_axis) builder.Input(FakeInput(DT_INT32));
+    TF_ASSERT_OK(builder.Attr("out_idx", DT_INT32).Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Checks the outputs against a sequential uniquification of `values`.
+  template <typename T>
+  void ExpectUnique(const std::vector<T>& values, bool with_counts) {
+    std::unordered_map<T, int32> indices;
+    std::vector<T> expected_unique;
+    std::vector<int32> expected_idx;
+    std::vector<int32> expected_counts;
+    for (const T& value : values) {
+      auto it = indices.emplace(value, expected_unique.size());
+      if (it.second) {
+        expected_unique.push_back(value);
+        expected_counts.push_back(0);
+      }
+      expected_idx.push_back(it.first->second);
+      ++expected_counts[it.first->second];
+    }
+    const int64_t num_unique = expected_unique.size();
+    test::ExpectTensorEqual<T>(
+        *GetOutput(0),
+        test::AsTensor<T>(expected_unique, TensorShape({num_unique})));
+    test::ExpectTensorEqual<int32>(*GetOutput(1),
+                                   test::AsTensor<int32>(expected_idx));
+    if (with_counts) {
+      test::ExpectTensorEqual<int32>(*GetOutput(2),
+                                     test::AsTensor<int32>(expected_counts));
+    }
+  }
+};
+
+TEST_F(UniqueOpTest, LargeInt64) {
+  MakeOp("Unique", DT_INT64, /*with_axis=*/false);
+  std::vector<int64_t> values(200 * 1000);
+  for (int64_t& value : values) value = std::rand() % 50000;
+  AddInputFromArray<int64_t>(TensorShape({static_cast<int64_t>(values.size())}),
+                             values);
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectUnique(values, /*with_counts=*/false);
+}
+
+TEST_F(UniqueOpTest, LargeInt32WithCounts) {
+  MakeOp("UniqueWithCounts", DT_INT32, /*with_axis=*/false);
+  std::vector<int32> values(100 * 1000);
+  // Mostly unique, with a few very frequent values.
+  for (int i = 0; i < values.size(); ++i) {
+    values[i] = i % 10 == 0 ? i % 7 : std::rand();
+  }
+  AddInputFromArray<int32>(TensorShape({static_cast<int64_t>(values.size())}),
+                           values);
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectUnique(values, /*with_counts=*/true);
+}
+
+TEST_F(UniqueOpTest, LargeStrings) {
+  MakeOp("Unique", DT_STRING, /*with_axis=*/false);
+  std::vector<tstring> values(100 * 1000);
+  for (tstring& value : values) value = strings::StrCat(std::rand() % 1000);
+  AddInputFromArray<tstring>(TensorShape({static_cast<int64_t>(values.size())}),
+                             values);
+  TF_ASSERT_OK(RunOpKernel());
+  ExpectUnique(values, /*with_counts=*/false);
+}
+
+TEST_F(UniqueOpTest, LargeInt32WithAxis) {
+  MakeOp("UniqueV2", DT_INT32, /*with_axis=*/true);
+  std::vector<int32> values(100 * 1000);
+  for (int32& value : values) value = std::rand() % 100;
+  AddInputFromArray<int32>(
+      TensorShape({1, static_cast<int64_t>(values.size()), 1}), values);
+  AddInputFromArray<int32>(TensorShape({1}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+  const Tensor& output = *GetOutput(0);
+  ASSERT_EQ(output.dims(), 3);
+  EXPECT_EQ(output.dim_size(0), 1);
+  EXPECT_EQ(output.dim_size(2), 1);
+  std::vector<int32> unique(output.flat<int32>().data(),
+                            output.flat<int32>().data() + output.NumElements());
+  std::unordered_map<int32, int32> indices;
+  for (int i = 0; i < values.size(); ++i) {
+    auto it = indices.emplace(values[i], indices.size());
+    EXPECT_EQ(GetOutput(1)->vec<int32>()(i), it.first->second);
+  }
+  ASSERT_EQ(unique.size(), indices.size());
+  for (const auto& it : indices) EXPECT_EQ(unique[it.second], it.first);
+}
+
 TensorProto GetRandomInt32TensorProto(int dim, int max_int) {
   TensorProto tensor_proto;
   tensor_proto.set_dtype(DT_INT32);
@@ -149,6 +262,36 @@ void BM_Unique_STRING(::testing::benchmark::State& state) {
                           sizeof(tstring));
 }
 
+// Benchmarks UniqueWithCounts over `dim` int64 ids, of which about
+// `unique_percent` percent are distinct.
+void BM_UniqueWithCounts_INT64(::testing::benchmark::State& state) {
+  const int dim = state.range(0);
+  const int unique_percent = state.range(1);
+  const int64_t max_id = std::max<int64_t>(1, int64_t{dim} * unique_percent /
+                                                  100);
+
+  Graph* g = new Graph(OpRegistry::Global());
+
+  Tensor input(DT_INT64, TensorShape({dim}));
+  auto input_flat = input.flat<int64_t>();
+  for (int i = 0; i < dim; ++i) {
+    // Spread the ids, as feature ids usually are.
+    input_flat(i) = (std::rand() % max_id) * 7919;
+  }
+
+  Node* node;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "UniqueWithCounts")
+                  .Input(test::graph::Constant(g, input))
+                  .Attr("T", DT_INT64)
+                  .Finalize(g, &node));
+  FixupSourceAndSinkEdges(g);
+
+  test::Benchmark("cpu", g, nullptr, nullptr, nullptr,
+                  "SINGLE_THREADED_EXECUTOR", /*old_benchmark_api*/ false)
+      .Run(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) * dim);
+}
+
 BENCHMARK(BM_Unique_INT32)
     ->UseRealTime()
     ->ArgPair(32, 1024 * 1024)
@@ -203,5 +346,19 @@ BENCHMARK(BM_Unique_STRING)
     ->Arg(64 * 1024)
     ->Arg(256 * 1024);
 
+BENCHMARK(BM_UniqueWithCounts_INT64)
+    ->UseRealTime()
+    ->ArgPair(16 * 1024, 1)
+    ->ArgPair(16 * 1024, 100)
+    ->ArgPair(256 * 1024, 1)
+    ->ArgPair(256 * 1024, 10)
+    ->ArgPair(256 * 1024, 100)
+    ->ArgPair(1024 * 1024, 1)
+    ->ArgPair(1024 * 1024, 10)
+    ->ArgPair(1024 * 1024, 100)
+    ->ArgPair(16 * 1024 * 1024, 1)
+    ->ArgPair(16 * 1024 * 1024, 10)
+    ->ArgPair(16 * 1024 * 1024, 100);
+
 }  // namespace
 }  // namespace tensorflow
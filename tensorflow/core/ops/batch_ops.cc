@@ -60,6 +60,14 @@ REGISTER_OP("BatchFunction")
     // NOTE: Support for `enable_large_batch_splitting == true` is still
     // developed in progress.
     .Attr("enable_large_batch_splitting: bool = false")
+    // If 'length_bucketing_dim' is non-negative, the inputs of each call are
+    // zero-padded along that dimension to the smallest of 'allowed_lengths'
+    // that fits them, and only calls padded to the same length are batched
+    // together. The outputs listed in 'length_bucketed_outputs' are trimmed
+    // back to the length of the call's inputs along that dimension.
+    .Attr("length_bucketing_dim: int = -1")
+    .Attr("allowed_lengths: list(int) = []")
+    .Attr("length_bucketed_outputs: list(int) = []")
     // TODO(apassos): Fix this shape inference function. It requires shape
     // inference of function calls.
     .SetShapeFn(shape_inference::UnknownShape)
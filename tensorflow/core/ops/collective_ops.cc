@@ -139,6 +139,8 @@ REGISTER_OP("CollectiveReduceV2")
     .Attr("is_stateless: bool = false")
     .Attr("Nordering_token: int >= 0 = 0")
     .Attr("max_subdivs_per_device: int = -1")
+    .Attr("pipeline_piece_bytes: int >= 0 = 0")
+    .Attr("wire_data_type: {'none', 'bfloat16'} = 'none'")
     .SetIsStateful()
     .SetIsDistributedCommunication()
     .SetShapeFn(shape_inference::UnchangedShape);
@@ -731,6 +731,8 @@ REGISTER_OP("CacheDataset")
     .Attr("output_types: list(type) >= 1")
     .Attr("output_shapes: list(shape) >= 1")
     .Attr("metadata: string = ''")
+    .Attr("memory_budget_bytes: int = 0")
+    .Attr("spill_directory: string = ''")
     // TODO(mdan): Should these use type inference instead?
     .SetTypeConstructor(full_type::VariadicTensorContainer(TFT_DATASET,
                                                            "output_types"))
@@ -749,6 +751,8 @@ REGISTER_OP("CacheDatasetV2")
     .Attr("output_types: list(type) >= 1")
     .Attr("output_shapes: list(shape) >= 1")
     .Attr("metadata: string = ''")
+    .Attr("memory_budget_bytes: int = 0")
+    .Attr("spill_directory: string = ''")
     .SetTypeConstructor(full_type::VariadicTensorContainer(TFT_DATASET,
                                                            "output_types"))
     .SetShapeFn([](shape_inference::InferenceContext* c) {
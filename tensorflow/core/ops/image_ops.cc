@@ -472,6 +472,32 @@ REGISTER_OP("DecodeImage")
     .Attr("expand_animations: bool = true")
     .SetShapeFn(DecodeImageV2ShapeFn);
 
+// --------------------------------------------------------------------------
+REGISTER_OP("DecodeImageBatch")
+    .Input("contents: string")
+    .Attr("channels: int = 3")
+    .Attr("target_height: int = 0")
+    .Attr("target_width: int = 0")
+    .Attr("fancy_upscaling: bool = true")
+    .Attr("dct_method: string = ''")
+    .Output("images: uint8")
+    .Output("image_shapes: int32")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle contents;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &contents));
+      int32_t channels;
+      TF_RETURN_IF_ERROR(c->GetAttr("channels", &channels));
+      if (channels != 1 && channels != 3 && channels != 4) {
+        return errors::InvalidArgument("channels must be 1, 3 or 4, got ",
+                                       channels);
+      }
+      DimensionHandle batch_dim = c->Dim(contents, 0);
+      c->set_output(0, c->MakeShape({batch_dim, InferenceContext::kUnknownDim,
+                                     InferenceContext::kUnknownDim, channels}));
+      c->set_output(1, c->Matrix(batch_dim, 3));
+      return OkStatus();
+    });
+
 // --------------------------------------------------------------------------
 REGISTER_OP("DecodeJpeg")
     .Input("contents: string")
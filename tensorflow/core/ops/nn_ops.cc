@@ -1301,6 +1301,51 @@ REGISTER_OP("LogSoftmax")
 
 // --------------------------------------------------------------------------
 
+REGISTER_OP("_FusedScaledDotProductAttention")
+    .Input("query: T")
+    .Input("key: T")
+    .Input("value: T")
+    .Input("args: num_args * T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("num_args: int >= 0")
+    .Attr("scale: float = 1.0")
+    .Attr("adj_key: bool = true")
+    .SetShapeFn([](InferenceContext* c) {
+      ShapeHandle query;
+      ShapeHandle key;
+      ShapeHandle value;
+      TF_RETURN_IF_ERROR(c->WithRankAtLeast(c->input(0), 2, &query));
+      if (!c->RankKnown(query)) {
+        c->set_output(0, c->UnknownShape());
+        return OkStatus();
+      }
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), c->Rank(query), &key));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), c->Rank(query), &value));
+
+      ShapeHandle batch_dims;
+      TF_RETURN_IF_ERROR(c->Subshape(query, 0, -1, &batch_dims));
+      ShapeHandle output;
+      TF_RETURN_IF_ERROR(c->Concatenate(
+          batch_dims, c->Vector(c->Dim(value, -1)), &output));
+      c->set_output(0, output);
+      return OkStatus();
+    })
+    .Doc(R"doc(
+Computes softmax(scale * query * key^T + mask) * value along the last two
+dimensions, without materializing the attention scores.
+
+`query` has shape [..., L_q, D], `value` has shape [..., L_k, D_v], and `key`
+has shape [..., L_k, D] if `adj_key` is true or [..., D, L_k] otherwise. The
+leading dimensions of all three must be equal. The optional mask in `args` is
+added to the scaled scores and must be broadcastable to [..., L_q, L_k].
+
+*NOTE*: Do not invoke this operator directly in Python. Grappler is
+expected to create these operators.
+)doc");
+
+// --------------------------------------------------------------------------
+
 REGISTER_OP("SoftmaxCrossEntropyWithLogits")
     .Input("features: T")
     .Input("labels: T")
@@ -14,14 +14,21 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
 #include <algorithm>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <optional>
 #include <utility>
 #include <vector>
 
 #include "absl/base/casts.h"
 #include "absl/container/flat_hash_map.h"
+#include "absl/numeric/bits.h"
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
 #include "tensorflow/core/framework/allocator.h"
@@ -37,6 +44,7 @@ limitations under the License.
 #include "tensorflow/core/platform/byte_order.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/raw_coding.h"
 #include "tensorflow/core/util/presized_cuckoo_map.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
 
@@ -117,6 +125,162 @@ constexpr uint8 kVarintTag(uint32 tag) { return (tag << 3) | 0; }
 constexpr uint8 kDelimitedTag(uint32 tag) { return (tag << 3) | 2; }
 constexpr uint8 kFixed32Tag(uint32 tag) { return (tag << 3) | 5; }
 
+// Returns a pointer to the next `size` bytes of `stream`, which must be backed
+// by a flat array, and skips over them. Returns nullptr if fewer than `size`
+// bytes are left before the current limit.
+const uint8* ReadPackedBytes(protobuf::io::CodedInputStream* stream,
+                             uint32 size) {
+  const void* ptr;
+  int available;
+  if (!stream->GetDirectBufferPointer(&ptr, &available) ||
+      available < static_cast<int64_t>(size) || !stream->Skip(size)) {
+    return nullptr;
+  }
+  return static_cast<const uint8*>(ptr);
+}
+
+// Packed varints are decoded straight from the serialized buffer rather than
+// through CodedInputStream::ReadVarint64. Runs of single-byte varints, which
+// dominate small ids and labels, are found and widened 16 bytes at a time with
+// SSE2/AVX2; longer varints are decoded from a single 64-bit load.
+
+// Returns the number of varints in [begin, end), i.e. the number of bytes
+// without the continuation bit set.
+int64_t CountPackedVarints(const uint8* begin, const uint8* end) {
+  int64_t count = 0;
+  const uint8* p = begin;
+#if defined(__SSE2__)
+  for (; end - p >= 16; p += 16) {
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    count += 16 - absl::popcount(static_cast<uint32>(_mm_movemask_epi8(bytes)));
+  }
+#endif
+  for (; p < end; ++p) {
+    count += (*p & 0x80) == 0;
+  }
+  return count;
+}
+
+// Decodes the varint at `*p` into `*value` and advances `*p` past it. Returns
+// false if the varint is longer than 10 bytes or extends past `end`.
+inline bool DecodeVarint64(const uint8** p, const uint8* end, uint64* value) {
+  const uint8* ptr = *p;
+  if (end - ptr >= 8) {
+    const uint64 word = core::DecodeFixed64(reinterpret_cast<const char*>(ptr));
+    const uint64 stop_bits = ~word & 0x8080808080808080ULL;
+    const int num_bytes =
+        stop_bits == 0 ? 8 : (absl::countr_zero(stop_bits) >> 3) + 1;
+    const uint64 payload_mask = 0x7f7f7f7f7f7f7f7fULL >> (64 - 8 * num_bytes);
+#if defined(__BMI2__)
+    uint64 result = _pext_u64(word, payload_mask);
+#else
+    // Packs the 7-bit groups of adjacent bytes, then of adjacent 16-bit and
+    // 32-bit halves.
+    uint64 result = word & payload_mask;
+    result = ((result & 0x7f007f007f007f00ULL) >> 1) |
+             (result & 0x007f007f007f007fULL);
+    result = ((result & 0x3fff00003fff0000ULL) >> 2) |
+             (result & 0x00003fff00003fffULL);
+    result = ((result & 0x0fffffff00000000ULL) >> 4) |
+             (result & 0x000000000fffffffULL);
+#endif
+    ptr += 8;
+    if (stop_bits == 0) {
+      // The 9th and 10th bytes hold the top 8 bits.
+      if (ptr == end) return false;
+      result |= static_cast<uint64>(*ptr & 0x7f) << 56;
+      if (*ptr++ >= 0x80) {
+        if (ptr == end || *ptr >= 0x80) return false;
+        result |= static_cast<uint64>(*ptr++) << 63;
+      }
+      *p = ptr;
+    } else {
+      *p = ptr - 8 + num_bytes;
+    }
+    *value = result;
+    return true;
+  }
+  // Varints near the end of the buffer.
+  uint64 result = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (ptr == end) return false;
+    const uint8 byte = *ptr++;
+    result |= static_cast<uint64>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      *value = result;
+      *p = ptr;
+      return true;
+    }
+  }
+  return false;
+}
+
+#if defined(__SSE2__)
+// Zero-extends the 16 bytes of `bytes` and stores them to `out`.
+inline void StoreBytesAsInt64(__m128i bytes, int64_t* out) {
+#if defined(__AVX2__)
+  __m256i* out256 = reinterpret_cast<__m256i*>(out);
+  _mm256_storeu_si256(out256, _mm256_cvtepu8_epi64(bytes));
+  _mm256_storeu_si256(out256 + 1,
+                      _mm256_cvtepu8_epi64(_mm_srli_si128(bytes, 4)));
+  _mm256_storeu_si256(out256 + 2,
+                      _mm256_cvtepu8_epi64(_mm_srli_si128(bytes, 8)));
+  _mm256_storeu_si256(out256 + 3,
+                      _mm256_cvtepu8_epi64(_mm_srli_si128(bytes, 12)));
+#else
+  const __m128i zero = _mm_setzero_si128();
+  __m128i* out128 = reinterpret_cast<__m128i*>(out);
+  const __m128i words[2] = {_mm_unpacklo_epi8(bytes, zero),
+                            _mm_unpackhi_epi8(bytes, zero)};
+  for (int i = 0; i < 2; ++i) {
+    const __m128i dwords[2] = {_mm_unpacklo_epi16(words[i], zero),
+                               _mm_unpackhi_epi16(words[i], zero)};
+    for (int j = 0; j < 2; ++j) {
+      _mm_storeu_si128(out128++, _mm_unpacklo_epi32(dwords[j], zero));
+      _mm_storeu_si128(out128++, _mm_unpackhi_epi32(dwords[j], zero));
+    }
+  }
+#endif
+}
+#endif
+
+// Decodes the packed varints in [begin, end). Stores the first `capacity` of
+// them to `out`, and validates but drops the others. Returns the number of
+// varints, or -1 if the data is malformed.
+int64_t DecodePackedVarints(const uint8* begin, const uint8* end, int64_t* out,
+                            int64_t capacity) {
+  int64_t index = 0;
+  const uint8* p = begin;
+  while (p < end) {
+#if defined(__SSE2__)
+    if (end - p >= 16) {
+      const __m128i bytes =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      const uint32 continuation_bits = _mm_movemask_epi8(bytes);
+      if (continuation_bits == 0 && capacity - index >= 16) {
+        StoreBytesAsInt64(bytes, out + index);
+        p += 16;
+        index += 16;
+        continue;
+      }
+      // Copy the single-byte varints preceding the first longer one.
+      const int num_single_bytes =
+          continuation_bits == 0 ? 16 : absl::countr_zero(continuation_bits);
+      for (int i = 0; i < num_single_bytes; ++i, ++index) {
+        if (index < capacity) out[index] = p[i];
+      }
+      p += num_single_bytes;
+      if (num_single_bytes == 16) continue;
+    }
+#endif
+    uint64 value;
+    if (!DecodeVarint64(&p, end, &value)) return -1;
+    if (index < capacity) out[index] = static_cast<int64_t>(value);
+    ++index;
+  }
+  return index;
+}
+
 namespace parsed {
 
 // ParseDataType has to be called first, then appropriate ParseZzzzList.
@@ -303,15 +467,24 @@ class Feature {
         if (!stream.ExpectTag(kDelimitedTag(1))) return false;  // packed tag
         uint32 packed_length;
         if (!stream.ReadVarint32(&packed_length)) return false;
-        auto packed_limit = stream.PushLimit(packed_length);
-
-        while (!stream.ExpectAtEnd()) {
-          protobuf_uint64 n;  // There is no API for int64
-          if (!stream.ReadVarint64(&n)) return false;
-          int64_list->push_back(static_cast<int64_t>(n));
+        if (packed_length > 0) {
+          const uint8* packed = ReadPackedBytes(&stream, packed_length);
+          if (packed == nullptr) return false;
+          const uint8* packed_end = packed + packed_length;
+
+          // Size the output for all the values up front, then decode them in
+          // place. As with `push_back`, a LimitedArraySlice that is too small
+          // keeps the values that fit and reports the overflow through
+          // EndDistance().
+          const size_t initial_size = int64_list->size();
+          int64_list->resize(initial_size +
+                             CountPackedVarints(packed, packed_end));
+          if (DecodePackedVarints(packed, packed_end,
+                                  int64_list->data() + initial_size,
+                                  int64_list->size() - initial_size) < 0) {
+            return false;
+          }
         }
-
-        stream.PopLimit(packed_limit);
       } else {  // non-packed
         while (!stream.ExpectAtEnd()) {
           if (!stream.ExpectTag(kVarintTag(1))) return false;
@@ -1924,18 +2097,30 @@ inline int ParseFloatFeature(protobuf::io::CodedInputStream* stream,
           !stream->ReadVarint32(&packed_length)) {
         return -1;
       }
-      auto packed_limit = stream->PushLimit(packed_length);
-      while (!stream->ExpectAtEnd()) {
-        uint32 buffer32;
-        if (!stream->ReadLittleEndian32(&buffer32)) {
+      constexpr uint32 kNumFloatBytes = 4;
+      if (packed_length % kNumFloatBytes != 0) {
+        return -1;
+      }
+      num_elements = packed_length / kNumFloatBytes;
+      if (out == nullptr) {
+        if (!stream->Skip(packed_length)) {
           return -1;
         }
-        if (out != nullptr) {
+      } else if (port::kLittleEndian) {
+        // The floats are stored in little endian order, so they can be copied
+        // directly.
+        if (!stream->ReadRaw(out, packed_length)) {
+          return -1;
+        }
+      } else {
+        for (int i = 0; i < num_elements; ++i) {
+          uint32 buffer32;
+          if (!stream->ReadLittleEndian32(&buffer32)) {
+            return -1;
+          }
           *out++ = absl::bit_cast<float>(buffer32);
         }
-        num_elements++;
       }
-      stream->PopLimit(packed_limit);
     } else if (peek_tag == kFixed32Tag(1)) {
       while (!stream->ExpectAtEnd()) {
         uint32 buffer32;
@@ -1975,18 +2160,21 @@ inline int ParseInt64Feature(protobuf::io::CodedInputStream* stream,
           !stream->ReadVarint32(&packed_length)) {
         return -1;
       }
-      auto packed_limit = stream->PushLimit(packed_length);
-      while (!stream->ExpectAtEnd()) {
-        protobuf_uint64 n;  // There is no API for int64
-        if (!stream->ReadVarint64(&n)) {
+      if (packed_length > 0) {
+        const uint8* packed = ReadPackedBytes(stream, packed_length);
+        if (packed == nullptr) {
           return -1;
         }
-        if (out != nullptr) {
-          *out++ = n;
+        // When only counting, still validate the values, since the second
+        // pass over the feature assumes that it parses.
+        const int64_t num_values = DecodePackedVarints(
+            packed, packed + packed_length, out,
+            out == nullptr ? 0 : std::numeric_limits<int64_t>::max());
+        if (num_values < 0) {
+          return -1;
         }
-        num_elements++;
+        num_elements = num_values;
       }
-      stream->PopLimit(packed_limit);
     } else if (peek_tag == kVarintTag(1)) {
       while (!stream->ExpectAtEnd()) {
         protobuf_uint64 n;  // There is no API for int64
@@ -15,12 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/util/example_proto_fast_parsing.h"
 
+#include <limits>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "tensorflow/core/example/example.pb.h"
 #include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/random/philox_random.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -172,6 +174,34 @@ TEST(FastParse, Packed) {
       "\x0a\x0d\x0a\x0b\x0a\x03\x61\x67\x65\x12\x04\x1a\x02\x08\x0d");
 }
 
+// Values whose varint encodings take from 1 to 10 bytes, followed by a run of
+// single-byte values long enough to be decoded in blocks.
+std::vector<int64_t> Int64ValuesOfAllSizes() {
+  std::vector<int64_t> values;
+  for (int bits = 0; bits <= 63; bits += 7) {
+    values.push_back((int64_t{1} << bits) - 1);
+    values.push_back(int64_t{1} << bits);
+  }
+  values.push_back(std::numeric_limits<int64_t>::max());
+  values.push_back(std::numeric_limits<int64_t>::min());
+  values.push_back(-1);
+  for (int i = 0; i < 40; ++i) {
+    values.push_back(i % 128);
+  }
+  values.push_back(300);
+  return values;
+}
+
+TEST(FastParse, PackedInt64OfAllSizes) {
+  Example example;
+  for (int64_t value : Int64ValuesOfAllSizes()) {
+    (*example.mutable_features()->mutable_feature())["ids"]
+        .mutable_int64_list()
+        ->add_value(value);
+  }
+  TestCorrectness(Serialize(example));
+}
+
 TEST(FastParse, ValueBeforeKeyInMap) {
   TestCorrectness("\x0a\x12\x0a\x10\x12\x09\x0a\x07\x0a\x05value\x0a\x03key");
 }
@@ -419,6 +449,39 @@ TEST(FastParse, FuzzTest) {
   }
 }
 
+TEST(TestFastParseExample, DensePackedInt64) {
+  const std::vector<int64_t> values = Int64ValuesOfAllSizes();
+  Example example;
+  for (int64_t value : values) {
+    (*example.mutable_features()->mutable_feature())["ids"]
+        .mutable_int64_list()
+        ->add_value(value);
+  }
+  std::vector<tstring> serialized(2, Serialize(example));
+
+  FastParseExampleConfig config;
+  AddDenseFeature("ids", DT_INT64, {static_cast<int64_t>(values.size())},
+                  false, values.size(), &config);
+  Result result;
+  TF_ASSERT_OK(FastParseExample(config, serialized, gtl::ArraySlice<tstring>(),
+                                nullptr, &result));
+  ASSERT_EQ(result.dense_values.size(), 1);
+  auto parsed = result.dense_values[0].matrix<int64_t>();
+  for (int i = 0; i < serialized.size(); ++i) {
+    for (int j = 0; j < values.size(); ++j) {
+      EXPECT_EQ(parsed(i, j), values[j]) << "example " << i << " value " << j;
+    }
+  }
+
+  // Too many values for the dense shape.
+  FastParseExampleConfig short_config;
+  AddDenseFeature("ids", DT_INT64, {static_cast<int64_t>(values.size() - 1)},
+                  false, values.size() - 1, &short_config);
+  EXPECT_FALSE(FastParseExample(short_config, serialized,
+                                gtl::ArraySlice<tstring>(), nullptr, &result)
+                   .ok());
+}
+
 TEST(TestFastParseExample, Empty) {
   Result result;
   FastParseExampleConfig config;
@@ -429,6 +492,68 @@ TEST(TestFastParseExample, Empty) {
   EXPECT_TRUE(status.ok()) << status;
 }
 
+// Parses batches of Examples holding a single feature of a typical shape:
+// 256 dense floats (state.range(0) == 0), 64 sparse ids hashed into the int64
+// range (1), 64 sparse small ids (2), or 8 sparse 16-byte strings (3).
+void BM_FastParseExampleFeature(::testing::benchmark::State& state) {
+  const int feature_kind = state.range(0);
+  constexpr int kBatchSize = 128;
+  random::PhiloxRandom philox(42);
+  random::SimplePhilox rng(&philox);
+
+  FastParseExampleConfig config;
+  std::vector<tstring> serialized;
+  int64_t bytes_per_batch = 0;
+  for (int i = 0; i < kBatchSize; ++i) {
+    Example example;
+    Feature& feature =
+        (*example.mutable_features()->mutable_feature())["feature"];
+    switch (feature_kind) {
+      case 0:
+        for (int j = 0; j < 256; ++j) {
+          feature.mutable_float_list()->add_value(rng.RandFloat());
+        }
+        break;
+      case 1:
+      case 2:
+        for (int j = 0; j < 64; ++j) {
+          feature.mutable_int64_list()->add_value(
+              feature_kind == 1 ? rng.Rand64() >> 1 : rng.Uniform(100));
+        }
+        break;
+      default:
+        for (int j = 0; j < 8; ++j) {
+          feature.mutable_bytes_list()->add_value(string(16, 'a' + j));
+        }
+        break;
+    }
+    serialized.push_back(Serialize(example));
+    bytes_per_batch += serialized.back().size();
+  }
+  switch (feature_kind) {
+    case 0:
+      AddDenseFeature("feature", DT_FLOAT, {256}, false, 256, &config);
+      break;
+    case 1:
+    case 2:
+      AddSparseFeature("feature", DT_INT64, &config);
+      break;
+    default:
+      AddSparseFeature("feature", DT_STRING, &config);
+      break;
+  }
+
+  for (auto s : state) {
+    Result result;
+    TF_CHECK_OK(FastParseExample(config, serialized,
+                                 gtl::ArraySlice<tstring>(), nullptr,
+                                 &result));
+  }
+  state.SetBytesProcessed(state.iterations() * bytes_per_batch);
+  state.SetItemsProcessed(state.iterations() * kBatchSize);
+}
+BENCHMARK(BM_FastParseExampleFeature)->Arg(0)->Arg(1)->Arg(2)->Arg(3);
+
 }  // namespace
 }  // namespace example
 }  // namespace tensorflow
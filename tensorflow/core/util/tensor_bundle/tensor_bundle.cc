@@ -15,11 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
 #include <memory>
 #include <utility>
 
+#include "tensorflow/core/framework/allocation_description.pb.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.pb.h"
 #include "tensorflow/core/framework/tensor_shape.pb.h"
@@ -38,6 +41,7 @@ limitations under the License.
 #include "tensorflow/core/lib/io/table_builder.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/bfloat16.h"
+#include "tensorflow/core/platform/blocking_counter.h"
 #include "tensorflow/core/platform/cord.h"
 #include "tensorflow/core/platform/errors.h"
 #include "tensorflow/core/platform/mem.h"
@@ -405,6 +409,28 @@ table::Options TableBuilderOptions() {
   return o;
 }
 
+// Whether BundleReader::GetSliceValue() can reassemble a tensor of "dtype"
+// from slices.
+bool CanStoreInSlices(DataType dtype) {
+  switch (dtype) {
+    case DT_FLOAT:
+    case DT_DOUBLE:
+    case DT_HALF:
+    case DT_BFLOAT16:
+    case DT_INT32:
+    case DT_INT64:
+    case DT_INT16:
+    case DT_INT8:
+    case DT_UINT8:
+    case DT_COMPLEX64:
+    case DT_COMPLEX128:
+    case DT_BOOL:
+      return true;
+    default:
+      return false;
+  }
+}
+
 // Writes zeros to output buffer to align the next write to the requested
 // alignment. "size" is the current size of the buffer and is updated to the
 // new size.
@@ -422,17 +448,42 @@ Status PadAlignment(tsl::BufferedWritableFile* out, int alignment,
   return status;
 }
 
+// A read-only TensorBuffer aliasing bytes of a memory-mapped data file. Keeps
+// the mapping alive for as long as any tensor refers to it.
+class MappedTensorBuffer : public TensorBuffer {
+ public:
+  MappedTensorBuffer(const char* data, size_t size,
+                     std::shared_ptr<ReadOnlyMemoryRegion> region)
+      : TensorBuffer(const_cast<char*>(data)),
+        size_(size),
+        region_(std::move(region)) {}
+
+  size_t size() const override { return size_; }
+  TensorBuffer* root_buffer() override { return this; }
+  void FillAllocationDescription(AllocationDescription* proto) const override {
+    proto->set_requested_bytes(size_);
+    proto->set_allocator_name("MappedTensorBuffer");
+    proto->set_ptr(reinterpret_cast<uintptr_t>(data()));
+  }
+  bool GetAllocatedBytes(size_t* out_bytes) const override { return false; }
+  // The mapping is read-only: never let an op forward this buffer as an
+  // output and write into it.
+  bool OwnsMemory() const override { return false; }
+
+ private:
+  const size_t size_;
+  const std::shared_ptr<ReadOnlyMemoryRegion> region_;
+};
+
 }  // namespace
 
 BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
-    : env_(env), options_(options), prefix_(prefix), out_(nullptr), size_(0) {
+    : env_(env), options_(options), prefix_(prefix) {
   status_ = env_->HasAtomicMove(prefix_, &use_temp_file_);
   if (!status_.ok()) return;
 
-  data_path_ = DataFilename(prefix_, 0, 1);
   metadata_path_ = MetaFilename(prefix_);
   if (use_temp_file_) {
-    data_path_ = strings::StrCat(data_path_, ".tempstate", random::New64());
     metadata_path_ =
         strings::StrCat(metadata_path_, ".tempstate", random::New64());
   }
@@ -442,13 +493,25 @@ BundleWriter::BundleWriter(Env* env, StringPiece prefix, const Options& options)
     return;
   }
 
-  std::unique_ptr<WritableFile> wrapper;
-  status_ = env_->NewWritableFile(data_path_, &wrapper);
-  if (!status_.ok()) return;
-  out_ = std::make_unique<tsl::BufferedWritableFile>(
-      std::move(wrapper), 8 << 20 /* 8MB write buffer */);
-
-  VLOG(1) << "Writing to file " << data_path_;
+  const int num_shards = std::max(1, options_.num_data_shards);
+  shards_.resize(num_shards);
+  for (int i = 0; i < num_shards; ++i) {
+    DataShard& shard = shards_[i];
+    shard.path = DataFilename(prefix_, i, num_shards);
+    if (use_temp_file_) {
+      shard.path = strings::StrCat(shard.path, ".tempstate", random::New64());
+    }
+    std::unique_ptr<WritableFile> wrapper;
+    status_ = env_->NewWritableFile(shard.path, &wrapper);
+    if (!status_.ok()) return;
+    shard.out = std::make_unique<tsl::BufferedWritableFile>(
+        std::move(wrapper), 8 << 20 /* 8MB write buffer */);
+    VLOG(1) << "Writing to file " << shard.path;
+  }
+  if (num_shards > 1) {
+    write_pool_ = std::make_unique<thread::ThreadPool>(
+        env_, "bundle_writer", num_shards);
+  }
 }
 
 Status BundleWriter::Add(StringPiece key, const Tensor& val) {
@@ -460,32 +523,97 @@ Status BundleWriter::Add(StringPiece key, const Tensor& val) {
     return status_;
   }
 
-  BundleEntryProto* entry = &entries_[key_string];
+  if (shards_.size() > 1 && CanStoreInSlices(val.dtype()) && val.dims() > 0 &&
+      val.dim_size(0) > 1 && val.TotalBytes() > options_.max_chunk_bytes) {
+    status_ = AddChunked(key_string, val);
+    return status_;
+  }
+
+  // Everything else goes to the data file with the fewest bytes.
+  auto shard = std::min_element(
+      shards_.begin(), shards_.end(),
+      [](const DataShard& a, const DataShard& b) { return a.size < b.size; });
+  status_ = WriteToShard(val, shard - shards_.begin(), &*shard,
+                         &entries_[key_string]);
+  return status_;
+}
+
+Status BundleWriter::WriteToShard(const Tensor& val, int shard_id,
+                                  DataShard* shard, BundleEntryProto* entry) {
   entry->set_dtype(val.dtype());
   val.shape().AsProto(entry->mutable_shape());
-  entry->set_shard_id(0);
-  entry->set_offset(size_);
+  entry->set_shard_id(shard_id);
+  entry->set_offset(shard->size);
 
   // Updates the data file.
+  tsl::BufferedWritableFile* out = shard->out.get();
   size_t data_bytes_written = 0;
   uint32 crc32c = 0;
-  out_->reset_crc32();
+  out->reset_crc32();
   if (val.dtype() == DT_STRING) {
-    status_ = WriteStringTensor(val, out_.get(), &data_bytes_written, &crc32c);
+    TF_RETURN_IF_ERROR(
+        WriteStringTensor(val, out, &data_bytes_written, &crc32c));
   } else if (val.dtype() == DT_VARIANT) {
-    status_ = WriteVariantTensor(val, out_.get(), &data_bytes_written, &crc32c);
+    TF_RETURN_IF_ERROR(
+        WriteVariantTensor(val, out, &data_bytes_written, &crc32c));
   } else {
-    status_ = WriteTensor(val, out_.get(), &data_bytes_written);
-    crc32c = out_->crc32();
+    TF_RETURN_IF_ERROR(WriteTensor(val, out, &data_bytes_written));
+    crc32c = out->crc32();
   }
 
-  if (status_.ok()) {
-    entry->set_size(data_bytes_written);
-    entry->set_crc32c(crc32c::Mask(crc32c));
-    size_ += data_bytes_written;
-    status_ = PadAlignment(out_.get(), options_.data_alignment, &size_);
+  entry->set_size(data_bytes_written);
+  entry->set_crc32c(crc32c::Mask(crc32c));
+  shard->size += data_bytes_written;
+  return PadAlignment(out, options_.data_alignment, &shard->size);
+}
+
+Status BundleWriter::AddChunked(const string& key, const Tensor& val) {
+  const int64_t num_rows = val.dim_size(0);
+  const int64_t row_bytes = std::max<int64_t>(1, val.TotalBytes() / num_rows);
+  const int64_t rows_per_chunk =
+      std::max<int64_t>(1, options_.max_chunk_bytes / row_bytes);
+  const int64_t num_chunks = (num_rows + rows_per_chunk - 1) / rows_per_chunk;
+
+  std::vector<TensorSlice> slices(num_chunks, TensorSlice(val.dims()));
+  for (int64_t i = 0; i < num_chunks; ++i) {
+    slices[i].set_start(0, i * rows_per_chunk);
+    slices[i].set_length(
+        0, std::min(rows_per_chunk, num_rows - i * rows_per_chunk));
   }
-  return status_;
+
+  // Data shard s checksums and writes chunks s, s + S, s + 2S, ... straight
+  // from "val"'s buffer, so the only extra memory is the write buffers.
+  const int num_shards = shards_.size();
+  std::vector<BundleEntryProto> chunk_entries(num_chunks);
+  std::vector<Status> statuses(num_shards);
+  BlockingCounter counter(num_shards);
+  for (int s = 0; s < num_shards; ++s) {
+    write_pool_->Schedule([&, s]() {
+      for (int64_t i = s; i < num_chunks && statuses[s].ok(); i += num_shards) {
+        const int64_t start = slices[i].start(0);
+        statuses[s] =
+            WriteToShard(val.Slice(start, start + slices[i].length(0)), s,
+                         &shards_[s], &chunk_entries[i]);
+      }
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  for (const Status& status : statuses) {
+    TF_RETURN_IF_ERROR(status);
+  }
+
+  // Same metadata layout as AddSlice(): the full tensor's entry lists the
+  // slices, each of which has its own entry pointing into the data files.
+  BundleEntryProto* full_entry = &entries_[key];
+  full_entry->set_dtype(val.dtype());
+  val.shape().AsProto(full_entry->mutable_shape());
+  for (int64_t i = 0; i < num_chunks; ++i) {
+    slices[i].AsProto(full_entry->add_slices());
+    entries_[checkpoint::EncodeTensorNameSlice(key, slices[i])] =
+        std::move(chunk_entries[i]);
+  }
+  return OkStatus();
 }
 
 Status BundleWriter::AddSlice(StringPiece full_tensor_key,
@@ -532,16 +660,25 @@ Status BundleWriter::AddSlice(StringPiece full_tensor_key,
 // TODO(zongheng): on metadata write failure or !status_.ok(), consider removing
 // the orphaned data file.
 Status BundleWriter::Finish() {
-  if (out_) {
-    status_.Update(out_->Close());
-    out_ = nullptr;
-    if (status_.ok()) {
-      if (use_temp_file_) {
-        status_ =
-            Env::Default()->RenameFile(data_path_, DataFilename(prefix_, 0, 1));
+  bool closed_data_files = false;
+  for (DataShard& shard : shards_) {
+    if (shard.out) {
+      status_.Update(shard.out->Close());
+      shard.out = nullptr;
+      closed_data_files = true;
+    }
+  }
+  if (closed_data_files) {
+    const int num_shards = shards_.size();
+    for (int i = 0; i < num_shards; ++i) {
+      if (status_.ok()) {
+        if (use_temp_file_) {
+          status_ = Env::Default()->RenameFile(
+              shards_[i].path, DataFilename(prefix_, i, num_shards));
+        }
+      } else {
+        Env::Default()->DeleteFile(shards_[i].path).IgnoreError();
       }
-    } else {
-      Env::Default()->DeleteFile(data_path_).IgnoreError();
     }
   }
   if (!status_.ok()) return status_;
@@ -557,7 +694,7 @@ Status BundleWriter::Finish() {
     table::TableBuilder builder(options, file.get());
     // Header entry.
     BundleHeaderProto header;
-    header.set_num_shards(1);
+    header.set_num_shards(shards_.size());
     header.set_endianness(BundleHeaderProto::LITTLE);
     if (!port::kLittleEndian) header.set_endianness(BundleHeaderProto::BIG);
     VersionDef* version = header.mutable_version();
@@ -770,6 +907,15 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
 BundleReader::BundleReader(
     Env* env, StringPiece prefix,
     bool enable_multi_threading_for_testing /* = false */)
+    : BundleReader(env, prefix, [enable_multi_threading_for_testing] {
+        Options options;
+        options.enable_multi_threading_for_testing =
+            enable_multi_threading_for_testing;
+        return options;
+      }()) {}
+
+BundleReader::BundleReader(Env* env, StringPiece prefix,
+                           const Options& options)
     : env_(env),
       prefix_(prefix),
       metadata_(nullptr),
@@ -777,7 +923,9 @@ BundleReader::BundleReader(
       index_cache_(nullptr),
       iter_(nullptr),
       need_to_swap_bytes_(false),
-      enable_multi_threading_for_testing_(enable_multi_threading_for_testing) {
+      enable_multi_threading_for_testing_(
+          options.enable_multi_threading_for_testing),
+      use_memory_mapped_data_(options.use_memory_mapped_data) {
   const string filename = MetaFilename(prefix_);
   uint64 file_size;
   status_ = env_->GetFileSize(filename, &file_size);
@@ -869,7 +1017,68 @@ Status BundleReader::GetBundleEntryProto(StringPiece key,
   return OkStatus();
 }
 
+Status BundleReader::GetMappedValue(const BundleEntryProto& entry,
+                                    Tensor* val, bool* mapped) {
+  *mapped = false;
+  if (!DataTypeCanUseMemcpy(entry.dtype()) || need_to_swap_bytes_ ||
+      entry.size() == 0) {
+    return OkStatus();
+  }
+  const TensorShape stored_shape(TensorShape(entry.shape()));
+  // Size mismatches are reported by the copying path.
+  if (entry.size() !=
+      stored_shape.num_elements() * DataTypeSize(entry.dtype())) {
+    return OkStatus();
+  }
+  if (val->NumElements() != 0 &&
+      (val->dtype() != entry.dtype() || val->shape() != stored_shape)) {
+    return OkStatus();
+  }
+
+  auto it = mapped_data_.find(entry.shard_id());
+  if (it == mapped_data_.end()) {
+    const string filename =
+        DataFilename(prefix_, entry.shard_id(), num_shards_);
+    std::unique_ptr<ReadOnlyMemoryRegion> region;
+    Status s = env_->NewReadOnlyMemoryRegionFromFile(filename, &region);
+    if (!s.ok()) {
+      VLOG(1) << "Unable to memory-map " << filename
+              << ", falling back to reading: " << s;
+    }
+    it = mapped_data_.emplace(entry.shard_id(), std::move(region)).first;
+  }
+  const std::shared_ptr<ReadOnlyMemoryRegion>& region = it->second;
+  if (region == nullptr || entry.offset() + entry.size() > region->length()) {
+    return OkStatus();
+  }
+  const char* data = static_cast<const char*>(region->data()) + entry.offset();
+  if (reinterpret_cast<uintptr_t>(data) % EIGEN_MAX_ALIGN_BYTES != 0) {
+    return OkStatus();
+  }
+
+  const uint32 actual_crc32c = crc32c::Value(data, entry.size());
+  if (crc32c::Unmask(entry.crc32c()) != actual_crc32c) {
+    return errors::DataLoss(
+        "TensorBundle at ", prefix_, " shard ", entry.shard_id(), " (",
+        entry.size(), " bytes): Checksum does not match: stored ",
+        strings::Printf("%08u", crc32c::Unmask(entry.crc32c())),
+        " vs. calculated on the restored bytes ", actual_crc32c);
+  }
+
+  MappedTensorBuffer* buf = new MappedTensorBuffer(data, entry.size(), region);
+  *val = Tensor(entry.dtype(), stored_shape, buf);
+  buf->Unref();
+  *mapped = true;
+  return OkStatus();
+}
+
 Status BundleReader::GetValue(const BundleEntryProto& entry, Tensor* val) {
+  if (use_memory_mapped_data_) {
+    bool mapped = false;
+    TF_RETURN_IF_ERROR(GetMappedValue(entry, val, &mapped));
+    if (mapped) return OkStatus();
+  }
+
   Tensor* ret = val;
   const TensorShape stored_shape(TensorShape(entry.shape()));
   if (val->NumElements() == 0) {
@@ -1018,6 +1227,11 @@ Status BundleReader::Lookup(StringPiece key, Tensor* val) {
   if (entry.slices().empty()) {
     return GetValue(entry, val);
   } else {
+    // The stored slices are copied into "val", which must hold the full
+    // tensor.
+    if (val->NumElements() == 0) {
+      *val = Tensor(entry.dtype(), TensorShape(entry.shape()));
+    }
     return GetSliceValue(
         key, entry,
         /* a full slice */ TensorSlice(TensorShape(entry.shape()).dims()), val);
@@ -1036,6 +1250,9 @@ Status BundleReader::ReadCurrent(Tensor* val) {
   if (entry.slices().empty()) {
     return GetValue(entry, val);
   } else {
+    if (val->NumElements() == 0) {
+      *val = Tensor(entry.dtype(), TensorShape(entry.shape()));
+    }
     return GetSliceValue(
         iter_->key(), entry,
         /* a full slice */ TensorSlice(TensorShape(entry.shape()).dims()), val);
@@ -1156,6 +1373,7 @@ Status BundleReader::GetSliceValue(StringPiece full_tensor_key,
 
       HANDLE_COPY(float)
       HANDLE_COPY(double)
+      HANDLE_COPY(Eigen::half)
       HANDLE_COPY(int32)
       HANDLE_COPY(uint8)
       HANDLE_COPY(int16)
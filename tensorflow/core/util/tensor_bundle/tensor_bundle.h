@@ -76,6 +76,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/cache.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/io/iterator.h"
@@ -119,6 +120,19 @@ class BundleWriter {
     // Alignment, in bytes, for tensor data.
     // Must be >= 1. The default size of 1 densely packs tensors.
     int data_alignment{1};
+
+    // Number of data files written concurrently. Must be >= 1. With more than
+    // one, large tensors (see "max_chunk_bytes") are split into chunks that
+    // are checksummed and written in parallel, one chunk per data file at a
+    // time, and other tensors go to the data file with the fewest bytes.
+    int num_data_shards{1};
+
+    // If "num_data_shards" > 1, tensors larger than this many bytes are stored
+    // as slices of at most this size along their first dimension, so they can
+    // be spread over the data files. Memory stays bounded: chunks are written
+    // straight from the tensor's buffer and Add() returns once all of them
+    // have been flushed to the write buffers.
+    int64_t max_chunk_bytes{64 << 20};
   };
   BundleWriter(Env* env, absl::string_view prefix,
                const Options& options = Options());
@@ -153,14 +167,31 @@ class BundleWriter {
   Status status() const { return status_; }
 
  private:
+  // A data file being written.
+  struct DataShard {
+    std::string path;
+    std::unique_ptr<tsl::BufferedWritableFile> out;
+    int64_t size = 0;  // Number of bytes written into out.
+  };
+
+  // Appends "val" to "shard" and fills in the location, size and checksum
+  // fields of "entry". Only touches "shard", so distinct shards may be written
+  // concurrently.
+  Status WriteToShard(const Tensor& val, int shard_id, DataShard* shard,
+                      BundleEntryProto* entry);
+
+  // Stores "val" under "key" as slices of at most "options_.max_chunk_bytes"
+  // along its first dimension, written in parallel over all data shards.
+  Status AddChunked(const std::string& key, const Tensor& val);
+
   Env* const env_;  // Not owned.
   const Options options_;
   const std::string prefix_;
   std::string metadata_path_;
-  std::string data_path_;
   bool use_temp_file_;
-  std::unique_ptr<tsl::BufferedWritableFile> out_;
-  int64_t size_;  // Number of bytes written into out_.
+  std::vector<DataShard> shards_;
+  // Writes chunks when there is more than one data shard.
+  std::unique_ptr<thread::ThreadPool> write_pool_;
   std::map<std::string, BundleEntryProto> entries_;
   Status status_;
 
@@ -200,6 +231,25 @@ Status MergeBundles(Env* env, gtl::ArraySlice<tstring> prefixes,
 // All threads accessing the same BundleReader must synchronize.
 class BundleReader {
  public:
+  struct Options {
+    Options() {}
+
+    // If true, data files are memory-mapped (on file systems that support it)
+    // and tensors of a memcpy-able dtype whose bytes are suitably aligned and
+    // need no byte swapping are returned without copying: their buffers alias
+    // the read-only mapping, which stays alive while any such tensor does.
+    // Pages are shared with every other reader of the same file. All other
+    // tensors are read into freshly allocated buffers as usual.
+    //
+    // Writers should set BundleWriter::Options::data_alignment to a multiple
+    // of EIGEN_MAX_ALIGN_BYTES to make every tensor eligible.
+    bool use_memory_mapped_data{false};
+
+    bool enable_multi_threading_for_testing{false};
+  };
+
+  BundleReader(Env* const env, absl::string_view prefix,
+               const Options& options);
   BundleReader(Env* const env, absl::string_view prefix,
                bool enable_multi_threading_for_testing = false);
   ~BundleReader();
@@ -309,6 +359,13 @@ class BundleReader {
   Status GetValue(const BundleEntryProto& entry,
                   Tensor* val) TF_MUST_USE_RESULT;
 
+  // Tries to point "val" at the bytes of "entry" in the memory-mapped data
+  // file, setting "*mapped" on success. Leaves "val" untouched and "*mapped"
+  // false if the entry is not eligible, in which case the caller falls back to
+  // GetValue()'s copying path. Returns an error only for a checksum mismatch.
+  Status GetMappedValue(const BundleEntryProto& entry, Tensor* val,
+                        bool* mapped) TF_MUST_USE_RESULT;
+
   // Reads the slice described by "slice_spec".  The corresponding full tensor
   // has key "ful_tensor_key" and metadata proto "full_tensor_entry".
   // REQUIRES: full_tensor_entry.slices_size() > 0
@@ -327,6 +384,11 @@ class BundleReader {
   table::Iterator* iter_;
   // Owned the InputBuffer objects and their underlying RandomAccessFile's.
   std::unordered_map<int32_t, io::InputBuffer*> data_;
+  // Memory-mapped data files, keyed by shard id. Only populated when
+  // "use_memory_mapped_data_" is set; a null entry records that the file
+  // system could not map the shard. Shared with the tensors that alias them.
+  std::unordered_map<int32_t, std::shared_ptr<ReadOnlyMemoryRegion>>
+      mapped_data_;
 
   // Maps each partitioned tensor's key to its stored slices (represented in a
   // TensorSliceSet).  Populated on-demand.
@@ -343,6 +405,7 @@ class BundleReader {
   friend class TensorBundleAlignmentTest;  // For testing data alignment.
 
   bool enable_multi_threading_for_testing_ = false;
+  bool use_memory_mapped_data_ = false;
 
   BundleReader(const BundleReader&) = delete;
   void operator=(const BundleReader&) = delete;
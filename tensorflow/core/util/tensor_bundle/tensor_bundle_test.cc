@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_bundle/tensor_bundle.h"
 
+#include <cstdio>
 #include <random>
 #include <string>
 #include <vector>
@@ -23,6 +24,10 @@ limitations under the License.
 #include <windows.h>
 #endif  // _WIN32
 
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.pb.h"
@@ -1148,6 +1153,81 @@ TEST(TensorBundleTest, LargeVariableLoadingTest) {
   }
 }
 
+BundleReader::Options MemoryMappedOptions() {
+  BundleReader::Options options;
+  options.use_memory_mapped_data = true;
+  return options;
+}
+
+TEST(TensorBundleTest, MemoryMappedRestore) {
+  {
+    BundleWriter::Options opts;
+    opts.data_alignment = EIGEN_MAX_ALIGN_BYTES;
+    BundleWriter writer(Env::Default(), Prefix("foo"), opts);
+    TF_EXPECT_OK(writer.Add("flag", Constant(true, TensorShape({1}))));
+    TF_EXPECT_OK(writer.Add("floats", Constant_100x100<float>(3)));
+    TF_EXPECT_OK(writer.Add("strings", Constant_2x3<tstring>("hello")));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  Tensor floats;
+  {
+    BundleReader reader(Env::Default(), Prefix("foo"), MemoryMappedOptions());
+    TF_ASSERT_OK(reader.status());
+    Expect<bool>(&reader, "flag", Constant(true, TensorShape({1})));
+    Expect<tstring>(&reader, "strings", Constant_2x3<tstring>("hello"));
+    TF_ASSERT_OK(reader.Lookup("floats", &floats));
+  }
+  // The mapping outlives the reader and is never handed out for in-place
+  // updates.
+  test::ExpectTensorEqual<float>(floats, Constant_100x100<float>(3));
+  EXPECT_FALSE(floats.RefCountIsOne());
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(floats.tensor_data().data()) %
+                   EIGEN_MAX_ALIGN_BYTES);
+}
+
+TEST(TensorBundleTest, MemoryMappedRestoreFallsBackWhenUnaligned) {
+  {
+    BundleWriter writer(Env::Default(), Prefix("foo"));
+    TF_EXPECT_OK(writer.Add("flag", Constant(true, TensorShape({1}))));
+    TF_EXPECT_OK(writer.Add("floats", Constant_100x100<float>(3)));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  BundleReader reader(Env::Default(), Prefix("foo"), MemoryMappedOptions());
+  TF_ASSERT_OK(reader.status());
+  Tensor floats;
+  TF_ASSERT_OK(reader.Lookup("floats", &floats));
+  test::ExpectTensorEqual<float>(floats, Constant_100x100<float>(3));
+  EXPECT_TRUE(floats.RefCountIsOne());
+}
+
+TEST(TensorBundleTest, ParallelChunkedWrite) {
+  {
+    BundleWriter::Options opts;
+    opts.num_data_shards = 3;
+    opts.max_chunk_bytes = 1000;  // 2 rows of a 100x100 float tensor.
+    BundleWriter writer(Env::Default(), Prefix("foo"), opts);
+    TF_EXPECT_OK(writer.Add("big", Constant_100x100<float>(3)));
+    TF_EXPECT_OK(writer.Add("small", Constant_2x3<int32>(1)));
+    TF_EXPECT_OK(writer.Add("strings", Constant_2x3<tstring>("hello")));
+    TF_ASSERT_OK(writer.Finish());
+  }
+  for (int i = 0; i < 3; ++i) {
+    TF_EXPECT_OK(Env::Default()->FileExists(DataFilename(Prefix("foo"), i, 3)));
+  }
+  BundleReader reader(Env::Default(), Prefix("foo"));
+  TF_ASSERT_OK(reader.status());
+  Expect<float>(&reader, "big", Constant_100x100<float>(3));
+  Expect<int32>(&reader, "small", Constant_2x3<int32>(1));
+  Expect<tstring>(&reader, "strings", Constant_2x3<tstring>("hello"));
+  std::vector<TensorSlice> slices;
+  TF_ASSERT_OK(reader.LookupTensorSlices("big", &slices));
+  EXPECT_EQ(50, slices.size());
+
+  Tensor big;
+  TF_ASSERT_OK(reader.Lookup("big", &big));
+  test::ExpectTensorEqual<float>(big, Constant_100x100<float>(3));
+}
+
 class TensorBundleAlignmentTest : public ::testing::Test {
  protected:
   template <typename T>
@@ -1227,6 +1307,71 @@ BENCHMARK(BM_BundleAlignment)->ArgPair(4096, 512);
 BENCHMARK(BM_BundleAlignment)->ArgPair(4096, 4096);
 BENCHMARK(BM_BundleAlignment)->ArgPair(4096, 1048576);
 
+// Sets "*resident" to the resident set size of the process and "*anonymous"
+// to the part of it that is not backed by files, i.e. mostly heap. Both are
+// 0 if they are unknown.
+static void ResidentBytes(int64_t* resident, int64_t* anonymous) {
+  *resident = 0;
+  *anonymous = 0;
+#if defined(__linux__)
+  // /proc files report a size of 0, so ReadFileToString() cannot read them.
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == nullptr) return;
+  long long size_pages = 0;      // NOLINT(runtime/int)
+  long long resident_pages = 0;  // NOLINT(runtime/int)
+  long long shared_pages = 0;    // NOLINT(runtime/int)
+  const int num_read = fscanf(statm, "%lld %lld %lld", &size_pages,
+                              &resident_pages, &shared_pages);
+  fclose(statm);
+  if (num_read != 3) return;
+  *resident = resident_pages * sysconf(_SC_PAGESIZE);
+  *anonymous = (resident_pages - shared_pages) * sysconf(_SC_PAGESIZE);
+#endif
+}
+
+// Restores a single float tensor of state.range(0) MiB, either copying it into
+// a heap buffer or aliasing the memory-mapped data file (state.range(1) != 0),
+// and reads all of it. The label reports how much the resident set size of
+// the process, and its anonymous (heap) part, grew while the restored tensor
+// is alive. Mapped pages only count towards the former.
+static void BM_BundleRestore(::testing::benchmark::State& state) {
+  const int64_t num_floats = state.range(0) * (1 << 20) / sizeof(float);
+  const bool use_memory_mapped_data = state.range(1) != 0;
+  {
+    BundleWriter::Options opts;
+    opts.data_alignment = EIGEN_MAX_ALIGN_BYTES;
+    BundleWriter writer(Env::Default(), Prefix("foo"), opts);
+    TF_CHECK_OK(writer.Add("big", Constant(1.5f, TensorShape({num_floats}))));
+    TF_CHECK_OK(writer.Finish());
+  }
+  BundleReader::Options options;
+  options.use_memory_mapped_data = use_memory_mapped_data;
+  int64_t rss_growth = 0;
+  int64_t heap_growth = 0;
+  for (auto s : state) {
+    int64_t rss_before, heap_before;
+    ResidentBytes(&rss_before, &heap_before);
+    BundleReader reader(Env::Default(), Prefix("foo"), options);
+    TF_CHECK_OK(reader.status());
+    Tensor t;
+    TF_CHECK_OK(reader.Lookup("big", &t));
+    // Faults in every page of a mapped tensor.
+    float sum = 0;
+    auto flat = t.flat<float>();
+    for (int64_t i = 0; i < num_floats; ++i) sum += flat(i);
+    testing::DoNotOptimize(sum);
+    int64_t rss_after, heap_after;
+    ResidentBytes(&rss_after, &heap_after);
+    rss_growth = rss_after - rss_before;
+    heap_growth = heap_after - heap_before;
+  }
+  state.SetBytesProcessed(state.iterations() * num_floats * sizeof(float));
+  state.SetLabel(strings::StrCat("rss_growth: ", rss_growth,
+                                 " heap_growth: ", heap_growth));
+}
+
+BENCHMARK(BM_BundleRestore)->ArgsProduct({{1, 64, 256}, {0, 1}});
+
 static void BM_BundleWriterSmallTensor(::testing::benchmark::State& state) {
   const int64_t bytes = state.range(0);
   Tensor t = Constant(static_cast<int8>('a'), TensorShape{bytes});
@@ -1252,4 +1397,22 @@ static void BM_BundleWriterLargeTensor(::testing::benchmark::State& state) {
 BENCHMARK(BM_BundleWriterLargeTensor)->Arg(1 << 10);
 BENCHMARK(BM_BundleWriterLargeTensor)->Arg(4 << 10);
 
+// Saves a single float variable of state.range(0) MiB, spread over
+// state.range(1) data files.
+static void BM_BundleWriterParallel(::testing::benchmark::State& state) {
+  const int64_t bytes = static_cast<int64_t>(state.range(0)) * (1 << 20);
+  Tensor t = Constant(1.5f, TensorShape{bytes / 1024, 256});
+  BundleWriter::Options opts;
+  opts.num_data_shards = state.range(1);
+  for (auto s : state) {
+    BundleWriter writer(Env::Default(), Prefix("foo"), opts);
+    TF_CHECK_OK(writer.Add("big", t));
+    TF_CHECK_OK(writer.Finish());
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+BENCHMARK(BM_BundleWriterParallel)
+    ->ArgsProduct({{1 << 10, 4 << 10, 10 << 10}, {1, 4, 8}});
+
 }  // namespace tensorflow
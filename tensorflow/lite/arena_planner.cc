@@ -43,6 +43,7 @@ ArenaPlanner::ArenaPlanner(TfLiteContext* context,
       graph_info_(std::move(graph_info)),
       arena_(kDefaultArenaAlignment, subgraph_index),
       persistent_arena_(kDefaultArenaAlignment, subgraph_index),
+      graph_io_arena_(kDefaultArenaAlignment, subgraph_index),
       preserve_all_tensors_(preserve_all_tensors),
       tensor_alignment_(tensor_alignment),
       last_active_node_(kLastActiveNodeUndefined) {}
@@ -50,6 +51,7 @@ ArenaPlanner::ArenaPlanner(TfLiteContext* context,
 ArenaPlanner::~ArenaPlanner() {
   arena_.ReleaseBuffer();
   persistent_arena_.ReleaseBuffer();
+  graph_io_arena_.ReleaseBuffer();
 }
 
 std::intptr_t ArenaPlanner::BasePointer(TfLiteAllocationType type) {
@@ -62,9 +64,41 @@ std::intptr_t ArenaPlanner::BasePointer(TfLiteAllocationType type) {
   return 0;
 }
 
+void ArenaPlanner::SetArenaBufferPool(ArenaBufferPool* pool) {
+  arena_buffer_pool_ = pool;
+  arena_.SetBufferPool(pool);
+}
+
+SimpleMemoryArena& ArenaPlanner::ArenaForTensor(int tensor_index) {
+  if (tensor_index < static_cast<int>(is_graph_io_tensor_.size()) &&
+      is_graph_io_tensor_[tensor_index]) {
+    return graph_io_arena_;
+  }
+  return arena_;
+}
+
+void ArenaPlanner::CalculateActiveAllocs(int node) {
+  if (is_graph_io_tensor_.empty()) {
+    arena_.CalculateActiveAllocs(allocs_, node);
+    return;
+  }
+  std::vector<ArenaAllocWithUsageInterval> allocs;
+  std::vector<ArenaAllocWithUsageInterval> graph_io_allocs;
+  for (int i = 0; i < static_cast<int>(allocs_.size()); ++i) {
+    if (&ArenaForTensor(i) == &graph_io_arena_) {
+      graph_io_allocs.push_back(allocs_[i]);
+    } else {
+      allocs.push_back(allocs_[i]);
+    }
+  }
+  arena_.CalculateActiveAllocs(allocs, node);
+  graph_io_arena_.CalculateActiveAllocs(graph_io_allocs, node);
+}
+
 TfLiteStatus ArenaPlanner::ResetAllocations() {
   TF_LITE_ENSURE_STATUS(arena_.ClearPlan());
   TF_LITE_ENSURE_STATUS(persistent_arena_.ClearPlan());
+  TF_LITE_ENSURE_STATUS(graph_io_arena_.ClearPlan());
   allocs_.clear();
   allocs_.resize(graph_info_->num_tensors());
   // NOMUTANTS -- Setting last_active_node_ to kLastActiveNodeUndefined causes
@@ -86,9 +120,10 @@ TfLiteStatus ArenaPlanner::ResetAllocationsAfter(int node) {
     }
   }
   if (last_active_node_ > node) {
-    arena_.CalculateActiveAllocs(allocs_, node);
+    CalculateActiveAllocs(node);
   } else {
     arena_.PurgeAfter(node);
+    graph_io_arena_.PurgeAfter(node);
   }
   last_active_node_ = node;
   return kTfLiteOk;
@@ -211,6 +246,22 @@ TfLiteStatus ArenaPlanner::PlanAllocations() {
   // Keeps track of references to each tensor.
   refcounts_.assign(num_tensors, 0);
 
+  // Graph inputs and outputs must outlive the leases of a shared buffer.
+  is_graph_io_tensor_.clear();
+  if (arena_buffer_pool_ != nullptr) {
+    is_graph_io_tensor_.assign(num_tensors, false);
+    for (int tensor_index : graph_info_->inputs()) {
+      if (tensor_index != kTfLiteOptionalTensor) {
+        is_graph_io_tensor_[tensor_index] = true;
+      }
+    }
+    for (int tensor_index : graph_info_->outputs()) {
+      if (tensor_index != kTfLiteOptionalTensor) {
+        is_graph_io_tensor_[tensor_index] = true;
+      }
+    }
+  }
+
   auto allocate = [this](int node, int tensor) -> TfLiteStatus {
     if (alloc_node_[tensor] != kNodeNotAssigned) {
       // Tensor has already been allocated.
@@ -384,7 +435,8 @@ TfLiteStatus ArenaPlanner::ReleaseNonPersistentMemory() {
   TfLiteTensor* tensors = graph_info_->tensors();
   for (int i = 0; i < static_cast<int>(graph_info_->num_tensors()); ++i) {
     TfLiteTensor& tensor = tensors[i];
-    if (tensor.allocation_type == kTfLiteArenaRw) {
+    if (tensor.allocation_type == kTfLiteArenaRw &&
+        &ArenaForTensor(FindSharedTensor(i)) == &arena_) {
       tensor.data.raw = nullptr;
     }
   }
@@ -414,11 +466,15 @@ void ArenaPlanner::DumpDebugInfo(const std::vector<int>& execution_plan) const {
   arena_.DumpDebugInfo("kTfLiteArenaRw Dump:", execution_plan);
   persistent_arena_.DumpDebugInfo("kTfLiteArenaRwPersistent Dump:",
                                   execution_plan);
+  if (arena_buffer_pool_ != nullptr) {
+    graph_io_arena_.DumpDebugInfo("kTfLiteArenaRw Graph IO Dump:",
+                                  execution_plan);
+  }
 }
 
 void ArenaPlanner::GetAllocInfo(size_t* arena_size,
                                 size_t* arena_persist_size) const {
-  *arena_size = arena_.GetBufferSize();
+  *arena_size = arena_.GetBufferSize() + graph_io_arena_.GetBufferSize();
   *arena_persist_size = persistent_arena_.GetBufferSize();
 }
 
@@ -429,6 +485,12 @@ TfLiteStatus ArenaPlanner::Commit(bool* reallocated) {
       persistent_arena_.Commit(context_, &persistent_arena_reallocated));
   *reallocated = arena_reallocated;
   *reallocated |= persistent_arena_reallocated;
+  if (arena_buffer_pool_ != nullptr) {
+    bool graph_io_arena_reallocated;
+    TF_LITE_ENSURE_STATUS(
+        graph_io_arena_.Commit(context_, &graph_io_arena_reallocated));
+    *reallocated |= graph_io_arena_reallocated;
+  }
   return kTfLiteOk;
 }
 
@@ -504,11 +566,13 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(
   }
   if (first_node < last_active_node_) {
     arena_.ResetAllocs();
+    graph_io_arena_.ResetAllocs();
     last_active_node_ = first_node;
   } else {
     // NOMUTANTS -- This function has no impact on the results, it only makes
     // exection faster.
     arena_.PurgeActiveAllocs(first_node);
+    graph_io_arena_.PurgeActiveAllocs(first_node);
   }
   CreateTensorAllocationVector(tensors_allocated);
   // Vector of ids of already allocated tensors, ordered by offset.
@@ -534,10 +598,12 @@ TfLiteStatus ArenaPlanner::CalculateAllocations(
       }
     }
     if (tensor.allocation_type == kTfLiteArenaRw) {
-      TF_LITE_ENSURE_STATUS(
-          arena_.Allocate(context_, tensor_alignment_, tensor.bytes,
-                          tensor_index, alloc_node_[tensor_index],
-                          dealloc_node_[tensor_index], &allocs_[tensor_index]));
+      TF_LITE_ENSURE_STATUS(ArenaForTensor(tensor_index)
+                                .Allocate(context_, tensor_alignment_,
+                                          tensor.bytes, tensor_index,
+                                          alloc_node_[tensor_index],
+                                          dealloc_node_[tensor_index],
+                                          &allocs_[tensor_index]));
     }
     // Check allocs_[].size to prevent from reallocation of persistent tensors.
     // Only allocate ArenaRwPersistent tensors which own their buffer.
@@ -593,8 +659,8 @@ TfLiteStatus ArenaPlanner::ResolveTensorAllocation(int32_t tensor_index,
     // Skip resolution if the size of the tensor is zero, leaving it as a
     // nullptr.
     if (allocs_[tensor_index].size != 0) {
-      return arena_.ResolveAlloc(context_, allocs_[tensor_index],
-                                 &tensor.data.raw);
+      return ArenaForTensor(tensor_index)
+          .ResolveAlloc(context_, allocs_[tensor_index], &tensor.data.raw);
     }
   }
   if (tensor.allocation_type == kTfLiteArenaRwPersistent) {
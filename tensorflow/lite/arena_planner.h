@@ -72,6 +72,17 @@ class ArenaPlanner : public MemoryPlanner {
   // Returns the base arena location for a given allocation type.
   std::intptr_t BasePointer(TfLiteAllocationType type);
 
+  // Makes the arena of non-persistent tensors lease its buffer from `pool`, so
+  // that the buffer can be shared with other planners between calls to
+  // `AcquireNonPersistentMemory()` and `ReleaseNonPersistentMemory()`. Graph
+  // inputs and outputs are then allocated in a separate arena that is not
+  // released, so they remain valid while the buffer is not held. Intermediate
+  // tensors are invalidated whenever the buffer is released. `pool` must
+  // outlive the planner.
+  // REQUIRES: Called before `PlanAllocations()`.
+  // WARNING: This is an experimental API and subject to change.
+  void SetArenaBufferPool(ArenaBufferPool* pool);
+
  private:
   // Check whether the input tensor's memory may be shared the output tensor.
   // tensor_changed: true if the output tensor modifies the tensor data. For
@@ -120,6 +131,12 @@ class ArenaPlanner : public MemoryPlanner {
   // Return the index of the tensor owing `tensor_index's` buffer.
   int FindSharedTensor(int tensor_index);
 
+  // Returns the arena that holds the kTfLiteArenaRw tensor `tensor_index`.
+  SimpleMemoryArena& ArenaForTensor(int tensor_index);
+
+  // Calculates the active allocs of the kTfLiteArenaRw arenas at `node`.
+  void CalculateActiveAllocs(int node);
+
   TfLiteContext* context_;
   std::unique_ptr<GraphInfo> graph_info_;
 
@@ -146,6 +163,17 @@ class ArenaPlanner : public MemoryPlanner {
   // declared as kTfLiteArenaRwPersistent.
   SimpleMemoryArena persistent_arena_;
 
+  // Raw memory buffer for the graph inputs and outputs declared kTfLiteArenaRw
+  // when `arena_` leases its buffer from `arena_buffer_pool_`.
+  SimpleMemoryArena graph_io_arena_;
+
+  // Pool that `arena_` leases its buffer from, or nullptr if `arena_` owns its
+  // buffer.
+  ArenaBufferPool* arena_buffer_pool_ = nullptr;
+
+  // Whether each tensor is allocated in `graph_io_arena_`.
+  std::vector<bool> is_graph_io_tensor_;
+
   // If true, then no overlapping of memory areas is done, meaning intermediate
   // tensors and temporary tensors can be queried after running.
   // (modulo running delegates)
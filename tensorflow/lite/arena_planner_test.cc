@@ -206,12 +206,16 @@ void ReportError(TfLiteContext* context, const char* format, ...) {
 
 class ArenaPlannerTest : public ::testing::Test {
  protected:
-  void SetGraph(TestGraph* graph, bool preserve_all_tensors = false) {
+  void SetGraph(TestGraph* graph, bool preserve_all_tensors = false,
+                ArenaBufferPool* arena_buffer_pool = nullptr) {
     graph_ = graph;
     context_.ReportError = ReportError;
     planner_ = std::make_unique<ArenaPlanner>(
         &context_, std::unique_ptr<GraphInfo>(new TestGraphInfo(graph)),
         preserve_all_tensors, kTensorAlignment);
+    if (arena_buffer_pool != nullptr) {
+      planner_->SetArenaBufferPool(arena_buffer_pool);
+    }
     CHECK(planner_->ResetAllocations() == kTfLiteOk);
     CHECK(planner_->PlanAllocations() == kTfLiteOk);
   }
@@ -964,6 +968,60 @@ TEST_F(ArenaPlannerTest, ModifiedGraph_DeallocateNonPersistentArena) {
   EXPECT_EQ(GetOffset(3), GetOffsetAfter(1));
 }
 
+TEST_F(ArenaPlannerTest, SharedArenaBufferPool) {
+  TestGraph graph({0, 1},
+                  {
+                      /* in, out, tmp */
+                      {{0, 1}, {2}, {}},     // First op
+                      {{2, 0}, {4, 5}, {}},  // Second op
+                      {{4, 5}, {3}, {}}      // Third op
+                  },
+                  {3});
+  ArenaBufferPool pool;
+  SetGraph(&graph, /*preserve_all_tensors=*/false, &pool);
+  Execute(0, graph.nodes().size() - 1);
+  EXPECT_TRUE(HasNonPersistentMemory());
+  EXPECT_EQ(pool.GetNumBuffers(), 1);
+  const size_t shared_bytes = pool.GetAllocatedBytes();
+  std::vector<TfLiteTensor>& tensors = *graph.tensors();
+  const void* input = tensors[0].data.raw;
+  const void* output = tensors[3].data.raw;
+
+  // Releasing the buffer keeps the graph inputs and outputs.
+  ReleaseNonPersistentMemory();
+  EXPECT_FALSE(HasNonPersistentMemory());
+  EXPECT_EQ(tensors[0].data.raw, input);
+  EXPECT_NE(tensors[1].data.raw, nullptr);
+  EXPECT_EQ(tensors[3].data.raw, output);
+  EXPECT_TRUE(IsUnallocated(2));
+  EXPECT_TRUE(IsUnallocated(4));
+  EXPECT_TRUE(IsUnallocated(5));
+
+  // A planner of another graph leases the same buffer.
+  TestGraph other_graph({0}, {{{0}, {1}, {}}, {{1}, {2}, {}}}, {2});
+  ArenaPlanner other_planner(
+      &context_, std::make_unique<TestGraphInfo>(&other_graph),
+      /*preserve_all_tensors=*/false, kTensorAlignment);
+  other_planner.SetArenaBufferPool(&pool);
+  ASSERT_EQ(other_planner.PlanAllocations(), kTfLiteOk);
+  ASSERT_EQ(other_planner.ExecuteAllocations(0, 1), kTfLiteOk);
+  EXPECT_EQ(pool.GetNumBuffers(), 1);
+  EXPECT_EQ(pool.GetAllocatedBytes(), shared_bytes);
+  EXPECT_NE((*other_graph.tensors())[1].data.raw, nullptr);
+
+  // Planners that hold memory at the same time need separate buffers.
+  AcquireNonPersistentMemory();
+  EXPECT_EQ(pool.GetNumBuffers(), 2);
+  EXPECT_FALSE(IsUnallocated(2));
+  EXPECT_FALSE(IsUnallocated(4));
+  EXPECT_FALSE(IsUnallocated(5));
+  EXPECT_EQ(tensors[0].data.raw, input);
+  EXPECT_EQ(tensors[3].data.raw, output);
+  ASSERT_EQ(other_planner.ReleaseNonPersistentMemory(), kTfLiteOk);
+  // The planner must not outlive the pool.
+  Destroy();
+}
+
 TEST_F(ArenaPlannerTest, ComplexGraph) {
   TestGraph graph({0},
                   {
@@ -964,6 +964,15 @@ std::vector<int> Subgraph::GetInputTensorsCount() {
 }
 
 TfLiteStatus Subgraph::AllocateTensors() {
+  TfLiteStatus status = AllocateTensorsImpl();
+  // A buffer leased from a shared pool is only held during `Invoke()`.
+  if (arena_buffer_pool_ && memory_planner_) {
+    TF_LITE_ENSURE_STATUS(memory_planner_->ReleaseNonPersistentMemory());
+  }
+  return status;
+}
+
+TfLiteStatus Subgraph::AllocateTensorsImpl() {
   if (!consistent_) {
     ReportError("AllocateTensors() called on inconsistent model.");
     return kTfLiteError;
@@ -1521,9 +1530,15 @@ TfLiteStatus Subgraph::PrepareOpsAndTensors() {
 #ifdef TFLITE_USE_SIMPLE_MEMORY_PLANNER
     memory_planner_.reset(new SimplePlanner(&context_, CreateGraphInfo()));
 #else
-    memory_planner_ = std::make_unique<ArenaPlanner>(
+    auto arena_planner = std::make_unique<ArenaPlanner>(
         &context_, CreateGraphInfo(), ShouldPreserveAllTensors(),
         kDefaultTensorAlignment, subgraph_index_);
+    if (options_ && options_->GetArenaBufferPool() &&
+        !ShouldPreserveAllTensors()) {
+      arena_buffer_pool_ = options_->GetArenaBufferPool();
+      arena_planner->SetArenaBufferPool(arena_buffer_pool_.get());
+    }
+    memory_planner_ = std::move(arena_planner);
 #endif
     memory_planner_->PlanAllocations();
   }
@@ -1578,7 +1593,19 @@ TfLiteStatus Subgraph::RemoveUnusedInputs() {
 }
 
 TfLiteStatus Subgraph::Invoke() {
-  auto status = InvokeImpl();
+  TfLiteStatus status;
+  if (arena_buffer_pool_ && memory_planner_ && state_ != kStateUninvokable) {
+    // Lease the buffer of non-persistent tensors for this invocation only.
+    status = memory_planner_->AcquireNonPersistentMemory();
+    if (status == kTfLiteOk) {
+      status = InvokeImpl();
+    }
+    if (memory_planner_->ReleaseNonPersistentMemory() != kTfLiteOk) {
+      status = kTfLiteError;
+    }
+  } else {
+    status = InvokeImpl();
+  }
   telemetry::TelemetryReportEvent(&context_, "Invoke", status);
   return status;
 }
@@ -689,6 +689,9 @@ class Subgraph {
   // Does not report invoke status through profiler.
   TfLiteStatus InvokeImpl();
 
+  // Implements `AllocateTensors()`.
+  TfLiteStatus AllocateTensorsImpl();
+
   // Allow a delegate to look at the graph and modify the graph to handle
   // parts of the graph themselves. After this is called, the graph may
   // contain new nodes that replace 1 more nodes.
@@ -1036,6 +1039,11 @@ class Subgraph {
   // Used by PreviewDelegateParitioning.
   std::vector<TfLiteDelegateParams> partitioning_preview_cache_;
 
+  // Pool the memory planner leases the buffer of non-persistent tensors from,
+  // if set in the interpreter options. The buffer is only held during
+  // `Invoke()`.
+  std::shared_ptr<ArenaBufferPool> arena_buffer_pool_;
+
   std::unique_ptr<MemoryPlanner> memory_planner_;
 
   // Maps tensor index to custom allocation for all applicable tensors.
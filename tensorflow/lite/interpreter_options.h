@@ -19,8 +19,13 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_INTERPRETER_OPTIONS_H_
 #define TENSORFLOW_LITE_INTERPRETER_OPTIONS_H_
 
+#include <memory>
+#include <utility>
+
 namespace tflite {
 
+class ArenaBufferPool;
+
 /// Options class for `Interpreter`.
 /// WARNING: This is an experimental API and subject to change.
 class InterpreterOptions {
@@ -93,11 +98,31 @@ class InterpreterOptions {
     experimental_disable_delegate_clustering_ = value;
   }
 
+  /// Shares the buffer that holds the intermediate tensors with the other
+  /// interpreters using `pool`. The buffer is only held for the duration of
+  /// `Invoke()`, so many interpreters that are not invoked at the same time,
+  /// e.g. several models served by one process, need a single buffer sized for
+  /// the largest of them instead of one buffer each. Graph inputs and outputs
+  /// keep their own memory. Intermediate tensors can not be read after
+  /// `Invoke()`, and delegates that hold on to tensor data pointers between
+  /// invocations must not be used. Ignored if all tensors are preserved.
+  /// WARNING: This is an experimental API and subject to change.
+  void SetArenaBufferPool(std::shared_ptr<ArenaBufferPool> pool) {
+    experimental_arena_buffer_pool_ = std::move(pool);
+  }
+
+  /// Returns the pool set by `SetArenaBufferPool()`, or nullptr.
+  /// WARNING: This is an experimental API and subject to change.
+  const std::shared_ptr<ArenaBufferPool>& GetArenaBufferPool() {
+    return experimental_arena_buffer_pool_;
+  }
+
  private:
   bool experimental_preserve_all_tensors_;
   bool experimental_ensure_dynamic_tensors_are_released_;
   int experimental_optimize_memory_for_large_tensors_;
   bool experimental_disable_delegate_clustering_;
+  std::shared_ptr<ArenaBufferPool> experimental_arena_buffer_pool_;
 };
 
 }  // namespace tflite
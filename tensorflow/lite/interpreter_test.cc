@@ -38,6 +38,7 @@ limitations under the License.
 #include "tensorflow/lite/external_cpu_backend_context.h"
 #include "tensorflow/lite/interpreter_test_util.h"
 #include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/simple_memory_arena.h"
 #include "tensorflow/lite/string_util.h"
 #include "tensorflow/lite/testing/util.h"
 #include "tensorflow/lite/util.h"
@@ -754,6 +755,53 @@ TEST(BasicInterpreter, ReleaseNonPersistentMemory) {
   ASSERT_EQ(interpreter.Invoke(), kTfLiteOk);
 }
 
+TEST(BasicInterpreter, SharedArenaBufferPool) {
+  auto pool = std::make_shared<ArenaBufferPool>();
+  InterpreterOptions options;
+  options.SetArenaBufferPool(pool);
+  TfLiteRegistration reg = GetPassthroughOpRegistration();
+  TfLiteQuantizationParams quantized;
+  Interpreter interpreters[2];
+  for (Interpreter& interpreter : interpreters) {
+    ASSERT_EQ(interpreter.AddTensors(3), kTfLiteOk);
+    ASSERT_EQ(interpreter.SetInputs({0}), kTfLiteOk);
+    ASSERT_EQ(interpreter.SetOutputs({2}), kTfLiteOk);
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_EQ(interpreter.SetTensorParametersReadWrite(i, kTfLiteFloat32, "",
+                                                         {3}, quantized),
+                kTfLiteOk);
+    }
+    ASSERT_EQ(
+        interpreter.AddNodeWithParameters({0}, {1}, nullptr, 0, nullptr, &reg),
+        kTfLiteOk);
+    ASSERT_EQ(
+        interpreter.AddNodeWithParameters({1}, {2}, nullptr, 0, nullptr, &reg),
+        kTfLiteOk);
+    ASSERT_EQ(interpreter.ApplyOptions(&options), kTfLiteOk);
+    ASSERT_EQ(interpreter.AllocateTensors(), kTfLiteOk);
+  }
+
+  for (int i = 0; i < 2; ++i) {
+    Interpreter& interpreter = interpreters[i];
+    // The graph input is available outside of Invoke().
+    float* input = interpreter.typed_input_tensor<float>(0);
+    for (int j = 0; j < 3; ++j) {
+      input[j] = i * 3 + j;
+    }
+    ASSERT_EQ(interpreter.Invoke(), kTfLiteOk);
+    // Intermediate tensors are only available during Invoke().
+    EXPECT_EQ(interpreter.tensor(1)->data.raw, nullptr);
+  }
+  for (int i = 0; i < 2; ++i) {
+    const float* output = interpreters[i].typed_output_tensor<float>(0);
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(output[j], i * 3 + j);
+    }
+  }
+  // Both interpreters used the same buffer.
+  EXPECT_EQ(pool->GetNumBuffers(), 1);
+}
+
 // Forcefully divides tensor allocation in three steps: one before invocation
 // and two more at invocation time. This happens because we use string tensors
 // and their sizes can't be determined until invocation time.
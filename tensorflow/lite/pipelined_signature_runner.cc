@@ -0,0 +1,334 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/pipelined_signature_runner.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/minimal_logging.h"
+#include "tensorflow/lite/util.h"
+
+namespace tflite {
+namespace {
+
+// Returns whether `tensor` can be bound to a custom allocation.
+bool SupportsCustomAllocation(const TfLiteTensor& tensor) {
+  return tensor.allocation_type == kTfLiteArenaRw ||
+         tensor.allocation_type == kTfLiteArenaRwPersistent ||
+         tensor.allocation_type == kTfLiteCustom;
+}
+
+// Returns whether dimension 0 of `tensor` can be resized.
+bool HasDynamicBatchDim(const TfLiteTensor& tensor) {
+  return tensor.dims != nullptr && tensor.dims->size > 0 &&
+         tensor.dims_signature != nullptr &&
+         tensor.dims_signature->size > 0 &&
+         tensor.dims_signature->data[0] == -1;
+}
+
+}  // namespace
+
+std::unique_ptr<PipelinedSignatureRunner> PipelinedSignatureRunner::Create(
+    SignatureRunner* runner, const Options& options) {
+  if (runner == nullptr || options.max_batch_size < 1) {
+    TFLITE_LOG(TFLITE_LOG_ERROR,
+               "PipelinedSignatureRunner requires a signature runner and a "
+               "positive max_batch_size.");
+    return nullptr;
+  }
+  int max_batch_size = options.max_batch_size;
+  for (const char* name : runner->input_names()) {
+    const TfLiteTensor* tensor = runner->input_tensor(name);
+    if (tensor == nullptr || tensor->type == kTfLiteString ||
+        tensor->dims == nullptr) {
+      TFLITE_LOG(TFLITE_LOG_ERROR,
+                 "PipelinedSignatureRunner does not support input %s.", name);
+      return nullptr;
+    }
+    if (max_batch_size > 1 && !HasDynamicBatchDim(*tensor)) {
+      TFLITE_LOG(TFLITE_LOG_INFO,
+                 "Dimension 0 of input %s is static, disabling batching.",
+                 name);
+      max_batch_size = 1;
+    }
+  }
+  for (const char* name : runner->output_names()) {
+    const TfLiteTensor* tensor = runner->output_tensor(name);
+    if (tensor == nullptr || tensor->type == kTfLiteString) {
+      TFLITE_LOG(TFLITE_LOG_ERROR,
+                 "PipelinedSignatureRunner does not support output %s.", name);
+      return nullptr;
+    }
+  }
+  return std::unique_ptr<PipelinedSignatureRunner>(
+      new PipelinedSignatureRunner(runner, max_batch_size));
+}
+
+PipelinedSignatureRunner::PipelinedSignatureRunner(SignatureRunner* runner,
+                                                   int max_batch_size)
+    : runner_(runner), max_batch_size_(max_batch_size) {
+  for (const char* name : runner_->input_names()) {
+    const TfLiteTensor* tensor = runner_->input_tensor(name);
+    request_input_dims_.emplace_back(tensor->dims->data,
+                                     tensor->dims->data + tensor->dims->size);
+    request_input_bytes_.push_back(tensor->bytes);
+    double_buffer_inputs_ &= SupportsCustomAllocation(*tensor);
+  }
+  for (const char* name : runner_->output_names()) {
+    const TfLiteTensor* tensor = runner_->output_tensor(name);
+    request_output_bytes_.push_back(tensor->bytes);
+    double_buffer_outputs_ &= SupportsCustomAllocation(*tensor);
+  }
+
+  auto allocate = [](size_t bytes) {
+    AlignedBuffer buffer;
+    buffer.bytes = bytes;
+    buffer.allocation.reset(new char[bytes + kDefaultTensorAlignment]);
+    const uintptr_t address =
+        reinterpret_cast<uintptr_t>(buffer.allocation.get());
+    buffer.data = buffer.allocation.get() +
+                  (kDefaultTensorAlignment - address % kDefaultTensorAlignment);
+    return buffer;
+  };
+  for (Slot& slot : slots_) {
+    if (double_buffer_inputs_) {
+      for (size_t bytes : request_input_bytes_) {
+        slot.inputs.push_back(allocate(bytes * max_batch_size_));
+      }
+    }
+    if (double_buffer_outputs_) {
+      for (size_t bytes : request_output_bytes_) {
+        slot.outputs.push_back(allocate(bytes * max_batch_size_));
+      }
+    }
+  }
+  worker_ = std::thread([this] { WorkerLoop(); });
+}
+
+PipelinedSignatureRunner::~PipelinedSignatureRunner() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutdown_ = true;
+  }
+  cond_var_.notify_all();
+  worker_.join();
+}
+
+TfLiteStatus PipelinedSignatureRunner::Run(
+    const std::vector<PipelinedRequest>& requests) {
+  for (const PipelinedRequest& request : requests) {
+    if (request.inputs.size() != request_input_bytes_.size() ||
+        request.outputs.size() != request_output_bytes_.size()) {
+      TFLITE_LOG(TFLITE_LOG_ERROR,
+                 "Expected requests with %d inputs and %d outputs.",
+                 static_cast<int>(request_input_bytes_.size()),
+                 static_cast<int>(request_output_bytes_.size()));
+      return kTfLiteError;
+    }
+  }
+  auto batch_size_at = [&](size_t first) {
+    return static_cast<int>(std::min<size_t>(max_batch_size_,
+                                             requests.size() - first));
+  };
+
+  TfLiteStatus status = kTfLiteOk;
+  // The batch whose outputs are still to be copied, if any.
+  Batch pending;
+  int slot = 0;
+  if (!requests.empty() && double_buffer_inputs_) {
+    StageInputs(requests, 0, batch_size_at(0), slots_[slot]);
+  }
+  for (size_t first = 0; first < requests.size();) {
+    Batch batch;
+    batch.first = first;
+    batch.num_requests = batch_size_at(first);
+    batch.status =
+        PrepareInvocation(requests, first, batch.num_requests, slots_[slot]);
+    if (batch.status == kTfLiteOk) {
+      StartInvocation();
+    }
+    // Overlap the invocation with copying the outputs of the previous batch
+    // and the inputs of the next one.
+    if (pending.num_requests > 0) {
+      if (CompleteRequests(requests, pending) != kTfLiteOk) {
+        status = kTfLiteError;
+      }
+      pending = Batch();
+    }
+    const size_t next = first + batch.num_requests;
+    if (next < requests.size() && double_buffer_inputs_) {
+      StageInputs(requests, next, batch_size_at(next), slots_[1 - slot]);
+    }
+    if (batch.status == kTfLiteOk) {
+      batch.status = WaitForInvocation();
+    }
+    if (batch.status == kTfLiteOk) {
+      batch.status = CollectOutputs(slots_[slot], &batch);
+    }
+    if (double_buffer_outputs_) {
+      pending = std::move(batch);
+    } else if (CompleteRequests(requests, batch) != kTfLiteOk) {
+      status = kTfLiteError;
+    }
+    first = next;
+    slot = 1 - slot;
+  }
+  if (pending.num_requests > 0 &&
+      CompleteRequests(requests, pending) != kTfLiteOk) {
+    status = kTfLiteError;
+  }
+  return status;
+}
+
+void PipelinedSignatureRunner::StageInputs(
+    const std::vector<PipelinedRequest>& requests, size_t first,
+    int num_requests, const Slot& slot) {
+  for (size_t i = 0; i < request_input_bytes_.size(); ++i) {
+    const size_t bytes = request_input_bytes_[i];
+    for (int j = 0; j < num_requests; ++j) {
+      std::memcpy(slot.inputs[i].data + j * bytes,
+                  requests[first + j].inputs[i], bytes);
+    }
+  }
+}
+
+TfLiteStatus PipelinedSignatureRunner::PrepareInvocation(
+    const std::vector<PipelinedRequest>& requests, size_t first,
+    int num_requests, const Slot& slot) {
+  const std::vector<const char*>& input_names = runner_->input_names();
+  const std::vector<const char*>& output_names = runner_->output_names();
+  if (num_requests != current_batch_size_) {
+    for (size_t i = 0; i < input_names.size(); ++i) {
+      std::vector<int> dims = request_input_dims_[i];
+      dims[0] *= num_requests;
+      TF_LITE_ENSURE_STATUS(runner_->ResizeInputTensor(input_names[i], dims));
+    }
+    current_batch_size_ = num_requests;
+  }
+  // Binding a custom allocation to a tensor that already has one only updates
+  // its data pointer.
+  if (double_buffer_inputs_) {
+    for (size_t i = 0; i < input_names.size(); ++i) {
+      TfLiteCustomAllocation allocation{slot.inputs[i].data,
+                                        slot.inputs[i].bytes};
+      TF_LITE_ENSURE_STATUS(
+          runner_->SetCustomAllocationForInputTensor(input_names[i],
+                                                     allocation));
+    }
+  }
+  if (double_buffer_outputs_) {
+    for (size_t i = 0; i < output_names.size(); ++i) {
+      TfLiteCustomAllocation allocation{slot.outputs[i].data,
+                                        slot.outputs[i].bytes};
+      TF_LITE_ENSURE_STATUS(runner_->SetCustomAllocationForOutputTensor(
+          output_names[i], allocation));
+    }
+  }
+  TF_LITE_ENSURE_STATUS(runner_->AllocateTensors());
+  if (!double_buffer_inputs_) {
+    for (size_t i = 0; i < input_names.size(); ++i) {
+      TfLiteTensor* tensor = runner_->input_tensor(input_names[i]);
+      const size_t bytes = request_input_bytes_[i];
+      for (int j = 0; j < num_requests; ++j) {
+        std::memcpy(tensor->data.raw + j * bytes,
+                    requests[first + j].inputs[i], bytes);
+      }
+    }
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus PipelinedSignatureRunner::CollectOutputs(const Slot& slot,
+                                                      Batch* batch) {
+  const std::vector<const char*>& output_names = runner_->output_names();
+  for (size_t i = 0; i < output_names.size(); ++i) {
+    const TfLiteTensor* tensor = runner_->output_tensor(output_names[i]);
+    // The outputs must be batched along dimension 0 like the inputs.
+    if (tensor->bytes % batch->num_requests != 0 ||
+        (batch->num_requests > 1 &&
+         (tensor->dims->size == 0 ||
+          tensor->dims->data[0] % batch->num_requests != 0))) {
+      TFLITE_LOG(TFLITE_LOG_ERROR,
+                 "Output %s is not batched along dimension 0.",
+                 output_names[i]);
+      return kTfLiteError;
+    }
+    batch->output_bytes.push_back(tensor->bytes / batch->num_requests);
+    batch->outputs.push_back(double_buffer_outputs_ ? slot.outputs[i].data
+                                                    : tensor->data.raw);
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus PipelinedSignatureRunner::CompleteRequests(
+    const std::vector<PipelinedRequest>& requests, const Batch& batch) {
+  if (batch.status == kTfLiteOk) {
+    for (size_t i = 0; i < batch.outputs.size(); ++i) {
+      const size_t bytes = batch.output_bytes[i];
+      for (int j = 0; j < batch.num_requests; ++j) {
+        std::memcpy(requests[batch.first + j].outputs[i],
+                    batch.outputs[i] + j * bytes, bytes);
+      }
+    }
+  }
+  for (int j = 0; j < batch.num_requests; ++j) {
+    const PipelinedRequest& request = requests[batch.first + j];
+    if (request.done) {
+      request.done(batch.status);
+    }
+  }
+  return batch.status;
+}
+
+void PipelinedSignatureRunner::StartInvocation() {
+  ++num_invocations_;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    invocation_requested_ = true;
+    invocation_done_ = false;
+  }
+  cond_var_.notify_all();
+}
+
+TfLiteStatus PipelinedSignatureRunner::WaitForInvocation() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_var_.wait(lock, [this] { return invocation_done_; });
+  return invocation_status_;
+}
+
+void PipelinedSignatureRunner::WorkerLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cond_var_.wait(lock,
+                   [this] { return invocation_requested_ || shutdown_; });
+    if (shutdown_) {
+      return;
+    }
+    invocation_requested_ = false;
+    lock.unlock();
+    const TfLiteStatus status = runner_->Invoke();
+    lock.lock();
+    invocation_status_ = status;
+    invocation_done_ = true;
+    cond_var_.notify_all();
+  }
+}
+
+}  // namespace tflite
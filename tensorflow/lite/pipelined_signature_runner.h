@@ -0,0 +1,193 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#ifndef TENSORFLOW_LITE_PIPELINED_SIGNATURE_RUNNER_H_
+#define TENSORFLOW_LITE_PIPELINED_SIGNATURE_RUNNER_H_
+
+#include <condition_variable>  // NOLINT
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/signature_runner.h"
+
+namespace tflite {
+
+/// A request processed by `PipelinedSignatureRunner`.
+/// WARNING: This is an experimental API and subject to change.
+struct PipelinedRequest {
+  /// The data of each signature input, in the order of
+  /// `SignatureRunner::input_names()`. Each buffer holds the contents of the
+  /// input tensor for a single request.
+  std::vector<const void*> inputs;
+
+  /// The buffers receiving each signature output, in the order of
+  /// `SignatureRunner::output_names()`. Each buffer must be large enough for
+  /// the output tensor of a single request.
+  std::vector<void*> outputs;
+
+  /// Called once the outputs have been written or the request has failed.
+  /// May be empty.
+  std::function<void(TfLiteStatus)> done;
+};
+
+/// Runs a stream of requests through a `SignatureRunner`, overlapping the
+/// copies of the inputs of the next request and of the outputs of the previous
+/// one with the invocation of the current one.
+///
+/// The signature inputs and outputs are double-buffered: they alternate
+/// between two sets of buffers owned by this class, which are bound to the
+/// tensors as custom allocations. While the signature runner is invoked on a
+/// worker thread with one set, the calling thread fills the other set with the
+/// inputs of the next request and copies out the outputs of the previous one.
+/// Tensors that can not use a custom allocation, e.g. dynamic tensors, are
+/// copied before or after the invocation instead.
+///
+/// Optionally, consecutive requests are batched along dimension 0 of the
+/// inputs and outputs, which requires that dimension 0 of every input is
+/// dynamic, i.e. -1 in `dims_signature`.
+///
+/// Usage:
+///
+/// <pre><code>
+/// runner->AllocateTensors();  // With the input shapes of a single request.
+/// PipelinedSignatureRunner::Options options;
+/// options.max_batch_size = 8;
+/// auto pipelined_runner = PipelinedSignatureRunner::Create(runner, options);
+/// std::vector<PipelinedRequest> requests = ...;
+/// pipelined_runner->Run(requests);
+/// </code></pre>
+///
+/// The input and output tensors of the signature runner keep pointing to
+/// buffers owned by this class, so the signature runner must not be used after
+/// this class is destroyed. This class is not thread-safe.
+/// WARNING: This is an experimental API and subject to change.
+class PipelinedSignatureRunner {
+ public:
+  struct Options {
+    /// The maximum number of requests batched into one invocation. Batching is
+    /// disabled if the inputs of the signature can not be resized along
+    /// dimension 0.
+    int max_batch_size = 1;
+  };
+
+  /// Creates a runner for `runner`, whose current input shapes are those of a
+  /// single request. `runner` must have allocated its tensors, and must
+  /// outlive the returned object. Returns nullptr on failure.
+  static std::unique_ptr<PipelinedSignatureRunner> Create(
+      SignatureRunner* runner, const Options& options);
+
+  ~PipelinedSignatureRunner();
+
+  PipelinedSignatureRunner(const PipelinedSignatureRunner&) = delete;
+  PipelinedSignatureRunner& operator=(const PipelinedSignatureRunner&) =
+      delete;
+
+  /// Runs `requests` in order and calls their `done` callbacks. Returns an
+  /// error if any request failed.
+  TfLiteStatus Run(const std::vector<PipelinedRequest>& requests);
+
+  /// Returns the effective maximum batch size.
+  int max_batch_size() const { return max_batch_size_; }
+
+  /// Returns the number of invocations of the signature runner so far.
+  int64_t num_invocations() const { return num_invocations_; }
+
+ private:
+  // A buffer aligned to `kDefaultTensorAlignment`.
+  struct AlignedBuffer {
+    std::unique_ptr<char[]> allocation;
+    char* data = nullptr;
+    size_t bytes = 0;
+  };
+
+  // The buffers of the inputs and outputs of one invocation.
+  struct Slot {
+    std::vector<AlignedBuffer> inputs;
+    std::vector<AlignedBuffer> outputs;
+  };
+
+  // The requests of one invocation.
+  struct Batch {
+    size_t first = 0;
+    int num_requests = 0;
+    TfLiteStatus status = kTfLiteOk;
+    // The data and per-request size of each output once invoked.
+    std::vector<const char*> outputs;
+    std::vector<size_t> output_bytes;
+  };
+
+  PipelinedSignatureRunner(SignatureRunner* runner, int max_batch_size);
+
+  // Copies the inputs of `num_requests` requests starting at `first` into
+  // `slot`.
+  void StageInputs(const std::vector<PipelinedRequest>& requests, size_t first,
+                   int num_requests, const Slot& slot);
+
+  // Resizes the inputs for a batch of `num_requests` requests and binds the
+  // buffers of `slot` to the inputs and outputs. Inputs that are not
+  // double-buffered are copied into their tensors.
+  TfLiteStatus PrepareInvocation(const std::vector<PipelinedRequest>& requests,
+                                 size_t first, int num_requests,
+                                 const Slot& slot);
+
+  // Records where the outputs of the invoked `batch` are. Must be called
+  // before the next invocation starts.
+  TfLiteStatus CollectOutputs(const Slot& slot, Batch* batch);
+
+  // Copies the outputs of `batch` to its requests and calls their `done`
+  // callbacks. Returns the status of the batch.
+  TfLiteStatus CompleteRequests(const std::vector<PipelinedRequest>& requests,
+                                const Batch& batch);
+
+  // Starts invoking the signature runner on the worker thread.
+  void StartInvocation();
+
+  // Waits for the invocation started by `StartInvocation()` to finish and
+  // returns its status.
+  TfLiteStatus WaitForInvocation();
+
+  void WorkerLoop();
+
+  SignatureRunner* const runner_;
+  const int max_batch_size_;
+  // The shape and size of each input and output of a single request.
+  std::vector<std::vector<int>> request_input_dims_;
+  std::vector<size_t> request_input_bytes_;
+  std::vector<size_t> request_output_bytes_;
+  // Whether the inputs and outputs are bound to the buffers of the slots.
+  bool double_buffer_inputs_ = true;
+  bool double_buffer_outputs_ = true;
+  Slot slots_[2];
+  // The batch size the inputs are currently resized for.
+  int current_batch_size_ = 1;
+  int64_t num_invocations_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable cond_var_;
+  bool invocation_requested_ = false;
+  bool invocation_done_ = false;
+  bool shutdown_ = false;
+  TfLiteStatus invocation_status_ = kTfLiteOk;
+  std::thread worker_;
+};
+
+}  // namespace tflite
+
+#endif  // TENSORFLOW_LITE_PIPELINED_SIGNATURE_RUNNER_H_
@@ -0,0 +1,123 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/lite/pipelined_signature_runner.h"
+
+#include <memory>
+#include <vector>
+
+#include <gtest/gtest.h>
+#include "tensorflow/lite/core/c/common.h"
+#include "tensorflow/lite/core/kernels/register.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/interpreter_builder.h"
+#include "tensorflow/lite/model_builder.h"
+#include "tensorflow/lite/testing/util.h"
+
+namespace tflite {
+namespace {
+
+class PipelinedSignatureRunnerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    model_ = FlatBufferModel::BuildFromFile(
+        "tensorflow/lite/testdata/multi_signatures.bin", &reporter_);
+    ASSERT_TRUE(model_);
+    ops::builtin::BuiltinOpResolver resolver;
+    ASSERT_EQ(InterpreterBuilder(*model_, resolver)(&interpreter_), kTfLiteOk);
+    // The "add" signature adds 2 to its input "x" of shape [-1].
+    runner_ = interpreter_->GetSignatureRunner("add");
+    ASSERT_NE(runner_, nullptr);
+    ASSERT_EQ(runner_->ResizeInputTensor("x", {2}), kTfLiteOk);
+    ASSERT_EQ(runner_->AllocateTensors(), kTfLiteOk);
+  }
+
+  // Runs `num_requests` requests of 2 floats through a pipelined runner with
+  // the given `max_batch_size` and checks their outputs.
+  void RunRequests(int max_batch_size, int num_requests) {
+    PipelinedSignatureRunner::Options options;
+    options.max_batch_size = max_batch_size;
+    auto pipelined_runner = PipelinedSignatureRunner::Create(runner_, options);
+    ASSERT_NE(pipelined_runner, nullptr);
+    EXPECT_EQ(pipelined_runner->max_batch_size(), max_batch_size);
+
+    std::vector<std::vector<float>> inputs(num_requests);
+    std::vector<std::vector<float>> outputs(num_requests,
+                                            std::vector<float>(2));
+    std::vector<TfLiteStatus> statuses(num_requests, kTfLiteError);
+    std::vector<PipelinedRequest> requests(num_requests);
+    for (int i = 0; i < num_requests; ++i) {
+      inputs[i] = {1.0f * i, -1.0f * i};
+      requests[i].inputs = {inputs[i].data()};
+      requests[i].outputs = {outputs[i].data()};
+      requests[i].done = [&statuses, i](TfLiteStatus status) {
+        statuses[i] = status;
+      };
+    }
+    ASSERT_EQ(pipelined_runner->Run(requests), kTfLiteOk);
+    for (int i = 0; i < num_requests; ++i) {
+      EXPECT_EQ(statuses[i], kTfLiteOk);
+      EXPECT_EQ(outputs[i][0], i + 2.0f);
+      EXPECT_EQ(outputs[i][1], -i + 2.0f);
+    }
+    EXPECT_EQ(pipelined_runner->num_invocations(),
+              (num_requests + max_batch_size - 1) / max_batch_size);
+  }
+
+  TestErrorReporter reporter_;
+  std::unique_ptr<FlatBufferModel> model_;
+  std::unique_ptr<Interpreter> interpreter_;
+  SignatureRunner* runner_ = nullptr;
+};
+
+TEST_F(PipelinedSignatureRunnerTest, Unbatched) { RunRequests(1, 5); }
+
+TEST_F(PipelinedSignatureRunnerTest, Batched) {
+  // The last batch only holds one request.
+  RunRequests(4, 9);
+}
+
+TEST_F(PipelinedSignatureRunnerTest, RunsRepeatedly) {
+  PipelinedSignatureRunner::Options options;
+  auto pipelined_runner = PipelinedSignatureRunner::Create(runner_, options);
+  ASSERT_NE(pipelined_runner, nullptr);
+  for (int i = 0; i < 3; ++i) {
+    const float input[2] = {1.0f * i, 2.0f * i};
+    float output[2] = {0.0f, 0.0f};
+    PipelinedRequest request;
+    request.inputs = {input};
+    request.outputs = {output};
+    ASSERT_EQ(pipelined_runner->Run({request}), kTfLiteOk);
+    EXPECT_EQ(output[0], i + 2.0f);
+    EXPECT_EQ(output[1], 2.0f * i + 2.0f);
+  }
+  EXPECT_EQ(pipelined_runner->Run({}), kTfLiteOk);
+  EXPECT_EQ(pipelined_runner->num_invocations(), 3);
+}
+
+TEST_F(PipelinedSignatureRunnerTest, InvalidRequests) {
+  PipelinedSignatureRunner::Options options;
+  options.max_batch_size = 0;
+  EXPECT_EQ(PipelinedSignatureRunner::Create(runner_, options), nullptr);
+  EXPECT_EQ(PipelinedSignatureRunner::Create(nullptr, {}), nullptr);
+
+  auto pipelined_runner = PipelinedSignatureRunner::Create(runner_, {});
+  ASSERT_NE(pipelined_runner, nullptr);
+  PipelinedRequest request;
+  EXPECT_EQ(pipelined_runner->Run({request}), kTfLiteError);
+  EXPECT_EQ(pipelined_runner->num_invocations(), 0);
+}
+
+}  // namespace
+}  // namespace tflite
@@ -44,6 +44,40 @@ T AlignTo(size_t alignment, T offset) {
 
 namespace tflite {
 
+size_t ArenaBufferPool::GetAllocatedBytes() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return allocated_bytes_;
+}
+
+size_t ArenaBufferPool::GetNumBuffers() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return buffers_.size();
+}
+
+ArenaBufferPool::Buffer* ArenaBufferPool::Acquire() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (free_buffers_.empty()) {
+    buffers_.push_back(std::make_unique<Buffer>());
+    return buffers_.back().get();
+  }
+  // The most recently returned buffer is the most likely to be in the cache.
+  Buffer* buffer = free_buffers_.back();
+  free_buffers_.pop_back();
+  return buffer;
+}
+
+void ArenaBufferPool::Reset(Buffer* buffer, char* data, size_t size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  allocated_bytes_ = allocated_bytes_ - buffer->size + size;
+  buffer->data.reset(data);
+  buffer->size = size;
+}
+
+void ArenaBufferPool::Release(Buffer* buffer) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_buffers_.push_back(buffer);
+}
+
 void SimpleMemoryArena::PurgeAfter(int32_t node) {
   for (int i = 0; i < active_allocs_.size(); ++i) {
     if (active_allocs_[i].first_node > node) {
@@ -143,6 +177,9 @@ TfLiteStatus SimpleMemoryArena::Allocate(
 
 TfLiteStatus SimpleMemoryArena::Commit(TfLiteContext* context,
                                        bool* arena_reallocated) {
+  if (buffer_pool_ != nullptr) {
+    return CommitLeasedBuffer(arena_reallocated);
+  }
   size_t required_size = RequiredBufferSize();
   if (required_size > underlying_buffer_size_) {
     *arena_reallocated = true;
@@ -187,6 +224,39 @@ TfLiteStatus SimpleMemoryArena::Commit(TfLiteContext* context,
   return underlying_buffer_ != nullptr ? kTfLiteOk : kTfLiteError;
 }
 
+TfLiteStatus SimpleMemoryArena::CommitLeasedBuffer(bool* arena_reallocated) {
+  *arena_reallocated = false;
+  if (leased_buffer_ == nullptr) {
+    leased_buffer_ = buffer_pool_->Acquire();
+    *arena_reallocated = true;
+  }
+  size_t required_size = RequiredBufferSize();
+  if (required_size > leased_buffer_->size) {
+    char* new_alloc = new char[required_size];
+    char* new_underlying_buffer_aligned_ptr = reinterpret_cast<char*>(
+        AlignTo(arena_alignment_, reinterpret_cast<intptr_t>(new_alloc)));
+    // Only the contents of a buffer that was already leased by this arena are
+    // meaningful. A newly leased buffer holds data of another arena.
+    if (!*arena_reallocated && high_water_mark_ > 0 &&
+        underlying_buffer_size_ > 0) {
+      size_t copy_amount = std::min(
+          leased_buffer_->data.get() + leased_buffer_->size -
+              underlying_buffer_aligned_ptr_,
+          new_alloc + required_size - new_underlying_buffer_aligned_ptr);
+      memcpy(new_underlying_buffer_aligned_ptr, underlying_buffer_aligned_ptr_,
+             copy_amount);
+    }
+    buffer_pool_->Reset(leased_buffer_, new_alloc, required_size);
+    *arena_reallocated = true;
+  }
+  underlying_buffer_size_ = leased_buffer_->size;
+  underlying_buffer_aligned_ptr_ = reinterpret_cast<char*>(
+      AlignTo(arena_alignment_,
+              reinterpret_cast<intptr_t>(leased_buffer_->data.get())));
+  committed_ = true;
+  return kTfLiteOk;
+}
+
 TfLiteStatus SimpleMemoryArena::ResolveAlloc(
     TfLiteContext* context, const ArenaAllocWithUsageInterval& alloc,
     char** output_ptr) {
@@ -211,13 +281,19 @@ TfLiteStatus SimpleMemoryArena::ClearPlan() {
 
 TfLiteStatus SimpleMemoryArena::ReleaseBuffer() {
   committed_ = false;
+  if (leased_buffer_ != nullptr) {
+    buffer_pool_->Release(leased_buffer_);
+    leased_buffer_ = nullptr;
+  } else {
 #ifdef TF_LITE_TENSORFLOW_PROFILER
-  OnTfLiteArenaDealloc(subgraph_index_, reinterpret_cast<std::uintptr_t>(this),
-                       underlying_buffer_size_);
+    OnTfLiteArenaDealloc(subgraph_index_,
+                         reinterpret_cast<std::uintptr_t>(this),
+                         underlying_buffer_size_);
 #endif
+    underlying_buffer_.reset();
+  }
   underlying_buffer_size_ = 0;
   underlying_buffer_aligned_ptr_ = nullptr;
-  underlying_buffer_.reset();
   return kTfLiteOk;
 }
 
@@ -19,6 +19,7 @@ limitations under the License.
 
 #include <cstdint>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <vector>
 
@@ -55,6 +56,51 @@ struct ArenaAllocWithUsageInterval {
   }
 };
 
+// A pool of arena buffers shared by the non-persistent arenas of several
+// interpreters, e.g. many models served by one process. An arena that uses the
+// pool leases a buffer when it is committed and returns it when its buffer is
+// released, so the pool only holds as many buffers as there are arenas
+// committed at the same time. Each buffer grows to the largest size required
+// by the arenas that leased it.
+//
+// This class is thread-safe.
+// WARNING: This is an experimental API and subject to change.
+class ArenaBufferPool {
+ public:
+  ArenaBufferPool() = default;
+  ArenaBufferPool(const ArenaBufferPool&) = delete;
+  ArenaBufferPool& operator=(const ArenaBufferPool&) = delete;
+
+  // Returns the total size of the buffers allocated by the pool.
+  size_t GetAllocatedBytes() const;
+
+  // Returns the number of buffers allocated by the pool.
+  size_t GetNumBuffers() const;
+
+ private:
+  friend class SimpleMemoryArena;
+
+  struct Buffer {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+  };
+
+  // Leases the most recently returned buffer, or a new empty one if all
+  // buffers are leased.
+  Buffer* Acquire();
+
+  // Replaces the contents of the leased `buffer` with `data` of `size` bytes.
+  void Reset(Buffer* buffer, char* data, size_t size);
+
+  // Returns a buffer leased by `Acquire()` to the pool.
+  void Release(Buffer* buffer);
+
+  mutable std::mutex mutex_;
+  std::vector<std::unique_ptr<Buffer>> buffers_;
+  std::vector<Buffer*> free_buffers_;
+  size_t allocated_bytes_ = 0;
+};
+
 // This small class is responsible for allocating, deallocating and reusing
 // dynamic memory from a common underlying buffer. The arena can be used in
 // scenarios when the pattern of memory allocations and deallocations is
@@ -70,6 +116,16 @@ class SimpleMemoryArena {
         underlying_buffer_size_(0),
         active_allocs_() {}
 
+  // Makes the arena lease its buffer from `buffer_pool` when committed instead
+  // of owning it. The buffer is returned to the pool by `ReleaseBuffer()`, and
+  // its contents are not preserved between leases. `buffer_pool` must outlive
+  // the arena.
+  // REQUIRES: The arena has no buffer.
+  // WARNING: This is an experimental API and subject to change.
+  void SetBufferPool(ArenaBufferPool* buffer_pool) {
+    buffer_pool_ = buffer_pool;
+  }
+
   // Delete all allocs. This should be called when allocating the first node of
   // a subgraph.
   void ResetAllocs();
@@ -149,6 +205,10 @@ class SimpleMemoryArena {
   int subgraph_index_;
 
  private:
+  // Implements `Commit()` for an arena that leases its buffer from
+  // `buffer_pool_`.
+  TfLiteStatus CommitLeasedBuffer(bool* arena_reallocated);
+
   bool committed_;
   size_t arena_alignment_;
   size_t high_water_mark_;
@@ -156,6 +216,9 @@ class SimpleMemoryArena {
   size_t underlying_buffer_size_;
   char* underlying_buffer_aligned_ptr_;
   std::vector<ArenaAllocWithUsageInterval> active_allocs_;
+  ArenaBufferPool* buffer_pool_ = nullptr;
+  // The buffer leased from `buffer_pool_`, if any.
+  ArenaBufferPool::Buffer* leased_buffer_ = nullptr;
 };
 
 }  // namespace tflite
@@ -14,6 +14,9 @@ limitations under the License.
 ==============================================================================*/
 #include "tensorflow/lite/simple_memory_arena.h"
 
+#include <cstdint>
+#include <cstring>
+
 #include <gtest/gtest.h>
 #include "tensorflow/lite/core/c/common.h"
 #include "tensorflow/lite/testing/util.h"
@@ -369,5 +372,74 @@ TEST_P(BufferAndPlanClearingTest, TestClearBufferAndClearPlan) {
 INSTANTIATE_TEST_SUITE_P(BufferAndPlanClearingTest, BufferAndPlanClearingTest,
                          ::testing::Values(true, false));
 
+TEST(SimpleMemoryArenaTest, TestSharedBufferPool) {
+  TfLiteContext context;
+  ArenaBufferPool pool;
+  SimpleMemoryArena arena1(64);
+  SimpleMemoryArena arena2(64);
+  arena1.SetBufferPool(&pool);
+  arena2.SetBufferPool(&pool);
+  ArenaAllocWithUsageInterval alloc1;
+  ArenaAllocWithUsageInterval alloc2;
+  arena1.Allocate(&context, 32, 2047, 0, 0, 2, &alloc1);
+  arena2.Allocate(&context, 32, 4095, 0, 0, 2, &alloc2);
+
+  bool reallocated = false;
+  ASSERT_EQ(arena1.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_TRUE(reallocated);
+  EXPECT_EQ(pool.GetNumBuffers(), 1);
+  EXPECT_EQ(pool.GetAllocatedBytes(), arena1.RequiredBufferSize());
+  ASSERT_EQ(arena1.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_FALSE(reallocated);
+  ASSERT_EQ(arena1.ReleaseBuffer(), kTfLiteOk);
+  EXPECT_EQ(arena1.GetBufferSize(), 0);
+
+  // The second arena leases the same buffer and grows it.
+  ASSERT_EQ(arena2.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_TRUE(reallocated);
+  EXPECT_EQ(pool.GetNumBuffers(), 1);
+  EXPECT_EQ(pool.GetAllocatedBytes(), arena2.RequiredBufferSize());
+  char* resolved_ptr = nullptr;
+  ASSERT_EQ(arena2.ResolveAlloc(&context, alloc2, &resolved_ptr), kTfLiteOk);
+  EXPECT_NE(resolved_ptr, nullptr);
+  EXPECT_EQ(reinterpret_cast<std::intptr_t>(resolved_ptr) % 64, 0);
+
+  // Arenas committed at the same time need separate buffers.
+  ASSERT_EQ(arena1.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_TRUE(reallocated);
+  EXPECT_EQ(pool.GetNumBuffers(), 2);
+  EXPECT_EQ(pool.GetAllocatedBytes(),
+            arena1.RequiredBufferSize() + arena2.RequiredBufferSize());
+  ASSERT_EQ(arena1.ResolveAlloc(&context, alloc1, &resolved_ptr), kTfLiteOk);
+  EXPECT_NE(resolved_ptr, nullptr);
+
+  ASSERT_EQ(arena1.ReleaseBuffer(), kTfLiteOk);
+  ASSERT_EQ(arena2.ReleaseBuffer(), kTfLiteOk);
+  EXPECT_EQ(pool.GetNumBuffers(), 2);
+}
+
+TEST(SimpleMemoryArenaTest, TestLeasedBufferGrowthPreservesContents) {
+  TfLiteContext context;
+  ArenaBufferPool pool;
+  SimpleMemoryArena arena(64);
+  arena.SetBufferPool(&pool);
+  ArenaAllocWithUsageInterval allocs[2];
+  arena.Allocate(&context, 32, 2047, 0, 0, 2, &allocs[0]);
+  bool reallocated = false;
+  ASSERT_EQ(arena.Commit(&context, &reallocated), kTfLiteOk);
+  char* resolved_ptr = nullptr;
+  ASSERT_EQ(arena.ResolveAlloc(&context, allocs[0], &resolved_ptr), kTfLiteOk);
+  std::memset(resolved_ptr, 42, 2047);
+
+  arena.Allocate(&context, 32, 2047, 1, 1, 2, &allocs[1]);
+  ASSERT_EQ(arena.Commit(&context, &reallocated), kTfLiteOk);
+  EXPECT_TRUE(reallocated);
+  EXPECT_EQ(pool.GetNumBuffers(), 1);
+  ASSERT_EQ(arena.ResolveAlloc(&context, allocs[0], &resolved_ptr), kTfLiteOk);
+  for (int i = 0; i < 2047; ++i) {
+    ASSERT_EQ(resolved_ptr[i], 42);
+  }
+}
+
 }  // namespace
 }  // namespace tflite
@@ -46,6 +46,7 @@ limitations under the License.
 #include "tensorflow/lite/op_resolver.h"
 #include "tensorflow/lite/optional_debug_tools.h"
 #include "tensorflow/lite/profiling/profile_summary_formatter.h"
+#include "tensorflow/lite/simple_memory_arena.h"
 #include "tensorflow/lite/string_util.h"
 #include "tensorflow/lite/tools/benchmark/benchmark_utils.h"
 #include "tensorflow/lite/tools/benchmark/profiling_listener.h"
@@ -312,6 +313,17 @@ CreateProfileSummaryFormatter(bool format_as_csv) {
              : std::make_shared<profiling::ProfileSummaryDefaultFormatter>();
 }
 
+// Returns the size of the arenas held by all subgraphs of `interpreter`.
+size_t GetArenaBytes(Interpreter* interpreter) {
+  size_t bytes = 0;
+  for (int i = 0; i < interpreter->subgraphs_size(); ++i) {
+    Subgraph::SubgraphAllocInfo alloc_info;
+    interpreter->subgraph(i)->GetMemoryAllocInfo(&alloc_info);
+    bytes += alloc_info.arena_size + alloc_info.arena_persist_size;
+  }
+  return bytes;
+}
+
 }  // namespace
 
 TfLiteStatus SplitInputLayerNameAndValueFile(
@@ -381,6 +393,14 @@ BenchmarkParams BenchmarkTfLiteModel::DefaultParams() {
                           BenchmarkParam::Create<int32_t>(0));
   default_params.AddParam("disable_delegate_clustering",
                           BenchmarkParam::Create<bool>(false));
+  default_params.AddParam("share_arena_buffers",
+                          BenchmarkParam::Create<bool>(false));
+  default_params.AddParam("num_interpreters",
+                          BenchmarkParam::Create<int32_t>(1));
+  default_params.AddParam("pipelined_requests",
+                          BenchmarkParam::Create<int32_t>(0));
+  default_params.AddParam("pipelined_max_batch_size",
+                          BenchmarkParam::Create<int32_t>(1));
   default_params.AddParam("output_filepath",
                           BenchmarkParam::Create<std::string>(""));
 
@@ -413,6 +433,8 @@ BenchmarkTfLiteModel::~BenchmarkTfLiteModel() {
 
   // Destory the owned interpreter earlier than other objects (specially
   // 'owned_delegates_').
+  pipelined_runner_.reset();
+  extra_interpreters_.clear();
   interpreter_.reset();
 }
 
@@ -469,6 +491,22 @@ std::vector<Flag> BenchmarkTfLiteModel::GetFlags() {
           "Optimize memory usage for large tensors with sacrificing latency."),
       CreateFlag<bool>("disable_delegate_clustering", &params_,
                        "Disable delegate clustering."),
+      CreateFlag<bool>("share_arena_buffers", &params_,
+                       "Share the arena buffer of intermediate tensors among "
+                       "all interpreters, holding it only during Invoke()."),
+      CreateFlag<int32_t>(
+          "num_interpreters", &params_,
+          "Number of interpreters created from the model. Each run invokes "
+          "all of them in turn. Only the first one uses delegates."),
+      CreateFlag<int32_t>(
+          "pipelined_requests", &params_,
+          "If positive, each run streams this many requests through the first "
+          "signature of the model, overlapping the copies of their inputs "
+          "and outputs with the invocations."),
+      CreateFlag<int32_t>(
+          "pipelined_max_batch_size", &params_,
+          "Maximum number of pipelined requests batched into one invocation. "
+          "Requires inputs whose first dimension can be resized."),
       CreateFlag<std::string>(
           "output_filepath", &params_,
           "File path to export outputs layer as binary data."),
@@ -528,6 +566,14 @@ void BenchmarkTfLiteModel::LogParams() {
                       "Optimize memory usage for large tensors", verbose);
   LOG_BENCHMARK_PARAM(bool, "disable_delegate_clustering",
                       "Disable delegate clustering", verbose);
+  LOG_BENCHMARK_PARAM(bool, "share_arena_buffers",
+                      "Share arena buffers among interpreters", verbose);
+  LOG_BENCHMARK_PARAM(int32_t, "num_interpreters", "Number of interpreters",
+                      verbose);
+  LOG_BENCHMARK_PARAM(int32_t, "pipelined_requests",
+                      "Number of pipelined requests per run", verbose);
+  LOG_BENCHMARK_PARAM(int32_t, "pipelined_max_batch_size",
+                      "Max batch size of pipelined requests", verbose);
   LOG_BENCHMARK_PARAM(std::string, "output_filepath",
                       "File path to export outputs layer to", verbose);
   LOG_BENCHMARK_PARAM(int32_t, "tensor_name_display_length",
@@ -552,6 +598,18 @@ TfLiteStatus BenchmarkTfLiteModel::ValidateParams() {
     return kTfLiteError;
   }
 
+  if (params_.Get<int32_t>("num_interpreters") < 1) {
+    TFLITE_LOG(ERROR) << "--num_interpreters must be at least 1";
+    return kTfLiteError;
+  }
+
+  if (params_.Get<int32_t>("pipelined_requests") < 0 ||
+      params_.Get<int32_t>("pipelined_max_batch_size") < 1) {
+    TFLITE_LOG(ERROR) << "--pipelined_requests must not be negative and "
+                         "--pipelined_max_batch_size must be at least 1";
+    return kTfLiteError;
+  }
+
   return PopulateInputLayerInfo(
       params_.Get<std::string>("input_layer"),
       params_.Get<std::string>("input_layer_shape"),
@@ -688,11 +746,39 @@ TfLiteStatus BenchmarkTfLiteModel::PrepareInputData() {
 }
 
 TfLiteStatus BenchmarkTfLiteModel::ResetInputsAndOutputs() {
-  auto interpreter_inputs = interpreter_->inputs();
+  TF_LITE_ENSURE_STATUS(ResetInputs(interpreter_.get()));
+  for (auto& interpreter : extra_interpreters_) {
+    TF_LITE_ENSURE_STATUS(ResetInputs(interpreter.get()));
+  }
+  if (pipelined_runner_ && pipelined_requests_.empty()) {
+    // All pipelined requests use the inputs of the first run.
+    const std::vector<const char*>& input_names =
+        pipelined_signature_runner_->input_names();
+    for (size_t i = 0; i < input_names.size(); ++i) {
+      const TfLiteTensor* t =
+          pipelined_signature_runner_->input_tensor(input_names[i]);
+      std::memcpy(pipelined_input_data_[i].data(), t->data.raw,
+                  pipelined_input_data_[i].size());
+    }
+    PipelinedRequest request;
+    for (const auto& data : pipelined_input_data_) {
+      request.inputs.push_back(data.data());
+    }
+    for (auto& data : pipelined_output_data_) {
+      request.outputs.push_back(data.data());
+    }
+    pipelined_requests_.assign(params_.Get<int32_t>("pipelined_requests"),
+                               request);
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus BenchmarkTfLiteModel::ResetInputs(Interpreter* interpreter) {
+  auto interpreter_inputs = interpreter->inputs();
   // Set the values of the input tensors from inputs_data_.
   for (int j = 0; j < interpreter_inputs.size(); ++j) {
     int i = interpreter_inputs[j];
-    TfLiteTensor* t = interpreter_->tensor(i);
+    TfLiteTensor* t = interpreter->tensor(i);
     if (t->type == kTfLiteString) {
       if (inputs_data_[j].data) {
         static_cast<DynamicBuffer*>(inputs_data_[j].data.get())
@@ -726,6 +812,10 @@ TfLiteStatus BenchmarkTfLiteModel::InitInterpreter() {
       params_.Get<int32_t>("optimize_memory_for_large_tensors"));
   options.SetDisableDelegateClustering(
       params_.Get<bool>("disable_delegate_clustering"));
+  if (params_.Get<bool>("share_arena_buffers")) {
+    arena_buffer_pool_ = std::make_shared<ArenaBufferPool>();
+    options.SetArenaBufferPool(arena_buffer_pool_);
+  }
 
   tflite::InterpreterBuilder builder(*model_, *resolver, &options);
   if (builder.SetNumThreads(num_threads) != kTfLiteOk) {
@@ -738,6 +828,17 @@ TfLiteStatus BenchmarkTfLiteModel::InitInterpreter() {
     TFLITE_LOG(ERROR) << "Failed to initialize the interpreter";
     return kTfLiteError;
   }
+  extra_interpreters_.clear();
+  for (int i = 1; i < params_.Get<int32_t>("num_interpreters"); ++i) {
+    tflite::InterpreterBuilder extra_builder(*model_, *resolver, &options);
+    extra_builder.SetNumThreads(num_threads);
+    extra_interpreters_.emplace_back();
+    extra_builder(&extra_interpreters_.back());
+    if (!extra_interpreters_.back()) {
+      TFLITE_LOG(ERROR) << "Failed to initialize interpreter #" << i;
+      return kTfLiteError;
+    }
+  }
   // Manually enable caching behavior in TF Lite interpreter.
   if (use_caching) {
     external_context_ = std::make_unique<tflite::ExternalCpuBackendContext>();
@@ -749,6 +850,10 @@ TfLiteStatus BenchmarkTfLiteModel::InitInterpreter() {
         std::move(cpu_backend_context));
     interpreter_->SetExternalContext(kTfLiteCpuBackendContext,
                                      external_context_.get());
+    for (auto& interpreter : extra_interpreters_) {
+      interpreter->SetExternalContext(kTfLiteCpuBackendContext,
+                                      external_context_.get());
+    }
   }
 
   return kTfLiteOk;
@@ -902,6 +1007,37 @@ TfLiteStatus BenchmarkTfLiteModel::Init() {
     return kTfLiteError;
   }
 
+  // The other interpreters use the input shapes of the first one.
+  for (auto& interpreter : extra_interpreters_) {
+    for (int i : interpreter->inputs()) {
+      const TfLiteTensor* t = interpreter_->tensor(i);
+      if (t->type != kTfLiteString) {
+        interpreter->ResizeInputTensor(
+            i, std::vector<int>(t->dims->data, t->dims->data + t->dims->size));
+      }
+    }
+    if (interpreter->AllocateTensors() != kTfLiteOk) {
+      TFLITE_LOG(ERROR) << "Failed to allocate tensors!";
+      return kTfLiteError;
+    }
+  }
+  if (!extra_interpreters_.empty() || arena_buffer_pool_) {
+    size_t arena_bytes = GetArenaBytes(interpreter_.get());
+    for (auto& interpreter : extra_interpreters_) {
+      arena_bytes += GetArenaBytes(interpreter.get());
+    }
+    if (arena_buffer_pool_) {
+      arena_bytes += arena_buffer_pool_->GetAllocatedBytes();
+    }
+    TFLITE_LOG(INFO) << "Arena memory of "
+                     << 1 + extra_interpreters_.size()
+                     << " interpreters: " << arena_bytes / 1024.0 << " KB";
+  }
+
+  if (params_.Get<int32_t>("pipelined_requests") > 0) {
+    TF_LITE_ENSURE_STATUS(InitPipelinedRunner());
+  }
+
   AddOwnedListener(
       std::unique_ptr<BenchmarkListener>(new RuyProfileListener()));
   AddOwnedListener(
@@ -910,6 +1046,45 @@ TfLiteStatus BenchmarkTfLiteModel::Init() {
   return kTfLiteOk;
 }
 
+TfLiteStatus BenchmarkTfLiteModel::InitPipelinedRunner() {
+  const std::vector<const std::string*> signature_keys =
+      interpreter_->signature_keys();
+  if (signature_keys.empty()) {
+    TFLITE_LOG(ERROR) << "--pipelined_requests requires a model with a "
+                         "signature";
+    return kTfLiteError;
+  }
+  pipelined_signature_runner_ =
+      interpreter_->GetSignatureRunner(signature_keys[0]->c_str());
+  if (pipelined_signature_runner_ == nullptr ||
+      pipelined_signature_runner_->AllocateTensors() != kTfLiteOk) {
+    TFLITE_LOG(ERROR) << "Failed to prepare signature " << *signature_keys[0];
+    return kTfLiteError;
+  }
+  PipelinedSignatureRunner::Options options;
+  options.max_batch_size = params_.Get<int32_t>("pipelined_max_batch_size");
+  pipelined_runner_ =
+      PipelinedSignatureRunner::Create(pipelined_signature_runner_, options);
+  if (!pipelined_runner_) {
+    TFLITE_LOG(ERROR) << "Failed to create the pipelined runner for signature "
+                      << *signature_keys[0];
+    return kTfLiteError;
+  }
+  TFLITE_LOG(INFO) << "Pipelining signature " << *signature_keys[0]
+                   << " with max batch size "
+                   << pipelined_runner_->max_batch_size();
+
+  for (const char* name : pipelined_signature_runner_->input_names()) {
+    pipelined_input_data_.emplace_back(
+        pipelined_signature_runner_->input_tensor(name)->bytes);
+  }
+  for (const char* name : pipelined_signature_runner_->output_names()) {
+    pipelined_output_data_.emplace_back(
+        pipelined_signature_runner_->output_tensor(name)->bytes);
+  }
+  return kTfLiteOk;
+}
+
 TfLiteStatus BenchmarkTfLiteModel::LoadModel() {
   std::string fd_or_graph_path = params_.Get<std::string>("graph");
   model_loader_ = tools::CreateModelLoaderFromPath(fd_or_graph_path);
@@ -960,7 +1135,16 @@ BenchmarkTfLiteModel::MayCreateProfilingListener() const {
           !params_.Get<std::string>("profiling_output_csv_file").empty())));
 }
 
-TfLiteStatus BenchmarkTfLiteModel::RunImpl() { return interpreter_->Invoke(); }
+TfLiteStatus BenchmarkTfLiteModel::RunImpl() {
+  if (pipelined_runner_) {
+    return pipelined_runner_->Run(pipelined_requests_);
+  }
+  TF_LITE_ENSURE_STATUS(interpreter_->Invoke());
+  for (auto& interpreter : extra_interpreters_) {
+    TF_LITE_ENSURE_STATUS(interpreter->Invoke());
+  }
+  return kTfLiteOk;
+}
 
 }  // namespace benchmark
 }  // namespace tflite
@@ -25,6 +25,7 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/lite/core/model.h"
+#include "tensorflow/lite/pipelined_signature_runner.h"
 #include "tensorflow/lite/profiling/profiler.h"
 #include "tensorflow/lite/tools/benchmark/benchmark_model.h"
 #include "tensorflow/lite/tools/model_loader.h"
@@ -112,12 +113,26 @@ class BenchmarkTfLiteModel : public BenchmarkModel {
   std::vector<utils::InputTensorData> inputs_data_;
   std::unique_ptr<tflite::FlatBufferModel> model_;
   std::unique_ptr<tflite::Interpreter> interpreter_;
+  // Interpreters created in addition to `interpreter_` for
+  // --num_interpreters. They run without delegates.
+  std::vector<std::unique_ptr<tflite::Interpreter>> extra_interpreters_;
+  std::shared_ptr<tflite::ArenaBufferPool> arena_buffer_pool_;
+  // Streams --pipelined_requests requests through the first signature of the
+  // model in each run, instead of invoking the interpreters.
+  tflite::SignatureRunner* pipelined_signature_runner_ = nullptr;
+  std::unique_ptr<tflite::PipelinedSignatureRunner> pipelined_runner_;
   std::unique_ptr<tflite::ExternalCpuBackendContext> external_context_;
 
  private:
   utils::InputTensorData CreateRandomTensorData(
       const TfLiteTensor& t, const InputLayerInfo* layer_info);
 
+  // Sets the input tensors of `interpreter` from `inputs_data_`.
+  TfLiteStatus ResetInputs(Interpreter* interpreter);
+
+  // Creates `pipelined_runner_` for the first signature of the model.
+  TfLiteStatus InitPipelinedRunner();
+
   void AddOwnedListener(std::unique_ptr<BenchmarkListener> listener) {
     if (listener == nullptr) return;
     owned_listeners_.emplace_back(std::move(listener));
@@ -130,6 +145,10 @@ class BenchmarkTfLiteModel : public BenchmarkModel {
   // Always TFLITE_LOG the benchmark result.
   BenchmarkLoggingListener log_output_;
   std::unique_ptr<tools::ModelLoader> model_loader_;
+  // The input and output buffers of the pipelined requests, which share them.
+  std::vector<std::vector<char>> pipelined_input_data_;
+  std::vector<std::vector<char>> pipelined_output_data_;
+  std::vector<PipelinedRequest> pipelined_requests_;
 };
 
 }  // namespace benchmark
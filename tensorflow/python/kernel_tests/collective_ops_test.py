@@ -615,6 +615,74 @@ class AllReduceWithSubdivisionsTest(test.TestCase, parameterized.TestCase):
       self.assertAllClose(result, [2.], rtol=1e-5, atol=1e-5)
 
 
+@combinations.generate(
+    combinations.combine(
+        mode='eager',
+        pipeline_piece_bytes=[0, 4, 64],
+        wire_data_type=['none', 'bfloat16']))
+class AllReducePipelinedTest(test.TestCase, parameterized.TestCase):
+
+  def setUp(self):
+    _setup_context()
+    super().setUp()
+
+  def testReduce(self, pipeline_piece_bytes, wire_data_type):
+    group_size = 3
+    group_key = 1
+    instance_key = 1
+    in_value = [float(i) for i in range(100)]
+
+    @def_function.function
+    def run_all_reduce():
+      collectives = []
+      for device_idx in range(group_size):
+        with ops.device('/device:CPU:%d' % device_idx):
+          collectives.append(
+              _collective_ops.all_reduce_v2(
+                  constant_op.constant(in_value),
+                  group_size,
+                  group_key,
+                  instance_key,
+                  communication_hint='ring',
+                  pipeline_piece_bytes=pipeline_piece_bytes,
+                  wire_data_type=wire_data_type))
+      return collectives
+
+    # The final values are rounded to bfloat16 when it is used on the wire,
+    # even though all devices are in the same task.
+    tolerance = 1e-2 if wire_data_type == 'bfloat16' else 1e-6
+    for result in run_all_reduce():
+      self.assertAllClose(
+          result, [group_size * v for v in in_value],
+          rtol=tolerance,
+          atol=tolerance)
+
+  def testWireDataTypeRequiresFloat(self, pipeline_piece_bytes,
+                                    wire_data_type):
+    if wire_data_type == 'none':
+      self.skipTest('Only bfloat16 on the wire restricts the input type')
+
+    @def_function.function
+    def run_all_reduce():
+      collectives = []
+      for device_idx in range(2):
+        with ops.device('/device:CPU:%d' % device_idx):
+          collectives.append(
+              _collective_ops.all_reduce_v2(
+                  constant_op.constant([1, 2]),
+                  group_size=2,
+                  group_key=2,
+                  instance_key=2,
+                  communication_hint='ring',
+                  pipeline_piece_bytes=pipeline_piece_bytes,
+                  wire_data_type=wire_data_type))
+      return collectives
+
+    with self.assertRaisesRegex(errors.UnimplementedError,
+                                'only DT_FLOAT as DT_BFLOAT16'):
+      run_all_reduce()
+
+
 @combinations.generate(
     combinations.combine(required_physical_gpus=2, mode='eager'))
 class XlaTest(test.TestCase, parameterized.TestCase):
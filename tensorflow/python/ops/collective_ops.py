@@ -102,6 +102,8 @@ def all_reduce_v2(t,
                   timeout=0,
                   ordering_token=None,
                   max_subdivs_per_device=-1,
+                  pipeline_piece_bytes=0,
+                  wire_data_type='none',
                   name=None):
   """Reduces tensors collectively, across devices.
 
@@ -132,6 +134,13 @@ def all_reduce_v2(t,
       parallelize processing of each per-device tensor. Setting to -1 disables
       subdivision and reverts to previous behavior of not sub-dividing tensor.
       Setting to 0 uses sytem defaults.
+    pipeline_piece_bytes: int. If positive, the ring implementation splits
+      each chunk into pieces of at most this many bytes that are received,
+      reduced and forwarded independently. This feature is experimental.
+    wire_data_type: `none` or `bfloat16`. With `bfloat16`, the ring
+      implementation sends float32 values between tasks as bfloat16, at the
+      cost of precision. Only float32 reductions on CPU are supported. This
+      feature is experimental.
     name: name of the Op.
 
   Returns:
@@ -154,6 +163,8 @@ def all_reduce_v2(t,
       is_stateless=False,
       ordering_token=ordering_token,
       max_subdivs_per_device=max_subdivs_per_device,
+      pipeline_piece_bytes=pipeline_piece_bytes,
+      wire_data_type=wire_data_type,
       name=name)
 
 
@@ -0,0 +1,411 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tsl/framework/thread_caching_cpu_allocator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "absl/numeric/bits.h"
+#include "absl/strings/match.h"
+#include "tsl/framework/allocator_registry.h"
+#include "tsl/platform/logging.h"
+#include "tsl/platform/mem.h"
+#include "tsl/profiler/lib/traceme.h"
+
+namespace tsl {
+namespace {
+
+// Size classes are the multiples of 64 bytes up to 1 KiB, followed by four
+// classes per doubling up to kMaxCachedBytes. All of them are multiples of
+// Allocator::kAllocatorAlignment, so every block in a slab is aligned.
+constexpr int kNumSmallClasses = 16;
+constexpr size_t kSmallClassBytes = 64;
+constexpr int kMinLargeLog2 = 10;
+constexpr int kMaxLog2 = 18;
+constexpr int kClassesPerDoubling = 4;
+constexpr int kNumSizeClasses =
+    kNumSmallClasses + (kMaxLog2 - kMinLargeLog2) * kClassesPerDoubling;
+static_assert(size_t{1} << kMaxLog2 ==
+                  ThreadCachingCPUAllocator::kMaxCachedBytes,
+              "kMaxLog2 does not match kMaxCachedBytes");
+static_assert(kSmallClassBytes % Allocator::kAllocatorAlignment == 0,
+              "Size classes must preserve alignment");
+
+// Thread caches move blocks to and from the pool in batches of about this many
+// bytes, and hold at most two batches per size class.
+constexpr size_t kBatchBytes = 32 << 10;
+constexpr int kMaxBatchBlocks = 32;
+
+int SizeClass(size_t num_bytes) {
+  if (num_bytes <= kNumSmallClasses * kSmallClassBytes) {
+    return num_bytes == 0 ? 0 : (num_bytes - 1) / kSmallClassBytes;
+  }
+  // 2^log2 < num_bytes <= 2^(log2 + 1).
+  const int log2 = absl::bit_width(num_bytes - 1) - 1;
+  const size_t step = (size_t{1} << log2) / kClassesPerDoubling;
+  return kNumSmallClasses + (log2 - kMinLargeLog2) * kClassesPerDoubling +
+         (num_bytes - (size_t{1} << log2) - 1) / step;
+}
+
+size_t ClassBytes(int size_class) {
+  if (size_class < kNumSmallClasses) {
+    return (size_class + 1) * kSmallClassBytes;
+  }
+  const int i = size_class - kNumSmallClasses;
+  const size_t base = size_t{1} << (kMinLargeLog2 + i / kClassesPerDoubling);
+  return base + (i % kClassesPerDoubling + 1) * (base / kClassesPerDoubling);
+}
+
+int BatchBlocks(int size_class) {
+  return std::clamp<int>(kBatchBytes / ClassBytes(size_class), 1,
+                         kMaxBatchBlocks);
+}
+
+// A free block, linked through its first bytes.
+struct FreeBlock {
+  FreeBlock* next;
+};
+
+struct FreeList {
+  FreeBlock* head = nullptr;
+  int count = 0;
+};
+
+// Maps each kSlabBytes-aligned region of the address space to the size class
+// of the slab occupying it, if any. Lookups are lock-free.
+class SlabMap {
+ public:
+  // Returns the size class of the slab containing `ptr`, or -1 if `ptr` is
+  // not in a slab.
+  int Get(const void* ptr) const {
+    const uintptr_t slab = SlabIndex(ptr);
+    if (slab >= kNumSlabs) return -1;
+    const uint8_t* leaf =
+        root_[slab / kLeafSize].load(std::memory_order_acquire);
+    return leaf == nullptr ? -1 : static_cast<int>(leaf[slab % kLeafSize]) - 1;
+  }
+
+  // Records that the slab at `ptr` holds blocks of `size_class`. Returns false
+  // if `ptr` is outside of the range covered by the map.
+  bool Set(const void* ptr, int size_class) {
+    const uintptr_t slab = SlabIndex(ptr);
+    if (slab >= kNumSlabs) return false;
+    mutex_lock l(mu_);
+    std::atomic<uint8_t*>& leaf = root_[slab / kLeafSize];
+    if (leaf.load(std::memory_order_relaxed) == nullptr) {
+      leaf.store(new uint8_t[kLeafSize](), std::memory_order_release);
+    }
+    leaf.load(std::memory_order_relaxed)[slab % kLeafSize] = size_class + 1;
+    return true;
+  }
+
+ private:
+  // Covers the 48-bit virtual address spaces of current 64-bit platforms.
+  static constexpr uintptr_t kNumSlabs =
+      (uint64_t{1} << 48) / ThreadCachingCPUAllocator::kSlabBytes;
+  static constexpr uintptr_t kLeafSize = 1 << 14;
+
+  static uintptr_t SlabIndex(const void* ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) /
+           ThreadCachingCPUAllocator::kSlabBytes;
+  }
+
+  mutex mu_;
+  std::atomic<uint8_t*> root_[(kNumSlabs + kLeafSize - 1) / kLeafSize] = {};
+};
+
+// The process-wide pool of free blocks shared by all thread caches.
+class CentralPool {
+ public:
+  static CentralPool* Get() {
+    static CentralPool* pool = new CentralPool;
+    return pool;
+  }
+
+  // Moves up to `max_blocks` free blocks of `size_class` to `*list`, carving
+  // a new slab if needed. Returns the number of blocks moved, which is zero
+  // only if no slab could be allocated.
+  int Fetch(int size_class, int max_blocks, FreeList* list) {
+    ClassList& pool_list = lists_[size_class];
+    mutex_lock l(pool_list.mu);
+    if (pool_list.free.head == nullptr && !AddSlab(size_class, &pool_list)) {
+      return 0;
+    }
+    int moved = 0;
+    while (moved < max_blocks && pool_list.free.head != nullptr) {
+      FreeBlock* block = pool_list.free.head;
+      pool_list.free.head = block->next;
+      block->next = list->head;
+      list->head = block;
+      ++moved;
+    }
+    pool_list.free.count -= moved;
+    list->count += moved;
+    return moved;
+  }
+
+  // Returns the first `num_blocks` blocks of `*list` to the pool.
+  void Release(int size_class, int num_blocks, FreeList* list) {
+    if (num_blocks == 0) return;
+    DCHECK_LE(num_blocks, list->count);
+    FreeBlock* first = list->head;
+    FreeBlock* last = first;
+    for (int i = 1; i < num_blocks; ++i) last = last->next;
+    list->head = last->next;
+    list->count -= num_blocks;
+
+    ClassList& pool_list = lists_[size_class];
+    mutex_lock l(pool_list.mu);
+    last->next = pool_list.free.head;
+    pool_list.free.head = first;
+    pool_list.free.count += num_blocks;
+  }
+
+  // Returns the size class of `ptr`, or -1 if it was not allocated from a
+  // slab.
+  int SizeClassOf(const void* ptr) const { return slab_map_.Get(ptr); }
+
+  int64_t slab_bytes() const {
+    return slab_bytes_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct ClassList {
+    mutex mu;
+    FreeList free TF_GUARDED_BY(mu);
+  };
+
+  bool AddSlab(int size_class, ClassList* pool_list)
+      TF_EXCLUSIVE_LOCKS_REQUIRED(pool_list->mu) {
+    tsl::profiler::TraceMe traceme("ThreadCachingCPUAllocator::AddSlab");
+    constexpr size_t kSlabBytes = ThreadCachingCPUAllocator::kSlabBytes;
+    char* slab =
+        static_cast<char*>(port::AlignedMalloc(kSlabBytes, kSlabBytes));
+    if (slab == nullptr) return false;
+    if (!slab_map_.Set(slab, size_class)) {
+      port::AlignedFree(slab);
+      return false;
+    }
+    slab_bytes_.fetch_add(kSlabBytes, std::memory_order_relaxed);
+    const size_t block_bytes = ClassBytes(size_class);
+    const int num_blocks = kSlabBytes / block_bytes;
+    // Link the blocks in address order.
+    for (int i = num_blocks - 1; i >= 0; --i) {
+      FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + i * block_bytes);
+      block->next = pool_list->free.head;
+      pool_list->free.head = block;
+    }
+    pool_list->free.count += num_blocks;
+    return true;
+  }
+
+  ClassList lists_[kNumSizeClasses];
+  SlabMap slab_map_;
+  std::atomic<int64_t> slab_bytes_{0};
+};
+
+// The free blocks owned by a thread, returned to the pool when it exits.
+struct ThreadCache {
+  ~ThreadCache();
+
+  FreeList lists[kNumSizeClasses];
+};
+
+// Set once the calling thread's cache has been destroyed, after which its
+// remaining deallocations go directly to the pool.
+thread_local bool thread_cache_destroyed = false;
+
+ThreadCache::~ThreadCache() {
+  for (int c = 0; c < kNumSizeClasses; ++c) {
+    CentralPool::Get()->Release(c, lists[c].count, &lists[c]);
+  }
+  thread_cache_destroyed = true;
+}
+
+ThreadCache* GetThreadCache() {
+  if (thread_cache_destroyed) return nullptr;
+  static thread_local ThreadCache cache;
+  return &cache;
+}
+
+}  // namespace
+
+void* ThreadCachingCPUAllocator::AllocateRaw(size_t alignment,
+                                             size_t num_bytes) {
+  if (alignment <= kAllocatorAlignment && num_bytes <= kMaxCachedBytes) {
+    const int size_class = SizeClass(num_bytes);
+    ThreadCache* cache = GetThreadCache();
+    FreeList local_list;
+    FreeList& list = cache != nullptr ? cache->lists[size_class] : local_list;
+    const int batch_blocks = cache != nullptr ? BatchBlocks(size_class) : 1;
+    if (list.head != nullptr ||
+        CentralPool::Get()->Fetch(size_class, batch_blocks, &list) > 0) {
+      FreeBlock* block = list.head;
+      list.head = block->next;
+      --list.count;
+      if (CPUAllocatorStatsEnabled()) {
+        RecordAllocation(ClassBytes(size_class));
+      }
+      return block;
+    }
+    // Fall back to malloc if no slab could be allocated.
+  }
+  void* p = port::AlignedMalloc(num_bytes, alignment);
+  if (CPUAllocatorStatsEnabled() && p != nullptr) {
+    RecordAllocation(port::MallocExtension_GetAllocatedSize(p));
+  }
+  return p;
+}
+
+void ThreadCachingCPUAllocator::DeallocateRaw(void* ptr) {
+  if (ptr == nullptr) return;
+  CentralPool* pool = CentralPool::Get();
+  const int size_class = pool->SizeClassOf(ptr);
+  if (size_class < 0) {
+    if (CPUAllocatorStatsEnabled()) {
+      RecordDeallocation(port::MallocExtension_GetAllocatedSize(ptr));
+    }
+    port::AlignedFree(ptr);
+    return;
+  }
+  if (CPUAllocatorStatsEnabled()) {
+    RecordDeallocation(ClassBytes(size_class));
+  }
+  ThreadCache* cache = GetThreadCache();
+  FreeList local_list;
+  FreeList& list = cache != nullptr ? cache->lists[size_class] : local_list;
+  FreeBlock* block = static_cast<FreeBlock*>(ptr);
+  block->next = list.head;
+  list.head = block;
+  ++list.count;
+  if (cache == nullptr) {
+    pool->Release(size_class, 1, &list);
+    return;
+  }
+  const int batch_blocks = BatchBlocks(size_class);
+  if (list.count > 2 * batch_blocks) {
+    pool->Release(size_class, batch_blocks, &list);
+  }
+}
+
+void ThreadCachingCPUAllocator::RecordAllocation(size_t bytes) {
+  mutex_lock l(mu_);
+  ++stats_.num_allocs;
+  stats_.bytes_in_use += bytes;
+  stats_.peak_bytes_in_use =
+      std::max<int64_t>(stats_.peak_bytes_in_use, stats_.bytes_in_use);
+  stats_.largest_alloc_size =
+      std::max<int64_t>(stats_.largest_alloc_size, bytes);
+}
+
+void ThreadCachingCPUAllocator::RecordDeallocation(size_t bytes) {
+  mutex_lock l(mu_);
+  stats_.bytes_in_use -= bytes;
+}
+
+absl::optional<AllocatorStats> ThreadCachingCPUAllocator::GetStats() {
+  if (!CPUAllocatorStatsEnabled()) return absl::nullopt;
+  AllocatorStats stats;
+  {
+    mutex_lock l(mu_);
+    stats = stats_;
+  }
+  // Slabs are never released, so the pool never shrinks.
+  stats.pool_bytes = CentralPool::Get()->slab_bytes();
+  stats.peak_pool_bytes = stats.pool_bytes;
+  return stats;
+}
+
+bool ThreadCachingCPUAllocator::ClearStats() {
+  if (!CPUAllocatorStatsEnabled()) return false;
+  mutex_lock l(mu_);
+  stats_.num_allocs = 0;
+  stats_.peak_bytes_in_use = stats_.bytes_in_use;
+  stats_.largest_alloc_size = 0;
+  return true;
+}
+
+size_t ThreadCachingCPUAllocator::AllocatedSizeSlow(const void* ptr) const {
+  const int size_class = CentralPool::Get()->SizeClassOf(ptr);
+  return size_class < 0 ? port::MallocExtension_GetAllocatedSize(ptr)
+                        : ClassBytes(size_class);
+}
+
+size_t ThreadCachingCPUAllocator::RoundedBytes(size_t num_bytes) {
+  return num_bytes > kMaxCachedBytes ? 0 : ClassBytes(SizeClass(num_bytes));
+}
+
+bool ThreadCachingCPUAllocatorEnabled() {
+  static const bool enabled = [] {
+    const char* value = std::getenv("TF_CPU_ALLOCATOR_USE_THREAD_CACHE");
+    return value != nullptr && (absl::EqualsIgnoreCase(value, "true") ||
+                                std::strcmp(value, "1") == 0);
+  }();
+  return enabled;
+}
+
+namespace {
+
+class ThreadCachingCPUAllocatorFactory : public AllocatorFactory {
+ public:
+  Allocator* CreateAllocator() override {
+    return new ThreadCachingCPUAllocator;
+  }
+
+  SubAllocator* CreateSubAllocator(int numa_node) override {
+    return new ThreadCachingCPUSubAllocator(new ThreadCachingCPUAllocator);
+  }
+
+ private:
+  class ThreadCachingCPUSubAllocator : public SubAllocator {
+   public:
+    explicit ThreadCachingCPUSubAllocator(ThreadCachingCPUAllocator* allocator)
+        : SubAllocator({}, {}), allocator_(allocator) {}
+
+    void* Alloc(size_t alignment, size_t num_bytes,
+                size_t* bytes_received) override {
+      *bytes_received = num_bytes;
+      return allocator_->AllocateRaw(alignment, num_bytes);
+    }
+
+    void Free(void* ptr, size_t num_bytes) override {
+      allocator_->DeallocateRaw(ptr);
+    }
+
+    bool SupportsCoalescing() const override { return false; }
+
+    AllocatorMemoryType GetMemoryType() const override {
+      return allocator_->GetMemoryType();
+    }
+
+   private:
+    std::unique_ptr<ThreadCachingCPUAllocator> allocator_;
+  };
+};
+
+// Takes precedence over DefaultCPUAllocator, and any other CPU allocator, only
+// when enabled.
+REGISTER_MEM_ALLOCATOR("ThreadCachingCPUAllocator",
+                       ThreadCachingCPUAllocatorEnabled() ? 250 : 50,
+                       ThreadCachingCPUAllocatorFactory);
+
+}  // namespace
+
+}  // namespace tsl
@@ -0,0 +1,94 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_TSL_FRAMEWORK_THREAD_CACHING_CPU_ALLOCATOR_H_
+#define TENSORFLOW_TSL_FRAMEWORK_THREAD_CACHING_CPU_ALLOCATOR_H_
+
+#include <cstddef>
+#include <string>
+
+#include "absl/types/optional.h"
+#include "tsl/framework/allocator.h"
+#include "tsl/platform/mutex.h"
+#include "tsl/platform/thread_annotations.h"
+
+namespace tsl {
+
+// A CPU Allocator for workloads dominated by small, short-lived allocations
+// made from many threads, such as the intermediate tensors of inference
+// graphs.
+//
+// Requests of up to kMaxCachedBytes with an alignment of at most
+// kAllocatorAlignment are rounded up to one of a fixed set of size classes
+// and served from a free list private to the calling thread. Thread caches
+// refill from and return to a process-wide pool in batches, so the pool's
+// per-class locks are taken once per batch instead of once per allocation.
+// The pool carves blocks out of kSlabBytes slabs, which are kept for reuse
+// rather than returned to the system. Larger or more strictly aligned
+// requests go directly to port::AlignedMalloc.
+//
+// All instances share the same pool and thread caches; memory allocated by
+// one instance may be deallocated by another.
+//
+// The allocator registered with AllocatorFactoryRegistry under the name
+// "ThreadCachingCPUAllocator" takes precedence over the default CPU allocator
+// if the environment variable TF_CPU_ALLOCATOR_USE_THREAD_CACHE is true.
+class ThreadCachingCPUAllocator : public Allocator {
+ public:
+  // Largest request served from the thread caches.
+  static constexpr size_t kMaxCachedBytes = 256 << 10;
+  // Size and alignment of the slabs that cached blocks are carved from.
+  static constexpr size_t kSlabBytes = 2 << 20;
+
+  ThreadCachingCPUAllocator() = default;
+  ~ThreadCachingCPUAllocator() override = default;
+
+  std::string Name() override { return "cpu_thread_caching"; }
+
+  void* AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void DeallocateRaw(void* ptr) override;
+
+  // Statistics are only collected if CPUAllocatorStatsEnabled().
+  absl::optional<AllocatorStats> GetStats() override;
+  bool ClearStats() override;
+
+  size_t AllocatedSizeSlow(const void* ptr) const override;
+
+  AllocatorMemoryType GetMemoryType() const override {
+    return AllocatorMemoryType::kHostPageable;
+  }
+
+  // Returns the number of bytes used by a cached request of `num_bytes`, or 0
+  // if such requests are not cached.
+  static size_t RoundedBytes(size_t num_bytes);
+
+ private:
+  void RecordAllocation(size_t bytes);
+  void RecordDeallocation(size_t bytes);
+
+  mutex mu_;
+  AllocatorStats stats_ TF_GUARDED_BY(mu_);
+
+  ThreadCachingCPUAllocator(const ThreadCachingCPUAllocator&) = delete;
+  void operator=(const ThreadCachingCPUAllocator&) = delete;
+};
+
+// Returns true if TF_CPU_ALLOCATOR_USE_THREAD_CACHE enables
+// ThreadCachingCPUAllocator as the default CPU allocator.
+bool ThreadCachingCPUAllocatorEnabled();
+
+}  // namespace tsl
+
+#endif  // TENSORFLOW_TSL_FRAMEWORK_THREAD_CACHING_CPU_ALLOCATOR_H_
@@ -0,0 +1,230 @@
+/* Copyright 2023 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tsl/framework/thread_caching_cpu_allocator.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "absl/types/optional.h"
+#include "tsl/framework/allocator.h"
+#include "tsl/framework/allocator_registry.h"
+#include "tsl/platform/env.h"
+#include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
+
+namespace tsl {
+namespace {
+
+bool IsAligned(const void* ptr, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+TEST(ThreadCachingCPUAllocatorTest, RoundedBytes) {
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(0), 64);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(1), 64);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(64), 64);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(65), 128);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(1024), 1024);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(1025), 1280);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(2048), 2048);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(2049), 2560);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(100000), 114688);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(
+                ThreadCachingCPUAllocator::kMaxCachedBytes),
+            ThreadCachingCPUAllocator::kMaxCachedBytes);
+  EXPECT_EQ(ThreadCachingCPUAllocator::RoundedBytes(
+                ThreadCachingCPUAllocator::kMaxCachedBytes + 1),
+            0);
+
+  // Size classes waste at most a quarter of the rounded size.
+  for (size_t bytes = 1; bytes <= ThreadCachingCPUAllocator::kMaxCachedBytes;
+       bytes += 61) {
+    const size_t rounded = ThreadCachingCPUAllocator::RoundedBytes(bytes);
+    EXPECT_GE(rounded, bytes);
+    EXPECT_EQ(rounded % Allocator::kAllocatorAlignment, 0);
+    EXPECT_LT(rounded - bytes, std::max<size_t>(64, rounded / 4)) << bytes;
+  }
+}
+
+TEST(ThreadCachingCPUAllocatorTest, AllocateAndDeallocate) {
+  ThreadCachingCPUAllocator allocator;
+  std::vector<std::pair<void*, size_t>> ptrs;
+  for (size_t bytes : {size_t{1}, size_t{64}, size_t{1000}, size_t{4097},
+                       ThreadCachingCPUAllocator::kMaxCachedBytes,
+                       ThreadCachingCPUAllocator::kMaxCachedBytes + 1,
+                       size_t{8} << 20}) {
+    for (int i = 0; i < 100; ++i) {
+      void* ptr =
+          allocator.AllocateRaw(Allocator::kAllocatorAlignment, bytes);
+      ASSERT_NE(ptr, nullptr);
+      EXPECT_TRUE(IsAligned(ptr, Allocator::kAllocatorAlignment));
+      if (ThreadCachingCPUAllocator::RoundedBytes(bytes) > 0) {
+        EXPECT_EQ(allocator.AllocatedSizeSlow(ptr),
+                  ThreadCachingCPUAllocator::RoundedBytes(bytes));
+      }
+      memset(ptr, i, bytes);
+      ptrs.emplace_back(ptr, bytes);
+    }
+  }
+  // Blocks must not overlap.
+  std::sort(ptrs.begin(), ptrs.end());
+  for (int i = 1; i < ptrs.size(); ++i) {
+    EXPECT_GE(static_cast<char*>(ptrs[i].first) -
+                  static_cast<char*>(ptrs[i - 1].first),
+              ptrs[i - 1].second);
+  }
+  for (const auto& ptr : ptrs) allocator.DeallocateRaw(ptr.first);
+  allocator.DeallocateRaw(nullptr);
+}
+
+TEST(ThreadCachingCPUAllocatorTest, ReusesCachedBlocks) {
+  ThreadCachingCPUAllocator allocator;
+  void* first = allocator.AllocateRaw(Allocator::kAllocatorAlignment, 300);
+  allocator.DeallocateRaw(first);
+  void* second = allocator.AllocateRaw(Allocator::kAllocatorAlignment, 280);
+  EXPECT_EQ(first, second);
+  allocator.DeallocateRaw(second);
+}
+
+TEST(ThreadCachingCPUAllocatorTest, OveralignedRequests) {
+  ThreadCachingCPUAllocator allocator;
+  for (size_t alignment : {128, 4096}) {
+    void* ptr = allocator.AllocateRaw(alignment, 100);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_TRUE(IsAligned(ptr, alignment));
+    allocator.DeallocateRaw(ptr);
+  }
+}
+
+TEST(ThreadCachingCPUAllocatorTest, CrossThreadAndCrossInstanceFrees) {
+  ThreadCachingCPUAllocator allocator;
+  ThreadCachingCPUAllocator other_allocator;
+  std::vector<void*> ptrs;
+  {
+    std::unique_ptr<Thread> thread(Env::Default()->StartThread(
+        ThreadOptions(), "allocate", [&allocator, &ptrs]() {
+          for (int i = 0; i < 10000; ++i) {
+            ptrs.push_back(allocator.AllocateRaw(
+                Allocator::kAllocatorAlignment, 64 + i % 4000));
+          }
+        }));
+  }
+  // The allocating thread has exited and returned its cache to the pool.
+  for (void* ptr : ptrs) other_allocator.DeallocateRaw(ptr);
+}
+
+TEST(ThreadCachingCPUAllocatorTest, Stats) {
+  EnableCPUAllocatorStats();
+  ThreadCachingCPUAllocator allocator;
+  void* small = allocator.AllocateRaw(Allocator::kAllocatorAlignment, 100);
+  void* large = allocator.AllocateRaw(Allocator::kAllocatorAlignment, 1 << 20);
+  absl::optional<AllocatorStats> stats = allocator.GetStats();
+  ASSERT_TRUE(stats.has_value());
+  EXPECT_EQ(stats->num_allocs, 2);
+  EXPECT_EQ(stats->bytes_in_use, 128 + allocator.AllocatedSizeSlow(large));
+  EXPECT_EQ(stats->peak_bytes_in_use, stats->bytes_in_use);
+  EXPECT_GE(stats->largest_alloc_size, 128);
+  EXPECT_GE(stats->pool_bytes, ThreadCachingCPUAllocator::kSlabBytes);
+
+  allocator.DeallocateRaw(large);
+  allocator.DeallocateRaw(small);
+  stats = allocator.GetStats();
+  EXPECT_EQ(stats->bytes_in_use, 0);
+  EXPECT_GT(stats->peak_bytes_in_use, 0);
+
+  EXPECT_TRUE(allocator.ClearStats());
+  stats = allocator.GetStats();
+  EXPECT_EQ(stats->num_allocs, 0);
+  EXPECT_EQ(stats->peak_bytes_in_use, 0);
+  EXPECT_EQ(stats->largest_alloc_size, 0);
+  DisableCPUAllocatorStats();
+  EXPECT_FALSE(allocator.GetStats().has_value());
+}
+
+TEST(ThreadCachingCPUAllocatorTest, ManyThreads) {
+  ThreadCachingCPUAllocator allocator;
+  std::vector<std::unique_ptr<Thread>> threads;
+  for (int t = 0; t < 16; ++t) {
+    threads.emplace_back(Env::Default()->StartThread(
+        ThreadOptions(), "stress", [&allocator, t]() {
+          std::vector<void*> live;
+          for (int i = 0; i < 20000; ++i) {
+            const size_t bytes = 1 + (i * 7919 + t * 104729) % 20000;
+            char* ptr = static_cast<char*>(
+                allocator.AllocateRaw(Allocator::kAllocatorAlignment, bytes));
+            ptr[0] = static_cast<char>(t);
+            ptr[bytes - 1] = static_cast<char>(t);
+            live.push_back(ptr);
+            if (live.size() > 64) {
+              char* old = static_cast<char*>(live[i % 64]);
+              CHECK_EQ(old[0], static_cast<char>(t));
+              allocator.DeallocateRaw(old);
+              live[i % 64] = live.back();
+              live.pop_back();
+            }
+          }
+          for (void* ptr : live) allocator.DeallocateRaw(ptr);
+        }));
+  }
+}
+
+TEST(ThreadCachingCPUAllocatorTest, Registered) {
+  Allocator* allocator = AllocatorFactoryRegistry::singleton()->GetAllocator();
+  EXPECT_EQ(allocator->Name(), ThreadCachingCPUAllocatorEnabled()
+                                   ? "cpu_thread_caching"
+                                   : "cpu");
+}
+
+// Each thread repeatedly allocates and frees batches of small, variously
+// sized buffers, as the ops of an inference graph do for their temporaries.
+void BenchmarkAllocator(::testing::benchmark::State& state,
+                        Allocator* allocator) {
+  const int num_live = 32;
+  std::vector<void*> live(num_live);
+  int64_t i = state.thread_index();
+  for (auto s : state) {
+    for (int j = 0; j < num_live; ++j, ++i) {
+      live[j] = allocator->AllocateRaw(Allocator::kAllocatorAlignment,
+                                       64 + (i * 2654435761) % state.range(0));
+    }
+    for (void* ptr : live) allocator->DeallocateRaw(ptr);
+  }
+  state.SetItemsProcessed(state.iterations() * num_live);
+}
+
+void BM_ThreadCachingCPUAllocator(::testing::benchmark::State& state) {
+  static ThreadCachingCPUAllocator* allocator = new ThreadCachingCPUAllocator;
+  BenchmarkAllocator(state, allocator);
+}
+BENCHMARK(BM_ThreadCachingCPUAllocator)
+    ->Arg(1 << 10)
+    ->Arg(64 << 10)
+    ->ThreadRange(1, 16);
+
+void BM_DefaultCPUAllocator(::testing::benchmark::State& state) {
+  BenchmarkAllocator(state, cpu_allocator());
+}
+BENCHMARK(BM_DefaultCPUAllocator)
+    ->Arg(1 << 10)
+    ->Arg(64 << 10)
+    ->ThreadRange(1, 16);
+
+}  // namespace
+}  // namespace tsl
@@ -16,14 +16,22 @@ limitations under the License.
 #include "tsl/lib/io/record_reader.h"
 
 #include <limits.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <utility>
 
 #include "tsl/lib/hash/crc32c.h"
 #include "tsl/lib/io/buffered_inputstream.h"
 #include "tsl/lib/io/compression.h"
 #include "tsl/lib/io/random_inputstream.h"
+#include "tsl/platform/cpu_info.h"
 #include "tsl/platform/env.h"
 #include "tsl/platform/errors.h"
+#include "tsl/platform/notification.h"
 #include "tsl/platform/raw_coding.h"
+#include "tsl/platform/threadpool.h"
 
 namespace tsl {
 namespace io {
@@ -58,7 +66,8 @@ RecordReader::RecordReader(RandomAccessFile* file,
                            const RecordReaderOptions& options)
     : options_(options),
       input_stream_(new RandomAccessInputStream(file)),
-      last_read_failed_(false) {
+      last_read_failed_(false),
+      file_(file) {
   if (options.buffer_size > 0) {
     input_stream_.reset(new BufferedInputStream(input_stream_.release(),
                                                 options.buffer_size, true));
@@ -92,8 +101,70 @@ inline const char* GetChecksumErrorSuffix(uint64 offset) {
   }
   return "";
 }
+
+// Largest block ReadRecords() reads, and prefetches, at once. Readers of
+// cloud file systems are given stream buffers of over 100MB, which would make
+// each readahead just as large.
+constexpr size_t kMaxBlockSize = 8 << 20;
+
+// Runs the block reads of readers without a readahead_runner. Each reader has
+// at most one read in flight.
+void ScheduleReadahead(std::function<void()> fn) {
+  static thread::ThreadPool* pool = new thread::ThreadPool(
+      Env::Default(), "record_readahead", port::MaxParallelism());
+  pool->Schedule(std::move(fn));
+}
+
+// Reads up to "n" bytes at "offset" of "file" into "*block". The result is
+// shorter than "n" only at the end of the file.
+Status ReadBlock(RandomAccessFile* file, uint64 offset, size_t n,
+                 std::string* block) {
+  block->resize(n);
+  StringPiece result;
+  Status s = file->Read(offset, n, &result, &(*block)[0]);
+  if (!s.ok() && !errors::IsOutOfRange(s)) {
+    block->clear();
+    return s;
+  }
+  if (!result.empty() && result.data() != block->data()) {
+    memmove(&(*block)[0], result.data(), result.size());
+  }
+  block->resize(result.size());
+  return OkStatus();
+}
 }  // namespace
 
+// State of ReadRecords() for uncompressed files: a window of file bytes that
+// is refilled block by block, and the read of the block after it that is
+// running in the background.
+struct RecordReader::BlockReadState {
+  BlockReadState(size_t block_size,
+                 std::function<void(std::function<void()>)> runner)
+      : block_size(block_size), runner(std::move(runner)) {}
+
+  const size_t block_size;
+  const std::function<void(std::function<void()>)> runner;
+
+  // The file bytes [window_offset, window_offset + window.size()).
+  std::string window;
+  uint64 window_offset = 0;
+
+  // Pending read of "block_size" bytes at "ahead_offset" into "ahead". Both
+  // are owned by the readahead closure until "ahead_done" is notified.
+  std::unique_ptr<Notification> ahead_done;
+  uint64 ahead_offset = 0;
+  std::string ahead;
+  Status ahead_status;
+};
+
+RecordReader::~RecordReader() { WaitForReadahead(); }
+
+void RecordReader::WaitForReadahead() {
+  if (block_state_ != nullptr && block_state_->ahead_done != nullptr) {
+    block_state_->ahead_done->WaitForNotification();
+  }
+}
+
 // Read n+4 bytes from file, verify that checksum of first n bytes is
 // stored in the last 4 bytes and store the first n bytes in *result.
 //
@@ -223,6 +294,147 @@ Status RecordReader::ReadRecord(uint64* offset, tstring* record) {
   return OkStatus();
 }
 
+Status RecordReader::FillWindow(uint64 offset, size_t n) {
+  BlockReadState* state = block_state_.get();
+  const uint64 window_end = state->window_offset + state->window.size();
+  if (offset >= state->window_offset && offset + n <= window_end) {
+    return OkStatus();
+  }
+  if (offset < state->window_offset || offset > window_end) {
+    state->window.clear();
+  } else {
+    // Keeps the start of the record at "offset" that is already buffered.
+    state->window.erase(0, offset - state->window_offset);
+  }
+  state->window_offset = offset;
+
+  bool at_eof = false;
+  while (state->window.size() < n) {
+    const uint64 end = state->window_offset + state->window.size();
+    std::string block;
+    size_t requested = 0;
+    if (state->ahead_done != nullptr) {
+      state->ahead_done->WaitForNotification();
+      state->ahead_done.reset();
+      if (state->ahead_offset == end && state->ahead_status.ok()) {
+        block.swap(state->ahead);
+        requested = state->block_size;
+      }
+    }
+    if (requested == 0) {
+      // No usable readahead: read synchronously, at least up to "n".
+      requested = std::max(state->block_size, n - state->window.size());
+      TF_RETURN_IF_ERROR(ReadBlock(file_, end, requested, &block));
+    }
+    state->window.append(block);
+    if (block.size() < requested) {
+      at_eof = true;
+      break;
+    }
+  }
+
+  // Prefetches the next block while the caller parses this one.
+  if (!at_eof && state->ahead_done == nullptr) {
+    state->ahead_offset = state->window_offset + state->window.size();
+    state->ahead_done = std::make_unique<Notification>();
+    Notification* done = state->ahead_done.get();
+    RandomAccessFile* file = file_;
+    state->runner([state, done, file]() {
+      state->ahead_status = ReadBlock(file, state->ahead_offset,
+                                      state->block_size, &state->ahead);
+      done->Notify();
+    });
+  }
+  return OkStatus();
+}
+
+Status RecordReader::ReadRecordFromWindow(uint64* offset, tstring* record) {
+  BlockReadState* state = block_state_.get();
+  // FillWindow() leaves "*offset" inside the window, or at its end at EOF.
+  auto available = [state, offset]() -> uint64 {
+    return state->window_offset + state->window.size() - *offset;
+  };
+
+  // Reads and checks the header.
+  TF_RETURN_IF_ERROR(FillWindow(*offset, kHeaderSize));
+  if (available() < kHeaderSize) {
+    if (available() == 0) {
+      return errors::OutOfRange("eof", GetChecksumErrorSuffix(*offset));
+    }
+    return errors::DataLoss("truncated record at ", *offset,
+                            GetChecksumErrorSuffix(*offset));
+  }
+  const char* header =
+      state->window.data() + (*offset - state->window_offset);
+  if (crc32c::Unmask(core::DecodeFixed32(header + sizeof(uint64))) !=
+      crc32c::Value(header, sizeof(uint64))) {
+    return errors::DataLoss("corrupted record at ", *offset,
+                            GetChecksumErrorSuffix(*offset));
+  }
+  const uint64 length = core::DecodeFixed64(header);
+  if (length >= SIZE_MAX - kHeaderSize - kFooterSize) {
+    return errors::DataLoss("record size too large",
+                            GetChecksumErrorSuffix(*offset));
+  }
+
+  // Checks the payload in place, then copies it into "*record".
+  const size_t record_size = kHeaderSize + length + kFooterSize;
+  TF_RETURN_IF_ERROR(FillWindow(*offset, record_size));
+  if (available() < record_size) {
+    return errors::DataLoss("truncated record at ", *offset);
+  }
+  const char* data =
+      state->window.data() + (*offset - state->window_offset) + kHeaderSize;
+  if (crc32c::Unmask(core::DecodeFixed32(data + length)) !=
+      crc32c::Value(data, length)) {
+    return errors::DataLoss("corrupted record at ", *offset,
+                            GetChecksumErrorSuffix(*offset));
+  }
+  record->assign(data, length);
+  *offset += record_size;
+  return OkStatus();
+}
+
+Status RecordReader::ReadRecords(uint64* offset, int max_records,
+                                 std::vector<tstring>* records) {
+  records->clear();
+  if (options_.buffer_size <= 0) {
+    // Unbuffered reads never go past the record that is returned.
+    records->emplace_back();
+    Status s = ReadRecord(offset, &records->back());
+    if (!s.ok()) records->clear();
+    return s;
+  }
+
+  const size_t block_size =
+      std::min<uint64>(options_.buffer_size, kMaxBlockSize);
+  const bool use_window =
+      options_.compression_type == RecordReaderOptions::NONE;
+  if (use_window && block_state_ == nullptr) {
+    block_state_ = std::make_unique<BlockReadState>(
+        block_size, options_.readahead_runner ? options_.readahead_runner
+                                              : ScheduleReadahead);
+  }
+  // Bounds the records to about one block, however large they are.
+  size_t num_bytes = 0;
+  Status s;
+  while (records->size() < static_cast<size_t>(max_records) &&
+         num_bytes < block_size) {
+    records->emplace_back();
+    tstring* record = &records->back();
+    s = use_window ? ReadRecordFromWindow(offset, record)
+                   : ReadRecord(offset, record);
+    if (!s.ok()) {
+      records->pop_back();
+      break;
+    }
+    num_bytes += record->size();
+  }
+  // Records read before an error are returned; the error is hit again, and
+  // returned, by the next call.
+  return records->empty() ? s : OkStatus();
+}
+
 Status RecordReader::SkipRecords(uint64* offset, int num_to_skip,
                                  int* num_skipped) {
   TF_RETURN_IF_ERROR(PositionInputStream(*offset));
@@ -16,6 +16,11 @@ limitations under the License.
 #ifndef TENSORFLOW_TSL_LIB_IO_RECORD_READER_H_
 #define TENSORFLOW_TSL_LIB_IO_RECORD_READER_H_
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "tsl/lib/io/inputstream_interface.h"
 #include "tsl/platform/errors.h"
 #include "tsl/platform/stringpiece.h"
@@ -46,6 +51,10 @@ struct RecordReaderOptions {
   // compressed files.) Consider using SequentialRecordReader.
   int64_t buffer_size = 0;
 
+  // Runs the background block reads of RecordReader::ReadRecords(). If unset,
+  // a thread pool shared by all readers in the process is used.
+  std::function<void(std::function<void()>)> readahead_runner;
+
   static RecordReaderOptions CreateRecordReaderOptions(
       const string& compression_type);
 
@@ -89,13 +98,30 @@ class RecordReader {
       tsl::RandomAccessFile* file,
       const RecordReaderOptions& options = RecordReaderOptions());
 
-  virtual ~RecordReader() = default;
+  virtual ~RecordReader();
 
   // Read the record at "*offset" into *record and update *offset to
   // point to the offset of the next record.  Returns OK on success,
   // OUT_OF_RANGE for end of file, or something else for an error.
   Status ReadRecord(uint64* offset, tstring* record);
 
+  // Replace "*records" with up to "max_records" records read starting at
+  // "*offset" and update *offset to point to the offset of the next unread
+  // record. Stops early once the records hold a block's worth of bytes.
+  // Without buffering (buffer_size of 0) at most one record is read.
+  //
+  // For uncompressed files this bypasses the per-record stream reads: the
+  // file is read in blocks of "buffer_size" bytes, capped at 8MB, the next
+  // block is prefetched in the background while the current one is parsed,
+  // and the CRCs are verified on the block before each payload is copied
+  // into its output string.
+  //
+  // Returns OK if at least one record was read, OUT_OF_RANGE for end of file,
+  // or something else for an error. An error hit after some records have been
+  // read is returned by the next call, so no valid record is lost.
+  Status ReadRecords(uint64* offset, int max_records,
+                     std::vector<tstring>* records);
+
   // Skip num_to_skip record starting at "*offset" and update *offset
   // to point to the offset of the next num_to_skip + 1 record.
   // Return OK on success, OUT_OF_RANGE for end of file, or something
@@ -115,7 +141,16 @@ class RecordReader {
   Status GetMetadata(Metadata* md);
 
  private:
+  struct BlockReadState;
+
   Status ReadChecksummed(uint64 offset, size_t n, tstring* result);
+  // Makes the block window hold the file bytes [offset, offset + n), or as
+  // many of them as the file has, reading ahead of it in the background.
+  Status FillWindow(uint64 offset, size_t n);
+  // Reads the record at "*offset" from the block window into "*record".
+  Status ReadRecordFromWindow(uint64* offset, tstring* record);
+  // Waits for a pending background block read, if any.
+  void WaitForReadahead();
   Status PositionInputStream(uint64 offset);
 
   RecordReaderOptions options_;
@@ -123,6 +158,9 @@ class RecordReader {
   bool last_read_failed_;
 
   std::unique_ptr<Metadata> cached_metadata_;
+  RandomAccessFile* const file_;  // Not owned.
+  // State of ReadRecords() for uncompressed files, created on first use.
+  std::unique_ptr<BlockReadState> block_state_;
 
   RecordReader(const RecordReader&) = delete;
   void operator=(const RecordReader&) = delete;
@@ -147,6 +185,13 @@ class SequentialRecordReader {
     return underlying_.ReadRecord(&offset_, record);
   }
 
+  // Replace *records with up to max_records of the next records in the file.
+  // Returns OK if at least one record was read, OUT_OF_RANGE for end of file,
+  // or something else for an error.
+  Status ReadRecords(int max_records, std::vector<tstring>* records) {
+    return underlying_.ReadRecords(&offset_, max_records, records);
+  }
+
   // Skip the next num_to_skip record in the file. Return OK on success,
   // OUT_OF_RANGE for end of file, or something else for an error.
   // "*num_skipped" records the number of records that are actually skipped.
@@ -23,6 +23,7 @@ limitations under the License.
 #include "tsl/platform/errors.h"
 #include "tsl/platform/str_util.h"
 #include "tsl/platform/test.h"
+#include "tsl/platform/test_benchmark.h"
 
 namespace tsl {
 namespace io {
@@ -372,6 +373,195 @@ TEST_F(RecordioTest, ReadEnd) { CheckOffsetPastEndReturnsNoRecords(0); }
 
 TEST_F(RecordioTest, ReadPastEnd) { CheckOffsetPastEndReturnsNoRecords(5); }
 
+void TestReadRecords(const RecordWriterOptions& writer_options,
+                     const RecordReaderOptions& reader_options) {
+  const int N = 500;
+  const int kMaxRecords = 7;
+  string contents;
+  StringDest dst(&contents);
+  {
+    RecordWriter writer(&dst, writer_options);
+    random::PhiloxRandom philox(301, 17);
+    random::SimplePhilox rnd(&philox);
+    for (int i = 0; i < N; i++) {
+      TF_ASSERT_OK(writer.WriteRecord(RandomSkewedString(i, &rnd)));
+    }
+    TF_ASSERT_OK(writer.Close());
+  }
+
+  StringSource file(&contents);
+  RecordReader reader(&file, reader_options);
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  uint64 offset = 0;
+  std::vector<tstring> records;
+  // Unbuffered readers return one record at a time.
+  const size_t max_size = reader_options.buffer_size > 0 ? kMaxRecords : 1;
+  int num_read = 0;
+  while (true) {
+    Status s = reader.ReadRecords(&offset, kMaxRecords, &records);
+    if (errors::IsOutOfRange(s)) break;
+    TF_ASSERT_OK(s);
+    ASSERT_GT(records.size(), 0);
+    ASSERT_LE(records.size(), max_size);
+    for (const tstring& record : records) {
+      ASSERT_EQ(RandomSkewedString(num_read++, &rnd), record);
+    }
+  }
+  EXPECT_EQ(N, num_read);
+  EXPECT_TRUE(records.empty());
+
+  // Single-record and batch reads can be mixed.
+  std::vector<string> expected;
+  {
+    random::PhiloxRandom philox(301, 17);
+    random::SimplePhilox rnd(&philox);
+    for (int i = 0; i < kMaxRecords + 2; i++) {
+      expected.push_back(RandomSkewedString(i, &rnd));
+    }
+  }
+  offset = 0;
+  tstring record;
+  TF_ASSERT_OK(reader.ReadRecord(&offset, &record));
+  EXPECT_EQ(expected[0], record);
+  TF_ASSERT_OK(reader.ReadRecords(&offset, kMaxRecords, &records));
+  EXPECT_EQ(expected[1], records[0]);
+  TF_ASSERT_OK(reader.ReadRecord(&offset, &record));
+  EXPECT_EQ(expected[1 + records.size()], record);
+}
+
+TEST_F(RecordioTest, ReadRecords) {
+  RecordReaderOptions options;
+  options.buffer_size = 256 << 10;
+  TestReadRecords(RecordWriterOptions(), options);
+}
+
+TEST_F(RecordioTest, ReadRecordsUnbuffered) {
+  TestReadRecords(RecordWriterOptions(), RecordReaderOptions());
+}
+
+TEST_F(RecordioTest, ReadRecordsWithSmallBlocks) {
+  // Most records span several blocks.
+  RecordReaderOptions options;
+  options.buffer_size = 100;
+  TestReadRecords(RecordWriterOptions(), options);
+}
+
+TEST_F(RecordioTest, ReadRecordsWithCompression) {
+  RecordReaderOptions options =
+      RecordReaderOptions::CreateRecordReaderOptions("ZLIB");
+  options.buffer_size = 256 << 10;
+  TestReadRecords(RecordWriterOptions::CreateRecordWriterOptions("ZLIB"),
+                  options);
+}
+
+TEST_F(RecordioTest, ReadRecordsUsesReadaheadRunner) {
+  int num_scheduled = 0;
+  RecordReaderOptions options;
+  options.buffer_size = 100;
+  options.readahead_runner = [&num_scheduled](std::function<void()> fn) {
+    ++num_scheduled;
+    fn();
+  };
+  TestReadRecords(RecordWriterOptions(), options);
+  EXPECT_GT(num_scheduled, 0);
+}
+
+TEST_F(RecordioTest, ReadRecordsReturnsValidRecordsBeforeError) {
+  string contents;
+  StringDest dst(&contents);
+  {
+    RecordWriter writer(&dst);
+    TF_ASSERT_OK(writer.WriteRecord("foo"));
+    TF_ASSERT_OK(writer.WriteRecord("bar"));
+    TF_ASSERT_OK(writer.Close());
+  }
+  // Corrupts the payload of "bar".
+  contents[contents.size() - 6] += 1;
+
+  StringSource file(&contents);
+  RecordReaderOptions options;
+  options.buffer_size = 256 << 10;
+  RecordReader reader(&file, options);
+  uint64 offset = 0;
+  std::vector<tstring> records;
+  TF_ASSERT_OK(reader.ReadRecords(&offset, 10, &records));
+  ASSERT_EQ(1, records.size());
+  EXPECT_EQ("foo", records[0]);
+  EXPECT_EQ(RecordReader::kHeaderSize + 3 + RecordReader::kFooterSize, offset);
+
+  Status s = reader.ReadRecords(&offset, 10, &records);
+  AssertHasSubstr(s.ToString(), "corrupted record");
+  EXPECT_TRUE(records.empty());
+}
+
+TEST_F(RecordioTest, ReadRecordsTruncated) {
+  string contents;
+  StringDest dst(&contents);
+  {
+    RecordWriter writer(&dst);
+    TF_ASSERT_OK(writer.WriteRecord(BigString("x", 1000)));
+    TF_ASSERT_OK(writer.Close());
+  }
+  contents.resize(contents.size() - 10);
+
+  StringSource file(&contents);
+  RecordReaderOptions options;
+  options.buffer_size = 256 << 10;
+  RecordReader reader(&file, options);
+  uint64 offset = 0;
+  std::vector<tstring> records;
+  Status s = reader.ReadRecords(&offset, 10, &records);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+  AssertHasSubstr(s.ToString(), "truncated record");
+}
+
+// Reads a file of state.range(0)-byte records one at a time, or in batches of
+// up to 256 records if state.range(1) is non-zero.
+void BM_ReadRecords(::testing::benchmark::State& state) {
+  const int record_size = state.range(0);
+  const bool batched = state.range(1) != 0;
+  const int64_t kFileSize = 256 << 20;
+  Env* env = Env::Default();
+  const string fname = testing::TmpDir() + "/recordio_benchmark";
+  {
+    std::unique_ptr<WritableFile> file;
+    TF_CHECK_OK(env->NewWritableFile(fname, &file));
+    RecordWriter writer(file.get());
+    const string record = BigString("abcdefghij", record_size);
+    for (int64_t written = 0; written < kFileSize; written += record_size) {
+      TF_CHECK_OK(writer.WriteRecord(record));
+    }
+    TF_CHECK_OK(writer.Close());
+  }
+  uint64 file_size = 0;
+  TF_CHECK_OK(env->GetFileSize(fname, &file_size));
+
+  RecordReaderOptions options;
+  options.buffer_size = 256 << 10;
+  for (auto s : state) {
+    std::unique_ptr<RandomAccessFile> file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+    SequentialRecordReader reader(file.get(), options);
+    Status status;
+    if (batched) {
+      std::vector<tstring> records;
+      while ((status = reader.ReadRecords(256, &records)).ok()) {
+        testing::DoNotOptimize(records.back());
+      }
+    } else {
+      tstring record;
+      while ((status = reader.ReadRecord(&record)).ok()) {
+        testing::DoNotOptimize(record);
+      }
+    }
+    CHECK(errors::IsOutOfRange(status)) << status;
+  }
+  state.SetBytesProcessed(state.iterations() * file_size);
+}
+
+BENCHMARK(BM_ReadRecords)->ArgsProduct({{100, 1 << 10, 64 << 10}, {0, 1}});
+
 }  // namespace
 }  // namespace io
 }  // namespace tsl